@@ -0,0 +1,131 @@
+#ifndef FLASH_QUEUE_H
+#define FLASH_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Log-structured FIFO of variable length records in NOR flash, used to
+// keep telemetry across connectivity loss and reboots. No ESP-IDF
+// dependencies: storage is reached through flash_queue_storage_t, so the
+// queue also runs on a host against a RAM model of the flash (see
+// tools/flash_queue_sim.c). The esp_partition backend is in
+// flash_queue_partition.h.
+//
+// The storage is a ring of erase sectors used strictly in turn, which
+// spreads erases evenly. Each sector starts with a header holding a
+// sequence number that grows by one per sector opened, so mount finds the
+// oldest and newest sector without any other metadata. The header repeats
+// the sequence number inverted, so a header torn by power loss doesn't
+// match. Records are appended behind each other and never span sectors:
+//   u8   marker (FLASH_QUEUE_RECORD_MARKER)
+//   u8   consumed (0xFF pending, 0x00 once popped)
+//   u16  length
+//   u32  CRC-32 of length and data
+//   ...  data, padded to 4 bytes
+// Popping a record only clears its consumed byte, which NOR flash allows
+// without an erase. A record cut short by power loss fails its CRC and is
+// skipped, a header that isn't plausible ends its sector. When the ring is
+// full the oldest sector is dropped, pending records in it included.
+//
+// Not thread safe, callers serialize access.
+
+#define FLASH_QUEUE_SECTOR_MAGIC    0x51544C46  // "FLTQ"
+#define FLASH_QUEUE_RECORD_MARKER   0xA5
+#define FLASH_QUEUE_SECTOR_HEADER   12
+#define FLASH_QUEUE_RECORD_HEADER   8
+#define FLASH_QUEUE_MIN_SECTORS     2
+
+// Queue return values
+#define FLASH_QUEUE_OK              0
+#define FLASH_QUEUE_ERR_IO          -1  // Storage operation failed
+#define FLASH_QUEUE_ERR_EMPTY       -2  // No pending record
+#define FLASH_QUEUE_ERR_SIZE        -3  // Record too large, or buffer too small
+#define FLASH_QUEUE_ERR_STORAGE     -4  // Storage geometry unusable
+
+// Storage backend, offsets are relative to the start of the queue area
+typedef struct {
+    int (*read)(void* ctx, uint32_t offset, void* buf, size_t len);
+    int (*write)(void* ctx, uint32_t offset, const void* buf, size_t len);
+    int (*erase)(void* ctx, uint32_t offset, size_t len);   // Whole sectors
+    void* ctx;
+    uint32_t size;              // Multiple of sector_size
+    uint32_t sector_size;
+} flash_queue_storage_t;
+
+// Counters since mount
+typedef struct {
+    uint32_t pending;           // Records not popped yet
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped;           // Pending records lost to ring wrap
+    uint32_t corrupt;           // Records that failed their CRC
+    uint32_t erases;
+} flash_queue_stats_t;
+
+// Queue state, kept in RAM and rebuilt by flash_queue_mount()
+typedef struct {
+    flash_queue_storage_t storage;
+    uint32_t sector_count;
+    uint32_t head_seq;          // Sequence number of the head sector
+    uint32_t head_sector;       // Sector appended to
+    uint32_t head_offset;       // Next free byte in it
+    uint32_t tail_sector;       // Oldest sector holding data
+    uint32_t read_sector;       // Oldest record that may still be pending
+    uint32_t read_offset;
+    size_t peeked_size;         // Record size behind the last peek, 0 if none
+    flash_queue_stats_t stats;
+} flash_queue_t;
+
+// ============================================
+// Queue
+// ============================================
+
+/**
+ * Rebuild the queue state from storage, formats blank or foreign storage
+ * @return FLASH_QUEUE_OK, FLASH_QUEUE_ERR_STORAGE or FLASH_QUEUE_ERR_IO
+ */
+int flash_queue_mount(flash_queue_t* q, const flash_queue_storage_t* storage);
+
+/**
+ * Erase all records
+ * @return FLASH_QUEUE_OK or FLASH_QUEUE_ERR_IO
+ */
+int flash_queue_format(flash_queue_t* q);
+
+/**
+ * Append a record, dropping the oldest sector if the ring is full
+ * @return FLASH_QUEUE_OK, FLASH_QUEUE_ERR_SIZE if len exceeds
+ *         flash_queue_max_record(), or FLASH_QUEUE_ERR_IO
+ */
+int flash_queue_push(flash_queue_t* q, const void* data, size_t len);
+
+/**
+ * Copy the oldest pending record without removing it
+ * @param buf Output buffer
+ * @param size Size of buf
+ * @param len Output record length
+ * @return FLASH_QUEUE_OK, FLASH_QUEUE_ERR_EMPTY, FLASH_QUEUE_ERR_SIZE if
+ *         buf is too small (len is set, flash_queue_pop() skips the
+ *         record), or FLASH_QUEUE_ERR_IO
+ */
+int flash_queue_peek(flash_queue_t* q, void* buf, size_t size, size_t* len);
+
+/**
+ * Remove the record returned by the last flash_queue_peek()
+ * @return FLASH_QUEUE_OK, FLASH_QUEUE_ERR_EMPTY without a peeked record,
+ *         or FLASH_QUEUE_ERR_IO
+ */
+int flash_queue_pop(flash_queue_t* q);
+
+/**
+ * Largest record the geometry allows
+ */
+size_t flash_queue_max_record(const flash_queue_t* q);
+
+/**
+ * Get counters since mount
+ */
+void flash_queue_get_stats(const flash_queue_t* q, flash_queue_stats_t* stats);
+
+#endif // FLASH_QUEUE_H
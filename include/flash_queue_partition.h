@@ -0,0 +1,24 @@
+#ifndef FLASH_QUEUE_PARTITION_H
+#define FLASH_QUEUE_PARTITION_H
+
+#include "esp_err.h"
+#include "flash_queue.h"
+
+// flash_queue storage backend on a data partition (esp_partition API).
+// The partition must not be encrypted: popping a record rewrites a single
+// byte, which encrypted partitions don't allow.
+
+// ============================================
+// Partition Backend
+// ============================================
+
+/**
+ * Fill a storage backend for a data partition
+ * @param label Partition label (see partitions.csv)
+ * @param storage Output backend for flash_queue_mount()
+ * @return ESP_OK, ESP_ERR_NOT_FOUND without such a partition,
+ *         ESP_ERR_NOT_SUPPORTED if it's encrypted
+ */
+esp_err_t flash_queue_partition_storage(const char* label, flash_queue_storage_t* storage);
+
+#endif // FLASH_QUEUE_PARTITION_H
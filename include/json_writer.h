@@ -0,0 +1,66 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streaming JSON writer into a caller-owned buffer, no heap use.
+// Output is byte-for-byte what cJSON_PrintUnformatted() prints for the
+// same tree: numbers use cJSON's "%d" / "%1.15g" / "%1.17g" selection and
+// strings get cJSON's escaping, so consumers can't tell the two apart.
+
+#define JSON_WRITER_MAX_DEPTH   8
+
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t len;
+    bool overflow;              // Output didn't fit, the buffer holds a truncated document
+    int depth;
+    bool first[JSON_WRITER_MAX_DEPTH];     // No member written yet at this level
+} json_writer_t;
+
+// ============================================
+// Document
+// ============================================
+
+/**
+ * Start a document in buf
+ * @param w Writer state
+ * @param buf Output buffer, NUL terminated after every call
+ * @param size Size of buf
+ */
+void json_writer_init(json_writer_t* w, char* buf, size_t size);
+
+/**
+ * Finish the document
+ * @return The NUL terminated document, NULL if it didn't fit or isn't closed
+ */
+const char* json_writer_finish(json_writer_t* w);
+
+// ============================================
+// Containers
+// ============================================
+
+/**
+ * Open an object or array, as a member of the current object when key is
+ * set, as an element otherwise
+ */
+void json_begin_object(json_writer_t* w, const char* key);
+void json_end_object(json_writer_t* w);
+void json_begin_array(json_writer_t* w, const char* key);
+void json_end_array(json_writer_t* w);
+
+// ============================================
+// Values
+// ============================================
+
+/**
+ * Add a value, as a member of the current object when key is set, as an
+ * array element otherwise. A NULL string is left out, as cJSON does.
+ */
+void json_add_string(json_writer_t* w, const char* key, const char* value);
+void json_add_number(json_writer_t* w, const char* key, double value);
+void json_add_bool(json_writer_t* w, const char* key, bool value);
+
+#endif // JSON_WRITER_H
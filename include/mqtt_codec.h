@@ -0,0 +1,229 @@
+#ifndef MQTT_CODEC_H
+#define MQTT_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// MQTT 3.1.1 packet codec. Packets are written into caller supplied buffers,
+// nothing is allocated. No ESP-IDF dependencies so it also builds on a host.
+
+// Codec return values (encoders return the packet length when positive)
+#define MQTT_CODEC_INCOMPLETE       0   // Decoder needs more bytes
+#define MQTT_CODEC_ERR_BUFFER       -1  // Output buffer too small
+#define MQTT_CODEC_ERR_MALFORMED    -2  // Invalid packet or argument
+
+#define MQTT_MAX_REMAINING_LENGTH   268435455   // 4 byte varint limit
+#define MQTT_MAX_FIXED_HEADER       5
+#define MQTT_INFLIGHT_MAX           8           // Tracked QoS 1 packets
+
+// Control packet types
+typedef enum {
+    MQTT_PKT_CONNECT = 1,
+    MQTT_PKT_CONNACK,
+    MQTT_PKT_PUBLISH,
+    MQTT_PKT_PUBACK,
+    MQTT_PKT_PUBREC,
+    MQTT_PKT_PUBREL,
+    MQTT_PKT_PUBCOMP,
+    MQTT_PKT_SUBSCRIBE,
+    MQTT_PKT_SUBACK,
+    MQTT_PKT_UNSUBSCRIBE,
+    MQTT_PKT_UNSUBACK,
+    MQTT_PKT_PINGREQ,
+    MQTT_PKT_PINGRESP,
+    MQTT_PKT_DISCONNECT
+} mqtt_packet_type_t;
+
+// CONNACK return codes
+typedef enum {
+    MQTT_CONNACK_ACCEPTED = 0,
+    MQTT_CONNACK_BAD_PROTOCOL,
+    MQTT_CONNACK_ID_REJECTED,
+    MQTT_CONNACK_SERVER_UNAVAILABLE,
+    MQTT_CONNACK_BAD_CREDENTIALS,
+    MQTT_CONNACK_NOT_AUTHORIZED
+} mqtt_connack_code_t;
+
+// CONNECT options
+typedef struct {
+    const char* client_id;
+    const char* username;       // NULL or "" to omit
+    const char* password;       // NULL or "" to omit
+    uint16_t keepalive;         // Seconds
+    bool clean_session;
+} mqtt_connect_options_t;
+
+// Decoded packet, body points into the decoder's input buffer
+typedef struct {
+    uint8_t type;               // mqtt_packet_type_t
+    uint8_t flags;              // Low nibble of the fixed header
+    uint32_t remaining_length;
+    const uint8_t* body;        // Variable header + payload
+    size_t total_length;        // Fixed header + remaining length
+} mqtt_packet_t;
+
+// Decoded PUBLISH
+typedef struct {
+    const char* topic;          // Not NUL terminated
+    uint16_t topic_len;
+    const uint8_t* payload;
+    size_t payload_len;
+    uint8_t qos;
+    bool retain;
+    bool dup;
+    uint16_t packet_id;         // 0 for QoS 0
+} mqtt_publish_t;
+
+// Packet identifier allocation and QoS 1 in-flight tracking
+typedef struct {
+    uint16_t next_id;
+    uint16_t inflight[MQTT_INFLIGHT_MAX];   // 0 = free slot
+} mqtt_session_t;
+
+// ============================================
+// Variable Length Integer
+// ============================================
+
+/**
+ * Encode a remaining length as an MQTT varint (1-4 bytes)
+ * @param value Value to encode (max MQTT_MAX_REMAINING_LENGTH)
+ * @param out Output buffer, at least 4 bytes
+ * @return Number of bytes written, MQTT_CODEC_ERR_MALFORMED if too large
+ */
+int mqtt_encode_varint(uint32_t value, uint8_t* out);
+
+/**
+ * Decode an MQTT varint
+ * @param in Input bytes
+ * @param len Number of input bytes available
+ * @param value Decoded value
+ * @return Bytes consumed, MQTT_CODEC_INCOMPLETE, or MQTT_CODEC_ERR_MALFORMED
+ */
+int mqtt_decode_varint(const uint8_t* in, size_t len, uint32_t* value);
+
+// ============================================
+// Encoders
+// ============================================
+
+/**
+ * Encode a CONNECT packet
+ * @return Packet length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_connect(uint8_t* buf, size_t size, const mqtt_connect_options_t* opts);
+
+/**
+ * Encode the part of a PUBLISH packet that precedes the payload
+ * Lets large payloads be streamed straight from their own buffer.
+ * @param payload_len Length of the payload that will follow
+ * @param packet_id Packet identifier, ignored for QoS 0
+ * @return Header length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_publish_header(uint8_t* buf, size_t size, const char* topic,
+                               size_t payload_len, uint8_t qos, bool retain,
+                               uint16_t packet_id);
+
+/**
+ * Encode a complete PUBLISH packet
+ * @return Packet length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_publish(uint8_t* buf, size_t size, const char* topic,
+                        const void* payload, size_t payload_len, uint8_t qos,
+                        bool retain, uint16_t packet_id);
+
+/**
+ * Encode a SUBSCRIBE packet for a single topic filter
+ * @return Packet length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_subscribe(uint8_t* buf, size_t size, uint16_t packet_id,
+                          const char* topic, uint8_t qos);
+
+/**
+ * Encode a PUBACK packet
+ * @return Packet length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_puback(uint8_t* buf, size_t size, uint16_t packet_id);
+
+/**
+ * Encode a packet without variable header (PINGREQ, DISCONNECT)
+ * @return Packet length or a negative MQTT_CODEC_ERR_* value
+ */
+int mqtt_encode_empty(uint8_t* buf, size_t size, mqtt_packet_type_t type);
+
+// ============================================
+// Decoders
+// ============================================
+
+/**
+ * Frame one packet from a byte stream
+ * @param buf Received bytes
+ * @param len Number of bytes available
+ * @param pkt Decoded packet (body points into buf)
+ * @return Packet length, MQTT_CODEC_INCOMPLETE, or MQTT_CODEC_ERR_MALFORMED
+ */
+int mqtt_decode_packet(const uint8_t* buf, size_t len, mqtt_packet_t* pkt);
+
+/**
+ * Decode a CONNACK packet
+ * @param session_present Session present flag
+ * @param return_code mqtt_connack_code_t
+ * @return 0 on success, MQTT_CODEC_ERR_MALFORMED otherwise
+ */
+int mqtt_decode_connack(const mqtt_packet_t* pkt, bool* session_present, uint8_t* return_code);
+
+/**
+ * Decode a SUBACK packet for a single topic filter
+ * @param granted_qos Granted QoS, 0x80 on failure
+ * @return 0 on success, MQTT_CODEC_ERR_MALFORMED otherwise
+ */
+int mqtt_decode_suback(const mqtt_packet_t* pkt, uint16_t* packet_id, uint8_t* granted_qos);
+
+/**
+ * Decode the packet identifier of PUBACK/PUBREC/PUBREL/PUBCOMP/UNSUBACK
+ * @return 0 on success, MQTT_CODEC_ERR_MALFORMED otherwise
+ */
+int mqtt_decode_ack(const mqtt_packet_t* pkt, uint16_t* packet_id);
+
+/**
+ * Decode a PUBLISH packet
+ * @return 0 on success, MQTT_CODEC_ERR_MALFORMED otherwise
+ */
+int mqtt_decode_publish(const mqtt_packet_t* pkt, mqtt_publish_t* publish);
+
+/**
+ * Get a readable description of a CONNACK return code
+ */
+const char* mqtt_connack_reason(uint8_t return_code);
+
+// ============================================
+// Session Helpers
+// ============================================
+
+/**
+ * Reset packet id allocation and drop all in-flight packets
+ */
+void mqtt_session_init(mqtt_session_t* session);
+
+/**
+ * Allocate a packet identifier (never 0, skips in-flight ids)
+ */
+uint16_t mqtt_session_next_id(mqtt_session_t* session);
+
+/**
+ * Track a QoS 1 packet until it's acknowledged
+ * @return true if tracked, false if all in-flight slots are used
+ */
+bool mqtt_session_track(mqtt_session_t* session, uint16_t packet_id);
+
+/**
+ * Mark a packet as acknowledged
+ * @return true if the id was in flight
+ */
+bool mqtt_session_ack(mqtt_session_t* session, uint16_t packet_id);
+
+/**
+ * Get the number of unacknowledged QoS 1 packets
+ */
+int mqtt_session_inflight(const mqtt_session_t* session);
+
+#endif // MQTT_CODEC_H
@@ -2,16 +2,65 @@
 #define MQTT_VEHICLE_CLIENT_H
 
 #include "esp_err.h"
+#include "telemetry_codec.h"
 #include <stdbool.h>
 
 // MQTT Configuration
 #define MQTT_BROKER_URI     "mqtt://103.175.219.138:1883"
+#define MQTT_BROKER_HOST    "103.175.219.138"   // Same broker, SIM808 TCP stack
+#define MQTT_BROKER_PORT    1883
 #define MQTT_USERNAME       "vehicle"
 #define MQTT_PASSWORD       "vehicle123"
 #define MQTT_KEEPALIVE      60
 
+// Persistent session: the broker keeps subscriptions and unacknowledged
+// QoS 1 messages over a disconnect, a reconnect then skips resubscribing.
+// Topic aliases need MQTT 5, whose property bytes on every publish cost
+// more than aliases save unless readings go out at QoS 0 (alias-only),
+// so MQTT 5 is only spoken then (tools/mqtt5_alias_bytes.c)
+#define MQTT_PERSISTENT_SESSION 1
+#define MQTT_SESSION_EXPIRY_S   3600    // MQTT 5, a 3.1.1 session lasts as long as the broker keeps it
+#define MQTT_TOPIC_ALIASES      (MQTT_QOS_READING == 0)
+
 // MQTT Topics
 #define TOPIC_EXCHANGE      "vehicle.exchange"
+#define TOPIC_REGISTRATION  "registration.new"
+
+// Payload buffers (static, see mqtt_vehicle_client.c)
+#define PAYLOAD_BUF_SIZE        512
+#define DIAG_PAYLOAD_BUF_SIZE   4096
+
+// Track batching (track1 encoding): fixes are collected and published as one
+// realtime.track message when the batch is full, its oldest fix is this old,
+// or the vehicle state changes
+#define TRACK_BATCH_POINTS      24      // Max TELEMETRY_TRACK_MAX_POINTS
+#define TRACK_BATCH_MS          120000  // 2 minutes
+
+// Readings taken in the same tracking cycle go out as one realtime.frame
+// message. Set to 1 for the legacy realtime.location/status/battery topics
+#define REALTIME_LEGACY_TOPICS  0
+
+// Store-and-forward: QoS 1 messages published while the broker is
+// unreachable go to a flash queue and are replayed once it's back
+#define BACKLOG_PARTITION       "telemetry"     // See partitions.csv
+#define BACKLOG_REPLAY_BURST    5       // Records per mqtt_replay_backlog() call
+#define BACKLOG_OUTBOX_LIMIT    4096    // Pause replay while esp-mqtt holds more bytes
+
+// Bounded outbox (see outbox_policy.h): esp-mqtt keeps at most
+// MQTT_OUTBOX_LIMIT bytes of unacknowledged messages in RAM, and each
+// message class may only fill its share of that. Reading QoS can drop
+// to 0 once the backend has track batching on, which carries the route
+#define MQTT_OUTBOX_LIMIT       16384   // Bytes
+#define MQTT_QOS_REPORT         1
+#define MQTT_QOS_STATUS         1
+#define MQTT_QOS_TRACK          1
+#define MQTT_QOS_READING        1       // Single fixes, battery
+#define MQTT_QOS_DIAG           0
+#define MQTT_SHARE_REPORT       100     // % of MQTT_OUTBOX_LIMIT
+#define MQTT_SHARE_STATUS       75
+#define MQTT_SHARE_TRACK        50
+#define MQTT_SHARE_READING      25
+#define MQTT_SHARE_DIAG         25
 
 // Message types
 typedef enum {
@@ -37,12 +86,41 @@ void mqtt_vehicle_start(void);
 void mqtt_vehicle_stop(void);
 bool mqtt_vehicle_is_connected(void);
 
+// Publish over the SIM808 TCP stack (sim808_mqtt_*, batched CIPSENDs)
+// instead of esp-mqtt, once sim808_mqtt_connect() succeeded. Subscribes
+// to the control topics now and after every reconnect
+void mqtt_vehicle_use_sim808(void);
+
 void mqtt_publish_location(float latitude, float longitude, float altitude);
 void mqtt_publish_status(bool is_active, bool is_locked, bool is_killed);
 void mqtt_publish_battery(float voltage, float battery_level);
+void mqtt_publish_frame(const telemetry_frame_t* frame, uint64_t timestamp_ms);
 void mqtt_publish_performance(void);
 void mqtt_publish_registration(void);
+void mqtt_publish_modem_diag(void);
+
+// Publish the pending track batch now / once it's due (no-op without one)
+void mqtt_flush_track(void);
+void mqtt_poll_track(void);
+
+// Replay a burst of stored messages (no-op while disconnected)
+void mqtt_replay_backlog(void);
+
+// Send the registration and reports command and connection handlers
+// asked for; publisher task only
+void mqtt_publish_pending(void);
+
+// Consistent copy of the vehicle state, never blocks
+void mqtt_get_vehicle_state(vehicle_state_t* state);
+
+// Apply a scheduled kill (inactive, locked, killed)
+// @return true if a kill was scheduled
+bool mqtt_vehicle_execute_kill(void);
+
+// Current time in ms since the Unix epoch (sample timestamps)
+uint64_t mqtt_get_epoch_ms(void);
 
-vehicle_state_t* mqtt_get_vehicle_state(void);
+// Command dispatch for messages received over another transport (SIM808)
+void mqtt_vehicle_handle_message(const char* topic, const char* data, int data_len);
 
 #endif // MQTT_VEHICLE_CLIENT_H
\ No newline at end of file
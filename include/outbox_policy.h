@@ -0,0 +1,94 @@
+#ifndef OUTBOX_POLICY_H
+#define OUTBOX_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Admission control for esp-mqtt's RAM outbox. Every publish belongs to a
+// message class with its own QoS and share of a hard byte limit: a class
+// is only let into the outbox while the bytes already queued plus its
+// message fit in its share. Classes that are superseded by the next
+// sample get the smallest shares, so a stalled link fills up with stale
+// readings first and the headroom above their share stays free for
+// status changes and performance reports. A refused QoS 1 message is
+// deferred (store-and-forward), a refused QoS 0 message is dropped.
+// No ESP-IDF dependencies (see tools/outbox_policy_sim.c).
+
+// Message classes, highest priority first
+typedef enum {
+    OUTBOX_CLASS_REPORT = 0,    // Performance reports, registration
+    OUTBOX_CLASS_STATUS,        // Status changes and frames carrying one
+    OUTBOX_CLASS_TRACK,         // Track batches
+    OUTBOX_CLASS_READING,       // Single fixes and battery readings
+    OUTBOX_CLASS_DIAG,          // Diagnostics
+    OUTBOX_CLASS_COUNT
+} outbox_class_t;
+
+// What to do with a message
+typedef enum {
+    OUTBOX_SEND = 0,            // Publish
+    OUTBOX_DEFER,               // Keep it elsewhere and retry later
+    OUTBOX_DROP                 // Discard
+} outbox_verdict_t;
+
+typedef struct {
+    uint8_t qos;
+    uint8_t share_pct;          // Of the limit, 100 may use all of it
+} outbox_class_config_t;
+
+// Counters since init
+typedef struct {
+    uint32_t sent;
+    uint32_t deferred;
+    uint32_t dropped;
+} outbox_class_stats_t;
+
+typedef struct {
+    uint32_t limit_bytes;
+    outbox_class_config_t classes[OUTBOX_CLASS_COUNT];
+    outbox_class_stats_t stats[OUTBOX_CLASS_COUNT];
+    uint32_t bytes;             // Outbox size at the last decision
+    uint32_t high_water;        // Largest outbox size admitted into
+} outbox_policy_t;
+
+// ============================================
+// Setup
+// ============================================
+
+/**
+ * Set the limit and per-class QoS and shares, and clear the counters
+ * @param limit_bytes Hard limit of the outbox
+ */
+void outbox_policy_init(outbox_policy_t* p, uint32_t limit_bytes,
+                        const outbox_class_config_t classes[OUTBOX_CLASS_COUNT]);
+
+// ============================================
+// Decisions
+// ============================================
+
+/**
+ * QoS to publish a class at
+ */
+int outbox_policy_qos(const outbox_policy_t* p, outbox_class_t cls);
+
+/**
+ * Decide on a message and count it
+ * @param outbox_bytes Bytes esp-mqtt holds right now
+ * @param len Size of the message
+ * @param can_defer A refused QoS 1 message can be kept (backlog mounted)
+ * @return OUTBOX_SEND, or OUTBOX_DEFER / OUTBOX_DROP when over the class share
+ */
+outbox_verdict_t outbox_policy_admit(outbox_policy_t* p, outbox_class_t cls, uint32_t outbox_bytes,
+                                     uint32_t len, bool can_defer);
+
+/**
+ * Count a message the client refused after admitting it (outbox full)
+ */
+void outbox_policy_refused(outbox_policy_t* p, outbox_class_t cls, outbox_verdict_t verdict);
+
+/**
+ * Get the class name used in diagnostics
+ */
+const char* outbox_class_name(outbox_class_t cls);
+
+#endif // OUTBOX_POLICY_H
@@ -0,0 +1,85 @@
+#ifndef RATE_CONTROLLER_H
+#define RATE_CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Picks the tracking task's sampling and publish intervals from what the
+// vehicle is doing, so a scooter at speed is followed closely and a
+// parked one costs next to nothing. No ESP-IDF dependencies.
+//
+//   MOVING  faster than RATE_MOVING_SPEED
+//   SLOW    faster than RATE_SLOW_SPEED, or the IMU feels motion (pushed,
+//           carried, being stolen)
+//   IDLE    rented but standing still
+//   LOCKED  not rented and standing still
+//
+// A faster tier is taken at once, a slower one only after the vehicle
+// stayed in it for RATE_STEP_DOWN_MS, so a traffic light doesn't drop the
+// rate. The task reads the intervals on every loop, changes apply without
+// restarting anything.
+
+// Tier thresholds
+#define RATE_MOVING_SPEED       15.0f   // km/h
+#define RATE_SLOW_SPEED         3.0f    // km/h, below is GPS noise
+#define RATE_MOTION_THRESHOLD   0.05f   // g, averaged deviation from 1 g
+#define RATE_MOTION_SMOOTHING   0.1f    // Weight of a new IMU sample
+#define RATE_STEP_DOWN_MS       60000   // Calm time before a slower tier
+
+// Rate tiers, fastest first
+typedef enum {
+    RATE_TIER_MOVING = 0,
+    RATE_TIER_SLOW,
+    RATE_TIER_IDLE,
+    RATE_TIER_LOCKED,
+    RATE_TIER_COUNT
+} rate_tier_t;
+
+// Intervals in ms
+typedef struct {
+    uint32_t gps_ms;            // GNSS sampling
+    uint32_t location_ms;       // realtime.location
+    uint32_t status_ms;         // realtime.status
+    uint32_t battery_ms;        // realtime.battery
+} rate_intervals_t;
+
+typedef struct {
+    rate_tier_t tier;
+    rate_intervals_t intervals; // Of the current tier
+    float speed;                // Last speed, km/h
+    float motion;               // Smoothed IMU motion energy, g
+    uint32_t tier_since_ms;     // When the current tier was entered
+    uint32_t slower_since_ms;   // Start of the calm period, 0 if none
+    uint32_t changes;           // Tier changes since init
+} rate_controller_t;
+
+// ============================================
+// Controller
+// ============================================
+
+/**
+ * Start in the SLOW tier, which matches the old fixed intervals
+ * @param now_ms Current time, any monotonic ms clock
+ */
+void rate_controller_init(rate_controller_t* rc, uint32_t now_ms);
+
+/**
+ * Feed an accelerometer sample
+ * @param accel_x Acceleration in g, likewise y and z
+ */
+void rate_controller_add_motion(rate_controller_t* rc, float accel_x, float accel_y, float accel_z);
+
+/**
+ * Re-evaluate the tier
+ * @param speed Ground speed in km/h
+ * @param is_active Vehicle is rented
+ * @return true if the tier, and so the intervals, changed
+ */
+bool rate_controller_update(rate_controller_t* rc, uint32_t now_ms, float speed, bool is_active);
+
+/**
+ * Get a tier's name for logs and diagnostics
+ */
+const char* rate_controller_tier_name(rate_tier_t tier);
+
+#endif // RATE_CONTROLLER_H
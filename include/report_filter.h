@@ -0,0 +1,81 @@
+#ifndef REPORT_FILTER_H
+#define REPORT_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Report-by-exception for the realtime.* topics. The tracking task still
+// samples at its fixed intervals, but a sample is only published when it
+// differs from the last published one by more than a dead-band, or when
+// the heartbeat interval has passed since then so the backend keeps
+// seeing the vehicle alive. No ESP-IDF dependencies (see
+// tools/report_filter_sim.c).
+//
+//   location  moved further than distance_m, or course turned by more than
+//             heading_deg while faster than heading_min_speed (the course
+//             of a parked receiver is noise)
+//   status    any flag changed
+//   battery   voltage moved by more than voltage_v
+//
+// Times are ms from any monotonic clock, wrap-around is handled.
+
+// State shared by every filter
+typedef struct {
+    uint32_t heartbeat_ms;      // Longest silence, 0 disables the heartbeat
+    uint32_t last_ms;           // Time of the last report
+    bool primed;                // A report went out already
+    uint32_t reports;           // Samples published
+    uint32_t heartbeats;        // ...of which only for liveness
+    uint32_t suppressed;        // Samples inside the dead-band
+} report_filter_t;
+
+typedef struct {
+    report_filter_t base;
+    float distance_m;
+    float heading_deg;
+    float heading_min_speed;    // km/h
+    float latitude;             // Last report
+    float longitude;
+    float course;
+} report_location_filter_t;
+
+typedef struct {
+    report_filter_t base;
+    uint8_t flags;              // Last report
+} report_status_filter_t;
+
+typedef struct {
+    report_filter_t base;
+    float voltage_v;
+    float voltage;              // Last report
+} report_battery_filter_t;
+
+// ============================================
+// Setup
+// ============================================
+
+/**
+ * Set dead-bands and heartbeat, the first sample is always reported
+ * @param heartbeat_ms Longest silence in ms, 0 for none
+ */
+void report_location_filter_init(report_location_filter_t* f, float distance_m, float heading_deg,
+                                 float heading_min_speed, uint32_t heartbeat_ms);
+void report_status_filter_init(report_status_filter_t* f, uint32_t heartbeat_ms);
+void report_battery_filter_init(report_battery_filter_t* f, float voltage_v, uint32_t heartbeat_ms);
+
+// ============================================
+// Decisions
+// ============================================
+
+/**
+ * Check a sample, and take it as the last report when it's due
+ * @param now_ms Sample time
+ * @return true if the sample should be published
+ */
+bool report_location_due(report_location_filter_t* f, uint32_t now_ms, float latitude,
+                         float longitude, float speed, float course);
+bool report_status_due(report_status_filter_t* f, uint32_t now_ms, bool is_active,
+                       bool is_locked, bool is_killed);
+bool report_battery_due(report_battery_filter_t* f, uint32_t now_ms, float voltage);
+
+#endif // REPORT_FILTER_H
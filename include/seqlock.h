@@ -0,0 +1,73 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Double-buffered seqlock for small structs shared between tasks. The
+// owner keeps two copies of the data; seq counts published writes and
+// seq & 1 picks the copy readers use. A writer fills the other copy and
+// publishes it by bumping seq, so readers never wait for a writer, even
+// one preempted half way on the same core. A reader retries only when a
+// write was published while it copied. Writers must be serialized by the
+// owner (a mutex). No ESP-IDF dependencies (see tools/snapshot_stress.c).
+//
+// Writer:
+//   uint32_t cur = seqlock_write_begin(&lock);
+//   data[(cur + 1) & 1] = data[cur & 1];
+//   ...modify data[(cur + 1) & 1]...
+//   seqlock_write_end(&lock);
+//
+// Reader:
+//   uint32_t seq;
+//   do {
+//       seq = seqlock_read_begin(&lock);
+//       copy = data[seq & 1];
+//   } while (seqlock_read_retry(&lock, seq));
+
+typedef struct {
+    _Atomic uint32_t seq;
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t* lock) {
+    atomic_init(&lock->seq, 0);
+}
+
+/**
+ * Start a write
+ * @return Current seq, the copy to write is (seq + 1) & 1
+ */
+static inline uint32_t seqlock_write_begin(seqlock_t* lock) {
+    uint32_t seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    // A reader that sees any store of this write also sees the last publish
+    atomic_thread_fence(memory_order_release);
+    return seq;
+}
+
+/**
+ * Publish the written copy
+ */
+static inline void seqlock_write_end(seqlock_t* lock) {
+    uint32_t seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    atomic_store_explicit(&lock->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Start a read
+ * @return Seq to pass to seqlock_read_retry(), the copy to read is seq & 1
+ */
+static inline uint32_t seqlock_read_begin(const seqlock_t* lock) {
+    return atomic_load_explicit(&((seqlock_t*)lock)->seq, memory_order_acquire);
+}
+
+/**
+ * Check a read
+ * @return true if a write was published meanwhile and the copy may be torn
+ */
+static inline bool seqlock_read_retry(const seqlock_t* lock, uint32_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&((seqlock_t*)lock)->seq, memory_order_relaxed) != seq;
+}
+
+#endif // SEQLOCK_H
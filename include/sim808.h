@@ -4,6 +4,7 @@
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_err.h"
+#include "sim808_gnss.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -11,24 +12,106 @@
 #define SIM808_UART_NUM         UART_NUM_2
 #define SIM808_TX_PIN           GPIO_NUM_17
 #define SIM808_RX_PIN           GPIO_NUM_16
-#define SIM808_BAUD_RATE        9600
+#define SIM808_BAUD_RATE        9600    // Power-on default, lowest fallback
 #define SIM808_BUF_SIZE         1024
 
+// Baud rate negotiation (AT+IPR), result is kept in NVS for warm boots
+#define SIM808_BAUD_NEGOTIATION 1
+#define SIM808_BAUD_VERIFY_PROBES 3     // "AT" probes that must pass at a new rate
+#define SIM808_BAUD_FALLBACK_PROBES 10  // "AT" probes judging the rate after link errors
+#define SIM808_NVS_NAMESPACE    "sim808"
+
+// GNSS streaming (AT+CGNSTST=1) instead of AT+CGNSINF polling
+#define SIM808_GNSS_STREAMING   1
+#define SIM808_GNSS_STALE_MS    3000    // Streamed fix older than this is invalid
+
+// MQTT over the SIM808 TCP socket
+#define SIM808_CIPSEND_MAX      1460    // Largest single AT+CIPSEND / CIPRXGET block
+#define SIM808_MQTT_RX_BUF_SIZE 1024    // Largest inbound MQTT packet
+#define SIM808_MQTT_TOPIC_MAX   128
+#define SIM808_MQTT_RESEND_MAX  768     // Largest QoS 1 PUBLISH kept for a resend, per in-flight slot
+#define SIM808_MQTT_KEEPALIVE   60      // Seconds
+#define SIM808_MQTT_ACK_TIMEOUT_MS 10000
+#define SIM808_MQTT_PING_IDLE_MS (SIM808_MQTT_KEEPALIVE * 1000 / 2)  // Quiet time before PINGREQ
+#define SIM808_MQTT_TICK_MS     1000    // Receive task keepalive check period
+#define SIM808_MQTT_RX_POLL_MS  5000    // Fallback CIPRXGET poll if a URC was missed
+#define SIM808_MQTT_RX_TASK_STACK_SIZE 4096
+#define SIM808_MQTT_RX_TASK_PRIORITY 7
+#define SIM808_MQTT_RECONNECT_MIN_MS 2000   // First retry after a lost connection
+#define SIM808_MQTT_RECONNECT_MAX_MS 120000 // Backoff doubles up to this
+
+// Transparent mode (AT+CIPMODE=1): the UART is a raw pipe to the broker
+// while connected. AT commands still work but each one escapes with +++
+// and returns with ATO, about two seconds, and NMEA streaming is paused.
+// Neither applies under the CMUX multiplexer, see sim808_cmux.h.
+#define SIM808_MQTT_TRANSPARENT 0
+#define SIM808_MQTT_CLOSED_CONFIRM_MS 1000  // Quiet after an in-band CLOSED before checking it
+
+// GPRS bearer
+#define SIM808_GPRS_MAX_ATTEMPTS        5
+#define SIM808_GPRS_BACKOFF_BASE_MS     1000
+#define SIM808_GPRS_BACKOFF_MAX_MS      30000
+#define SIM808_GPRS_REG_TIMEOUT_MS      30000   // Wait for CREG per attempt
+#define SIM808_GPRS_ATTACH_TIMEOUT_MS   10000   // AT+CGATT=1
+#define SIM808_GPRS_OPEN_TIMEOUT_MS     30000   // AT+SAPBR=1,1
+
+// Publish batching: several PUBLISH packets share one CIPSEND handshake
+#define SIM808_BATCH_WINDOW_MS      200     // Collect publishes this long
+#define SIM808_BATCH_MAX_MESSAGES   8
+#define SIM808_BATCH_TASK_STACK_SIZE 4096
+#define SIM808_BATCH_TASK_PRIORITY  6
+
 // SIM808 Control Pins
 #define SIM808_POWER_PIN        GPIO_NUM_4
 #define SIM808_RST_PIN          GPIO_NUM_2
 
-// GPS Data Structure
+// Callback for streamed GNSS fixes, runs in the AT RX task (keep it short)
+typedef void (*sim808_gps_fix_cb_t)(const sim808_gps_data_t* fix, void* arg);
+
+// Handler for inbound PUBLISH messages, called from the MQTT receive task.
+// The topic is NUL terminated, data is not.
+typedef void (*sim808_mqtt_message_handler_t)(const char* topic, const char* data, int data_len);
+
+// Called from the MQTT receive task after it reconnected a lost connection.
+// The session is clean, so subscriptions have to be made again here.
+typedef void (*sim808_mqtt_connect_handler_t)(void);
+
+// Completion callback for a batched publish, result of the CIPSEND carrying it.
+// The message is handed back (topic NUL terminated) so a failed one can be
+// kept elsewhere; both pointers are only valid during the call.
+typedef void (*sim808_publish_cb_t)(esp_err_t result, const char* topic, const void* payload,
+                                    size_t len, void* arg);
+
+// Publish batching statistics
+typedef struct {
+    uint32_t messages;          // Publishes queued through the batcher
+    uint32_t sends;             // CIPSEND handshakes used for them
+    uint32_t handshakes_saved;  // messages - sends
+    uint32_t failed_messages;   // Publishes whose CIPSEND failed
+} sim808_batch_stats_t;
+
+// GPRS bearer state machine
+typedef enum {
+    SIM808_BEARER_IDLE = 0,     // Not connected, no attempt running
+    SIM808_BEARER_REGISTERING,  // Waiting for CREG home/roaming
+    SIM808_BEARER_ATTACHING,    // Waiting for CGATT
+    SIM808_BEARER_OPENING,      // SAPBR=1,1 in progress
+    SIM808_BEARER_CONNECTED,
+    SIM808_BEARER_BACKOFF,      // Waiting before the next attempt
+} sim808_bearer_state_t;
+
+// GPRS connection metrics
 typedef struct {
-    bool valid;              // GPS fix status
-    float latitude;          // Latitude in degrees (negative = South)
-    float longitude;         // Longitude in degrees (negative = West)
-    float altitude;          // Altitude in meters
-    float speed;             // Speed in km/h
-    int satellites;          // Number of satellites in view
-    char timestamp[20];      // ISO8601 timestamp (YYYY-MM-DDTHH:MM:SSZ)
-    char date[11];           // Date (YYYY-MM-DD)
-} sim808_gps_data_t;
+    uint32_t attempts;          // sim808_gprs_connect() calls
+    uint32_t connects;          // Successful calls
+    uint32_t fast_path_hits;    // Calls that found the bearer already up
+    uint32_t retries;           // Backoff retries
+    uint32_t failures;          // Calls that gave up
+    uint32_t last_connect_ms;   // Time to connect of the last success
+    uint32_t min_connect_ms;
+    uint32_t max_connect_ms;
+    uint32_t total_connect_ms;  // Divide by connects for the mean
+} sim808_gprs_stats_t;
 
 // GPRS Configuration Structure
 typedef struct {
@@ -70,22 +153,37 @@ esp_err_t sim808_power_on(void);
  */
 esp_err_t sim808_power_off(void);
 
+/**
+ * Negotiate the fastest stable baud rate with AT+IPR
+ * Tries the rate ladder from the top, verifies each step with AT probes
+ * and stores the result in NVS and the modem profile (AT&W)
+ * @return ESP_OK on success, ESP_FAIL if no rate could be verified
+ */
+esp_err_t sim808_negotiate_baud(void);
+
+/**
+ * Get the current UART baud rate of the SIM808 link
+ * @return Baud rate in bits per second
+ */
+uint32_t sim808_get_baud_rate(void);
+
 // ============================================
 // AT Command Functions
 // ============================================
 
 /**
  * Send AT command and get response
+ * Returns as soon as the final result code arrives (see sim808_at_exec)
  * @param cmd Command string to send
  * @param response Buffer to store response
  * @param response_size Size of response buffer
  * @param timeout_ms Timeout in milliseconds
- * @return ESP_OK on success, ESP_ERR_TIMEOUT on timeout
+ * @return ESP_OK on "OK", ESP_FAIL on an error final, ESP_ERR_TIMEOUT on timeout
  */
 esp_err_t sim808_send_command(const char* cmd, char* response, size_t response_size, uint32_t timeout_ms);
 
 /**
- * Wait for specific response string
+ * Wait for a line starting with a specific response string
  * @param expected Expected response string
  * @param timeout_ms Timeout in milliseconds
  * @return true if expected response received, false otherwise
@@ -110,11 +208,32 @@ esp_err_t sim808_gps_power_off(void);
 
 /**
  * Get GPS data
+ * While streaming, returns the latest streamed fix without an AT round-trip
  * @param data Pointer to GPS data structure
  * @return ESP_OK on success with valid fix, ESP_FAIL on error or no fix
  */
 esp_err_t sim808_gps_get_data(sim808_gps_data_t* data);
 
+/**
+ * Start continuous NMEA output (AT+CGNSTST=1)
+ * @param callback Called for every completed fix (may be NULL)
+ * @param arg User argument passed to the callback
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if GPS is off, ESP_FAIL on error
+ */
+esp_err_t sim808_gps_stream_start(sim808_gps_fix_cb_t callback, void* arg);
+
+/**
+ * Stop continuous NMEA output
+ * @return ESP_OK on success
+ */
+esp_err_t sim808_gps_stream_stop(void);
+
+/**
+ * Check if NMEA streaming is active
+ * @return true if streaming, false if polling with AT+CGNSINF
+ */
+bool sim808_gps_is_streaming(void);
+
 /**
  * Check if GPS has valid fix
  * @return true if GPS has fix, false otherwise
@@ -127,8 +246,11 @@ bool sim808_gps_has_fix(void);
 
 /**
  * Connect to GPRS network
+ * Reuses a live bearer without touching it (AT+SAPBR=2,1). Otherwise it
+ * waits for registration and attach, then opens the bearer. Failed
+ * attempts are retried with jittered exponential backoff.
  * @param config GPRS configuration (APN, username, password)
- * @return ESP_OK on success, ESP_FAIL on error
+ * @return ESP_OK on success, ESP_FAIL after SIM808_GPRS_MAX_ATTEMPTS
  */
 esp_err_t sim808_gprs_connect(sim808_gprs_config_t* config);
 
@@ -138,12 +260,31 @@ esp_err_t sim808_gprs_connect(sim808_gprs_config_t* config);
  */
 esp_err_t sim808_gprs_disconnect(void);
 
+/**
+ * Forget the cached bearer profile and state
+ * Called when the modem powers on, off or restarts (RDY), since it keeps
+ * the SAPBR=3 profile only until then.
+ */
+void sim808_gprs_reset_state(void);
+
 /**
  * Check if GPRS is connected
  * @return true if connected, false otherwise
  */
 bool sim808_gprs_is_connected(void);
 
+/**
+ * Get the bearer state machine state
+ * @return Current state
+ */
+sim808_bearer_state_t sim808_gprs_get_state(void);
+
+/**
+ * Get GPRS time-to-connect metrics
+ * @param stats Pointer to statistics structure to fill
+ */
+void sim808_gprs_get_stats(sim808_gprs_stats_t* stats);
+
 // ============================================
 // MQTT Functions (via AT commands)
 // ============================================
@@ -162,13 +303,60 @@ esp_err_t sim808_mqtt_connect(sim808_mqtt_config_t* config);
 esp_err_t sim808_mqtt_disconnect(void);
 
 /**
- * Publish message to MQTT topic
+ * Publish message to MQTT topic (QoS 0)
  * @param topic MQTT topic string
  * @param payload Message payload (JSON string)
  * @return ESP_OK on success, ESP_FAIL on error
  */
 esp_err_t sim808_mqtt_publish(const char* topic, const char* payload);
 
+/**
+ * Publish message to MQTT topic with a given QoS
+ * Payloads larger than one CIPSEND are split across several sends.
+ * QoS 1 publishes are kept until their PUBACK is received and sent again,
+ * DUP set, after an automatic reconnect. The session is clean, so this is
+ * at least once while this device stays up; a new sim808_mqtt_connect()
+ * or a reset drops them, and so does a packet over SIM808_MQTT_RESEND_MAX.
+ * @param topic MQTT topic string
+ * @param payload Message payload
+ * @param len Payload length in bytes
+ * @param qos QoS level (0 or 1)
+ * @return ESP_OK on success, ESP_FAIL on error
+ */
+esp_err_t sim808_mqtt_publish_qos(const char* topic, const void* payload, size_t len, int qos);
+
+/**
+ * Queue a publish to share a CIPSEND with others sent shortly after it
+ * The batch goes out SIM808_BATCH_WINDOW_MS after its first message, or
+ * earlier when the next message no longer fits one CIPSEND.
+ * The callback runs on whichever task sends the batch (the batch task, a
+ * later publish, sim808_mqtt_flush() or a reconnect) and must not publish.
+ * Success means the modem took the packet; QoS 1 delivery from there on is
+ * as for sim808_mqtt_publish_qos().
+ * @param topic MQTT topic string (at most SIM808_MQTT_TOPIC_MAX bytes)
+ * @param payload Message payload
+ * @param len Payload length in bytes
+ * @param qos QoS level (0 or 1)
+ * @param callback Called with the send result once the batch is sent (may be NULL)
+ * @param arg User argument passed to the callback
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE if not connected,
+ *         ESP_ERR_INVALID_ARG if the topic is too long, ESP_FAIL on error
+ */
+esp_err_t sim808_mqtt_publish_batched(const char* topic, const void* payload, size_t len, int qos,
+                                      sim808_publish_cb_t callback, void* arg);
+
+/**
+ * Send all queued batched publishes immediately
+ * @return ESP_OK on success, ESP_FAIL if the CIPSEND failed
+ */
+esp_err_t sim808_mqtt_flush(void);
+
+/**
+ * Get publish batching statistics
+ * @param stats Pointer to statistics structure to fill
+ */
+void sim808_mqtt_get_batch_stats(sim808_batch_stats_t* stats);
+
 /**
  * Subscribe to MQTT topic
  * @param topic MQTT topic string (can include wildcards)
@@ -176,12 +364,33 @@ esp_err_t sim808_mqtt_publish(const char* topic, const char* payload);
  */
 esp_err_t sim808_mqtt_subscribe(const char* topic);
 
+/**
+ * Set the handler for messages on subscribed topics
+ * QoS 1 messages are acknowledged before the handler runs.
+ * @param handler Message handler (NULL to drop messages)
+ */
+void sim808_mqtt_set_message_handler(sim808_mqtt_message_handler_t handler);
+
+/**
+ * Set the handler run after an automatic reconnect
+ * A connection lost after sim808_mqtt_connect() (no PINGRESP, CLOSED) is
+ * reopened with backoff until sim808_mqtt_disconnect().
+ * @param handler Resubscribes and announces the device (NULL for none)
+ */
+void sim808_mqtt_set_connect_handler(sim808_mqtt_connect_handler_t handler);
+
 /**
  * Check if MQTT is connected
  * @return true if connected, false otherwise
  */
 bool sim808_mqtt_is_connected(void);
 
+/**
+ * Get number of QoS 1 publishes waiting for their PUBACK
+ * @return Number of in-flight publishes
+ */
+int sim808_mqtt_inflight(void);
+
 // ============================================
 // Utility Functions
 // ============================================
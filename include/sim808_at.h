@@ -0,0 +1,249 @@
+#ifndef SIM808_AT_H
+#define SIM808_AT_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// AT Engine Configuration
+#define SIM808_AT_LINE_MAX          256     // Longest line kept by the framer
+#define SIM808_AT_MAX_URC_HANDLERS  8       // Registered URC prefixes
+#define SIM808_AT_TASK_STACK_SIZE   4096
+#define SIM808_AT_TASK_PRIORITY     10
+#define SIM808_AT_LINK_ERROR_THRESHOLD 3    // Consecutive timeouts before link recovery
+#define SIM808_AT_LINK_WINDOW       32      // Recent commands the timeout ratio is taken over (max 32)
+#define SIM808_AT_LINK_ERROR_PCT    20      // Timeout share of the window before link recovery
+#define SIM808_AT_ESCAPE_GUARD_MS   1000    // Silence required around +++
+
+// URC handler, called from the AT RX task for every line matching its prefix.
+// Handlers must not issue AT commands themselves (the RX task would deadlock),
+// they should hand the line over to another task instead.
+typedef void (*sim808_urc_handler_t)(const char* line, void* arg);
+
+// Data mode handler, receives every byte from the modem while data mode is
+// active. Runs in the AT RX task, the same rules as URC handlers apply.
+typedef void (*sim808_raw_handler_t)(const uint8_t* data, size_t len, void* arg);
+
+// Link error handler, called from the task whose command hit the threshold,
+// with the command lock held so no other command interleaves with recovery
+typedef void (*sim808_link_error_handler_t)(void);
+
+// Transport write, replaces the direct UART write of commands and data
+// @return Number of bytes accepted, negative on error
+typedef int (*sim808_at_write_fn_t)(const void* data, size_t len);
+
+// Transport receive, gets the raw UART bytes instead of the line framer.
+// Runs in the AT RX task and passes AT traffic on with sim808_at_feed().
+typedef void (*sim808_at_rx_fn_t)(const uint8_t* data, size_t len);
+
+// Data session on a channel of its own (e.g. a CMUX DLCI), next to the AT
+// channel. Mirrors the data mode calls below, which delegate to it.
+typedef struct {
+    esp_err_t (*open)(const char* cmd, const char* const* finals,
+                      sim808_raw_handler_t handler, void* arg, uint32_t timeout_ms);
+    esp_err_t (*escape)(void);
+    esp_err_t (*resume)(void);
+    esp_err_t (*write)(const void* data, size_t len);
+    void (*close)(void);        // Must not block, see sim808_at_leave_data_mode()
+    bool (*active)(void);
+} sim808_data_channel_t;
+
+// ============================================
+// Engine Lifecycle
+// ============================================
+
+/**
+ * Start the UART RX task that frames modem lines
+ * Must be called after the UART driver is installed
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if resources can't be allocated
+ */
+esp_err_t sim808_at_start(void);
+
+/**
+ * Set the handler run after SIM808_AT_LINK_ERROR_THRESHOLD consecutive timeouts,
+ * or once SIM808_AT_LINK_ERROR_PCT of the last SIM808_AT_LINK_WINDOW commands
+ * timed out (a link dropping some bytes, e.g. framing errors)
+ * The handler may issue AT commands to recover the link
+ * @param handler Recovery handler (NULL to disable)
+ */
+void sim808_at_set_link_error_handler(sim808_link_error_handler_t handler);
+
+// ============================================
+// Command Execution
+// ============================================
+
+/**
+ * Execute an AT command and return as soon as a final result arrives
+ *
+ * Every line received while the command is pending is appended to
+ * response (CRLF terminated), including the final result line.
+ * "ERROR", "+CME ERROR", "+CMS ERROR", "SEND FAIL" and "CONNECT FAIL"
+ * always terminate the command with ESP_FAIL.
+ *
+ * @param cmd Command string to send (NULL to only wait for a final)
+ * @param finals NULL terminated list of success finals matched as line
+ *               prefixes ("OK", ">", "SEND OK", ...), NULL for { "OK" }
+ * @param response Buffer to store response (may be NULL)
+ * @param response_size Size of response buffer
+ * @param timeout_ms Timeout in milliseconds
+ * @param matched Index of the matched success final (may be NULL)
+ * @return ESP_OK on success final, ESP_FAIL on error final,
+ *         ESP_ERR_TIMEOUT if no final arrived in time
+ */
+esp_err_t sim808_at_exec(const char* cmd, const char* const* finals,
+                         char* response, size_t response_size,
+                         uint32_t timeout_ms, int* matched);
+
+/**
+ * Send a command that prompts for raw data (CIPSEND, HTTPDATA, ...)
+ * @param cmd Command string to send
+ * @param prompt Prompt to wait for before writing data (">", "DOWNLOAD")
+ * @param data Raw bytes to write after the prompt
+ * @param len Number of bytes to write
+ * @param finals Success finals after the data (NULL for { "OK" })
+ * @param timeout_ms Timeout for each of the two phases
+ * @return ESP_OK on success, ESP_FAIL or ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t sim808_at_send_data(const char* cmd, const char* prompt,
+                              const void* data, size_t len,
+                              const char* const* finals, uint32_t timeout_ms);
+
+/**
+ * Execute a command whose response carries a raw data block
+ *
+ * The line starting with data_prefix announces the block, the first number
+ * after the prefix is its length (e.g. "+CIPRXGET: 2,<len>,<left>"). That
+ * many bytes following the line are copied to data without line framing.
+ *
+ * @param cmd Command string to send
+ * @param data_prefix Header line prefix, e.g. "+CIPRXGET: 2,"
+ * @param data Buffer for the raw bytes
+ * @param data_size Size of data buffer
+ * @param data_len Number of raw bytes received
+ * @param timeout_ms Timeout in milliseconds
+ * @return ESP_OK on "OK", ESP_FAIL on an error final, ESP_ERR_TIMEOUT on timeout
+ */
+esp_err_t sim808_at_exec_binary(const char* cmd, const char* data_prefix,
+                                uint8_t* data, size_t data_size, size_t* data_len,
+                                uint32_t timeout_ms);
+
+/**
+ * Take exclusive ownership of the AT channel
+ * Lets multi-command sequences run without interleaving (recursive)
+ */
+void sim808_at_lock(void);
+
+/**
+ * Release ownership taken with sim808_at_lock()
+ */
+void sim808_at_unlock(void);
+
+// ============================================
+// Data Mode
+// ============================================
+
+/**
+ * Run a command that turns the UART into a raw byte pipe (CIPSTART with
+ * CIPMODE=1, ATD*99#, ...). Bytes after the success final go to handler.
+ *
+ * While data mode is active, commands issued through this engine escape
+ * with +++ first and return with ATO afterwards. Each escape costs about
+ * two guard periods, so callers with several commands should escape once
+ * with sim808_at_escape_data_mode() and resume when done. With a data
+ * channel set (sim808_at_set_data_channel()) the session runs there and
+ * commands don't escape it.
+ *
+ * @param cmd Command string to send
+ * @param finals Finals that start data mode (NULL for { "CONNECT" })
+ * @param handler Receives all bytes while data mode is active
+ * @param arg User argument passed to the handler
+ * @param timeout_ms Timeout in milliseconds
+ * @return ESP_OK once in data mode, ESP_FAIL or ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t sim808_at_enter_data_mode(const char* cmd, const char* const* finals,
+                                    sim808_raw_handler_t handler, void* arg,
+                                    uint32_t timeout_ms);
+
+/**
+ * Switch to command mode with the +++ escape, keeping the connection open
+ * @return ESP_OK in command mode, ESP_ERR_INVALID_STATE without a data session
+ */
+esp_err_t sim808_at_escape_data_mode(void);
+
+/**
+ * Return to data mode with ATO after sim808_at_escape_data_mode()
+ * @return ESP_OK in data mode, ESP_FAIL if the connection is gone
+ */
+esp_err_t sim808_at_resume_data_mode(void);
+
+/**
+ * Forget the data session, e.g. after the modem reported it closed
+ * Safe to call from a data mode or URC handler
+ */
+void sim808_at_leave_data_mode(void);
+
+/**
+ * Check whether data mode is active (not escaped)
+ */
+bool sim808_at_in_data_mode(void);
+
+/**
+ * Write raw bytes to the modem while in data mode
+ * Fails without blocking while an escape is in progress
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not in data mode
+ */
+esp_err_t sim808_at_write_data(const void* data, size_t len);
+
+// ============================================
+// Transport
+// ============================================
+
+/**
+ * Route modem I/O through a transport such as a CMUX multiplexer
+ * Resets the line framer, call it right after the modem switched framing
+ * @param write Writer for commands and data (NULL for the UART)
+ * @param rx Receiver of raw UART bytes (NULL for the line framer)
+ */
+void sim808_at_set_transport(sim808_at_write_fn_t write, sim808_at_rx_fn_t rx);
+
+/**
+ * Pass AT channel bytes received by a transport to the line framer
+ * Must be called from the transport receiver (AT RX task)
+ */
+void sim808_at_feed(const uint8_t* data, size_t len);
+
+/**
+ * Run data mode on a separate channel instead of the AT channel
+ * Commands no longer escape an open data session while it is set.
+ * @param channel Channel operations (NULL to share the AT channel again)
+ */
+void sim808_at_set_data_channel(const sim808_data_channel_t* channel);
+
+/**
+ * Check whether data mode runs beside the AT channel
+ * @return true if commands and data sessions don't share a byte stream
+ */
+bool sim808_at_has_data_channel(void);
+
+// ============================================
+// Unsolicited Result Codes
+// ============================================
+
+/**
+ * Register a handler for unsolicited result codes
+ * @param prefix Line prefix to match (e.g. "+CIPRXGET: 1", "CLOSED")
+ * @param handler Callback invoked from the RX task
+ * @param arg User argument passed to the handler
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the registry is full
+ */
+esp_err_t sim808_at_register_urc(const char* prefix, sim808_urc_handler_t handler, void* arg);
+
+/**
+ * Remove a previously registered URC handler
+ * @param prefix Prefix used at registration
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not registered
+ */
+esp_err_t sim808_at_unregister_urc(const char* prefix);
+
+#endif // SIM808_AT_H
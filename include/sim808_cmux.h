@@ -0,0 +1,75 @@
+#ifndef SIM808_CMUX_H
+#define SIM808_CMUX_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// GSM 07.10 multiplexer (AT+CMUX=0, basic option) on the SIM808 UART.
+// The UART then carries framed virtual channels:
+//   DLCI 0  multiplexer control
+//   DLCI 1  AT commands, URCs and streamed NMEA
+//   DLCI 2  data session (PPP or a transparent CIPMODE=1 socket)
+// The AT engine is moved onto DLCI 1 and its data mode onto DLCI 2, so
+// CSQ and GNSS polling run while the data session keeps flowing instead of
+// escaping it with +++/ATO. Each channel has its own transmit buffer and
+// lock, so an AT command never waits behind a long PPP write.
+//
+// The multiplexer can't be combined with a baud rate change, negotiate the
+// rate before starting it.
+
+// CMUX Configuration
+#define SIM808_USE_CMUX             1
+#define SIM808_CMUX_N1              127     // Largest information field (AT+CMUX default)
+#define SIM808_CMUX_CHANNELS        3       // DLCI 0 to 2
+#define SIM808_CMUX_DLCI_AT         1
+#define SIM808_CMUX_DLCI_DATA       2
+#define SIM808_CMUX_OPEN_TIMEOUT_MS 3000    // SABM to UA per channel
+
+// Per channel counters
+typedef struct {
+    uint32_t rx_frames;
+    uint32_t tx_frames;
+    uint32_t rx_bytes;          // Information field bytes
+    uint32_t tx_bytes;
+    uint32_t tx_dropped;        // Data refused while the modem asserted flow control
+} sim808_cmux_channel_stats_t;
+
+typedef struct {
+    sim808_cmux_channel_stats_t channels[SIM808_CMUX_CHANNELS];
+    uint32_t fcs_errors;        // Frames dropped for a bad checksum
+    uint32_t oversized;         // Frames longer than SIM808_CMUX_N1
+} sim808_cmux_stats_t;
+
+// ============================================
+// Multiplexer
+// ============================================
+
+/**
+ * Switch the modem to multiplexer mode and open the AT and data channels
+ * Must be called after sim808_power_on() and before any data session.
+ * @return ESP_OK once all channels are open, ESP_FAIL if the modem refused
+ *         AT+CMUX or a channel didn't open (the UART is back to plain AT)
+ */
+esp_err_t sim808_cmux_start(void);
+
+/**
+ * Close the channels and return the modem to plain AT mode
+ * Any data session must be ended first.
+ * @return ESP_OK on success
+ */
+esp_err_t sim808_cmux_stop(void);
+
+/**
+ * Check whether the multiplexer is running
+ * @return true between sim808_cmux_start() and sim808_cmux_stop()
+ */
+bool sim808_cmux_is_active(void);
+
+/**
+ * Get frame and byte counters
+ * @param stats Output counters
+ */
+void sim808_cmux_get_stats(sim808_cmux_stats_t* stats);
+
+#endif // SIM808_CMUX_H
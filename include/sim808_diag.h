@@ -0,0 +1,157 @@
+#ifndef SIM808_DIAG_H
+#define SIM808_DIAG_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Modem diagnostics: every AT command is tagged with an id derived from its
+// name, and the engine records its latency into a fixed-size histogram per
+// id together with timeout and error counts. UART byte counters and a
+// short CSQ history complete the picture of where cellular time goes.
+// All storage is static, recording never allocates.
+
+// Diagnostics Configuration
+#define SIM808_DIAG_HIST_BUCKETS    11      // See sim808_diag_bucket_limit_ms()
+#define SIM808_DIAG_CSQ_SAMPLES     16      // CSQ history depth
+
+// AT command ids
+typedef enum {
+    SIM808_CMD_OTHER = 0,
+    SIM808_CMD_AT,              // Bare "AT" probe
+    SIM808_CMD_ATE,
+    SIM808_CMD_ATD,
+    SIM808_CMD_ATO,
+    SIM808_CMD_ATH,
+    SIM808_CMD_ESCAPE,          // +++
+    SIM808_CMD_IPR,
+    SIM808_CMD_CMUX,
+    SIM808_CMD_CSQ,
+    SIM808_CMD_CREG,
+    SIM808_CMD_CGATT,
+    SIM808_CMD_CGDCONT,
+    SIM808_CMD_SAPBR,
+    SIM808_CMD_CIPMODE,
+    SIM808_CMD_CIPRXGET,
+    SIM808_CMD_CIPSTART,
+    SIM808_CMD_CIPSEND,
+    SIM808_CMD_CIPCLOSE,
+    SIM808_CMD_CIPSHUT,
+    SIM808_CMD_CGNSPWR,
+    SIM808_CMD_CGNSINF,
+    SIM808_CMD_CGNSTST,
+    SIM808_CMD_HTTPINIT,
+    SIM808_CMD_HTTPPARA,
+    SIM808_CMD_HTTPDATA,
+    SIM808_CMD_HTTPACTION,
+    SIM808_CMD_HTTPTERM,
+    SIM808_CMD_CPOWD,
+    SIM808_CMD_COUNT
+} sim808_cmd_id_t;
+
+// Per command statistics
+typedef struct {
+    uint32_t count;             // Completed commands, including failures
+    uint32_t timeouts;          // No final result in time
+    uint32_t errors;            // ERROR, +CME ERROR, SEND FAIL...
+    uint32_t total_ms;
+    uint32_t max_ms;
+    uint32_t hist[SIM808_DIAG_HIST_BUCKETS];
+} sim808_cmd_stats_t;
+
+// CSQ sample
+typedef struct {
+    uint32_t uptime_s;
+    int8_t rssi;                // 0-31, 99 unknown
+    int8_t ber;
+} sim808_csq_sample_t;
+
+// Link counters
+typedef struct {
+    uint32_t bytes_in;          // UART bytes received
+    uint32_t bytes_out;         // UART bytes written
+    uint32_t commands;
+    uint32_t timeouts;
+    uint32_t errors;
+} sim808_link_stats_t;
+
+// ============================================
+// Recording (AT engine and driver)
+// ============================================
+
+/**
+ * Tag a command string with its id
+ * @param cmd Command as sent ("AT+CSQ\r\n", "ATD*99***1#\r\n", "+++")
+ * @return Command id, SIM808_CMD_OTHER if unknown
+ */
+sim808_cmd_id_t sim808_diag_classify(const char* cmd);
+
+/**
+ * Record one completed command
+ * @param id Command id
+ * @param result ESP_OK, ESP_FAIL for an error final or ESP_ERR_TIMEOUT
+ * @param latency_ms Time from write to final result
+ */
+void sim808_diag_record_cmd(sim808_cmd_id_t id, esp_err_t result, uint32_t latency_ms);
+
+/**
+ * Count UART traffic
+ */
+void sim808_diag_record_bytes(size_t in, size_t out);
+
+/**
+ * Add a CSQ sample to the history
+ */
+void sim808_diag_record_csq(int rssi, int ber);
+
+// ============================================
+// Query API
+// ============================================
+
+/**
+ * Get the name of a command id ("CSQ", "CIPSEND", ...)
+ */
+const char* sim808_diag_cmd_name(sim808_cmd_id_t id);
+
+/**
+ * Get the upper latency limit of a histogram bucket
+ * @return Limit in ms, UINT32_MAX for the last bucket
+ */
+uint32_t sim808_diag_bucket_limit_ms(int bucket);
+
+/**
+ * Get statistics of one command
+ * @param id Command id
+ * @param stats Output statistics
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown id
+ */
+esp_err_t sim808_diag_get_cmd_stats(sim808_cmd_id_t id, sim808_cmd_stats_t* stats);
+
+/**
+ * Estimate a latency percentile from a command's histogram
+ * @param stats Statistics from sim808_diag_get_cmd_stats()
+ * @param percent Percentile (1-100)
+ * @return Upper limit of the bucket holding the percentile, capped at max_ms
+ */
+uint32_t sim808_diag_percentile_ms(const sim808_cmd_stats_t* stats, int percent);
+
+/**
+ * Get link counters
+ */
+void sim808_diag_get_link_stats(sim808_link_stats_t* stats);
+
+/**
+ * Copy the CSQ history, oldest first
+ * @param samples Output array
+ * @param max Capacity of samples
+ * @return Number of samples copied
+ */
+size_t sim808_diag_get_csq_history(sim808_csq_sample_t* samples, size_t max);
+
+/**
+ * Clear all statistics
+ */
+void sim808_diag_reset(void);
+
+#endif // SIM808_DIAG_H
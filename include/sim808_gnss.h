@@ -0,0 +1,75 @@
+#ifndef SIM808_GNSS_H
+#define SIM808_GNSS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Fixed-point scale of latitude_e6 / longitude_e6 (modem reports 6 decimals)
+#define SIM808_GNSS_COORD_SCALE 1000000
+
+// Longest NMEA sentence accepted by the streaming parser ($...*hh)
+#define SIM808_NMEA_MAX_LEN     96
+
+// GPS Data Structure
+typedef struct {
+    bool valid;              // GPS fix status
+    float latitude;          // Latitude in degrees (negative = South)
+    float longitude;         // Longitude in degrees (negative = West)
+    int32_t latitude_e6;     // Latitude in micro-degrees, exact modem value
+    int32_t longitude_e6;    // Longitude in micro-degrees, exact modem value
+    float altitude;          // Altitude in meters
+    float speed;             // Speed in km/h
+    float course;            // Course over ground in degrees
+    float hdop;              // Horizontal dilution of precision
+    float pdop;              // Position dilution of precision
+    float vdop;              // Vertical dilution of precision
+    int satellites;          // Number of satellites in view
+    int satellites_used;     // Number of satellites used for the fix
+    char timestamp[21];      // ISO8601 timestamp (YYYY-MM-DDTHH:MM:SSZ)
+    char date[11];           // Date (YYYY-MM-DD)
+} sim808_gps_data_t;
+
+// Incremental NMEA parser state
+typedef struct {
+    char sentence[SIM808_NMEA_MAX_LEN];  // Sentence body between '$' and '*'
+    uint8_t len;
+    uint8_t checksum;                    // Running XOR of the body
+    uint8_t state;
+    uint8_t rx_checksum;                 // Checksum received after '*'
+    sim808_gps_data_t fix;               // Epoch being assembled
+    uint32_t sentences;                  // Sentences with a valid checksum
+    uint32_t checksum_errors;            // Sentences dropped on checksum
+} sim808_nmea_parser_t;
+
+/**
+ * Parse an AT+CGNSINF response into a GPS data structure
+ *
+ * Single pass over the fields, no allocation and no sscanf. Empty fields
+ * (",,," while there is no fix) leave the matching members zeroed.
+ *
+ * @param response Modem response containing a "+CGNSINF:" line
+ * @param data Pointer to GPS data structure to fill
+ * @return true if the line was parsed and reports a valid fix
+ */
+bool sim808_gnss_parse_cgnsinf(const char* response, sim808_gps_data_t* data);
+
+/**
+ * Reset an NMEA parser
+ * @param parser Parser state
+ */
+void sim808_nmea_init(sim808_nmea_parser_t* parser);
+
+/**
+ * Feed one received byte to the NMEA parser
+ *
+ * Sentences are validated against their checksum before they are applied.
+ * GGA, GSA, GSV and VTG update the epoch in progress and RMC closes it
+ * (the modem is configured with AT+CGNSSEQ="RMC").
+ *
+ * @param parser Parser state
+ * @param c Received byte
+ * @return true when an RMC sentence completed a fix, available in parser->fix
+ */
+bool sim808_nmea_feed(sim808_nmea_parser_t* parser, char c);
+
+#endif // SIM808_GNSS_H
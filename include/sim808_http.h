@@ -0,0 +1,80 @@
+#ifndef SIM808_HTTP_H
+#define SIM808_HTTP_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bulk upload through the SIM808 HTTP stack (AT+HTTPINIT / HTTPDATA /
+// HTTPACTION) on bearer 1, for backlogs too large for MQTT publishes.
+//
+// The body is read from a callback and sent as a series of POSTs, one per
+// chunk, each addressed with its position in the upload:
+//   <url>?id=<upload_id>&offset=<offset>&total=<total_len>
+// The ingest endpoint appends the chunk if offset matches what it already
+// holds and answers 2xx. On a mismatch it answers 409 with the offset it
+// expects as the body, and the upload continues from there. The confirmed
+// offset is kept in the job, so a caller that stores it can resume an
+// interrupted upload after a reconnect or reboot.
+//
+// Bodies are sent uncompressed: a deflate compressor (miniz tdefl) needs
+// more RAM than this board can spare.
+//
+// Needs the modem's bearer (sim808_gprs_connect()), so it's unavailable
+// with SIM808_USE_PPP, where the data call belongs to PPP. Nothing in the
+// firmware calls it yet: the flash backlog is replayed over MQTT, and an
+// upload path for it needs an ingest format on the backend first.
+
+// HTTP Configuration
+#define SIM808_HTTP_CHUNK_SIZE          4096    // Body bytes per POST
+#define SIM808_HTTP_URL_MAX             256
+#define SIM808_HTTP_DATA_TIMEOUT_MS     10000   // HTTPDATA input window
+#define SIM808_HTTP_ACTION_TIMEOUT_MS   60000   // HTTPACTION to +HTTPACTION
+#define SIM808_HTTP_MAX_RETRIES         3       // Failed POSTs of one chunk
+
+// Body source: copy up to size bytes starting at offset into buf
+// @return Bytes copied (0 past the end), negative on error
+typedef int (*sim808_http_read_cb_t)(uint32_t offset, uint8_t* buf, size_t size, void* arg);
+
+// Upload job
+typedef struct {
+    const char* url;                // Ingest endpoint, without query string
+    const char* upload_id;          // Identifies the upload across resumes
+    const char* content_type;       // NULL for "application/octet-stream"
+    uint32_t total_len;
+    uint32_t offset;                // In: resume point, out: bytes the server holds
+    sim808_http_read_cb_t read;
+    void* arg;
+} sim808_http_upload_t;
+
+// ============================================
+// HTTP
+// ============================================
+
+/**
+ * POST one body and return the HTTP status
+ * @param url Full URL
+ * @param content_type Content-Type header (NULL for "application/octet-stream")
+ * @param data Body
+ * @param len Body length
+ * @param status Output HTTP status (600+ are modem network errors)
+ * @return ESP_OK once a status was received, ESP_FAIL or ESP_ERR_TIMEOUT if
+ *         the modem didn't complete the request, ESP_ERR_INVALID_STATE /
+ *         ESP_ERR_NOT_SUPPORTED as sim808_http_upload()
+ */
+esp_err_t sim808_http_post(const char* url, const char* content_type,
+                           const void* data, size_t len, int* status);
+
+/**
+ * Upload a body in chunks, resuming at upload->offset
+ * Requires an open bearer (sim808_gprs_connect()). One upload at a time,
+ * the modem has a single HTTP session.
+ * @param upload Job, offset is updated after every acknowledged chunk
+ * @return ESP_OK once the server holds total_len bytes, ESP_ERR_INVALID_STATE
+ *         without a bearer, ESP_ERR_NOT_SUPPORTED with SIM808_USE_PPP,
+ *         ESP_FAIL if a chunk kept failing (resume later)
+ */
+esp_err_t sim808_http_upload(sim808_http_upload_t* upload);
+
+#endif // SIM808_HTTP_H
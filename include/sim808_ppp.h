@@ -0,0 +1,74 @@
+#ifndef SIM808_PPP_H
+#define SIM808_PPP_H
+
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "sim808.h"
+#include <stdbool.h>
+
+// PPP over the SIM808 UART. The modem dials the packet data service
+// (ATD*99***1#) and the UART carries PPP frames into an lwIP netif, so
+// sockets and esp_mqtt_client run over cellular exactly as over WiFi.
+// Needs CONFIG_LWIP_PPP_SUPPORT (and CONFIG_LWIP_PPP_PAP_SUPPORT for APNs
+// with credentials).
+//
+// The link only depends on the UART bytes, so it can be brought up against
+// pppd on a Linux host through a serial adapter or pty that answers
+// "AT+CGDCONT" with OK and "ATD*99***1#" with CONNECT before starting pppd
+// (tools/sim808_emulator.py --ppp, tools/ppp_link_test.sh).
+//
+// While PPP is up, AT commands (CSQ, CGNSINF) escape to command mode with
+// +++ and resume with ATO, which pauses IP traffic for about two seconds.
+// Under the CMUX multiplexer (sim808_cmux.h) PPP runs on its own channel
+// and commands don't interrupt it.
+
+// PPP Configuration
+#define SIM808_USE_PPP                  1       // PRODUCTION mode runs esp_mqtt_client over PPP
+#define SIM808_PPP_CONNECT_TIMEOUT_MS   30000   // Dial to IP address
+#define SIM808_PPP_DIAL_TIMEOUT_MS      20000   // ATD*99***1# to CONNECT
+
+// Redial supervisor: a session that ends on an error (carrier loss, LCP
+// echo timeout) is dialed again, waiting MIN before the first attempt and
+// doubling up to MAX while attempts fail
+#define SIM808_PPP_REDIAL_MIN_MS        2000
+#define SIM808_PPP_REDIAL_MAX_MS        120000
+#define SIM808_PPP_TASK_STACK_SIZE      4096
+#define SIM808_PPP_TASK_PRIORITY        6
+
+// ============================================
+// PPP Link
+// ============================================
+
+/**
+ * Dial the packet data service and start PPP on a new netif
+ * Blocks until an IP address is assigned or SIM808_PPP_CONNECT_TIMEOUT_MS.
+ * Once up, a lost session is redialed in the background until sim808_ppp_stop
+ * @param config APN and optional PAP credentials
+ * @return ESP_OK once the netif has an IP address, ESP_ERR_TIMEOUT if
+ *         negotiation didn't finish, ESP_FAIL if the modem refused to dial
+ */
+esp_err_t sim808_ppp_start(const sim808_gprs_config_t* config);
+
+/**
+ * Terminate PPP, hang up the data call and stop redialing
+ * @return ESP_OK on success
+ */
+esp_err_t sim808_ppp_stop(void);
+
+/**
+ * Check whether the PPP netif has an IP address
+ * @return true if connected
+ */
+bool sim808_ppp_is_connected(void);
+
+/**
+ * Get the PPP netif (NULL before sim808_ppp_start)
+ */
+esp_netif_t* sim808_ppp_get_netif(void);
+
+/**
+ * Get the number of times a lost session was redialed
+ */
+uint32_t sim808_ppp_get_redial_count(void);
+
+#endif // SIM808_PPP_H
@@ -0,0 +1,218 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary encoding for the realtime.* and report.performance.*
+// payloads. Same fields as the JSON messages, minus vehicle_id which the
+// topic already carries. No ESP-IDF dependencies so the decoder also builds
+// on a host (see tools/telemetry_roundtrip.c).
+//
+// Message layout:
+//   u8      version (TELEMETRY_CODEC_VERSION)
+//   u8      type (telemetry_msg_type_t)
+//   varint  timestamp, ms since the Unix epoch
+//   ...     type specific fields, in JSON key order
+//
+// Varints are unsigned LEB128 (7 bits per byte, low group first). Signed
+// values are zigzag mapped first. Floats are sent as fixed point integers
+// at the TELEMETRY_*_SCALE resolution. Strings are a varint length and the
+// bytes, without NUL.
+//
+// A track message (realtime.track) carries a batch of fixes: the first
+// point in full, every later one as zigzag deltas from the point before
+// (time, latitude, longitude, altitude), polyline style. Deltas are taken
+// between the fixed point values, so no error builds up along the batch.
+//
+// A frame message (realtime.frame) carries the location, status and battery
+// readings of one tracking cycle. A fields byte (TELEMETRY_FRAME_*) after
+// the timestamp tells which are present; they follow in that order, each
+// laid out as in its own message type.
+//
+// A JSON payload always starts with '{', a binary one with the version
+// byte, so a consumer can tell them apart while a vehicle switches.
+
+#define TELEMETRY_CODEC_VERSION         1
+#define TELEMETRY_ENCODING_JSON         "json"
+#define TELEMETRY_ENCODING_BINARY       "bin1"      // Name advertised for this version
+#define TELEMETRY_ENCODING_TRACK        "track1"    // bin1 with locations batched
+
+#define TELEMETRY_MAX_MESSAGE           192     // Largest message other than a track
+#define TELEMETRY_MAX_VARINT            10      // Bytes for a 64 bit varint
+#define TELEMETRY_TRACK_MAX_POINTS      32      // Fixes per track message
+#define TELEMETRY_TRACK_MAX_MESSAGE     (16 + 25 * TELEMETRY_TRACK_MAX_POINTS)
+
+// Codec return values (encoders return the message length when positive)
+#define TELEMETRY_CODEC_ERR_BUFFER      -1  // Output buffer too small
+#define TELEMETRY_CODEC_ERR_MALFORMED   -2  // Truncated or invalid message
+
+// Fixed point resolution, units per JSON unit
+#define TELEMETRY_COORD_SCALE           10000000    // 1e-7 degree (~1 cm)
+#define TELEMETRY_ALTITUDE_SCALE        10          // 0.1 m
+#define TELEMETRY_VOLTAGE_SCALE         1000        // mV
+#define TELEMETRY_LEVEL_SCALE           10          // 0.1 %
+#define TELEMETRY_PERF_SCALE            100         // 0.01 of the reported unit
+
+// Message types
+typedef enum {
+    TELEMETRY_MSG_LOCATION = 1,
+    TELEMETRY_MSG_STATUS,
+    TELEMETRY_MSG_BATTERY,
+    TELEMETRY_MSG_PERFORMANCE,
+    TELEMETRY_MSG_TRACK,
+    TELEMETRY_MSG_FRAME
+} telemetry_msg_type_t;
+
+// Status flags
+#define TELEMETRY_STATUS_ACTIVE         0x01
+#define TELEMETRY_STATUS_LOCKED         0x02
+#define TELEMETRY_STATUS_KILLED         0x04
+
+// Frame fields
+#define TELEMETRY_FRAME_LOCATION        0x01
+#define TELEMETRY_FRAME_STATUS          0x02
+#define TELEMETRY_FRAME_BATTERY         0x04
+
+// realtime.location
+typedef struct {
+    float latitude;
+    float longitude;
+    float altitude;
+} telemetry_location_t;
+
+// realtime.status
+typedef struct {
+    bool is_active;
+    bool is_locked;
+    bool is_killed;
+} telemetry_status_t;
+
+// realtime.battery
+typedef struct {
+    float voltage;
+    float battery_level;
+} telemetry_battery_t;
+
+// report.performance
+typedef struct {
+    char order_id[64];
+    char weight_score[16];
+    float front_tire;
+    float rear_tire;
+    float brake_pad;
+    float engine_oil;
+    float chain_or_cvt;
+    float engine;
+    float distance_travelled;
+    float average_speed;
+    float max_speed;
+} telemetry_performance_t;
+
+// One fix of a realtime.track batch
+typedef struct {
+    uint64_t timestamp_ms;
+    float latitude;
+    float longitude;
+    float altitude;
+} telemetry_track_point_t;
+
+// realtime.track
+typedef struct {
+    uint16_t count;
+    telemetry_track_point_t points[TELEMETRY_TRACK_MAX_POINTS];
+} telemetry_track_t;
+
+// realtime.frame, only the parts flagged in fields are valid
+typedef struct {
+    uint8_t fields;                 // TELEMETRY_FRAME_*
+    telemetry_location_t location;
+    telemetry_status_t status;
+    telemetry_battery_t battery;
+} telemetry_frame_t;
+
+// Decoded message
+typedef struct {
+    uint8_t version;
+    uint8_t type;                   // telemetry_msg_type_t
+    uint64_t timestamp_ms;          // First point of a track
+    union {
+        telemetry_location_t location;
+        telemetry_status_t status;
+        telemetry_battery_t battery;
+        telemetry_performance_t performance;
+        telemetry_track_t track;
+        telemetry_frame_t frame;
+    };
+} telemetry_message_t;
+
+// ============================================
+// Varint
+// ============================================
+
+/**
+ * Encode an unsigned LEB128 varint
+ * @param out Output buffer, at least TELEMETRY_MAX_VARINT bytes
+ * @return Number of bytes written
+ */
+int telemetry_encode_varint(uint64_t value, uint8_t* out);
+
+/**
+ * Decode an unsigned LEB128 varint
+ * @return Bytes consumed or TELEMETRY_CODEC_ERR_MALFORMED
+ */
+int telemetry_decode_varint(const uint8_t* in, size_t len, uint64_t* value);
+
+/**
+ * Map a signed value onto an unsigned one, small magnitudes stay small
+ */
+static inline uint64_t telemetry_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t telemetry_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// ============================================
+// Encoders
+// ============================================
+
+/**
+ * Encode a message
+ * @param timestamp_ms Sample time, ms since the Unix epoch
+ * @return Message length or a negative TELEMETRY_CODEC_ERR_* value
+ */
+int telemetry_encode_location(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                              const telemetry_location_t* location);
+int telemetry_encode_status(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                            const telemetry_status_t* status);
+int telemetry_encode_battery(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                             const telemetry_battery_t* battery);
+int telemetry_encode_performance(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                                 const telemetry_performance_t* performance);
+int telemetry_encode_frame(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                           const telemetry_frame_t* frame);
+
+/**
+ * Encode a track batch
+ * @param points Fixes, oldest first
+ * @param count Number of fixes, 1 to TELEMETRY_TRACK_MAX_POINTS
+ * @return Message length or a negative TELEMETRY_CODEC_ERR_* value
+ */
+int telemetry_encode_track(uint8_t* buf, size_t size, const telemetry_track_point_t* points,
+                           size_t count);
+
+// ============================================
+// Decoder
+// ============================================
+
+/**
+ * Decode a message, values come back at the fixed point resolution
+ * @return 0 on success, TELEMETRY_CODEC_ERR_MALFORMED otherwise (including
+ *         an unknown version or type)
+ */
+int telemetry_decode(const uint8_t* buf, size_t len, telemetry_message_t* msg);
+
+#endif // TELEMETRY_CODEC_H
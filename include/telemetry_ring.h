@@ -0,0 +1,89 @@
+#ifndef TELEMETRY_RING_H
+#define TELEMETRY_RING_H
+
+#include "telemetry_codec.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lock-free single producer / single consumer ring of fixed size records
+// between the tracking task, which samples, and the publisher task, which
+// serializes and sends. Pushing never blocks, so a slow network can't
+// hold up GPS sampling or the kill switch. No ESP-IDF dependencies.
+//
+// The producer owns head, the consumer owns tail. When the ring is full,
+// TELEMETRY_RING_DROP_NEWEST discards the record being pushed, and
+// TELEMETRY_RING_DROP_OLDEST takes the oldest slot back from the consumer
+// with a compare-and-swap on tail. A pop that raced with such a drop
+// loses its compare-and-swap, throws its copy away and takes the next
+// record, so a half-overwritten record is never returned.
+
+#define TELEMETRY_RING_SIZE     32      // Records, power of two
+
+// What to discard when the ring is full
+typedef enum {
+    TELEMETRY_RING_DROP_OLDEST = 0,
+    TELEMETRY_RING_DROP_NEWEST
+} telemetry_ring_policy_t;
+
+// Record kinds
+typedef enum {
+    TELEMETRY_RECORD_FRAME = 1,     // Readings for realtime.frame
+    TELEMETRY_RECORD_FLUSH_TRACK,   // Send the pending track batch
+    TELEMETRY_RECORD_DIAG           // Publish diag.modem
+} telemetry_record_kind_t;
+
+typedef struct {
+    uint8_t kind;                   // telemetry_record_kind_t
+    uint64_t timestamp_ms;          // Sample time, ms since the Unix epoch
+    telemetry_frame_t frame;        // TELEMETRY_RECORD_FRAME
+} telemetry_record_t;
+
+// Counters since init
+typedef struct {
+    uint32_t depth;                 // Records waiting
+    uint32_t high_water;            // Deepest the ring has been
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped;               // By either policy
+} telemetry_ring_stats_t;
+
+typedef struct {
+    telemetry_record_t records[TELEMETRY_RING_SIZE];
+    _Atomic uint32_t head;          // Next slot to write, producer only
+    _Atomic uint32_t tail;          // Next slot to read
+    telemetry_ring_policy_t policy;
+    // Word sized, one writer each
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped;
+    uint32_t high_water;
+} telemetry_ring_t;
+
+// ============================================
+// Ring
+// ============================================
+
+/**
+ * Empty the ring and set its full policy
+ */
+void telemetry_ring_init(telemetry_ring_t* ring, telemetry_ring_policy_t policy);
+
+/**
+ * Add a record, producer side, never blocks
+ * @return true if queued, false if dropped (TELEMETRY_RING_DROP_NEWEST)
+ */
+bool telemetry_ring_push(telemetry_ring_t* ring, const telemetry_record_t* record);
+
+/**
+ * Take the oldest record, consumer side
+ * @return true if a record was copied to out, false if empty
+ */
+bool telemetry_ring_pop(telemetry_ring_t* ring, telemetry_record_t* out);
+
+/**
+ * Get depth and counters, from any task
+ */
+void telemetry_ring_get_stats(telemetry_ring_t* ring, telemetry_ring_stats_t* stats);
+
+#endif // TELEMETRY_RING_H
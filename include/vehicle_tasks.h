@@ -3,30 +3,49 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "rate_controller.h"
+#include "telemetry_ring.h"
 
 // Task priorities
 #define GPS_TASK_PRIORITY           5
 #define TRACKING_TASK_PRIORITY      5
 #define MONITOR_TASK_PRIORITY       3
+#define PUBLISHER_TASK_PRIORITY     4       // Below tracking, sensing preempts sending
 
 // Task stack sizes
 #define GPS_TASK_STACK_SIZE         4096
 #define TRACKING_TASK_STACK_SIZE    8192
 #define MONITOR_TASK_STACK_SIZE     3072
+#define PUBLISHER_TASK_STACK_SIZE   6144
 
 // Task handles (extern for access from main)
 extern TaskHandle_t gps_task_handle;
 extern TaskHandle_t tracking_task_handle;
 extern TaskHandle_t monitor_task_handle;
+extern TaskHandle_t publisher_task_handle;
 
 // Task functions
 void gps_reading_task(void *pvParameters);
 void vehicle_tracking_task(void *pvParameters);
 void system_monitor_task(void *pvParameters);
+void telemetry_publisher_task(void *pvParameters);
 
 // Task management functions
 void vehicle_tasks_init(void);
 void vehicle_tasks_start(void);
 void vehicle_tasks_stop(void);
 
+// Current sampling and publish rates (tier, intervals, inputs)
+void vehicle_tasks_get_rates(rate_controller_t* rates);
+
+// Publish queue depth and drop counters
+void vehicle_tasks_get_publisher_stats(telemetry_ring_stats_t* stats);
+
+// Have the publisher task run now (mqtt_publish_pending()), from any task
+void vehicle_tasks_wake_publisher(void);
+
+// A command changed the vehicle state: the tracking task flushes the track
+// batch and reports the state as a status-only frame, from any task
+void vehicle_tasks_notify_state_change(void);
+
 #endif // VEHICLE_TASKS_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "flash_queue.h"
+#include <string.h>
+
+#define ERASED_BYTE         0xFF
+#define CONSUMED_BYTE       0x00
+#define CRC_CHUNK           64
+
+// On-flash headers, both targets are little endian
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv;           // ~seq
+} sector_header_t;
+
+typedef struct {
+    uint8_t marker;
+    uint8_t consumed;
+    uint16_t length;
+    uint32_t crc;
+} record_header_t;
+
+// Result of reading a record header
+typedef enum {
+    RECORD_VALID,               // Header plausible, data not checked yet
+    RECORD_END,                 // Erased space, nothing written from here
+    RECORD_BAD                  // Garbage, the rest of the sector is unusable
+} record_status_t;
+
+/**
+ * CRC-32 (IEEE, reflected), bitwise to keep the code free of tables
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * Bytes a record takes in flash
+ */
+static size_t record_size(size_t len) {
+    return (FLASH_QUEUE_RECORD_HEADER + len + 3) & ~(size_t)3;
+}
+
+static uint32_t sector_base(const flash_queue_t* q, uint32_t sector) {
+    return sector * q->storage.sector_size;
+}
+
+static uint32_t next_sector(const flash_queue_t* q, uint32_t sector) {
+    return (sector + 1) % q->sector_count;
+}
+
+/**
+ * Read and sanity check the record header at offset
+ */
+static record_status_t read_record_header(flash_queue_t* q, uint32_t sector, uint32_t offset,
+                                          record_header_t* hdr) {
+    if (offset + FLASH_QUEUE_RECORD_HEADER > q->storage.sector_size) {
+        return RECORD_END;
+    }
+    if (q->storage.read(q->storage.ctx, sector_base(q, sector) + offset, hdr, sizeof(*hdr)) != 0) {
+        return RECORD_BAD;
+    }
+    if (hdr->marker == ERASED_BYTE) {
+        return RECORD_END;
+    }
+    if (hdr->marker != FLASH_QUEUE_RECORD_MARKER ||
+        offset + record_size(hdr->length) > q->storage.sector_size) {
+        return RECORD_BAD;
+    }
+    return RECORD_VALID;
+}
+
+/**
+ * Check a record's CRC, reading the data into buf when it fits
+ */
+static bool check_record(flash_queue_t* q, uint32_t sector, uint32_t offset,
+                         const record_header_t* hdr, void* buf, size_t size) {
+    uint32_t addr = sector_base(q, sector) + offset + FLASH_QUEUE_RECORD_HEADER;
+    uint32_t crc = crc32_update(0, (const uint8_t*)&hdr->length, sizeof(hdr->length));
+
+    if (buf != NULL && hdr->length <= size) {
+        if (q->storage.read(q->storage.ctx, addr, buf, hdr->length) != 0) {
+            return false;
+        }
+        crc = crc32_update(crc, buf, hdr->length);
+    } else {
+        uint8_t chunk[CRC_CHUNK];
+        for (size_t done = 0; done < hdr->length; done += sizeof(chunk)) {
+            size_t n = hdr->length - done;
+            if (n > sizeof(chunk)) {
+                n = sizeof(chunk);
+            }
+            if (q->storage.read(q->storage.ctx, addr + done, chunk, n) != 0) {
+                return false;
+            }
+            crc = crc32_update(crc, chunk, n);
+        }
+    }
+    return crc == hdr->crc;
+}
+
+/**
+ * Walk the records of a sector from offset
+ * @param end Output offset where appending could continue (sector size if
+ *            the sector ended in garbage)
+ * @param first_pending Output offset of the first pending record, or the
+ *                      sector size if there is none
+ * @return Number of valid pending records
+ */
+static uint32_t scan_sector(flash_queue_t* q, uint32_t sector, uint32_t offset,
+                            uint32_t* end, uint32_t* first_pending) {
+    uint32_t pending = 0;
+    record_header_t hdr;
+
+    *first_pending = q->storage.sector_size;
+    while (true) {
+        record_status_t status = read_record_header(q, sector, offset, &hdr);
+        if (status == RECORD_END) {
+            break;
+        }
+        if (status == RECORD_BAD) {
+            q->stats.corrupt++;
+            offset = q->storage.sector_size;
+            break;
+        }
+
+        if (hdr.consumed == ERASED_BYTE) {
+            if (check_record(q, sector, offset, &hdr, NULL, 0)) {
+                if (pending++ == 0) {
+                    *first_pending = offset;
+                }
+            } else {
+                // Usually the write power loss cut short
+                q->stats.corrupt++;
+            }
+        }
+        offset += record_size(hdr.length);
+    }
+
+    *end = offset;
+    return pending;
+}
+
+/**
+ * Erase a sector and stamp it with a sequence number
+ */
+static int open_sector(flash_queue_t* q, uint32_t sector, uint32_t seq) {
+    sector_header_t hdr = { .magic = FLASH_QUEUE_SECTOR_MAGIC, .seq = seq, .seq_inv = ~seq };
+
+    q->stats.erases++;
+    if (q->storage.erase(q->storage.ctx, sector_base(q, sector), q->storage.sector_size) != 0 ||
+        q->storage.write(q->storage.ctx, sector_base(q, sector), &hdr, sizeof(hdr)) != 0) {
+        return FLASH_QUEUE_ERR_IO;
+    }
+    return FLASH_QUEUE_OK;
+}
+
+/**
+ * Give up the oldest sector so the head can move into it
+ */
+static void drop_tail(flash_queue_t* q) {
+    if (q->read_sector == q->tail_sector) {
+        uint32_t end, first_pending;
+        uint32_t lost = scan_sector(q, q->tail_sector, q->read_offset, &end, &first_pending);
+        q->stats.dropped += lost;
+        q->stats.pending -= (lost < q->stats.pending) ? lost : q->stats.pending;
+
+        q->read_sector = next_sector(q, q->tail_sector);
+        q->read_offset = FLASH_QUEUE_SECTOR_HEADER;
+        q->peeked_size = 0;
+    }
+    q->tail_sector = next_sector(q, q->tail_sector);
+}
+
+/**
+ * Rebuild the queue state from storage
+ */
+int flash_queue_mount(flash_queue_t* q, const flash_queue_storage_t* storage) {
+    memset(q, 0, sizeof(*q));
+    q->storage = *storage;
+
+    if (storage->sector_size <= FLASH_QUEUE_SECTOR_HEADER + FLASH_QUEUE_RECORD_HEADER ||
+        storage->size % storage->sector_size != 0 ||
+        storage->size / storage->sector_size < FLASH_QUEUE_MIN_SECTORS) {
+        return FLASH_QUEUE_ERR_STORAGE;
+    }
+    q->sector_count = storage->size / storage->sector_size;
+
+    // Newest and oldest stamped sector
+    bool found = false;
+    uint32_t tail_seq = 0;
+    for (uint32_t s = 0; s < q->sector_count; s++) {
+        sector_header_t hdr;
+        if (storage->read(storage->ctx, sector_base(q, s), &hdr, sizeof(hdr)) != 0) {
+            return FLASH_QUEUE_ERR_IO;
+        }
+        if (hdr.magic != FLASH_QUEUE_SECTOR_MAGIC || hdr.seq != ~hdr.seq_inv) {
+            continue;
+        }
+        if (!found || hdr.seq > q->head_seq) {
+            q->head_seq = hdr.seq;
+            q->head_sector = s;
+        }
+        if (!found || hdr.seq < tail_seq) {
+            tail_seq = hdr.seq;
+            q->tail_sector = s;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        return flash_queue_format(q);
+    }
+
+    // Sectors were opened in ring order, walk them oldest first
+    bool have_pending = false;
+    uint32_t s = q->tail_sector;
+    while (true) {
+        uint32_t end, first_pending;
+        uint32_t pending = scan_sector(q, s, FLASH_QUEUE_SECTOR_HEADER, &end, &first_pending);
+        if (pending > 0 && !have_pending) {
+            q->read_sector = s;
+            q->read_offset = first_pending;
+            have_pending = true;
+        }
+        q->stats.pending += pending;
+
+        if (s == q->head_sector) {
+            q->head_offset = end;
+            break;
+        }
+        s = next_sector(q, s);
+    }
+
+    if (!have_pending) {
+        q->read_sector = q->head_sector;
+        q->read_offset = q->head_offset;
+    }
+    return FLASH_QUEUE_OK;
+}
+
+/**
+ * Erase all records
+ */
+int flash_queue_format(flash_queue_t* q) {
+    memset(&q->stats, 0, sizeof(q->stats));
+
+    for (uint32_t s = 1; s < q->sector_count; s++) {
+        q->stats.erases++;
+        if (q->storage.erase(q->storage.ctx, sector_base(q, s), q->storage.sector_size) != 0) {
+            return FLASH_QUEUE_ERR_IO;
+        }
+    }
+
+    q->head_seq = 1;
+    q->head_sector = 0;
+    q->head_offset = FLASH_QUEUE_SECTOR_HEADER;
+    q->tail_sector = 0;
+    q->read_sector = 0;
+    q->read_offset = FLASH_QUEUE_SECTOR_HEADER;
+    q->peeked_size = 0;
+    return open_sector(q, 0, q->head_seq);
+}
+
+/**
+ * Append a record
+ */
+int flash_queue_push(flash_queue_t* q, const void* data, size_t len) {
+    if (len > flash_queue_max_record(q)) {
+        return FLASH_QUEUE_ERR_SIZE;
+    }
+
+    size_t size = record_size(len);
+    if (q->head_offset + size > q->storage.sector_size) {
+        uint32_t next = next_sector(q, q->head_sector);
+        if (next == q->tail_sector) {
+            drop_tail(q);
+        }
+
+        // Move on even if the erase fails, the next push then tries the
+        // sector after it instead of hammering this one
+        q->head_sector = next;
+        q->head_seq++;
+        q->head_offset = q->storage.sector_size;
+        if (open_sector(q, next, q->head_seq) != FLASH_QUEUE_OK) {
+            return FLASH_QUEUE_ERR_IO;
+        }
+        q->head_offset = FLASH_QUEUE_SECTOR_HEADER;
+    }
+
+    record_header_t hdr = {
+        .marker = FLASH_QUEUE_RECORD_MARKER,
+        .consumed = ERASED_BYTE,
+        .length = (uint16_t)len,
+    };
+    hdr.crc = crc32_update(0, (const uint8_t*)&hdr.length, sizeof(hdr.length));
+    hdr.crc = crc32_update(hdr.crc, data, len);
+
+    uint32_t addr = sector_base(q, q->head_sector) + q->head_offset;
+    if (q->storage.write(q->storage.ctx, addr, &hdr, sizeof(hdr)) != 0 ||
+        (len > 0 && q->storage.write(q->storage.ctx, addr + sizeof(hdr), data, len) != 0)) {
+        // Whatever made it to flash fails its CRC, continue in a fresh sector
+        q->head_offset = q->storage.sector_size;
+        return FLASH_QUEUE_ERR_IO;
+    }
+
+    q->head_offset += size;
+    q->stats.pending++;
+    q->stats.pushed++;
+    return FLASH_QUEUE_OK;
+}
+
+/**
+ * Copy the oldest pending record
+ */
+int flash_queue_peek(flash_queue_t* q, void* buf, size_t size, size_t* len) {
+    record_header_t hdr;
+
+    q->peeked_size = 0;
+    while (true) {
+        if (q->read_sector == q->head_sector && q->read_offset >= q->head_offset) {
+            return FLASH_QUEUE_ERR_EMPTY;
+        }
+
+        record_status_t status = read_record_header(q, q->read_sector, q->read_offset, &hdr);
+        if (status != RECORD_VALID) {
+            if (status == RECORD_BAD) {
+                q->stats.corrupt++;
+            }
+            if (q->read_sector == q->head_sector) {
+                q->read_offset = q->head_offset;
+            } else {
+                q->read_sector = next_sector(q, q->read_sector);
+                q->read_offset = FLASH_QUEUE_SECTOR_HEADER;
+            }
+            continue;
+        }
+
+        if (hdr.consumed != ERASED_BYTE) {
+            q->read_offset += record_size(hdr.length);
+            continue;
+        }
+
+        if (!check_record(q, q->read_sector, q->read_offset, &hdr, buf, size)) {
+            q->stats.corrupt++;
+            q->read_offset += record_size(hdr.length);
+            continue;
+        }
+
+        *len = hdr.length;
+        q->peeked_size = record_size(hdr.length);
+        return (hdr.length <= size) ? FLASH_QUEUE_OK : FLASH_QUEUE_ERR_SIZE;
+    }
+}
+
+/**
+ * Remove the last peeked record
+ */
+int flash_queue_pop(flash_queue_t* q) {
+    static const uint8_t consumed = CONSUMED_BYTE;
+
+    if (q->peeked_size == 0) {
+        return FLASH_QUEUE_ERR_EMPTY;
+    }
+
+    uint32_t addr = sector_base(q, q->read_sector) + q->read_offset +
+                    offsetof(record_header_t, consumed);
+    if (q->storage.write(q->storage.ctx, addr, &consumed, 1) != 0) {
+        return FLASH_QUEUE_ERR_IO;
+    }
+
+    q->read_offset += q->peeked_size;
+    q->peeked_size = 0;
+    if (q->stats.pending > 0) {
+        q->stats.pending--;
+    }
+    q->stats.popped++;
+    return FLASH_QUEUE_OK;
+}
+
+/**
+ * Largest record the geometry allows
+ */
+size_t flash_queue_max_record(const flash_queue_t* q) {
+    size_t max = q->storage.sector_size - FLASH_QUEUE_SECTOR_HEADER - FLASH_QUEUE_RECORD_HEADER;
+    return (max > UINT16_MAX) ? UINT16_MAX : max;
+}
+
+/**
+ * Get counters since mount
+ */
+void flash_queue_get_stats(const flash_queue_t* q, flash_queue_stats_t* stats) {
+    *stats = q->stats;
+}
@@ -0,0 +1,44 @@
+#include "flash_queue_partition.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+static const char *TAG = "FLASH_QUEUE";
+
+static int partition_read(void* ctx, uint32_t offset, void* buf, size_t len) {
+    return esp_partition_read((const esp_partition_t*)ctx, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int partition_write(void* ctx, uint32_t offset, const void* buf, size_t len) {
+    return esp_partition_write((const esp_partition_t*)ctx, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int partition_erase(void* ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range((const esp_partition_t*)ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+/**
+ * Fill a storage backend for a data partition
+ */
+esp_err_t flash_queue_partition_storage(const char* label, flash_queue_storage_t* storage) {
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "No data partition '%s'", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->encrypted) {
+        ESP_LOGE(TAG, "Partition '%s' is encrypted", label);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    storage->read = partition_read;
+    storage->write = partition_write;
+    storage->erase = partition_erase;
+    storage->ctx = (void*)part;
+    storage->sector_size = SPI_FLASH_SEC_SIZE;
+    storage->size = part->size - (part->size % SPI_FLASH_SEC_SIZE);
+
+    ESP_LOGI(TAG, "Partition '%s': %lu KB at 0x%lx", label,
+             (unsigned long)(storage->size / 1024), (unsigned long)part->address);
+    return ESP_OK;
+}
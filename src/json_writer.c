@@ -0,0 +1,233 @@
+#include "json_writer.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Append raw bytes, flagging overflow instead of truncating mid-token
+ */
+static void put(json_writer_t* w, const char* s, size_t n) {
+    if (w->overflow) {
+        return;
+    }
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+/**
+ * Append a quoted string with cJSON's escaping
+ */
+static void put_string(json_writer_t* w, const char* s) {
+    put(w, "\"", 1);
+
+    const char* run = s;
+    for (const unsigned char* p = (const unsigned char*)s; *p != '\0'; p++) {
+        char esc[7];
+        size_t esc_len = 2;
+
+        switch (*p) {
+            case '\"': esc[1] = '\"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                if (*p >= 32) {
+                    continue;
+                }
+                snprintf(esc + 1, sizeof(esc) - 1, "u%04x", *p);
+                esc_len = 6;
+                break;
+        }
+        esc[0] = '\\';
+
+        // Copy the unescaped run before this character in one go
+        put(w, run, (const char*)p - run);
+        put(w, esc, esc_len);
+        run = (const char*)p + 1;
+    }
+    put(w, run, strlen(run));
+
+    put(w, "\"", 1);
+}
+
+/**
+ * Same tolerance cJSON uses to accept the short number form
+ */
+static bool compare_double(double a, double b) {
+    double max_val = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= max_val * DBL_EPSILON;
+}
+
+/**
+ * Append a number formatted like cJSON's print_number()
+ */
+static void put_number(json_writer_t* w, double d) {
+    char num[26];
+    int len;
+
+    if (isnan(d) || isinf(d)) {
+        put(w, "null", 4);
+        return;
+    }
+
+    // cJSON compares against the clamped int it stores next to the double;
+    // NaN is out above, converting it to int is undefined
+    int as_int;
+    if (d >= INT_MAX) {
+        as_int = INT_MAX;
+    } else if (d <= (double)INT_MIN) {
+        as_int = INT_MIN;
+    } else {
+        as_int = (int)d;
+    }
+
+    if (d == (double)as_int) {
+        len = snprintf(num, sizeof(num), "%d", as_int);
+    } else {
+        // Shortest form that reads back as the same double
+        double test = 0;
+        len = snprintf(num, sizeof(num), "%1.15g", d);
+        if (sscanf(num, "%lg", &test) != 1 || !compare_double(test, d)) {
+            len = snprintf(num, sizeof(num), "%1.17g", d);
+        }
+    }
+
+    if (len < 0 || len >= (int)sizeof(num)) {
+        w->overflow = true;
+        return;
+    }
+    put(w, num, len);
+}
+
+/**
+ * Separator and key ahead of a value
+ */
+static void begin_value(json_writer_t* w, const char* key) {
+    if (w->depth > 0) {
+        if (!w->first[w->depth - 1]) {
+            put(w, ",", 1);
+        }
+        w->first[w->depth - 1] = false;
+    }
+    if (key != NULL) {
+        put_string(w, key);
+        put(w, ":", 1);
+    }
+}
+
+/**
+ * Open a container level
+ */
+static void push(json_writer_t* w, const char* open) {
+    put(w, open, 1);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    w->first[w->depth++] = true;
+}
+
+/**
+ * Close a container level
+ */
+static void pop(json_writer_t* w, const char* close) {
+    put(w, close, 1);
+    if (w->depth > 0) {
+        w->depth--;
+    }
+}
+
+/**
+ * Start a document
+ */
+void json_writer_init(json_writer_t* w, char* buf, size_t size) {
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = (size == 0);
+    w->depth = 0;
+    if (size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+/**
+ * Finish the document
+ */
+const char* json_writer_finish(json_writer_t* w) {
+    if (w->overflow || w->depth != 0) {
+        return NULL;
+    }
+    return w->buf;
+}
+
+/**
+ * Open an object
+ */
+void json_begin_object(json_writer_t* w, const char* key) {
+    begin_value(w, key);
+    push(w, "{");
+}
+
+/**
+ * Close an object
+ */
+void json_end_object(json_writer_t* w) {
+    pop(w, "}");
+}
+
+/**
+ * Open an array
+ */
+void json_begin_array(json_writer_t* w, const char* key) {
+    begin_value(w, key);
+    push(w, "[");
+}
+
+/**
+ * Close an array
+ */
+void json_end_array(json_writer_t* w) {
+    pop(w, "]");
+}
+
+/**
+ * Add a string
+ */
+void json_add_string(json_writer_t* w, const char* key, const char* value) {
+    if (value == NULL) {
+        return;
+    }
+    begin_value(w, key);
+    put_string(w, value);
+}
+
+/**
+ * Add a number
+ */
+void json_add_number(json_writer_t* w, const char* key, double value) {
+    begin_value(w, key);
+    put_number(w, value);
+}
+
+/**
+ * Add a boolean
+ */
+void json_add_bool(json_writer_t* w, const char* key, bool value) {
+    begin_value(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
@@ -1,6 +1,7 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "esp_system.h"
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -11,6 +12,9 @@
 #include "vehicle_performance.h"
 #include "utils.h"
 #include "mqtt_vehicle_client.h"
+#include "sim808.h"
+#include "sim808_cmux.h"
+#include "sim808_ppp.h"
 
 #define TAG "MAIN"
 
@@ -18,6 +22,11 @@
 #define WIFI_SSID "darmawan"
 #define WIFI_PASS "password"
 
+// Cellular APN (Change these for your operator)
+#define GPRS_APN  "internet"
+#define GPRS_USER ""
+#define GPRS_PASS ""
+
 const char* mode = "DEBUG"; // Set mode to "DEBUG" or "PRODUCTION"
 
 // functions forward declarations
@@ -25,6 +34,8 @@ static bool initialize_wifi(void);
 static esp_err_t initialize_sim808(void);
 static void initialize_sensors(void);
 static void initialize_performance(void);
+static esp_err_t connect_gprs(void);
+static esp_err_t connect_mqtt(void);
 
 
 /**
@@ -37,14 +48,22 @@ static void initialize_performance(void) {
 
 /**
  * Initialize and start MQTT client
+ * @param sim808_tcp Connect over the modem's TCP stack instead of esp-mqtt
  */
-static void initialize_mqtt(void) {
+static esp_err_t initialize_mqtt(bool sim808_tcp) {
     mqtt_vehicle_init(web_config_get_vehicle_id());
+    
+    if (sim808_tcp) {
+        // Reconnects on its own from here on
+        return connect_mqtt();
+    }
+    
     mqtt_vehicle_start();
     ESP_LOGI(TAG, "✓ MQTT client started");
     
     // Wait for MQTT connection
     vTaskDelay(pdMS_TO_TICKS(3000));
+    return ESP_OK;
 }
 
 /**
@@ -67,6 +86,16 @@ void app_main(void) {
     ESP_LOGI(TAG, "Starting system initialization...");
     ESP_LOGI(TAG, "");
     
+    // NVS holds persisted driver settings (e.g. negotiated SIM808 baud rate)
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        nvs_flash_init();
+    }
+    
+    // Without PPP, MQTT runs on the SIM808's own TCP stack
+    bool sim808_tcp = false;
+    
     if(mode == "DEBUG"){
         ESP_LOGI(TAG, "Mode: DEBUG");
         ESP_LOGI(TAG, " Connecting to WiFi...");
@@ -83,6 +112,7 @@ void app_main(void) {
             vTaskDelay(pdMS_TO_TICKS(10000));
             esp_restart();
         }
+        sim808_tcp = !SIM808_USE_PPP;
     }
 
 
@@ -95,7 +125,11 @@ void app_main(void) {
     
     // Step 6: Initialize MQTT
     ESP_LOGI(TAG, "[6/8] Initializing MQTT client...");
-    initialize_mqtt();
+    if (initialize_mqtt(sim808_tcp) != ESP_OK) {
+        ESP_LOGE(TAG, "MQTT connection failed. Restarting in 10 seconds...");
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        esp_restart();
+    }
     
     // Step 7: Start vehicle tasks
     ESP_LOGI(TAG, "[7/8] Starting vehicle tasks...");
@@ -166,6 +200,32 @@ static esp_err_t initialize_sim808(void) {
         ESP_LOGI(TAG, "✓ Signal quality: RSSI=%d, BER=%d", rssi, ber);
     }
     
+#if SIM808_USE_CMUX
+    // GNSS and status commands then run beside the data session
+    if (sim808_cmux_start() != ESP_OK) {
+        ESP_LOGW(TAG, "CMUX unavailable, data mode will share the AT channel");
+    }
+#endif
+    
+#if SIM808_USE_PPP
+    // IP link over the modem, the MQTT client then works exactly as on WiFi
+    sim808_gprs_config_t gprs_config = {
+        .apn = GPRS_APN,
+        .username = GPRS_USER,
+        .password = GPRS_PASS,
+    };
+    if (sim808_ppp_start(&gprs_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start PPP link");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "✓ PPP link up");
+#else
+    // Bearer for the modem's TCP stack, connect_mqtt() runs over it
+    if (connect_gprs() != ESP_OK) {
+        return ESP_FAIL;
+    }
+#endif
+    
     return ESP_OK;
 }
 
@@ -261,12 +321,12 @@ static esp_err_t connect_mqtt(void) {
     ESP_LOGI(TAG, "Connecting to MQTT broker (RabbitMQ)...");
     
     sim808_mqtt_config_t mqtt_config = {
-        .broker = MQTT_BROKER,
-        .port = MQTT_PORT,
+        .broker = MQTT_BROKER_HOST,
+        .port = MQTT_BROKER_PORT,
         .username = MQTT_USERNAME,
         .password = MQTT_PASSWORD,
-        .client_id = VEHICLE_ID,
     };
+    strncpy(mqtt_config.client_id, web_config_get_vehicle_id(), sizeof(mqtt_config.client_id) - 1);
     
     if (sim808_mqtt_connect(&mqtt_config) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to connect to MQTT");
@@ -275,17 +335,9 @@ static esp_err_t connect_mqtt(void) {
     
     ESP_LOGI(TAG, "✓ MQTT connected to RabbitMQ");
     
-    // Subscribe to control topics
-    char topic[128];
-    snprintf(topic, sizeof(topic), "control.start_rent.%s", VEHICLE_ID);
-    sim808_mqtt_subscribe(topic);
-    
-    snprintf(topic, sizeof(topic), "control.end_rent.%s", VEHICLE_ID);
-    sim808_mqtt_subscribe(topic);
-    
-    // Publish registration
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    publish_registration();
+    // Commands, subscriptions, registration and telemetry then go over this
+    // connection, as on WiFi, and come back after every reconnect
+    mqtt_vehicle_use_sim808();
     
     return ESP_OK;
 }
@@ -0,0 +1,440 @@
+#include "mqtt_codec.h"
+#include <string.h>
+
+/**
+ * Write a big-endian 16 bit value
+ */
+static uint8_t* put_u16(uint8_t* p, uint16_t value) {
+    p[0] = (value >> 8) & 0xFF;
+    p[1] = value & 0xFF;
+    return p + 2;
+}
+
+/**
+ * Write a length-prefixed UTF-8 string
+ */
+static uint8_t* put_string(uint8_t* p, const char* str, size_t len) {
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, str, len);
+    return p + len;
+}
+
+/**
+ * Read a big-endian 16 bit value
+ */
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * Write fixed header, returns pointer past it or NULL if it doesn't fit
+ */
+static uint8_t* put_fixed_header(uint8_t* buf, size_t size, uint8_t first_byte,
+                                 uint32_t remaining_length, size_t body_in_buf) {
+    uint8_t varint[4];
+    int varint_len = mqtt_encode_varint(remaining_length, varint);
+    if (varint_len < 0) {
+        return NULL;
+    }
+    if (size < 1 + (size_t)varint_len + body_in_buf) {
+        return NULL;
+    }
+    buf[0] = first_byte;
+    memcpy(buf + 1, varint, varint_len);
+    return buf + 1 + varint_len;
+}
+
+/**
+ * Encode varint
+ */
+int mqtt_encode_varint(uint32_t value, uint8_t* out) {
+    if (value > MQTT_MAX_REMAINING_LENGTH) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    int len = 0;
+    do {
+        uint8_t byte = value % 128;
+        value /= 128;
+        if (value > 0) {
+            byte |= 0x80;
+        }
+        out[len++] = byte;
+    } while (value > 0);
+
+    return len;
+}
+
+/**
+ * Decode varint
+ */
+int mqtt_decode_varint(const uint8_t* in, size_t len, uint32_t* value) {
+    uint32_t result = 0;
+    uint32_t multiplier = 1;
+
+    for (size_t i = 0; i < 4; i++) {
+        if (i >= len) {
+            return MQTT_CODEC_INCOMPLETE;
+        }
+        result += (in[i] & 0x7F) * multiplier;
+        if ((in[i] & 0x80) == 0) {
+            *value = result;
+            return (int)i + 1;
+        }
+        multiplier *= 128;
+    }
+
+    return MQTT_CODEC_ERR_MALFORMED;
+}
+
+/**
+ * Encode CONNECT
+ */
+int mqtt_encode_connect(uint8_t* buf, size_t size, const mqtt_connect_options_t* opts) {
+    size_t client_id_len = opts->client_id ? strlen(opts->client_id) : 0;
+    size_t username_len = opts->username ? strlen(opts->username) : 0;
+    size_t password_len = opts->password ? strlen(opts->password) : 0;
+
+    if (client_id_len > 0xFFFF || username_len > 0xFFFF || password_len > 0xFFFF) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    uint8_t flags = opts->clean_session ? 0x02 : 0x00;
+    uint32_t remaining = 10 + 2 + client_id_len;
+    if (username_len > 0) {
+        flags |= 0x80;
+        remaining += 2 + username_len;
+    }
+    if (password_len > 0) {
+        flags |= 0x40;
+        remaining += 2 + password_len;
+    }
+
+    uint8_t* p = put_fixed_header(buf, size, MQTT_PKT_CONNECT << 4, remaining, remaining);
+    if (p == NULL) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+
+    // Variable header: protocol name, level 4 (3.1.1), flags, keep alive
+    p = put_string(p, "MQTT", 4);
+    *p++ = 0x04;
+    *p++ = flags;
+    p = put_u16(p, opts->keepalive);
+
+    // Payload
+    p = put_string(p, opts->client_id ? opts->client_id : "", client_id_len);
+    if (username_len > 0) {
+        p = put_string(p, opts->username, username_len);
+    }
+    if (password_len > 0) {
+        p = put_string(p, opts->password, password_len);
+    }
+
+    return (int)(p - buf);
+}
+
+/**
+ * Encode PUBLISH header
+ */
+int mqtt_encode_publish_header(uint8_t* buf, size_t size, const char* topic,
+                               size_t payload_len, uint8_t qos, bool retain,
+                               uint16_t packet_id) {
+    size_t topic_len = strlen(topic);
+    if (topic_len == 0 || topic_len > 0xFFFF || qos > 1) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+    if (qos > 0 && packet_id == 0) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    size_t variable_len = 2 + topic_len + (qos > 0 ? 2 : 0);
+    if (variable_len + payload_len > MQTT_MAX_REMAINING_LENGTH) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    uint8_t first = (MQTT_PKT_PUBLISH << 4) | (qos << 1) | (retain ? 0x01 : 0x00);
+    uint8_t* p = put_fixed_header(buf, size, first, variable_len + payload_len, variable_len);
+    if (p == NULL) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+
+    p = put_string(p, topic, topic_len);
+    if (qos > 0) {
+        p = put_u16(p, packet_id);
+    }
+
+    return (int)(p - buf);
+}
+
+/**
+ * Encode PUBLISH
+ */
+int mqtt_encode_publish(uint8_t* buf, size_t size, const char* topic,
+                        const void* payload, size_t payload_len, uint8_t qos,
+                        bool retain, uint16_t packet_id) {
+    int header_len = mqtt_encode_publish_header(buf, size, topic, payload_len,
+                                                qos, retain, packet_id);
+    if (header_len < 0) {
+        return header_len;
+    }
+    if (size - header_len < payload_len) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+
+    memcpy(buf + header_len, payload, payload_len);
+    return header_len + (int)payload_len;
+}
+
+/**
+ * Encode SUBSCRIBE
+ */
+int mqtt_encode_subscribe(uint8_t* buf, size_t size, uint16_t packet_id,
+                          const char* topic, uint8_t qos) {
+    size_t topic_len = strlen(topic);
+    if (topic_len == 0 || topic_len > 0xFFFF || qos > 2 || packet_id == 0) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    // Reserved flags 0010 are mandatory for SUBSCRIBE
+    uint32_t remaining = 2 + 2 + topic_len + 1;
+    uint8_t* p = put_fixed_header(buf, size, (MQTT_PKT_SUBSCRIBE << 4) | 0x02, remaining, remaining);
+    if (p == NULL) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+
+    p = put_u16(p, packet_id);
+    p = put_string(p, topic, topic_len);
+    *p++ = qos;
+
+    return (int)(p - buf);
+}
+
+/**
+ * Encode PUBACK
+ */
+int mqtt_encode_puback(uint8_t* buf, size_t size, uint16_t packet_id) {
+    if (size < 4) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+    buf[0] = MQTT_PKT_PUBACK << 4;
+    buf[1] = 2;
+    put_u16(buf + 2, packet_id);
+    return 4;
+}
+
+/**
+ * Encode PINGREQ / DISCONNECT
+ */
+int mqtt_encode_empty(uint8_t* buf, size_t size, mqtt_packet_type_t type) {
+    if (type != MQTT_PKT_PINGREQ && type != MQTT_PKT_DISCONNECT) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+    if (size < 2) {
+        return MQTT_CODEC_ERR_BUFFER;
+    }
+    buf[0] = type << 4;
+    buf[1] = 0;
+    return 2;
+}
+
+/**
+ * Frame one packet
+ */
+int mqtt_decode_packet(const uint8_t* buf, size_t len, mqtt_packet_t* pkt) {
+    if (len < 2) {
+        return MQTT_CODEC_INCOMPLETE;
+    }
+
+    uint32_t remaining;
+    int varint_len = mqtt_decode_varint(buf + 1, len - 1, &remaining);
+    if (varint_len <= 0) {
+        return varint_len;
+    }
+
+    size_t total = 1 + varint_len + remaining;
+    if (len < total) {
+        return MQTT_CODEC_INCOMPLETE;
+    }
+
+    pkt->type = buf[0] >> 4;
+    pkt->flags = buf[0] & 0x0F;
+    pkt->remaining_length = remaining;
+    pkt->body = buf + 1 + varint_len;
+    pkt->total_length = total;
+
+    if (pkt->type < MQTT_PKT_CONNECT || pkt->type > MQTT_PKT_DISCONNECT) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    return (int)total;
+}
+
+/**
+ * Decode CONNACK
+ */
+int mqtt_decode_connack(const mqtt_packet_t* pkt, bool* session_present, uint8_t* return_code) {
+    if (pkt->type != MQTT_PKT_CONNACK || pkt->remaining_length != 2) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+    *session_present = (pkt->body[0] & 0x01) != 0;
+    *return_code = pkt->body[1];
+    return 0;
+}
+
+/**
+ * Decode SUBACK
+ */
+int mqtt_decode_suback(const mqtt_packet_t* pkt, uint16_t* packet_id, uint8_t* granted_qos) {
+    if (pkt->type != MQTT_PKT_SUBACK || pkt->remaining_length < 3) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+    *packet_id = get_u16(pkt->body);
+    *granted_qos = pkt->body[2];
+    return 0;
+}
+
+/**
+ * Decode PUBACK-style acknowledgement
+ */
+int mqtt_decode_ack(const mqtt_packet_t* pkt, uint16_t* packet_id) {
+    if (pkt->remaining_length != 2) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+    switch (pkt->type) {
+        case MQTT_PKT_PUBACK:
+        case MQTT_PKT_PUBREC:
+        case MQTT_PKT_PUBREL:
+        case MQTT_PKT_PUBCOMP:
+        case MQTT_PKT_UNSUBACK:
+            *packet_id = get_u16(pkt->body);
+            return 0;
+        default:
+            return MQTT_CODEC_ERR_MALFORMED;
+    }
+}
+
+/**
+ * Decode PUBLISH
+ */
+int mqtt_decode_publish(const mqtt_packet_t* pkt, mqtt_publish_t* publish) {
+    if (pkt->type != MQTT_PKT_PUBLISH || pkt->remaining_length < 2) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    publish->qos = (pkt->flags >> 1) & 0x03;
+    publish->retain = (pkt->flags & 0x01) != 0;
+    publish->dup = (pkt->flags & 0x08) != 0;
+    if (publish->qos > 2) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    size_t offset = 2;
+    publish->topic_len = get_u16(pkt->body);
+    publish->topic = (const char*)pkt->body + 2;
+    offset += publish->topic_len;
+
+    publish->packet_id = 0;
+    if (publish->qos > 0) {
+        if (offset + 2 > pkt->remaining_length) {
+            return MQTT_CODEC_ERR_MALFORMED;
+        }
+        publish->packet_id = get_u16(pkt->body + offset);
+        offset += 2;
+    }
+
+    if (offset > pkt->remaining_length) {
+        return MQTT_CODEC_ERR_MALFORMED;
+    }
+
+    publish->payload = pkt->body + offset;
+    publish->payload_len = pkt->remaining_length - offset;
+    return 0;
+}
+
+/**
+ * CONNACK return code description
+ */
+const char* mqtt_connack_reason(uint8_t return_code) {
+    switch (return_code) {
+        case MQTT_CONNACK_ACCEPTED:           return "accepted";
+        case MQTT_CONNACK_BAD_PROTOCOL:       return "unacceptable protocol version";
+        case MQTT_CONNACK_ID_REJECTED:        return "identifier rejected";
+        case MQTT_CONNACK_SERVER_UNAVAILABLE: return "server unavailable";
+        case MQTT_CONNACK_BAD_CREDENTIALS:    return "bad user name or password";
+        case MQTT_CONNACK_NOT_AUTHORIZED:     return "not authorized";
+        default:                              return "unknown";
+    }
+}
+
+/**
+ * Reset session
+ */
+void mqtt_session_init(mqtt_session_t* session) {
+    memset(session, 0, sizeof(*session));
+    session->next_id = 1;
+}
+
+/**
+ * Check whether a packet id is still in flight
+ */
+static bool session_is_inflight(const mqtt_session_t* session, uint16_t packet_id) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (session->inflight[i] == packet_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Allocate packet id
+ */
+uint16_t mqtt_session_next_id(mqtt_session_t* session) {
+    uint16_t id;
+    do {
+        id = session->next_id++;
+        if (session->next_id == 0) {
+            session->next_id = 1;
+        }
+    } while (id == 0 || session_is_inflight(session, id));
+    return id;
+}
+
+/**
+ * Track QoS 1 packet
+ */
+bool mqtt_session_track(mqtt_session_t* session, uint16_t packet_id) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (session->inflight[i] == 0) {
+            session->inflight[i] = packet_id;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Acknowledge packet
+ */
+bool mqtt_session_ack(mqtt_session_t* session, uint16_t packet_id) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (session->inflight[i] == packet_id) {
+            session->inflight[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Count in-flight packets
+ */
+int mqtt_session_inflight(const mqtt_session_t* session) {
+    int count = 0;
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (session->inflight[i] != 0) {
+            count++;
+        }
+    }
+    return count;
+}
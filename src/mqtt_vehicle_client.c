@@ -1,35 +1,251 @@
 #include "mqtt_vehicle_client.h"
 #include "mqtt_client.h"
 #include "vehicle_performance.h"
+#include "sim808.h"
+#include "sim808_diag.h"
+#include "sim808_ppp.h"
+#include "json_writer.h"
+#include "telemetry_codec.h"
+#include "flash_queue.h"
+#include "flash_queue_partition.h"
+#include "outbox_policy.h"
+#include "vehicle_tasks.h"
+#include "seqlock.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include <stdatomic.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 static const char *TAG = "MQTT_VEHICLE";
 static esp_mqtt_client_handle_t client = NULL;
+static volatile bool connected = false;
 static char vehicle_id[32] = {0};
-static vehicle_state_t vehicle_state = {
-    .is_active = false,
-    .is_locked = true,
-    .is_killed = false,
-    .kill_scheduled = false
+
+// Set by mqtt_vehicle_use_sim808(): publishes go out over the modem's own
+// TCP stack, batched into shared CIPSENDs, and esp-mqtt stays idle
+static bool sim808_transport = false;
+
+// Publish topics, built once in mqtt_vehicle_init()
+static char topic_location[64];
+static char topic_status[64];
+static char topic_battery[64];
+static char topic_performance[64];
+static char topic_track[64];
+static char topic_frame[64];
+static char topic_diag[64];
+
+// Subscribed as control.<command>.<vehicle_id>
+static const char* const control_commands[] = {
+    "start_rent", "end_rent", "kill_vehicle", "set_encoding"
+};
+#define CONTROL_COMMAND_COUNT (sizeof(control_commands) / sizeof(control_commands[0]))
+
+// MQTT 5 topic aliases (MQTT_TOPIC_ALIASES), alias n stands for alias_topics[n - 1]. A mapping
+// only lives as long as the network connection, so alias_bound is cleared
+// when connection_count moves on. Only QoS 0 goes out alias-only: esp-mqtt
+// resends unacknowledged QoS 1 packets as encoded, maybe on a connection
+// that doesn't know the alias. Guarded by publish_mutex
+static char* const alias_topics[] = {
+    topic_frame, topic_location, topic_status, topic_battery, topic_track, topic_performance, topic_diag
+};
+#define ALIAS_COUNT (sizeof(alias_topics) / sizeof(alias_topics[0]))
+static SemaphoreHandle_t publish_mutex = NULL;
+static uint32_t alias_bound = 0;
+static bool aliases_refused = false;
+static uint32_t alias_connection = 0;
+static uint32_t alias_bytes_saved = 0;
+static volatile uint32_t connection_count = 0;
+static uint32_t sessions_resumed = 0;
+
+// Payloads are written in place, publishing never touches the heap
+static SemaphoreHandle_t payload_mutex = NULL;
+static char payload_buf[PAYLOAD_BUF_SIZE];
+static char diag_buf[DIAG_PAYLOAD_BUF_SIZE];
+
+// realtime.* and report.performance.* go out binary once the backend asks,
+// locations optionally batched into realtime.track
+static bool binary_encoding = false;
+static bool track_batching = false;
+
+// Pending track batch, guarded by payload_mutex
+static telemetry_track_point_t track_points[TRACK_BATCH_POINTS];
+static size_t track_count = 0;
+static uint8_t track_buf[TELEMETRY_TRACK_MAX_MESSAGE];
+
+// Messages held in flash while the broker is unreachable, one record is
+// qos, topic length, topic and payload
+#define BACKLOG_RECORD_MAX  (2 + 64 + TELEMETRY_TRACK_MAX_MESSAGE)
+static SemaphoreHandle_t backlog_mutex = NULL;
+static flash_queue_t backlog;
+static bool backlog_ready = false;
+static uint8_t backlog_buf[BACKLOG_RECORD_MAX];
+static uint8_t replay_buf[BACKLOG_RECORD_MAX];  // Publisher task only
+
+// Per-class QoS and share of esp-mqtt's outbox, counters under outbox_lock
+static const outbox_class_config_t outbox_classes[OUTBOX_CLASS_COUNT] = {
+    [OUTBOX_CLASS_REPORT] = { MQTT_QOS_REPORT, MQTT_SHARE_REPORT },
+    [OUTBOX_CLASS_STATUS] = { MQTT_QOS_STATUS, MQTT_SHARE_STATUS },
+    [OUTBOX_CLASS_TRACK] = { MQTT_QOS_TRACK, MQTT_SHARE_TRACK },
+    [OUTBOX_CLASS_READING] = { MQTT_QOS_READING, MQTT_SHARE_READING },
+    [OUTBOX_CLASS_DIAG] = { MQTT_QOS_DIAG, MQTT_SHARE_DIAG },
 };
+static outbox_policy_t outbox;
+static portMUX_TYPE outbox_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Double buffered so snapshots never block or tear; the command handler
+// and the tracking task's kill switch both write, under state_mutex
+#define VEHICLE_STATE_INITIAL { .is_active = false, .is_locked = true, .is_killed = false, .kill_scheduled = false }
+static vehicle_state_t vehicle_state[2] = { VEHICLE_STATE_INITIAL, VEHICLE_STATE_INITIAL };
+static seqlock_t state_seq;
+static SemaphoreHandle_t state_mutex = NULL;
+
+// Publishes asked for by command and connection handlers, sent by the
+// publisher task in mqtt_publish_pending(). Handlers never publish: the
+// esp-mqtt task holds the client lock while it runs them, and publishers
+// call into esp-mqtt with payload_mutex held
+#define PENDING_REGISTRATION    0x01
+#define PENDING_PERFORMANCE     0x02
+static _Atomic uint32_t pending_publishes = 0;
+static vehicle_performance_t pending_report;    // Taken at end_rent
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /**
- * Get current ISO8601 timestamp
+ * Format ms since the Unix epoch as an ISO8601 timestamp
  */
-static void get_timestamp(char* buffer, size_t size) {
+static void format_timestamp(uint64_t epoch_ms, char* buffer, size_t size) {
+    time_t sec = (time_t)(epoch_ms / 1000);
+    struct tm timeinfo;
+    gmtime_r(&sec, &timeinfo);
+    
+    strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
+    snprintf(buffer + strlen(buffer), size - strlen(buffer), ".%03dZ", (int)(epoch_ms % 1000));
+}
+
+/**
+ * Get current time in ms since the Unix epoch
+ */
+static uint64_t get_epoch_ms(void) {
     struct timeval tv;
     gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/**
+ * Get current ISO8601 timestamp
+ */
+static void get_timestamp(char* buffer, size_t size) {
+    format_timestamp(get_epoch_ms(), buffer, size);
+}
+
+/**
+ * Start changing the vehicle state, returns the copy to modify
+ */
+static vehicle_state_t* state_write_begin(void) {
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    uint32_t seq = seqlock_write_begin(&state_seq);
+    vehicle_state[(seq + 1) & 1] = vehicle_state[seq & 1];
+    return &vehicle_state[(seq + 1) & 1];
+}
+
+/**
+ * Publish the modified copy
+ */
+static void state_write_end(void) {
+    seqlock_write_end(&state_seq);
+    xSemaphoreGive(state_mutex);
+}
+
+static void backlog_store(const char* topic, const char* data, int len, int qos);
+
+/**
+ * Keep a batched QoS 1 message whose CIPSEND failed, batch task or reconnect
+ */
+static void sim808_publish_done(esp_err_t result, const char* topic, const void* payload,
+                                size_t len, void* arg) {
+    if (result != ESP_OK) {
+        ESP_LOGW(TAG, "Batched publish to %s failed, keeping it in the backlog", topic);
+        backlog_store(topic, payload, (int)len, (int)(intptr_t)arg);
+    }
+}
+
+/**
+ * Hand a message to esp-mqtt, as a topic alias where that's safe
+ * @return esp_mqtt_client_publish() result
+ */
+static int client_publish(const char* topic, const char* data, int len, int qos) {
+    esp_mqtt5_publish_property_config_t property = {0};
     
-    time_t now = tv.tv_sec;
-    struct tm timeinfo;
-    gmtime_r(&now, &timeinfo);
+    // Publishes within SIM808_BATCH_WINDOW_MS share one CIPSEND handshake;
+    // a refusal (in-flight window full) is treated like a full outbox. Queued
+    // is not sent: a QoS 1 message lost with its batch goes to the backlog
+    if (sim808_transport) {
+        sim808_publish_cb_t done = (qos > 0 && backlog_ready) ? sim808_publish_done : NULL;
+        esp_err_t ret = sim808_mqtt_publish_batched(topic, data, len, qos, done, (void*)(intptr_t)qos);
+        return (ret == ESP_OK) ? 0 : -2;
+    }
     
-    strftime(buffer, size, "%Y-%m-%dT%H:%M:%S", &timeinfo);
-    snprintf(buffer + strlen(buffer), size - strlen(buffer), ".%03ldZ", tv.tv_usec / 1000);
+    if (!MQTT_TOPIC_ALIASES) {
+        return esp_mqtt_client_publish(client, topic, data, len, qos, 0);
+    }
+    
+    // The property is one-shot client state, so setting it and publishing
+    // happen under publish_mutex. Only publisher tasks get here, handlers
+    // running on the esp-mqtt task never publish (mqtt_publish_pending)
+    xSemaphoreTake(publish_mutex, portMAX_DELAY);
+    if (alias_connection != connection_count) {
+        alias_connection = connection_count;
+        alias_bound = 0;
+        aliases_refused = false;
+    }
+    
+    // The first publish on a connection binds the alias, later QoS 0 ones
+    // send just the alias
+    const char* wire_topic = topic;
+    size_t index = ALIAS_COUNT;
+    if (connected && !aliases_refused) {
+        for (index = 0; index < ALIAS_COUNT && strcmp(topic, alias_topics[index]) != 0; index++) {
+        }
+        if (index < ALIAS_COUNT && (!(alias_bound & (1u << index)) || qos == 0)) {
+            property.topic_alias = (uint16_t)(index + 1);
+            if (alias_bound & (1u << index)) {
+                wire_topic = "";
+            }
+        }
+    }
+    
+    if (esp_mqtt5_client_set_publish_property(client, &property) != ESP_OK) {
+        // Broker takes fewer aliases (its Topic Alias Maximum)
+        ESP_LOGW(TAG, "Broker refused topic alias %u, sending full topics", property.topic_alias);
+        aliases_refused = true;
+        memset(&property, 0, sizeof(property));
+        wire_topic = topic;
+        esp_mqtt5_client_set_publish_property(client, &property);
+    }
+    int msg_id = esp_mqtt_client_publish(client, wire_topic, data, len, qos, 0);
+    
+    if (msg_id >= 0 && property.topic_alias) {
+        if (wire_topic == topic) {
+            alias_bound |= 1u << index;
+        } else {
+            // Topic string minus the 3 byte alias property
+            alias_bytes_saved += strlen(topic) - 3;
+        }
+    }
+    xSemaphoreGive(publish_mutex);
+    return msg_id;
+}
+
+/**
+ * Ask the publisher task to send something
+ */
+static void request_publish(uint32_t what) {
+    atomic_fetch_or(&pending_publishes, what);
+    vehicle_tasks_wake_publisher();
 }
 
 /**
@@ -63,42 +279,76 @@ static void handle_command(const char* topic, const char* data, int data_len) {
     
     // Handle commands
     if (strcmp(command, "start_rent") == 0) {
+        vehicle_state_t* state = state_write_begin();
         cJSON *order_id_json = cJSON_GetObjectItem(json, "order_id");
         if (order_id_json && cJSON_IsString(order_id_json)) {
-            strncpy(vehicle_state.order_id, order_id_json->valuestring, sizeof(vehicle_state.order_id) - 1);
-            ESP_LOGI(TAG, "Starting rent with order_id: %s", vehicle_state.order_id);
+            strncpy(state->order_id, order_id_json->valuestring, sizeof(state->order_id) - 1);
+            ESP_LOGI(TAG, "Starting rent with order_id: %s", state->order_id);
         }
         
-        vehicle_state.is_locked = false;
-        vehicle_state.is_active = true;
-        vehicle_state.is_killed = false;
-        vehicle_state.kill_scheduled = false;
+        state->is_locked = false;
+        state->is_active = true;
+        state->is_killed = false;
+        state->kill_scheduled = false;
+        
+        char order_id[sizeof(state->order_id)];
+        memcpy(order_id, state->order_id, sizeof(order_id));
+        state_write_end();
         
         // Start performance tracking
-        performance_start_tracking(vehicle_state.order_id);
+        performance_start_tracking(order_id);
         
         ESP_LOGI(TAG, "Vehicle unlocked and activated");
     }
     else if (strcmp(command, "end_rent") == 0) {
-        vehicle_state.is_active = false;
-        vehicle_state.is_locked = true;
+        vehicle_state_t* state = state_write_begin();
+        state->is_active = false;
+        state->is_locked = true;
+        state_write_end();
         
         // Stop performance tracking and send report
         performance_stop_tracking();
-        mqtt_publish_performance();
+        vehicle_performance_t report = performance_get_data();
+        portENTER_CRITICAL(&pending_lock);
+        pending_report = report;
+        portEXIT_CRITICAL(&pending_lock);
+        request_publish(PENDING_PERFORMANCE);
         
-        memset(vehicle_state.order_id, 0, sizeof(vehicle_state.order_id));
+        state = state_write_begin();
+        memset(state->order_id, 0, sizeof(state->order_id));
+        state_write_end();
         ESP_LOGI(TAG, "Rent ended, vehicle locked");
     }
     else if (strcmp(command, "kill_vehicle") == 0) {
-        vehicle_state.kill_scheduled = true;
+        state_write_begin()->kill_scheduled = true;
+        state_write_end();
         ESP_LOGW(TAG, "Kill vehicle scheduled (waiting for low speed)");
     }
+    else if (strcmp(command, "set_encoding") == 0) {
+        cJSON *encoding_json = cJSON_GetObjectItem(json, "encoding");
+        if (encoding_json && cJSON_IsString(encoding_json)) {
+            if (strcmp(encoding_json->valuestring, TELEMETRY_ENCODING_TRACK) == 0) {
+                binary_encoding = true;
+                track_batching = true;
+            } else if (strcmp(encoding_json->valuestring, TELEMETRY_ENCODING_BINARY) == 0) {
+                binary_encoding = true;
+                track_batching = false;
+            } else if (strcmp(encoding_json->valuestring, TELEMETRY_ENCODING_JSON) == 0) {
+                binary_encoding = false;
+                track_batching = false;
+            } else {
+                ESP_LOGW(TAG, "Unsupported encoding: %s", encoding_json->valuestring);
+            }
+        }
+        ESP_LOGI(TAG, "Telemetry encoding: %s",
+                 track_batching ? TELEMETRY_ENCODING_TRACK :
+                 binary_encoding ? TELEMETRY_ENCODING_BINARY : TELEMETRY_ENCODING_JSON);
+    }
     
     cJSON_Delete(json);
     
-    // Publish status update
-    mqtt_publish_status(vehicle_state.is_active, vehicle_state.is_locked, vehicle_state.is_killed);
+    // The tracking task closes the track batch and sends the new status
+    vehicle_tasks_notify_state_change();
 }
 
 /**
@@ -110,27 +360,34 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
+            connection_count++;
+            connected = true;
+            
+            // The broker kept our session, subscriptions included
+            if (event->session_present) {
+                sessions_resumed++;
+                ESP_LOGI(TAG, "Connected to MQTT broker, session resumed");
+                request_publish(PENDING_REGISTRATION);
+                break;
+            }
             ESP_LOGI(TAG, "Connected to MQTT broker");
             
             // Subscribe to control commands
             char topic[128];
-            snprintf(topic, sizeof(topic), "control.start_rent.%s", vehicle_id);
-            esp_mqtt_client_subscribe(client, topic, 1);
-            
-            snprintf(topic, sizeof(topic), "control.end_rent.%s", vehicle_id);
-            esp_mqtt_client_subscribe(client, topic, 1);
-            
-            snprintf(topic, sizeof(topic), "control.kill_vehicle.%s", vehicle_id);
-            esp_mqtt_client_subscribe(client, topic, 1);
+            for (size_t i = 0; i < CONTROL_COMMAND_COUNT; i++) {
+                snprintf(topic, sizeof(topic), "control.%s.%s", control_commands[i], vehicle_id);
+                esp_mqtt_client_subscribe(client, topic, 1);
+            }
             
             ESP_LOGI(TAG, "Subscribed to control topics");
             
             // Send registration message
-            mqtt_publish_registration();
+            request_publish(PENDING_REGISTRATION);
             break;
             
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "Disconnected from MQTT broker");
+            connected = false;
             break;
             
         case MQTT_EVENT_DATA:
@@ -161,15 +418,62 @@ void mqtt_vehicle_init(const char* vid) {
         strncpy(vehicle_id, vid, sizeof(vehicle_id) - 1);
     }
     
+    snprintf(topic_location, sizeof(topic_location), "realtime.location.%s", vehicle_id);
+    snprintf(topic_status, sizeof(topic_status), "realtime.status.%s", vehicle_id);
+    snprintf(topic_battery, sizeof(topic_battery), "realtime.battery.%s", vehicle_id);
+    snprintf(topic_performance, sizeof(topic_performance), "report.performance.%s", vehicle_id);
+    snprintf(topic_track, sizeof(topic_track), "realtime.track.%s", vehicle_id);
+    snprintf(topic_frame, sizeof(topic_frame), "realtime.frame.%s", vehicle_id);
+    snprintf(topic_diag, sizeof(topic_diag), "diag.modem.%s", vehicle_id);
+    
+    if (payload_mutex == NULL) {
+        payload_mutex = xSemaphoreCreateMutex();
+    }
+    if (publish_mutex == NULL) {
+        publish_mutex = xSemaphoreCreateMutex();
+    }
+    if (state_mutex == NULL) {
+        state_mutex = xSemaphoreCreateMutex();
+        seqlock_init(&state_seq);
+    }
+    
+    // Messages a previous run couldn't deliver are still in flash
+    if (backlog_mutex == NULL) {
+        backlog_mutex = xSemaphoreCreateMutex();
+        
+        flash_queue_storage_t storage;
+        if (flash_queue_partition_storage(BACKLOG_PARTITION, &storage) == ESP_OK &&
+            flash_queue_mount(&backlog, &storage) == FLASH_QUEUE_OK) {
+            flash_queue_stats_t stats;
+            flash_queue_get_stats(&backlog, &stats);
+            ESP_LOGI(TAG, "Backlog: %lu messages pending", (unsigned long)stats.pending);
+            backlog_ready = true;
+        } else {
+            ESP_LOGW(TAG, "Backlog unavailable, messages are dropped while offline");
+        }
+    }
+    
+    outbox_policy_init(&outbox, MQTT_OUTBOX_LIMIT, outbox_classes);
+    
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = MQTT_BROKER_URI,
         .credentials.username = MQTT_USERNAME,
         .credentials.authentication.password = MQTT_PASSWORD,
         .session.keepalive = MQTT_KEEPALIVE,
+        .session.protocol_ver = MQTT_TOPIC_ALIASES ? MQTT_PROTOCOL_V_5 : MQTT_PROTOCOL_V_3_1_1,
+        .session.disable_clean_session = MQTT_PERSISTENT_SESSION,
         .network.disable_auto_reconnect = false,
+        .outbox.limit = MQTT_OUTBOX_LIMIT,
     };
     
     client = esp_mqtt_client_init(&mqtt_cfg);
+    
+    if (MQTT_TOPIC_ALIASES) {
+        esp_mqtt5_connection_property_config_t connect_property = {
+            .session_expiry_interval = MQTT_PERSISTENT_SESSION ? MQTT_SESSION_EXPIRY_S : 0,
+        };
+        esp_mqtt5_client_set_connect_property(client, &connect_property);
+    }
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     
     ESP_LOGI(TAG, "MQTT client initialized for vehicle: %s", vehicle_id);
@@ -195,11 +499,270 @@ void mqtt_vehicle_stop(void) {
     }
 }
 
+/**
+ * SIM808 connection (re)established: subscribe, as on MQTT_EVENT_CONNECTED
+ */
+static void sim808_connected(void) {
+    char topic[128];
+    for (size_t i = 0; i < CONTROL_COMMAND_COUNT; i++) {
+        snprintf(topic, sizeof(topic), "control.%s.%s", control_commands[i], vehicle_id);
+        sim808_mqtt_subscribe(topic);
+    }
+    ESP_LOGI(TAG, "Subscribed to control topics");
+    
+    request_publish(PENDING_REGISTRATION);
+}
+
+/**
+ * Publish over the SIM808 TCP stack from now on
+ */
+void mqtt_vehicle_use_sim808(void) {
+    sim808_transport = true;
+    ESP_LOGI(TAG, "Publishing over the SIM808 TCP stack");
+    
+    // Commands arrive on the SIM808 receive task, the handler only queues work
+    sim808_mqtt_set_message_handler(handle_command);
+    sim808_mqtt_set_connect_handler(sim808_connected);
+    sim808_connected();
+}
+
+/**
+ * Check the broker connection of the transport in use
+ */
+static bool link_connected(void) {
+    return sim808_transport ? sim808_mqtt_is_connected() : connected;
+}
+
+/**
+ * Bytes esp-mqtt holds unacknowledged (the SIM808 stack bounds its own)
+ */
+static uint32_t outbox_size(void) {
+    return sim808_transport ? 0 : (uint32_t)esp_mqtt_client_get_outbox_size(client);
+}
+
 /**
  * Check if MQTT is connected
  */
 bool mqtt_vehicle_is_connected(void) {
-    return (client != NULL);
+    return link_connected();
+}
+
+/**
+ * Keep a message in flash until the broker is reachable
+ */
+static void backlog_store(const char* topic, const char* data, int len, int qos) {
+    size_t topic_len = strlen(topic);
+    if (topic_len > UINT8_MAX || 2 + topic_len + len > sizeof(backlog_buf)) {
+        ESP_LOGE(TAG, "Message for %s too large for the backlog", topic);
+        return;
+    }
+    
+    xSemaphoreTake(backlog_mutex, portMAX_DELAY);
+    backlog_buf[0] = (uint8_t)qos;
+    backlog_buf[1] = (uint8_t)topic_len;
+    memcpy(backlog_buf + 2, topic, topic_len);
+    memcpy(backlog_buf + 2 + topic_len, data, len);
+    int ret = flash_queue_push(&backlog, backlog_buf, 2 + topic_len + len);
+    xSemaphoreGive(backlog_mutex);
+    
+    if (ret != FLASH_QUEUE_OK) {
+        ESP_LOGE(TAG, "Backlog write failed (%d)", ret);
+    }
+}
+
+/**
+ * Publish at the class QoS, or keep QoS 1 messages in flash while
+ * disconnected or while the class is over its share of the outbox
+ */
+static void publish_or_store(const char* topic, const char* data, int len, outbox_class_t cls) {
+    int qos = outbox_policy_qos(&outbox, cls);
+    if (!link_connected() && qos > 0 && backlog_ready) {
+        backlog_store(topic, data, len, qos);
+        return;
+    }
+    
+    uint32_t outbox_bytes = outbox_size();
+    portENTER_CRITICAL(&outbox_lock);
+    outbox_verdict_t verdict = outbox_policy_admit(&outbox, cls, outbox_bytes, len, backlog_ready);
+    portEXIT_CRITICAL(&outbox_lock);
+    
+    if (verdict == OUTBOX_SEND) {
+        // -2 is esp-mqtt's own limit, another task filled the outbox meanwhile
+        if (client_publish(topic, data, len, qos) != -2) {
+            return;
+        }
+        verdict = (qos > 0 && backlog_ready) ? OUTBOX_DEFER : OUTBOX_DROP;
+        portENTER_CRITICAL(&outbox_lock);
+        outbox_policy_refused(&outbox, cls, verdict);
+        portEXIT_CRITICAL(&outbox_lock);
+    }
+    
+    if (verdict == OUTBOX_DEFER) {
+        backlog_store(topic, data, len, qos);
+    } else {
+        ESP_LOGD(TAG, "Outbox at %lu bytes, dropped %s message", (unsigned long)outbox_bytes,
+                 outbox_class_name(cls));
+    }
+}
+
+/**
+ * Record the send result of a replayed message
+ */
+static void replay_done(esp_err_t result, const char* topic, const void* payload,
+                        size_t len, void* arg) {
+    *(esp_err_t*)arg = result;
+}
+
+/**
+ * Send one backlog record over the SIM808 and wait for its CIPSEND
+ * @return ESP_OK once the modem took it
+ */
+static esp_err_t replay_sim808(const char* topic, const char* data, int len, int qos) {
+    esp_err_t result = ESP_FAIL;
+    esp_err_t ret = sim808_mqtt_publish_batched(topic, data, len, qos, replay_done, &result);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    // Whoever sends the batch (this flush, the batch task or a reconnect)
+    // holds the batch lock, so the callback has run once this returns
+    sim808_mqtt_flush();
+    return result;
+}
+
+/**
+ * Replay a burst of stored messages
+ */
+void mqtt_replay_backlog(void) {
+    if (!client || !link_connected() || !backlog_ready) return;
+    
+    // backlog_mutex is never held across esp-mqtt calls: copy the record
+    // out, publish it, then pop it. Only this task pops, so the record
+    // popped is the one peeked, or gone if a push overwrote its sector.
+    // Over the SIM808 it is popped only after its CIPSEND succeeded
+    for (int i = 0; i < BACKLOG_REPLAY_BURST; i++) {
+        // Leave room for live traffic in esp-mqtt's outbox
+        if (outbox_size() > BACKLOG_OUTBOX_LIMIT) {
+            break;
+        }
+        
+        size_t len = 0;
+        xSemaphoreTake(backlog_mutex, portMAX_DELAY);
+        int ret = flash_queue_peek(&backlog, replay_buf, sizeof(replay_buf), &len);
+        xSemaphoreGive(backlog_mutex);
+        if (ret == FLASH_QUEUE_ERR_EMPTY || ret == FLASH_QUEUE_ERR_IO) {
+            break;
+        }
+        
+        if (ret == FLASH_QUEUE_OK && len >= 2 && 2 + (size_t)replay_buf[1] <= len) {
+            char topic[UINT8_MAX + 1];
+            size_t topic_len = replay_buf[1];
+            memcpy(topic, replay_buf + 2, topic_len);
+            topic[topic_len] = '\0';
+            
+            const char* data = (const char*)replay_buf + 2 + topic_len;
+            int data_len = (int)(len - 2 - topic_len);
+            if (sim808_transport) {
+                esp_err_t sent = replay_sim808(topic, data, data_len, replay_buf[0]);
+                if (sent == ESP_ERR_INVALID_ARG) {
+                    ESP_LOGW(TAG, "Skipping backlog record for %s, topic too long", topic);
+                } else if (sent != ESP_OK) {
+                    break;
+                }
+            } else if (client_publish(topic, data, data_len, replay_buf[0]) < 0) {
+                break;
+            }
+        } else {
+            ESP_LOGW(TAG, "Skipping unreadable backlog record (%u bytes)", (unsigned)len);
+        }
+        
+        xSemaphoreTake(backlog_mutex, portMAX_DELAY);
+        flash_queue_pop(&backlog);
+        xSemaphoreGive(backlog_mutex);
+    }
+}
+
+/**
+ * Publish a finished document
+ */
+static void publish_json(const char* topic, json_writer_t* w, outbox_class_t cls) {
+    const char* payload = json_writer_finish(w);
+    if (payload == NULL) {
+        ESP_LOGE(TAG, "Payload for %s doesn't fit its buffer", topic);
+        return;
+    }
+    publish_or_store(topic, payload, w->len, cls);
+}
+
+/**
+ * Publish an encoded binary message
+ */
+static void publish_binary(const char* topic, int len, outbox_class_t cls) {
+    if (len < 0) {
+        ESP_LOGE(TAG, "Binary payload for %s doesn't fit its buffer", topic);
+        return;
+    }
+    publish_or_store(topic, payload_buf, len, cls);
+}
+
+/**
+ * Publish the pending track batch, payload_mutex held
+ */
+static void track_flush_locked(void) {
+    if (track_count == 0) {
+        return;
+    }
+    
+    int len = telemetry_encode_track(track_buf, sizeof(track_buf), track_points, track_count);
+    if (len < 0) {
+        ESP_LOGE(TAG, "Track batch of %u points doesn't fit its buffer", (unsigned)track_count);
+    } else {
+        publish_or_store(topic_track, (const char*)track_buf, len, OUTBOX_CLASS_TRACK);
+        ESP_LOGD(TAG, "Published track: %u points, %d bytes", (unsigned)track_count, len);
+    }
+    track_count = 0;
+}
+
+/**
+ * Publish the pending track batch now
+ */
+void mqtt_flush_track(void) {
+    if (!client) return;
+    
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    track_flush_locked();
+    xSemaphoreGive(payload_mutex);
+}
+
+/**
+ * Publish the pending track batch once its oldest fix reached TRACK_BATCH_MS
+ */
+void mqtt_poll_track(void) {
+    if (!client) return;
+    
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    if (track_count > 0 && get_epoch_ms() - track_points[0].timestamp_ms >= TRACK_BATCH_MS) {
+        track_flush_locked();
+    }
+    xSemaphoreGive(payload_mutex);
+}
+
+/**
+ * Add a fix to the track batch, sending it once full or old enough
+ */
+static void track_append(uint64_t timestamp_ms, float latitude, float longitude, float altitude) {
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    track_points[track_count++] = (telemetry_track_point_t){
+        .timestamp_ms = timestamp_ms,
+        .latitude = latitude,
+        .longitude = longitude,
+        .altitude = altitude
+    };
+    if (track_count >= TRACK_BATCH_POINTS ||
+        track_points[track_count - 1].timestamp_ms - track_points[0].timestamp_ms >= TRACK_BATCH_MS) {
+        track_flush_locked();
+    }
+    xSemaphoreGive(payload_mutex);
 }
 
 /**
@@ -208,26 +771,46 @@ bool mqtt_vehicle_is_connected(void) {
 void mqtt_publish_location(float latitude, float longitude, float altitude) {
     if (!client) return;
     
-    char topic[128];
+    if (track_batching) {
+        track_append(get_epoch_ms(), latitude, longitude, altitude);
+        return;
+    }
+    
+    if (binary_encoding) {
+        telemetry_location_t location = {
+            .latitude = latitude,
+            .longitude = longitude,
+            .altitude = altitude
+        };
+        
+        xSemaphoreTake(payload_mutex, portMAX_DELAY);
+        int len = telemetry_encode_location((uint8_t*)payload_buf, sizeof(payload_buf),
+                                            get_epoch_ms(), &location);
+        publish_binary(topic_location, len, OUTBOX_CLASS_READING);
+        xSemaphoreGive(payload_mutex);
+        return;
+    }
+    
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
-    cJSON_AddNumberToObject(root, "latitude", latitude);
-    cJSON_AddNumberToObject(root, "longitude", longitude);
-    cJSON_AddNumberToObject(root, "altitude", altitude);
-    cJSON_AddStringToObject(root, "timestamp", timestamp);
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
     
-    char *payload = cJSON_PrintUnformatted(root);
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_number(&w, "latitude", latitude);
+    json_add_number(&w, "longitude", longitude);
+    json_add_number(&w, "altitude", altitude);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
     
-    snprintf(topic, sizeof(topic), "realtime.location.%s", vehicle_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
+    publish_json(topic_location, &w, OUTBOX_CLASS_READING);
     
-    ESP_LOGD(TAG, "Published location: %.6f, %.6f", latitude, longitude);
+    xSemaphoreGive(payload_mutex);
     
-    cJSON_free(payload);
-    cJSON_Delete(root);
+    ESP_LOGD(TAG, "Published location: %.6f, %.6f", latitude, longitude);
 }
 
 /**
@@ -236,26 +819,41 @@ void mqtt_publish_location(float latitude, float longitude, float altitude) {
 void mqtt_publish_status(bool is_active, bool is_locked, bool is_killed) {
     if (!client) return;
     
-    char topic[128];
+    if (binary_encoding) {
+        telemetry_status_t status = {
+            .is_active = is_active,
+            .is_locked = is_locked,
+            .is_killed = is_killed
+        };
+        
+        xSemaphoreTake(payload_mutex, portMAX_DELAY);
+        int len = telemetry_encode_status((uint8_t*)payload_buf, sizeof(payload_buf),
+                                          get_epoch_ms(), &status);
+        publish_binary(topic_status, len, OUTBOX_CLASS_STATUS);
+        xSemaphoreGive(payload_mutex);
+        return;
+    }
+    
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
-    cJSON_AddBoolToObject(root, "is_active", is_active);
-    cJSON_AddBoolToObject(root, "is_locked", is_locked);
-    cJSON_AddBoolToObject(root, "is_killed", is_killed);
-    cJSON_AddStringToObject(root, "timestamp", timestamp);
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
     
-    char *payload = cJSON_PrintUnformatted(root);
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_bool(&w, "is_active", is_active);
+    json_add_bool(&w, "is_locked", is_locked);
+    json_add_bool(&w, "is_killed", is_killed);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
     
-    snprintf(topic, sizeof(topic), "realtime.status.%s", vehicle_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
+    publish_json(topic_status, &w, OUTBOX_CLASS_STATUS);
     
-    ESP_LOGD(TAG, "Published status: active=%d, locked=%d", is_active, is_locked);
+    xSemaphoreGive(payload_mutex);
     
-    cJSON_free(payload);
-    cJSON_Delete(root);
+    ESP_LOGD(TAG, "Published status: active=%d, locked=%d", is_active, is_locked);
 }
 
 /**
@@ -264,63 +862,188 @@ void mqtt_publish_status(bool is_active, bool is_locked, bool is_killed) {
 void mqtt_publish_battery(float voltage, float battery_level) {
     if (!client) return;
     
-    char topic[128];
+    if (binary_encoding) {
+        telemetry_battery_t battery = {
+            .voltage = voltage,
+            .battery_level = battery_level
+        };
+        
+        xSemaphoreTake(payload_mutex, portMAX_DELAY);
+        int len = telemetry_encode_battery((uint8_t*)payload_buf, sizeof(payload_buf),
+                                           get_epoch_ms(), &battery);
+        publish_binary(topic_battery, len, OUTBOX_CLASS_READING);
+        xSemaphoreGive(payload_mutex);
+        return;
+    }
+    
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
-    cJSON_AddNumberToObject(root, "device_voltage", voltage);
-    cJSON_AddNumberToObject(root, "device_battery_level", battery_level);
-    cJSON_AddStringToObject(root, "timestamp", timestamp);
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
     
-    char *payload = cJSON_PrintUnformatted(root);
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_number(&w, "device_voltage", voltage);
+    json_add_number(&w, "device_battery_level", battery_level);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
     
-    snprintf(topic, sizeof(topic), "realtime.battery.%s", vehicle_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
+    publish_json(topic_battery, &w, OUTBOX_CLASS_READING);
+    
+    xSemaphoreGive(payload_mutex);
     
     ESP_LOGD(TAG, "Published battery: %.2fV, %.2f%%", voltage, battery_level);
+}
+
+/**
+ * Publish the readings of one tracking cycle
+ */
+void mqtt_publish_frame(const telemetry_frame_t* frame, uint64_t timestamp_ms) {
+    if (!client || frame->fields == 0) return;
     
-    cJSON_free(payload);
-    cJSON_Delete(root);
+#if REALTIME_LEGACY_TOPICS
+    if (frame->fields & TELEMETRY_FRAME_LOCATION) {
+        mqtt_publish_location(frame->location.latitude, frame->location.longitude,
+                              frame->location.altitude);
+    }
+    if (frame->fields & TELEMETRY_FRAME_STATUS) {
+        mqtt_publish_status(frame->status.is_active, frame->status.is_locked, frame->status.is_killed);
+    }
+    if (frame->fields & TELEMETRY_FRAME_BATTERY) {
+        mqtt_publish_battery(frame->battery.voltage, frame->battery.battery_level);
+    }
+#else
+    telemetry_frame_t f = *frame;
+    
+    // Track batches carry the fixes
+    if (track_batching && (f.fields & TELEMETRY_FRAME_LOCATION)) {
+        track_append(timestamp_ms, f.location.latitude, f.location.longitude, f.location.altitude);
+        f.fields &= ~TELEMETRY_FRAME_LOCATION;
+        if (f.fields == 0) return;
+    }
+    
+    // Readings alone are superseded by the next frame, a status change isn't
+    outbox_class_t frame_class = (f.fields & TELEMETRY_FRAME_STATUS) ? OUTBOX_CLASS_STATUS
+                                                                      : OUTBOX_CLASS_READING;
+    
+    if (binary_encoding) {
+        xSemaphoreTake(payload_mutex, portMAX_DELAY);
+        int len = telemetry_encode_frame((uint8_t*)payload_buf, sizeof(payload_buf), timestamp_ms, &f);
+        publish_binary(topic_frame, len, frame_class);
+        xSemaphoreGive(payload_mutex);
+        return;
+    }
+    
+    char timestamp[32];
+    format_timestamp(timestamp_ms, timestamp, sizeof(timestamp));
+    
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    
+    // A reading is present when its object is
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    if (f.fields & TELEMETRY_FRAME_LOCATION) {
+        json_begin_object(&w, "location");
+        json_add_number(&w, "latitude", f.location.latitude);
+        json_add_number(&w, "longitude", f.location.longitude);
+        json_add_number(&w, "altitude", f.location.altitude);
+        json_end_object(&w);
+    }
+    if (f.fields & TELEMETRY_FRAME_STATUS) {
+        json_begin_object(&w, "status");
+        json_add_bool(&w, "is_active", f.status.is_active);
+        json_add_bool(&w, "is_locked", f.status.is_locked);
+        json_add_bool(&w, "is_killed", f.status.is_killed);
+        json_end_object(&w);
+    }
+    if (f.fields & TELEMETRY_FRAME_BATTERY) {
+        json_begin_object(&w, "battery");
+        json_add_number(&w, "device_voltage", f.battery.voltage);
+        json_add_number(&w, "device_battery_level", f.battery.battery_level);
+        json_end_object(&w);
+    }
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
+    
+    publish_json(topic_frame, &w, frame_class);
+    
+    xSemaphoreGive(payload_mutex);
+    
+    ESP_LOGD(TAG, "Published frame: fields=0x%02x", f.fields);
+#endif
 }
 
 /**
- * Publish performance report
+ * Publish a performance report from given data
  */
-void mqtt_publish_performance(void) {
+static void publish_performance(const vehicle_performance_t* perf) {
     if (!client) return;
     
-    vehicle_performance_t perf = performance_get_data();
+    telemetry_performance_t report = {
+        .front_tire = perf->s_front_tire,
+        .rear_tire = perf->s_rear_tire,
+        .brake_pad = perf->s_brake_pad,
+        .engine_oil = perf->s_engine_oil,
+        .chain_or_cvt = perf->s_chain_or_cvt,
+        .engine = perf->s_engine,
+        .distance_travelled = perf->total_distance_km,
+        .average_speed = perf->average_speed,
+        .max_speed = perf->max_speed
+    };
+    strncpy(report.order_id, perf->order_id, sizeof(report.order_id) - 1);
+    strncpy(report.weight_score, perf->weight_score, sizeof(report.weight_score) - 1);
+    
+    if (binary_encoding) {
+        xSemaphoreTake(payload_mutex, portMAX_DELAY);
+        int len = telemetry_encode_performance((uint8_t*)payload_buf, sizeof(payload_buf),
+                                               get_epoch_ms(), &report);
+        publish_binary(topic_performance, len, OUTBOX_CLASS_REPORT);
+        xSemaphoreGive(payload_mutex);
+        
+        ESP_LOGI(TAG, "Published binary performance report for order: %s", report.order_id);
+        return;
+    }
     
-    char topic[128];
     char timestamp[32];
     get_timestamp(timestamp, sizeof(timestamp));
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
-    cJSON_AddStringToObject(root, "order_id", perf.order_id);
-    cJSON_AddStringToObject(root, "weight_score", perf.weight_score);
-    cJSON_AddNumberToObject(root, "front_tire", perf.s_front_tire);
-    cJSON_AddNumberToObject(root, "rear_tire", perf.s_rear_tire);
-    cJSON_AddNumberToObject(root, "brake_pad", perf.s_brake_pad);
-    cJSON_AddNumberToObject(root, "engine_oil", perf.s_engine_oil);
-    cJSON_AddNumberToObject(root, "chain_or_cvt", perf.s_chain_or_cvt);
-    cJSON_AddNumberToObject(root, "engine", perf.s_engine);
-    cJSON_AddNumberToObject(root, "distance_travelled", perf.total_distance_km);
-    cJSON_AddNumberToObject(root, "average_speed", perf.average_speed);
-    cJSON_AddNumberToObject(root, "max_speed", perf.max_speed);
-    cJSON_AddStringToObject(root, "timestamp", timestamp);
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
     
-    char *payload = cJSON_PrintUnformatted(root);
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_string(&w, "order_id", report.order_id);
+    json_add_string(&w, "weight_score", report.weight_score);
+    json_add_number(&w, "front_tire", report.front_tire);
+    json_add_number(&w, "rear_tire", report.rear_tire);
+    json_add_number(&w, "brake_pad", report.brake_pad);
+    json_add_number(&w, "engine_oil", report.engine_oil);
+    json_add_number(&w, "chain_or_cvt", report.chain_or_cvt);
+    json_add_number(&w, "engine", report.engine);
+    json_add_number(&w, "distance_travelled", report.distance_travelled);
+    json_add_number(&w, "average_speed", report.average_speed);
+    json_add_number(&w, "max_speed", report.max_speed);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
     
-    snprintf(topic, sizeof(topic), "report.performance.%s", vehicle_id);
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
+    publish_json(topic_performance, &w, OUTBOX_CLASS_REPORT);
     
-    ESP_LOGI(TAG, "Published performance report for order: %s", perf.order_id);
+    xSemaphoreGive(payload_mutex);
     
-    cJSON_free(payload);
-    cJSON_Delete(root);
+    ESP_LOGI(TAG, "Published performance report for order: %s", report.order_id);
+}
+
+/**
+ * Publish performance report
+ */
+void mqtt_publish_performance(void) {
+    vehicle_performance_t perf = performance_get_data();
+    publish_performance(&perf);
 }
 
 /**
@@ -329,25 +1052,242 @@ void mqtt_publish_performance(void) {
 void mqtt_publish_registration(void) {
     if (!client) return;
     
-    char topic[128];
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    
+    json_writer_t w;
+    json_writer_init(&w, payload_buf, sizeof(payload_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
+    // Payload encodings this firmware can send, the backend picks one
+    // with control.set_encoding
+    json_begin_array(&w, "encodings");
+    json_add_string(&w, NULL, TELEMETRY_ENCODING_JSON);
+    json_add_string(&w, NULL, TELEMETRY_ENCODING_BINARY);
+    json_add_string(&w, NULL, TELEMETRY_ENCODING_TRACK);
+    json_end_array(&w);
+    json_add_bool(&w, "frames", !REALTIME_LEGACY_TOPICS);
+    json_end_object(&w);
     
-    char *payload = cJSON_PrintUnformatted(root);
+    publish_json(TOPIC_REGISTRATION, &w, OUTBOX_CLASS_REPORT);
     
-    snprintf(topic, sizeof(topic), "registration.new");
-    esp_mqtt_client_publish(client, topic, payload, 0, 1, 0);
+    xSemaphoreGive(payload_mutex);
     
     ESP_LOGI(TAG, "Published registration for vehicle: %s", vehicle_id);
+}
+
+/**
+ * Publish modem diagnostics
+ */
+void mqtt_publish_modem_diag(void) {
+    if (!client) return;
+    
+    char timestamp[32];
+    get_timestamp(timestamp, sizeof(timestamp));
+    
+    sim808_link_stats_t link;
+    sim808_diag_get_link_stats(&link);
+    
+    sim808_gprs_stats_t gprs;
+    sim808_gprs_get_stats(&gprs);
+    
+    rate_controller_t rates;
+    vehicle_tasks_get_rates(&rates);
+    
+    telemetry_ring_stats_t queue;
+    vehicle_tasks_get_publisher_stats(&queue);
+    
+    sim808_batch_stats_t batch;
+    sim808_mqtt_get_batch_stats(&batch);
+    outbox_policy_t outbox_copy;
+    portENTER_CRITICAL(&outbox_lock);
+    outbox_copy = outbox;
+    portEXIT_CRITICAL(&outbox_lock);
+    
+    xSemaphoreTake(payload_mutex, portMAX_DELAY);
+    
+    json_writer_t w;
+    json_writer_init(&w, diag_buf, sizeof(diag_buf));
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_number(&w, "bytes_in", link.bytes_in);
+    json_add_number(&w, "bytes_out", link.bytes_out);
+    json_add_number(&w, "commands", link.commands);
+    json_add_number(&w, "timeouts", link.timeouts);
+    json_add_number(&w, "errors", link.errors);
+    
+    json_begin_object(&w, "gprs");
+    json_add_number(&w, "connects", gprs.connects);
+    json_add_number(&w, "failures", gprs.failures);
+    json_add_number(&w, "last_connect_ms", gprs.last_connect_ms);
+    json_add_number(&w, "max_connect_ms", gprs.max_connect_ms);
+#if SIM808_USE_PPP
+    json_add_number(&w, "ppp_redials", sim808_ppp_get_redial_count());
+#endif
+    json_end_object(&w);
     
-    cJSON_free(payload);
-    cJSON_Delete(root);
+    // Sampling and publish rates the vehicle runs at
+    json_begin_object(&w, "rates");
+    json_add_string(&w, "tier", rate_controller_tier_name(rates.tier));
+    json_add_number(&w, "gps_ms", rates.intervals.gps_ms);
+    json_add_number(&w, "location_ms", rates.intervals.location_ms);
+    json_add_number(&w, "status_ms", rates.intervals.status_ms);
+    json_add_number(&w, "battery_ms", rates.intervals.battery_ms);
+    json_add_number(&w, "speed", rates.speed);
+    json_add_number(&w, "motion", rates.motion);
+    json_add_number(&w, "changes", rates.changes);
+    json_end_object(&w);
+    
+    // Publishes sharing CIPSENDs on the SIM808 TCP stack
+    json_begin_object(&w, "batch");
+    json_add_number(&w, "messages", batch.messages);
+    json_add_number(&w, "sends", batch.sends);
+    json_add_number(&w, "handshakes_saved", batch.handshakes_saved);
+    json_add_number(&w, "failed_messages", batch.failed_messages);
+    json_end_object(&w);
+    
+    // Tracking task to publisher task queue
+    json_begin_object(&w, "publish_queue");
+    json_add_number(&w, "depth", queue.depth);
+    json_add_number(&w, "high_water", queue.high_water);
+    json_add_number(&w, "pushed", queue.pushed);
+    json_add_number(&w, "dropped", queue.dropped);
+    json_end_object(&w);
+    
+    // esp-mqtt outbox occupancy and what each class got into it
+    json_begin_object(&w, "outbox");
+    json_add_number(&w, "bytes", outbox_size());
+    json_add_number(&w, "limit", outbox_copy.limit_bytes);
+    json_add_number(&w, "high_water", outbox_copy.high_water);
+    for (int cls = 0; cls < OUTBOX_CLASS_COUNT; cls++) {
+        json_begin_object(&w, outbox_class_name((outbox_class_t)cls));
+        json_add_number(&w, "qos", outbox_copy.classes[cls].qos);
+        json_add_number(&w, "sent", outbox_copy.stats[cls].sent);
+        json_add_number(&w, "deferred", outbox_copy.stats[cls].deferred);
+        json_add_number(&w, "dropped", outbox_copy.stats[cls].dropped);
+        json_end_object(&w);
+    }
+    json_end_object(&w);
+    
+    // Session resumption and topic alias savings
+    json_begin_object(&w, "session");
+    json_add_string(&w, "protocol", MQTT_TOPIC_ALIASES ? "5" : "3.1.1");
+    json_add_number(&w, "connections", connection_count);
+    json_add_number(&w, "sessions_resumed", sessions_resumed);
+    json_add_number(&w, "alias_bytes_saved", alias_bytes_saved);
+    json_end_object(&w);
+    
+    // Signal history, oldest first
+    sim808_csq_sample_t samples[SIM808_DIAG_CSQ_SAMPLES];
+    size_t sample_count = sim808_diag_get_csq_history(samples, SIM808_DIAG_CSQ_SAMPLES);
+    json_begin_array(&w, "csq");
+    for (size_t i = 0; i < sample_count; i++) {
+        json_begin_object(&w, NULL);
+        json_add_number(&w, "uptime_s", samples[i].uptime_s);
+        json_add_number(&w, "rssi", samples[i].rssi);
+        json_add_number(&w, "ber", samples[i].ber);
+        json_end_object(&w);
+    }
+    json_end_array(&w);
+    
+    // Upper bucket limits, the last bucket is open ended
+    json_begin_array(&w, "hist_limits_ms");
+    for (int i = 0; i < SIM808_DIAG_HIST_BUCKETS - 1; i++) {
+        json_add_number(&w, NULL, sim808_diag_bucket_limit_ms(i));
+    }
+    json_end_array(&w);
+    
+    // Commands that ran at least once
+    json_begin_array(&w, "at");
+    for (int id = 0; id < SIM808_CMD_COUNT; id++) {
+        sim808_cmd_stats_t stats;
+        if (sim808_diag_get_cmd_stats((sim808_cmd_id_t)id, &stats) != ESP_OK || stats.count == 0) {
+            continue;
+        }
+        
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "cmd", sim808_diag_cmd_name((sim808_cmd_id_t)id));
+        json_add_number(&w, "count", stats.count);
+        json_add_number(&w, "timeouts", stats.timeouts);
+        json_add_number(&w, "errors", stats.errors);
+        json_add_number(&w, "avg_ms", stats.total_ms / stats.count);
+        json_add_number(&w, "p50_ms", sim808_diag_percentile_ms(&stats, 50));
+        json_add_number(&w, "p95_ms", sim808_diag_percentile_ms(&stats, 95));
+        json_add_number(&w, "max_ms", stats.max_ms);
+        json_begin_array(&w, "hist");
+        for (int i = 0; i < SIM808_DIAG_HIST_BUCKETS; i++) {
+            json_add_number(&w, NULL, stats.hist[i]);
+        }
+        json_end_array(&w);
+        json_end_object(&w);
+    }
+    json_end_array(&w);
+    
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
+    
+    publish_json(topic_diag, &w, OUTBOX_CLASS_DIAG);
+    
+    xSemaphoreGive(payload_mutex);
+    
+    ESP_LOGD(TAG, "Published modem diagnostics (%lu commands)", (unsigned long)link.commands);
+}
+
+/**
+ * Send what handlers asked for, from the publisher task
+ */
+void mqtt_publish_pending(void) {
+    uint32_t what = atomic_exchange(&pending_publishes, 0);
+    
+    if (what & PENDING_REGISTRATION) {
+        mqtt_publish_registration();
+    }
+    if (what & PENDING_PERFORMANCE) {
+        vehicle_performance_t report;
+        portENTER_CRITICAL(&pending_lock);
+        report = pending_report;
+        portEXIT_CRITICAL(&pending_lock);
+        publish_performance(&report);
+    }
+}
+
+/**
+ * Handle a command received outside the esp-mqtt client
+ */
+void mqtt_vehicle_handle_message(const char* topic, const char* data, int data_len) {
+    handle_command(topic, data, data_len);
+}
+
+/**
+ * Get a consistent copy of the vehicle state
+ */
+void mqtt_get_vehicle_state(vehicle_state_t* state) {
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&state_seq);
+        *state = vehicle_state[seq & 1];
+    } while (seqlock_read_retry(&state_seq, seq));
+}
+
+/**
+ * Carry out a scheduled kill
+ */
+bool mqtt_vehicle_execute_kill(void) {
+    vehicle_state_t* state = state_write_begin();
+    bool scheduled = state->kill_scheduled;
+    if (scheduled) {
+        state->is_active = false;
+        state->is_locked = true;
+        state->is_killed = true;
+        state->kill_scheduled = false;
+    }
+    state_write_end();
+    return scheduled;
 }
 
 /**
- * Get vehicle state
+ * Get current time in ms since the Unix epoch
  */
-vehicle_state_t* mqtt_get_vehicle_state(void) {
-    return &vehicle_state;
+uint64_t mqtt_get_epoch_ms(void) {
+    return get_epoch_ms();
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "outbox_policy.h"
+#include <string.h>
+
+static const char* const class_names[OUTBOX_CLASS_COUNT] = {
+    [OUTBOX_CLASS_REPORT] = "report",
+    [OUTBOX_CLASS_STATUS] = "status",
+    [OUTBOX_CLASS_TRACK] = "track",
+    [OUTBOX_CLASS_READING] = "reading",
+    [OUTBOX_CLASS_DIAG] = "diag",
+};
+
+void outbox_policy_init(outbox_policy_t* p, uint32_t limit_bytes,
+                        const outbox_class_config_t classes[OUTBOX_CLASS_COUNT]) {
+    memset(p, 0, sizeof(*p));
+    p->limit_bytes = limit_bytes;
+    memcpy(p->classes, classes, sizeof(p->classes));
+}
+
+int outbox_policy_qos(const outbox_policy_t* p, outbox_class_t cls) {
+    return p->classes[cls].qos;
+}
+
+outbox_verdict_t outbox_policy_admit(outbox_policy_t* p, outbox_class_t cls, uint32_t outbox_bytes,
+                                     uint32_t len, bool can_defer) {
+    uint32_t share = (uint32_t)((uint64_t)p->limit_bytes * p->classes[cls].share_pct / 100);
+    p->bytes = outbox_bytes;
+
+    if (outbox_bytes + len <= share) {
+        p->stats[cls].sent++;
+        if (outbox_bytes + len > p->high_water) {
+            p->high_water = outbox_bytes + len;
+        }
+        return OUTBOX_SEND;
+    }
+
+    if (p->classes[cls].qos > 0 && can_defer) {
+        p->stats[cls].deferred++;
+        return OUTBOX_DEFER;
+    }
+    p->stats[cls].dropped++;
+    return OUTBOX_DROP;
+}
+
+void outbox_policy_refused(outbox_policy_t* p, outbox_class_t cls, outbox_verdict_t verdict) {
+    p->stats[cls].sent--;
+    if (verdict == OUTBOX_DEFER) {
+        p->stats[cls].deferred++;
+    } else {
+        p->stats[cls].dropped++;
+    }
+}
+
+const char* outbox_class_name(outbox_class_t cls) {
+    return (cls < OUTBOX_CLASS_COUNT) ? class_names[cls] : "unknown";
+}
@@ -0,0 +1,82 @@
+#include "rate_controller.h"
+#include <math.h>
+#include <string.h>
+
+// Per tier: GNSS, location, status, battery
+static const rate_intervals_t tier_intervals[RATE_TIER_COUNT] = {
+    [RATE_TIER_MOVING] = { 1000,   1000,   5000,   10000 },
+    [RATE_TIER_SLOW]   = { 5000,   5000,   5000,   10000 },
+    [RATE_TIER_IDLE]   = { 30000,  30000,  30000,  60000 },
+    [RATE_TIER_LOCKED] = { 300000, 300000, 300000, 300000 },
+};
+
+static const char* const tier_names[RATE_TIER_COUNT] = {
+    [RATE_TIER_MOVING] = "moving",
+    [RATE_TIER_SLOW] = "slow",
+    [RATE_TIER_IDLE] = "idle",
+    [RATE_TIER_LOCKED] = "locked",
+};
+
+/**
+ * Tier the inputs ask for right now
+ */
+static rate_tier_t target_tier(const rate_controller_t* rc, bool is_active) {
+    if (rc->speed >= RATE_MOVING_SPEED) {
+        return RATE_TIER_MOVING;
+    }
+    if (rc->speed >= RATE_SLOW_SPEED || rc->motion >= RATE_MOTION_THRESHOLD) {
+        return RATE_TIER_SLOW;
+    }
+    return is_active ? RATE_TIER_IDLE : RATE_TIER_LOCKED;
+}
+
+static void set_tier(rate_controller_t* rc, rate_tier_t tier, uint32_t now_ms) {
+    rc->tier = tier;
+    rc->intervals = tier_intervals[tier];
+    rc->tier_since_ms = now_ms;
+    rc->slower_since_ms = 0;
+}
+
+void rate_controller_init(rate_controller_t* rc, uint32_t now_ms) {
+    memset(rc, 0, sizeof(*rc));
+    set_tier(rc, RATE_TIER_SLOW, now_ms);
+}
+
+void rate_controller_add_motion(rate_controller_t* rc, float accel_x, float accel_y, float accel_z) {
+    // Gravity alone reads 1 g in any orientation
+    float deviation = fabsf(sqrtf(accel_x * accel_x + accel_y * accel_y + accel_z * accel_z) - 1.0f);
+    rc->motion += (deviation - rc->motion) * RATE_MOTION_SMOOTHING;
+}
+
+bool rate_controller_update(rate_controller_t* rc, uint32_t now_ms, float speed, bool is_active) {
+    rc->speed = speed;
+    rate_tier_t target = target_tier(rc, is_active);
+
+    if (target == rc->tier) {
+        rc->slower_since_ms = 0;
+        return false;
+    }
+
+    if (target < rc->tier) {
+        set_tier(rc, target, now_ms);
+        rc->changes++;
+        return true;
+    }
+
+    // Slower only once it stayed calm long enough; 0 marks no calm period
+    if (rc->slower_since_ms == 0) {
+        rc->slower_since_ms = now_ms ? now_ms : 1;
+        return false;
+    }
+    if ((uint32_t)(now_ms - rc->slower_since_ms) < RATE_STEP_DOWN_MS) {
+        return false;
+    }
+
+    set_tier(rc, target, now_ms);
+    rc->changes++;
+    return true;
+}
+
+const char* rate_controller_tier_name(rate_tier_t tier) {
+    return (tier < RATE_TIER_COUNT) ? tier_names[tier] : "unknown";
+}
@@ -0,0 +1,100 @@
+#include "report_filter.h"
+#include <math.h>
+#include <string.h>
+
+#define EARTH_RADIUS_M      6371000.0f
+#define DEG_TO_RAD          0.017453292519943f
+
+/**
+ * Distance in meters, equirectangular, plenty for dead-bands of a few
+ * hundred meters
+ */
+static float approx_distance(float lat1, float lon1, float lat2, float lon2) {
+    float x = (lon2 - lon1) * DEG_TO_RAD * cosf((lat1 + lat2) * 0.5f * DEG_TO_RAD);
+    float y = (lat2 - lat1) * DEG_TO_RAD;
+    return sqrtf(x * x + y * y) * EARTH_RADIUS_M;
+}
+
+/**
+ * Smallest angle between two courses, 0..180
+ */
+static float heading_change(float from, float to) {
+    float d = fmodf(fabsf(to - from), 360.0f);
+    return (d > 180.0f) ? 360.0f - d : d;
+}
+
+/**
+ * Common part of every decision, changed tells if the sample left the
+ * dead-band
+ */
+static bool filter_decide(report_filter_t* f, uint32_t now_ms, bool changed) {
+    bool heartbeat = f->heartbeat_ms && (uint32_t)(now_ms - f->last_ms) >= f->heartbeat_ms;
+
+    if (f->primed && !changed && !heartbeat) {
+        f->suppressed++;
+        return false;
+    }
+
+    if (f->primed && !changed) {
+        f->heartbeats++;
+    }
+    f->primed = true;
+    f->last_ms = now_ms;
+    f->reports++;
+    return true;
+}
+
+void report_location_filter_init(report_location_filter_t* f, float distance_m, float heading_deg,
+                                 float heading_min_speed, uint32_t heartbeat_ms) {
+    memset(f, 0, sizeof(*f));
+    f->base.heartbeat_ms = heartbeat_ms;
+    f->distance_m = distance_m;
+    f->heading_deg = heading_deg;
+    f->heading_min_speed = heading_min_speed;
+}
+
+void report_status_filter_init(report_status_filter_t* f, uint32_t heartbeat_ms) {
+    memset(f, 0, sizeof(*f));
+    f->base.heartbeat_ms = heartbeat_ms;
+}
+
+void report_battery_filter_init(report_battery_filter_t* f, float voltage_v, uint32_t heartbeat_ms) {
+    memset(f, 0, sizeof(*f));
+    f->base.heartbeat_ms = heartbeat_ms;
+    f->voltage_v = voltage_v;
+}
+
+bool report_location_due(report_location_filter_t* f, uint32_t now_ms, float latitude,
+                         float longitude, float speed, float course) {
+    bool changed = approx_distance(f->latitude, f->longitude, latitude, longitude) > f->distance_m;
+    if (!changed && speed >= f->heading_min_speed) {
+        changed = heading_change(f->course, course) > f->heading_deg;
+    }
+
+    if (!filter_decide(&f->base, now_ms, changed)) {
+        return false;
+    }
+    f->latitude = latitude;
+    f->longitude = longitude;
+    f->course = course;
+    return true;
+}
+
+bool report_status_due(report_status_filter_t* f, uint32_t now_ms, bool is_active,
+                       bool is_locked, bool is_killed) {
+    uint8_t flags = (is_active ? 0x01 : 0) | (is_locked ? 0x02 : 0) | (is_killed ? 0x04 : 0);
+
+    if (!filter_decide(&f->base, now_ms, flags != f->flags)) {
+        return false;
+    }
+    f->flags = flags;
+    return true;
+}
+
+bool report_battery_due(report_battery_filter_t* f, uint32_t now_ms, float voltage) {
+    if (!filter_decide(&f->base, now_ms, fabsf(voltage - f->voltage) > f->voltage_v)) {
+        return false;
+    }
+    f->voltage = voltage;
+    return true;
+}
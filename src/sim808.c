@@ -1,6 +1,10 @@
 #include "sim808.h"
+#include "sim808_at.h"
+#include "sim808_cmux.h"
+#include "sim808_diag.h"
 #include "esp_log.h"
 #include "esp_mac.h"
+#include "nvs.h"
 #include <string.h>
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
@@ -8,15 +12,248 @@
 
 static const char *TAG = "SIM808";
 static bool gps_powered = false;
-static bool gprs_connected = false;
-static bool mqtt_connected = false;
+
+// GNSS streaming state, latest fix is shared with the AT RX task
+static bool gps_streaming = false;
+static sim808_nmea_parser_t nmea_parser;
+static sim808_gps_data_t latest_fix = {0};
+static TickType_t latest_fix_time = 0;
+static portMUX_TYPE fix_lock = portMUX_INITIALIZER_UNLOCKED;
+static sim808_gps_fix_cb_t fix_callback = NULL;
+static void* fix_callback_arg = NULL;
+
+// Baud rates tried when negotiating, fastest first
+static const uint32_t baud_ladder[] = { 460800, 115200, 57600, SIM808_BAUD_RATE };
+#define BAUD_LADDER_LEN (sizeof(baud_ladder) / sizeof(baud_ladder[0]))
+static uint32_t current_baud = SIM808_BAUD_RATE;
+
+/**
+ * Load the negotiated baud rate from NVS
+ */
+static uint32_t load_saved_baud(void) {
+    nvs_handle_t nvs;
+    uint32_t baud = SIM808_BAUD_RATE;
+    
+    if (nvs_open(SIM808_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_u32(nvs, "baud", &baud) != ESP_OK) {
+            baud = SIM808_BAUD_RATE;
+        }
+        nvs_close(nvs);
+    }
+    return baud;
+}
+
+/**
+ * Store the negotiated baud rate in NVS
+ */
+static void save_baud(uint32_t baud) {
+    nvs_handle_t nvs;
+    
+    if (nvs_open(SIM808_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS unavailable, baud rate not saved");
+        return;
+    }
+    nvs_set_u32(nvs, "baud", baud);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+/**
+ * Switch the local UART to a new rate (AT lock held, nothing in flight)
+ */
+static void set_local_baud(uint32_t baud) {
+    uart_wait_tx_done(SIM808_UART_NUM, pdMS_TO_TICKS(100));
+    uart_set_baudrate(SIM808_UART_NUM, baud);
+    uart_flush_input(SIM808_UART_NUM);
+    current_baud = baud;
+}
+
+/**
+ * Probe the link with plain "AT" commands
+ * @return number of probes answered with OK
+ */
+static int probe_link(int attempts) {
+    char response[32];
+    int ok = 0;
+    
+    for (int i = 0; i < attempts; i++) {
+        if (sim808_at_exec("AT\r\n", NULL, response, sizeof(response), 300, NULL) == ESP_OK) {
+            ok++;
+        }
+    }
+    return ok;
+}
+
+/**
+ * Find the rate the modem is currently talking at
+ * The saved rate is tried first, then the ladder; the SIM808 also locks
+ * onto the first "AT" it sees while in autobaud mode (IPR=0).
+ */
+static esp_err_t detect_baud(void) {
+    esp_err_t ret = ESP_FAIL;
+    
+    sim808_at_lock();
+    if (probe_link(2) > 0) {
+        ret = ESP_OK;
+    }
+    for (int i = 0; ret != ESP_OK && i < BAUD_LADDER_LEN; i++) {
+        set_local_baud(baud_ladder[i]);
+        if (probe_link(3) > 0) {
+            ESP_LOGI(TAG, "Modem detected at %lu baud", (unsigned long)baud_ladder[i]);
+            ret = ESP_OK;
+        }
+    }
+    if (ret != ESP_OK) {
+        set_local_baud(SIM808_BAUD_RATE);
+    }
+    sim808_at_unlock();
+    
+    return ret;
+}
+
+/**
+ * Move both sides of the link to a new rate and verify it
+ * The caller holds the AT lock, so no other command goes out between the
+ * AT+IPR and the local switch or during the verification.
+ */
+static esp_err_t switch_baud(uint32_t baud) {
+    char cmd[32];
+    char response[32];
+    uint32_t previous = current_baud;
+    
+    snprintf(cmd, sizeof(cmd), "AT+IPR=%lu\r\n", (unsigned long)baud);
+    if (sim808_send_command(cmd, response, sizeof(response), 1000) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    // The OK comes at the old rate, the modem switches right after it
+    set_local_baud(baud);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    
+    if (probe_link(SIM808_BAUD_VERIFY_PROBES) == SIM808_BAUD_VERIFY_PROBES) {
+        return ESP_OK;
+    }
+    
+    ESP_LOGW(TAG, "Link unstable at %lu baud", (unsigned long)baud);
+    set_local_baud(previous);
+    if (probe_link(2) == 0) {
+        detect_baud();
+    }
+    return ESP_FAIL;
+}
+
+/**
+ * Persist the current rate on the modem (AT&W keeps IPR) and locally
+ */
+static void keep_baud(void) {
+    char response[32];
+    sim808_send_command("AT&W\r\n", response, sizeof(response), 1000);
+    save_baud(current_baud);
+}
+
+/**
+ * Negotiate the fastest stable baud rate
+ */
+esp_err_t sim808_negotiate_baud(void) {
+    esp_err_t ret = ESP_FAIL;
+    
+    sim808_at_lock();
+    for (int i = 0; i < BAUD_LADDER_LEN; i++) {
+        uint32_t baud = baud_ladder[i];
+        
+        if (baud != current_baud && switch_baud(baud) != ESP_OK) {
+            continue;
+        }
+        
+        keep_baud();
+        ESP_LOGI(TAG, "Link running at %lu baud", (unsigned long)current_baud);
+        ret = ESP_OK;
+        break;
+    }
+    sim808_at_unlock();
+    
+    return ret;
+}
+
+/**
+ * Get the current link baud rate
+ */
+uint32_t sim808_get_baud_rate(void) {
+    return current_baud;
+}
+
+/**
+ * Judge the current rate by probing it and step down if it is lossy
+ */
+static void baud_step_down(void) {
+    // A modem that answers nearly every probe at this rate was just busy;
+    // some probes lost is a rate the link can't carry (framing errors)
+    int ok = probe_link(SIM808_BAUD_FALLBACK_PROBES);
+    int failed = SIM808_BAUD_FALLBACK_PROBES - ok;
+    if (failed * 100 < SIM808_AT_LINK_ERROR_PCT * SIM808_BAUD_FALLBACK_PROBES) {
+        return;
+    }
+    
+    // The multiplexer can't survive a rate change
+    if (sim808_cmux_is_active()) {
+        ESP_LOGE(TAG, "AT link errors on the multiplexer");
+        return;
+    }
+    
+    ESP_LOGW(TAG, "AT link errors at %lu baud (%d of %d probes lost), falling back",
+             (unsigned long)current_baud, failed, SIM808_BAUD_FALLBACK_PROBES);
+    if (ok == 0 && detect_baud() != ESP_OK) {
+        ESP_LOGE(TAG, "Modem not responding at any rate");
+        return;
+    }
+    
+    for (int i = 0; i < BAUD_LADDER_LEN; i++) {
+        if (baud_ladder[i] >= current_baud) {
+            continue;
+        }
+        if (switch_baud(baud_ladder[i]) == ESP_OK) {
+            keep_baud();
+            ESP_LOGW(TAG, "Link fell back to %lu baud", (unsigned long)current_baud);
+            return;
+        }
+    }
+}
+
+/**
+ * Step down one rate after repeated or frequent AT timeouts
+ * Called by the AT engine, with its lock held, from the task that hit the
+ * timeouts.
+ */
+static void baud_fallback(void) {
+    sim808_at_lock();
+    
+    // One +++ escape for all the probes, not one per probe
+    bool escaped = sim808_at_in_data_mode() && sim808_at_escape_data_mode() == ESP_OK;
+    baud_step_down();
+    if (escaped) {
+        sim808_at_resume_data_mode();
+    }
+    
+    sim808_at_unlock();
+}
+
+/**
+ * URC: the modem (re)started, e.g. after a brownout
+ */
+static void modem_ready_urc(const char* line, void* arg) {
+    ESP_LOGW(TAG, "Modem restarted");
+    sim808_gprs_reset_state();
+}
 
 /**
  * Initialize UART for SIM808 communication
  */
 esp_err_t sim808_init(void) {
+    // Warm boot: start at the rate negotiated last time
+    current_baud = load_saved_baud();
+    
     uart_config_t uart_config = {
-        .baud_rate = SIM808_BAUD_RATE,
+        .baud_rate = current_baud,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -42,6 +279,12 @@ esp_err_t sim808_init(void) {
         return ret;
     }
     
+    ret = sim808_at_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start AT engine");
+        return ret;
+    }
+    
     // Configure control pins
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << SIM808_POWER_PIN) | (1ULL << SIM808_RST_PIN),
@@ -55,7 +298,12 @@ esp_err_t sim808_init(void) {
     gpio_set_level(SIM808_POWER_PIN, 0);
     gpio_set_level(SIM808_RST_PIN, 1);
     
-    ESP_LOGI(TAG, "SIM808 UART initialized");
+    sim808_at_set_link_error_handler(baud_fallback);
+    
+    // Sent at boot once the rate is fixed (AT+IPR, see sim808_negotiate_baud)
+    sim808_at_register_urc("RDY", modem_ready_urc, NULL);
+    
+    ESP_LOGI(TAG, "SIM808 UART initialized at %lu baud", (unsigned long)current_baud);
     return ESP_OK;
 }
 
@@ -73,9 +321,12 @@ esp_err_t sim808_power_on(void) {
     // Wait for module to boot
     vTaskDelay(pdMS_TO_TICKS(3000));
     
-    // Test communication
+    // Whatever the modem had configured is gone
+    sim808_gprs_reset_state();
+    
+    // Test communication, finding the modem's rate if it isn't the saved one
     char response[128];
-    if (sim808_send_command("AT\r\n", response, sizeof(response), 2000) != ESP_OK) {
+    if (detect_baud() != ESP_OK) {
         ESP_LOGE(TAG, "No response from SIM808");
         return ESP_FAIL;
     }
@@ -86,6 +337,10 @@ esp_err_t sim808_power_on(void) {
     // Set SMS text mode
     sim808_send_command("AT+CMGF=1\r\n", response, sizeof(response), 1000);
     
+#if SIM808_BAUD_NEGOTIATION
+    sim808_negotiate_baud();
+#endif
+    
     ESP_LOGI(TAG, "SIM808 powered on successfully");
     return ESP_OK;
 }
@@ -96,6 +351,7 @@ esp_err_t sim808_power_on(void) {
 esp_err_t sim808_power_off(void) {
     char response[128];
     sim808_send_command("AT+CPOWD=1\r\n", response, sizeof(response), 5000);
+    sim808_gprs_reset_state();
     
     ESP_LOGI(TAG, "SIM808 powered off");
     return ESP_OK;
@@ -105,45 +361,15 @@ esp_err_t sim808_power_off(void) {
  * Send AT command and wait for response
  */
 esp_err_t sim808_send_command(const char* cmd, char* response, size_t response_size, uint32_t timeout_ms) {
-    // Clear UART buffer
-    uart_flush(SIM808_UART_NUM);
-    
-    // Send command
-    uart_write_bytes(SIM808_UART_NUM, cmd, strlen(cmd));
-    ESP_LOGD(TAG, "Sent: %s", cmd);
-    
-    // Wait for response
-    int len = uart_read_bytes(SIM808_UART_NUM, (uint8_t*)response, response_size - 1, 
-                              timeout_ms / portTICK_PERIOD_MS);
-    
-    if (len > 0) {
-        response[len] = '\0';
-        ESP_LOGD(TAG, "Received: %s", response);
-        return ESP_OK;
-    }
-    
-    response[0] = '\0';
-    return ESP_ERR_TIMEOUT;
+    return sim808_at_exec(cmd, NULL, response, response_size, timeout_ms, NULL);
 }
 
 /**
  * Wait for specific response
  */
 bool sim808_wait_for_response(const char* expected, uint32_t timeout_ms) {
-    char buffer[256];
-    TickType_t start_time = xTaskGetTickCount();
-    
-    while ((xTaskGetTickCount() - start_time) < pdMS_TO_TICKS(timeout_ms)) {
-        int len = uart_read_bytes(SIM808_UART_NUM, (uint8_t*)buffer, sizeof(buffer) - 1, 
-                                  100 / portTICK_PERIOD_MS);
-        if (len > 0) {
-            buffer[len] = '\0';
-            if (strstr(buffer, expected) != NULL) {
-                return true;
-            }
-        }
-    }
-    return false;
+    const char* finals[] = { expected, NULL };
+    return sim808_at_exec(NULL, finals, NULL, 0, timeout_ms, NULL) == ESP_OK;
 }
 
 /**
@@ -168,6 +394,12 @@ esp_err_t sim808_gps_power_on(void) {
     gps_powered = true;
     ESP_LOGI(TAG, "GPS powered on, waiting for fix...");
     
+#if SIM808_GNSS_STREAMING
+    if (sim808_gps_stream_start(NULL, NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "NMEA streaming unavailable, falling back to CGNSINF polling");
+    }
+#endif
+    
     return ESP_OK;
 }
 
@@ -176,60 +408,13 @@ esp_err_t sim808_gps_power_on(void) {
  */
 esp_err_t sim808_gps_power_off(void) {
     char response[128];
+    sim808_gps_stream_stop();
     sim808_send_command("AT+CGNSPWR=0\r\n", response, sizeof(response), 2000);
     gps_powered = false;
     ESP_LOGI(TAG, "GPS powered off");
     return ESP_OK;
 }
 
-/**
- * Parse GNSS data from AT+CGNSINF response
- * Format: +CGNSINF: <GNSS run status>,<Fix status>,<UTC date & Time>,<Latitude>,<Longitude>,
- *         <MSL Altitude>,<Speed Over Ground>,<Course Over Ground>,<Fix Mode>,<Reserved1>,
- *         <HDOP>,<PDOP>,<VDOP>,<Reserved2>,<GNSS Satellites in View>,<HPA>,<VPA>
- */
-static bool parse_gnss_data(const char* response, sim808_gps_data_t* data) {
-    char* line = strstr(response, "+CGNSINF:");
-    if (line == NULL) {
-        return false;
-    }
-    
-    line += strlen("+CGNSINF:");
-    
-    int run_status, fix_status;
-    char datetime[24];
-    float lat, lon, alt, speed, course;
-    int fix_mode, sat_view;
-    float hdop, pdop, vdop;
-    
-    int parsed = sscanf(line, "%d,%d,%[^,],%f,%f,%f,%f,%f,%d,%*f,%f,%f,%f,%*d,%d",
-                       &run_status, &fix_status, datetime, &lat, &lon, &alt, 
-                       &speed, &course, &fix_mode, &hdop, &pdop, &vdop, &sat_view);
-    
-    if (parsed < 13) {
-        return false;
-    }
-    
-    data->valid = (fix_status == 1);
-    data->latitude = lat;
-    data->longitude = lon;
-    data->altitude = alt;
-    data->speed = speed;
-    data->satellites = sat_view;
-    
-    // Parse datetime (format: yyyyMMddHHmmss.sss)
-    if (strlen(datetime) >= 14) {
-        snprintf(data->timestamp, sizeof(data->timestamp), 
-                "%.4s-%.2s-%.2sT%.2s:%.2s:%.2sZ",
-                datetime, datetime+4, datetime+6, 
-                datetime+8, datetime+10, datetime+12);
-        snprintf(data->date, sizeof(data->date), 
-                "%.4s-%.2s-%.2s", datetime, datetime+4, datetime+6);
-    }
-    
-    return data->valid;
-}
-
 /**
  * Get GPS data
  */
@@ -239,13 +424,26 @@ esp_err_t sim808_gps_get_data(sim808_gps_data_t* data) {
         return ESP_ERR_INVALID_STATE;
     }
     
+    // Streaming keeps the latest fix up to date without an AT round-trip
+    if (gps_streaming) {
+        portENTER_CRITICAL(&fix_lock);
+        *data = latest_fix;
+        TickType_t age = xTaskGetTickCount() - latest_fix_time;
+        portEXIT_CRITICAL(&fix_lock);
+        
+        if (age > pdMS_TO_TICKS(SIM808_GNSS_STALE_MS)) {
+            data->valid = false;
+        }
+        return data->valid ? ESP_OK : ESP_FAIL;
+    }
+    
     char response[512];
     if (sim808_send_command("AT+CGNSINF\r\n", response, sizeof(response), 2000) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get GPS data");
         return ESP_FAIL;
     }
     
-    if (parse_gnss_data(response, data)) {
+    if (sim808_gnss_parse_cgnsinf(response, data)) {
         ESP_LOGD(TAG, "GPS: %.6f, %.6f, alt=%.2f, speed=%.2f, sats=%d", 
                 data->latitude, data->longitude, data->altitude, data->speed, data->satellites);
         return ESP_OK;
@@ -256,332 +454,99 @@ esp_err_t sim808_gps_get_data(sim808_gps_data_t* data) {
 }
 
 /**
- * Check if GPS has fix
+ * Feed streamed NMEA lines to the parser (runs in the AT RX task)
  */
-bool sim808_gps_has_fix(void) {
-    sim808_gps_data_t data;
-    return (sim808_gps_get_data(&data) == ESP_OK && data.valid);
-}
-
-/**
- * Connect to GPRS network
- */
-esp_err_t sim808_gprs_connect(sim808_gprs_config_t* config) {
-    char response[256];
-    char cmd[128];
-    
-    ESP_LOGI(TAG, "Connecting to GPRS network...");
-    
-    // Check network registration
-    sim808_send_command("AT+CREG?\r\n", response, sizeof(response), 2000);
-    
-    // Set bearer profile
-    sim808_send_command("AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"\r\n", response, sizeof(response), 2000);
+static void nmea_urc_handler(const char* line, void* arg) {
+    bool epoch_done = false;
     
-    snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"APN\",\"%s\"\r\n", config->apn);
-    sim808_send_command(cmd, response, sizeof(response), 2000);
-    
-    if (strlen(config->username) > 0) {
-        snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"USER\",\"%s\"\r\n", config->username);
-        sim808_send_command(cmd, response, sizeof(response), 2000);
+    for (const char* c = line; *c != '\0'; c++) {
+        epoch_done |= sim808_nmea_feed(&nmea_parser, *c);
     }
+    sim808_nmea_feed(&nmea_parser, '\r');
     
-    if (strlen(config->password) > 0) {
-        snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"PWD\",\"%s\"\r\n", config->password);
-        sim808_send_command(cmd, response, sizeof(response), 2000);
+    if (!epoch_done) {
+        return;
     }
     
-    // Open bearer
-    sim808_send_command("AT+SAPBR=1,1\r\n", response, sizeof(response), 10000);
+    portENTER_CRITICAL(&fix_lock);
+    latest_fix = nmea_parser.fix;
+    latest_fix_time = xTaskGetTickCount();
+    portEXIT_CRITICAL(&fix_lock);
     
-    // Check bearer status
-    if (sim808_send_command("AT+SAPBR=2,1\r\n", response, sizeof(response), 2000) == ESP_OK) {
-        if (strstr(response, "1,1") != NULL) {
-            gprs_connected = true;
-            ESP_LOGI(TAG, "GPRS connected successfully");
-            return ESP_OK;
-        }
+    if (fix_callback != NULL) {
+        fix_callback(&nmea_parser.fix, fix_callback_arg);
     }
-    
-    ESP_LOGE(TAG, "Failed to connect to GPRS");
-    return ESP_FAIL;
-}
-
-/**
- * Disconnect from GPRS network
- */
-esp_err_t sim808_gprs_disconnect(void) {
-    char response[128];
-    sim808_send_command("AT+SAPBR=0,1\r\n", response, sizeof(response), 5000);
-    gprs_connected = false;
-    ESP_LOGI(TAG, "GPRS disconnected");
-    return ESP_OK;
-}
-
-/**
- * Check if GPRS is connected
- */
-bool sim808_gprs_is_connected(void) {
-    return gprs_connected;
 }
 
 /**
- * Connect to MQTT broker (RabbitMQ)
+ * Start NMEA streaming
  */
-esp_err_t sim808_mqtt_connect(sim808_mqtt_config_t* config) {
-    char response[256];
-    char cmd[256];
+esp_err_t sim808_gps_stream_start(sim808_gps_fix_cb_t callback, void* arg) {
+    char response[64];
     
-    if (!gprs_connected) {
-        ESP_LOGE(TAG, "GPRS is not connected");
+    if (!gps_powered) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    ESP_LOGI(TAG, "Connecting to MQTT broker (RabbitMQ)...");
-    
-    // Initialize TCP/IP application
-    sim808_send_command("AT+CIPSHUT\r\n", response, sizeof(response), 2000);
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // Set single connection mode
-    sim808_send_command("AT+CIPMUX=0\r\n", response, sizeof(response), 2000);
-    
-    // Start TCP connection to MQTT broker
-    snprintf(cmd, sizeof(cmd), "AT+CIPSTART=\"TCP\",\"%s\",%d\r\n", 
-             config->broker, config->port);
-    
-    if (sim808_send_command(cmd, response, sizeof(response), 10000) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to connect to broker");
-        return ESP_FAIL;
-    }
+    fix_callback = callback;
+    fix_callback_arg = arg;
     
-    if (!sim808_wait_for_response("CONNECT OK", 10000)) {
-        ESP_LOGE(TAG, "TCP connection failed");
-        return ESP_FAIL;
+    if (gps_streaming) {
+        return ESP_OK;
     }
     
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // Build MQTT CONNECT packet
-    uint8_t connect_packet[256];
-    int packet_len = 0;
-    
-    // Fixed header
-    connect_packet[packet_len++] = 0x10;  // CONNECT message type
-    int remaining_length_pos = packet_len;
-    connect_packet[packet_len++] = 0;     // Placeholder for remaining length
-    
-    // Variable header - Protocol Name
-    connect_packet[packet_len++] = 0x00;
-    connect_packet[packet_len++] = 0x04;
-    connect_packet[packet_len++] = 'M';
-    connect_packet[packet_len++] = 'Q';
-    connect_packet[packet_len++] = 'T';
-    connect_packet[packet_len++] = 'T';
-    
-    // Protocol Level (4 for MQTT 3.1.1)
-    connect_packet[packet_len++] = 0x04;
-    
-    // Connect Flags (username and password)
-    connect_packet[packet_len++] = 0xC2;  // Clean session + username + password
-    
-    // Keep Alive (60 seconds)
-    connect_packet[packet_len++] = 0x00;
-    connect_packet[packet_len++] = 0x3C;
-    
-    // Payload - Client ID
-    int client_id_len = strlen(config->client_id);
-    connect_packet[packet_len++] = (client_id_len >> 8) & 0xFF;
-    connect_packet[packet_len++] = client_id_len & 0xFF;
-    memcpy(&connect_packet[packet_len], config->client_id, client_id_len);
-    packet_len += client_id_len;
-    
-    // Payload - Username
-    int username_len = strlen(config->username);
-    connect_packet[packet_len++] = (username_len >> 8) & 0xFF;
-    connect_packet[packet_len++] = username_len & 0xFF;
-    memcpy(&connect_packet[packet_len], config->username, username_len);
-    packet_len += username_len;
-    
-    // Payload - Password
-    int password_len = strlen(config->password);
-    connect_packet[packet_len++] = (password_len >> 8) & 0xFF;
-    connect_packet[packet_len++] = password_len & 0xFF;
-    memcpy(&connect_packet[packet_len], config->password, password_len);
-    packet_len += password_len;
-    
-    // Update remaining length
-    connect_packet[remaining_length_pos] = packet_len - 2;
-    
-    // Send MQTT CONNECT packet
-    snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d\r\n", packet_len);
-    sim808_send_command(cmd, response, sizeof(response), 2000);
-    
-    if (!sim808_wait_for_response(">", 5000)) {
-        ESP_LOGE(TAG, "Failed to enter send mode");
+    sim808_nmea_init(&nmea_parser);
+    if (sim808_at_register_urc("$G", nmea_urc_handler, NULL) != ESP_OK) {
         return ESP_FAIL;
     }
     
-    uart_write_bytes(SIM808_UART_NUM, (const char*)connect_packet, packet_len);
-    
-    if (sim808_wait_for_response("SEND OK", 5000)) {
-        // Wait for CONNACK
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        mqtt_connected = true;
-        ESP_LOGI(TAG, "MQTT connected to RabbitMQ");
-        return ESP_OK;
-    }
+    // RMC closes each epoch so one fix is published per output cycle
+    sim808_send_command("AT+CGNSSEQ=\"RMC\"\r\n", response, sizeof(response), 1000);
     
-    ESP_LOGE(TAG, "MQTT connection failed");
-    return ESP_FAIL;
-}
-
-/**
- * Disconnect from MQTT broker
- */
-esp_err_t sim808_mqtt_disconnect(void) {
-    char response[128];
-    
-    // Send MQTT DISCONNECT packet
-    uint8_t disconnect_packet[] = {0xE0, 0x00};
-    char cmd[64];
-    snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d\r\n", sizeof(disconnect_packet));
-    sim808_send_command(cmd, response, sizeof(response), 2000);
-    
-    if (sim808_wait_for_response(">", 5000)) {
-        uart_write_bytes(SIM808_UART_NUM, (const char*)disconnect_packet, sizeof(disconnect_packet));
+    if (sim808_send_command("AT+CGNSTST=1\r\n", response, sizeof(response), 2000) != ESP_OK) {
+        sim808_at_unregister_urc("$G");
+        ESP_LOGE(TAG, "Failed to enable NMEA streaming");
+        return ESP_FAIL;
     }
     
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // Close TCP connection
-    sim808_send_command("AT+CIPCLOSE\r\n", response, sizeof(response), 5000);
-    
-    mqtt_connected = false;
-    ESP_LOGI(TAG, "MQTT disconnected");
+    gps_streaming = true;
+    ESP_LOGI(TAG, "NMEA streaming enabled");
     return ESP_OK;
 }
 
 /**
- * Publish message to MQTT topic
+ * Stop NMEA streaming
  */
-esp_err_t sim808_mqtt_publish(const char* topic, const char* payload) {
-    if (!mqtt_connected) {
-        ESP_LOGW(TAG, "MQTT is not connected");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    char response[128];
-    char cmd[64];
+esp_err_t sim808_gps_stream_stop(void) {
+    char response[64];
     
-    int topic_len = strlen(topic);
-    int payload_len = strlen(payload);
-    
-    // Build MQTT PUBLISH packet
-    uint8_t publish_packet[1024];
-    int packet_len = 0;
-    
-    // Fixed header
-    publish_packet[packet_len++] = 0x30;  // PUBLISH, QoS 0
-    
-    // Remaining length (topic length + payload length + 2 bytes for topic length field)
-    int remaining_length = 2 + topic_len + payload_len;
-    publish_packet[packet_len++] = remaining_length & 0xFF;
-    if (remaining_length > 127) {
-        publish_packet[packet_len - 1] |= 0x80;
-        publish_packet[packet_len++] = (remaining_length >> 7) & 0xFF;
-    }
-    
-    // Topic name
-    publish_packet[packet_len++] = (topic_len >> 8) & 0xFF;
-    publish_packet[packet_len++] = topic_len & 0xFF;
-    memcpy(&publish_packet[packet_len], topic, topic_len);
-    packet_len += topic_len;
-    
-    // Payload
-    memcpy(&publish_packet[packet_len], payload, payload_len);
-    packet_len += payload_len;
-    
-    // Send packet
-    snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d\r\n", packet_len);
-    sim808_send_command(cmd, response, sizeof(response), 2000);
-    
-    if (!sim808_wait_for_response(">", 5000)) {
-        ESP_LOGE(TAG, "Failed to enter send mode");
-        return ESP_FAIL;
-    }
-    
-    uart_write_bytes(SIM808_UART_NUM, (const char*)publish_packet, packet_len);
-    
-    if (sim808_wait_for_response("SEND OK", 5000)) {
-        ESP_LOGD(TAG, "Published to %s: %s", topic, payload);
+    if (!gps_streaming) {
         return ESP_OK;
     }
     
-    ESP_LOGE(TAG, "Publish failed");
-    return ESP_FAIL;
+    sim808_send_command("AT+CGNSTST=0\r\n", response, sizeof(response), 2000);
+    sim808_at_unregister_urc("$G");
+    gps_streaming = false;
+    fix_callback = NULL;
+    
+    ESP_LOGI(TAG, "NMEA streaming disabled (%lu sentences, %lu checksum errors)",
+             (unsigned long)nmea_parser.sentences, (unsigned long)nmea_parser.checksum_errors);
+    return ESP_OK;
 }
 
 /**
- * Subscribe to MQTT topic
+ * Check if NMEA streaming is active
  */
-esp_err_t sim808_mqtt_subscribe(const char* topic) {
-    if (!mqtt_connected) {
-        ESP_LOGW(TAG, "MQTT is not connected");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    char response[128];
-    char cmd[64];
-    
-    int topic_len = strlen(topic);
-    
-    // Build MQTT SUBSCRIBE packet
-    uint8_t subscribe_packet[256];
-    int packet_len = 0;
-    
-    // Fixed header
-    subscribe_packet[packet_len++] = 0x82;  // SUBSCRIBE
-    subscribe_packet[packet_len++] = 2 + 2 + topic_len + 1;  // Remaining length
-    
-    // Packet identifier
-    subscribe_packet[packet_len++] = 0x00;
-    subscribe_packet[packet_len++] = 0x01;
-    
-    // Topic filter
-    subscribe_packet[packet_len++] = (topic_len >> 8) & 0xFF;
-    subscribe_packet[packet_len++] = topic_len & 0xFF;
-    memcpy(&subscribe_packet[packet_len], topic, topic_len);
-    packet_len += topic_len;
-    
-    // QoS
-    subscribe_packet[packet_len++] = 0x00;
-    
-    // Send packet
-    snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%d\r\n", packet_len);
-    sim808_send_command(cmd, response, sizeof(response), 2000);
-    
-    if (!sim808_wait_for_response(">", 5000)) {
-        ESP_LOGE(TAG, "Failed to enter send mode");
-        return ESP_FAIL;
-    }
-    
-    uart_write_bytes(SIM808_UART_NUM, (const char*)subscribe_packet, packet_len);
-    
-    if (sim808_wait_for_response("SEND OK", 5000)) {
-        ESP_LOGI(TAG, "Subscribed to topic: %s", topic);
-        return ESP_OK;
-    }
-    
-    ESP_LOGE(TAG, "Subscribe failed");
-    return ESP_FAIL;
+bool sim808_gps_is_streaming(void) {
+    return gps_streaming;
 }
 
 /**
- * Check if MQTT is connected
+ * Check if GPS has fix
  */
-bool sim808_mqtt_is_connected(void) {
-    return mqtt_connected;
+bool sim808_gps_has_fix(void) {
+    sim808_gps_data_t data;
+    return (sim808_gps_get_data(&data) == ESP_OK && data.valid);
 }
 
 /**
@@ -597,6 +562,7 @@ esp_err_t sim808_get_signal_quality(int* rssi, int* ber) {
     char* csq = strstr(response, "+CSQ:");
     if (csq != NULL) {
         sscanf(csq + 5, "%d,%d", rssi, ber);
+        sim808_diag_record_csq(*rssi, *ber);
         ESP_LOGD(TAG, "Signal: RSSI=%d, BER=%d", *rssi, *ber);
         return ESP_OK;
     }
@@ -0,0 +1,828 @@
+#include "sim808_at.h"
+#include "sim808.h"
+#include "sim808_diag.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SIM808_AT";
+
+// Finals that always terminate a command as a failure
+static const char* const error_finals[] = {
+    "ERROR", "+CME ERROR", "+CMS ERROR", "SEND FAIL", "CONNECT FAIL", "NO CARRIER", NULL
+};
+
+// Data mode (re)entry finals
+static const char* const connect_finals[] = { "CONNECT", NULL };
+
+static const char* const default_finals[] = { "OK", NULL };
+
+// Pending command, shared between the caller and the RX task
+typedef struct {
+    bool armed;
+    const char* const* finals;
+    char* response;
+    size_t response_size;
+    size_t response_len;
+    int matched;
+    esp_err_t result;
+    const char* data_prefix;    // Header line announcing a binary block
+    uint8_t* data;
+    size_t data_size;
+    size_t data_len;
+    bool enter_data;            // Switch to data mode on a success final
+} at_pending_t;
+
+// Raw data block expected inside a command response
+typedef struct {
+    const char* prefix;
+    uint8_t* data;
+    size_t size;
+    size_t len;
+} at_binary_t;
+
+typedef struct {
+    char prefix[24];
+    sim808_urc_handler_t handler;
+    void* arg;
+} urc_entry_t;
+
+static TaskHandle_t rx_task_handle = NULL;
+static SemaphoreHandle_t cmd_mutex = NULL;      // Serializes callers
+static SemaphoreHandle_t state_mutex = NULL;    // Guards pending + URC registry
+static SemaphoreHandle_t done_sem = NULL;       // Signals a matched final
+
+static at_pending_t pending = {0};
+static sim808_link_error_handler_t link_error_handler = NULL;
+static uint32_t consecutive_timeouts = 0;      // Guarded by cmd_mutex
+static uint32_t recent_timeouts = 0;            // Bit per recent command, 1 = timed out; cmd_mutex
+static uint32_t recent_commands = 0;            // Commands in recent_timeouts; cmd_mutex
+static bool in_link_recovery = false;           // Guarded by cmd_mutex
+static urc_entry_t urc_handlers[SIM808_AT_MAX_URC_HANDLERS] = {0};
+
+// Data mode: while raw_handler is set every received byte goes to it
+static sim808_raw_handler_t data_handler = NULL;   // Handler of the open data session
+static void* data_handler_arg = NULL;
+static volatile sim808_raw_handler_t raw_handler = NULL;   // NULL while escaped
+static volatile bool data_tx_paused = false;    // Escape pending, writers must back off
+
+// Transport hooks, NULL while the engine owns the UART directly
+static sim808_at_write_fn_t transport_write = NULL;
+static sim808_at_rx_fn_t transport_rx = NULL;
+static const sim808_data_channel_t* data_channel = NULL;   // Data mode on its own channel
+
+// Line framer state (RX task only)
+static char line_buf[SIM808_AT_LINE_MAX];
+static size_t line_len = 0;
+static size_t binary_remaining = 0;    // Raw bytes still owed after a data header
+static bool skip_lf = false;           // Header ended in CR, its LF isn't data
+
+/**
+ * Match a line against a NULL terminated list of prefixes
+ */
+static int match_final(const char* line, const char* const* finals) {
+    for (int i = 0; finals[i] != NULL; i++) {
+        if (strncmp(line, finals[i], strlen(finals[i])) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Append a line to the pending response buffer
+ */
+static void append_response(const char* line) {
+    if (pending.response == NULL || pending.response_size == 0) {
+        return;
+    }
+    size_t room = pending.response_size - pending.response_len - 1;
+    size_t len = strlen(line);
+    if (len + 2 > room) {
+        len = room > 2 ? room - 2 : 0;
+    }
+    memcpy(pending.response + pending.response_len, line, len);
+    pending.response_len += len;
+    if (room >= 2) {
+        pending.response[pending.response_len++] = '\r';
+        pending.response[pending.response_len++] = '\n';
+    }
+    pending.response[pending.response_len] = '\0';
+}
+
+/**
+ * Complete the pending command (state_mutex held)
+ */
+static void complete_pending(esp_err_t result, int matched) {
+    pending.armed = false;
+    pending.result = result;
+    pending.matched = matched;
+    xSemaphoreGive(done_sem);
+}
+
+/**
+ * Dispatch one framed line to a URC handler or the pending command
+ * @return Number of raw bytes announced by a data header line, 0 otherwise
+ */
+static size_t handle_line(const char* line) {
+    size_t binary_len = 0;
+    sim808_urc_handler_t handler = NULL;
+    void* handler_arg = NULL;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+
+    for (int i = 0; i < SIM808_AT_MAX_URC_HANDLERS; i++) {
+        if (urc_handlers[i].handler != NULL &&
+            strncmp(line, urc_handlers[i].prefix, strlen(urc_handlers[i].prefix)) == 0) {
+            handler = urc_handlers[i].handler;
+            handler_arg = urc_handlers[i].arg;
+            break;
+        }
+    }
+
+    if (handler == NULL) {
+        if (pending.armed && pending.data_prefix != NULL &&
+            strncmp(line, pending.data_prefix, strlen(pending.data_prefix)) == 0) {
+            binary_len = strtoul(line + strlen(pending.data_prefix), NULL, 10);
+        }
+        if (pending.armed) {
+            append_response(line);
+            // Errors first, "CONNECT FAIL" must not match a "CONNECT" final
+            int idx = match_final(line, pending.finals);
+            if (match_final(line, error_finals) >= 0) {
+                complete_pending(ESP_FAIL, -1);
+            } else if (idx >= 0) {
+                if (pending.enter_data) {
+                    // Switch before the next byte, it already belongs to the data stream
+                    raw_handler = data_handler;
+                }
+                complete_pending(ESP_OK, idx);
+            }
+        } else {
+            ESP_LOGD(TAG, "Unhandled URC: %s", line);
+        }
+    }
+
+    xSemaphoreGive(state_mutex);
+
+    // Run handlers outside the lock so they may queue work freely
+    if (handler != NULL) {
+        handler(line, handler_arg);
+    }
+
+    return binary_len;
+}
+
+/**
+ * Store raw bytes of a binary block into the pending data buffer
+ */
+static void store_binary(const uint8_t* data, size_t len) {
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (pending.armed && pending.data != NULL) {
+        size_t room = pending.data_size - pending.data_len;
+        size_t n = len < room ? len : room;
+        memcpy(pending.data + pending.data_len, data, n);
+        pending.data_len += n;
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+/**
+ * Check for a data prompt, which the modem sends without a line ending
+ */
+static void check_prompt(void) {
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (pending.armed) {
+        int idx = match_final(">", pending.finals);
+        if (idx >= 0) {
+            append_response(">");
+            complete_pending(ESP_OK, idx);
+            line_len = 0;
+        }
+    }
+    xSemaphoreGive(state_mutex);
+}
+
+/**
+ * Feed received bytes into the line framer
+ */
+static void feed_bytes(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)data[i];
+
+        // Data mode: the rest of the buffer is payload, not AT lines
+        sim808_raw_handler_t handler = raw_handler;
+        if (handler != NULL) {
+            line_len = 0;
+            skip_lf = false;
+            handler(data + i, len - i, data_handler_arg);
+            return;
+        }
+
+        if (skip_lf) {
+            skip_lf = false;
+            if (c == '\n') {
+                continue;
+            }
+        }
+
+        // Raw block announced by a data header, copied without framing
+        if (binary_remaining > 0) {
+            size_t n = len - i < binary_remaining ? len - i : binary_remaining;
+            store_binary(data + i, n);
+            binary_remaining -= n;
+            i += n - 1;
+            continue;
+        }
+
+        if (c == '\r' || c == '\n') {
+            if (line_len > 0) {
+                line_buf[line_len] = '\0';
+                binary_remaining = handle_line(line_buf);
+                skip_lf = (binary_remaining > 0 && c == '\r');
+                line_len = 0;
+            }
+            continue;
+        }
+
+        // Drop the space the modem sends after a "> " prompt
+        if (line_len == 0 && c == ' ') {
+            continue;
+        }
+
+        if (line_len < sizeof(line_buf) - 1) {
+            line_buf[line_len++] = c;
+        }
+
+        if (line_len == 1 && c == '>') {
+            check_prompt();
+        }
+    }
+}
+
+/**
+ * UART RX task: blocks for the first byte, then drains whatever is buffered
+ */
+static void at_rx_task(void* pvParameters) {
+    uint8_t buf[128];
+
+    while (1) {
+        int len = uart_read_bytes(SIM808_UART_NUM, buf, 1, portMAX_DELAY);
+        if (len <= 0) {
+            continue;
+        }
+
+        size_t buffered = 0;
+        uart_get_buffered_data_len(SIM808_UART_NUM, &buffered);
+        if (buffered > sizeof(buf) - 1) {
+            buffered = sizeof(buf) - 1;
+        }
+        if (buffered > 0) {
+            int more = uart_read_bytes(SIM808_UART_NUM, buf + 1, buffered, 0);
+            if (more > 0) {
+                len += more;
+            }
+        }
+
+        sim808_diag_record_bytes(len, 0);
+
+        sim808_at_rx_fn_t rx = transport_rx;
+        if (rx != NULL) {
+            rx(buf, len);
+        } else {
+            feed_bytes(buf, len);
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * Start the AT engine
+ */
+esp_err_t sim808_at_start(void) {
+    if (rx_task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    cmd_mutex = xSemaphoreCreateRecursiveMutex();
+    state_mutex = xSemaphoreCreateMutex();
+    done_sem = xSemaphoreCreateBinary();
+    if (cmd_mutex == NULL || state_mutex == NULL || done_sem == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate AT engine primitives");
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(
+        at_rx_task,
+        "sim808_rx",
+        SIM808_AT_TASK_STACK_SIZE,
+        NULL,
+        SIM808_AT_TASK_PRIORITY,
+        &rx_task_handle
+    );
+
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create AT RX task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "AT engine started");
+    return ESP_OK;
+}
+
+/**
+ * Set link error handler
+ */
+void sim808_at_set_link_error_handler(sim808_link_error_handler_t handler) {
+    link_error_handler = handler;
+}
+
+/**
+ * Lock the AT channel
+ */
+void sim808_at_lock(void) {
+    xSemaphoreTakeRecursive(cmd_mutex, portMAX_DELAY);
+}
+
+/**
+ * Unlock the AT channel
+ */
+void sim808_at_unlock(void) {
+    xSemaphoreGiveRecursive(cmd_mutex);
+}
+
+/**
+ * Write to the modem through the transport, or straight to the UART
+ */
+static int at_write(const void* data, size_t len) {
+    sim808_at_write_fn_t write = transport_write;
+    if (write != NULL) {
+        return write(data, len);
+    }
+    sim808_diag_record_bytes(0, len);
+    return uart_write_bytes(SIM808_UART_NUM, data, len);
+}
+
+/**
+ * Write raw bytes and wait for one of the finals (AT channel locked)
+ */
+static esp_err_t at_transact(const void* out, size_t out_len, const char* const* finals,
+                             char* response, size_t response_size,
+                             uint32_t timeout_ms, int* matched, at_binary_t* binary,
+                             bool enter_data) {
+    // Arm the matcher before writing so a fast reply can't be missed
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    xSemaphoreTake(done_sem, 0);
+    pending.finals = (finals != NULL) ? finals : default_finals;
+    pending.response = response;
+    pending.response_size = response_size;
+    pending.response_len = 0;
+    pending.matched = -1;
+    pending.result = ESP_ERR_TIMEOUT;
+    pending.data_prefix = binary ? binary->prefix : NULL;
+    pending.data = binary ? binary->data : NULL;
+    pending.data_size = binary ? binary->size : 0;
+    pending.data_len = 0;
+    pending.enter_data = enter_data;
+    pending.armed = true;
+    if (response != NULL && response_size > 0) {
+        response[0] = '\0';
+    }
+    xSemaphoreGive(state_mutex);
+
+    if (out != NULL && out_len > 0) {
+        at_write(out, out_len);
+    }
+
+    xSemaphoreTake(done_sem, pdMS_TO_TICKS(timeout_ms));
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    esp_err_t result = pending.result;
+    int idx = pending.matched;
+    if (binary != NULL) {
+        binary->len = pending.data_len;
+    }
+    pending.armed = false;
+    pending.response = NULL;
+    pending.data = NULL;
+    pending.data_prefix = NULL;
+    pending.enter_data = false;
+    xSemaphoreGive(state_mutex);
+
+    if (matched != NULL) {
+        *matched = idx;
+    }
+    return result;
+}
+
+/**
+ * Record a command's latency under its id
+ */
+static void record_command(sim808_cmd_id_t id, esp_err_t result, int64_t start_us) {
+    sim808_diag_record_cmd(id, result, (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+}
+
+/**
+ * Leave data mode for a command (AT channel locked)
+ * @return true if data mode was escaped and must be resumed afterwards
+ */
+static bool escape_for_command(void) {
+    if (raw_handler == NULL) {
+        return false;
+    }
+    ESP_LOGD(TAG, "Escaping data mode for a command");
+    return sim808_at_escape_data_mode() == ESP_OK;
+}
+
+/**
+ * Record a command result in the timeout window (cmd_mutex held)
+ */
+static void link_record(bool timed_out) {
+    recent_timeouts = (recent_timeouts << 1) | (timed_out ? 1 : 0);
+    if (recent_commands < SIM808_AT_LINK_WINDOW) {
+        recent_commands++;
+    }
+}
+
+/**
+ * Check the timeout counters against the recovery thresholds (cmd_mutex held)
+ */
+static bool link_degraded(void) {
+    if (consecutive_timeouts >= SIM808_AT_LINK_ERROR_THRESHOLD) {
+        return true;
+    }
+    if (recent_commands < SIM808_AT_LINK_WINDOW) {
+        return false;
+    }
+    uint32_t window = (SIM808_AT_LINK_WINDOW >= 32) ? UINT32_MAX : (1u << SIM808_AT_LINK_WINDOW) - 1;
+    int timeouts = __builtin_popcount(recent_timeouts & window);
+    return timeouts * 100 >= SIM808_AT_LINK_ERROR_PCT * SIM808_AT_LINK_WINDOW;
+}
+
+/**
+ * Execute AT command
+ */
+esp_err_t sim808_at_exec(const char* cmd, const char* const* finals,
+                         char* response, size_t response_size,
+                         uint32_t timeout_ms, int* matched) {
+    if (rx_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim808_at_lock();
+    bool escaped = escape_for_command();
+    ESP_LOGD(TAG, "Sent: %s", cmd ? cmd : "(wait)");
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact(cmd, cmd ? strlen(cmd) : 0, finals,
+                                response, response_size, timeout_ms, matched, NULL, false);
+    if (cmd != NULL) {
+        record_command(sim808_diag_classify(cmd), ret, start_us);
+    }
+    if (escaped) {
+        sim808_at_resume_data_mode();
+    }
+
+    if (ret == ESP_ERR_TIMEOUT) {
+        ESP_LOGD(TAG, "Timeout waiting for final");
+        consecutive_timeouts++;
+    } else {
+        consecutive_timeouts = 0;
+        if (response != NULL) {
+            ESP_LOGD(TAG, "Received: %s", response);
+        }
+    }
+    if (!in_link_recovery) {
+        link_record(ret == ESP_ERR_TIMEOUT);
+    }
+
+    // Let the driver recover the link once, without recursing from its own
+    // probes. Under the lock: a rate change must not interleave with
+    // another task's command, which would go out at the wrong rate
+    if (link_error_handler != NULL && !in_link_recovery && link_degraded()) {
+        in_link_recovery = true;
+        link_error_handler();
+        in_link_recovery = false;
+        consecutive_timeouts = 0;
+        recent_timeouts = 0;
+        recent_commands = 0;
+    }
+    sim808_at_unlock();
+
+    return ret;
+}
+
+/**
+ * Execute AT command that returns a raw data block
+ */
+esp_err_t sim808_at_exec_binary(const char* cmd, const char* data_prefix,
+                                uint8_t* data, size_t data_size, size_t* data_len,
+                                uint32_t timeout_ms) {
+    if (rx_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char response[96];
+    at_binary_t binary = {
+        .prefix = data_prefix,
+        .data = data,
+        .size = data_size,
+    };
+
+    sim808_at_lock();
+    bool escaped = escape_for_command();
+    ESP_LOGD(TAG, "Sent: %s", cmd);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact(cmd, strlen(cmd), NULL, response, sizeof(response),
+                                timeout_ms, NULL, &binary, false);
+    record_command(sim808_diag_classify(cmd), ret, start_us);
+    if (escaped) {
+        sim808_at_resume_data_mode();
+    }
+    sim808_at_unlock();
+
+    *data_len = binary.len;
+    return ret;
+}
+
+/**
+ * Send command followed by raw data after the prompt
+ */
+esp_err_t sim808_at_send_data(const char* cmd, const char* prompt,
+                              const void* data, size_t len,
+                              const char* const* finals, uint32_t timeout_ms) {
+    if (rx_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const char* prompt_finals[] = { prompt, NULL };
+    char response[64];
+
+    sim808_at_lock();
+    bool escaped = escape_for_command();
+
+    // Prompt and data phase count as one command
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact(cmd, strlen(cmd), prompt_finals,
+                                response, sizeof(response), timeout_ms, NULL, NULL, false);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "No %s prompt for %s", prompt, cmd);
+    } else {
+        ret = at_transact(data, len, finals, response, sizeof(response), timeout_ms, NULL, NULL,
+                          false);
+    }
+    record_command(sim808_diag_classify(cmd), ret, start_us);
+
+    if (escaped) {
+        sim808_at_resume_data_mode();
+    }
+    sim808_at_unlock();
+    return ret;
+}
+
+/**
+ * Enter data mode
+ */
+esp_err_t sim808_at_enter_data_mode(const char* cmd, const char* const* finals,
+                                    sim808_raw_handler_t handler, void* arg,
+                                    uint32_t timeout_ms) {
+    if (rx_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char response[96];
+
+    if (data_channel != NULL) {
+        return data_channel->open(cmd, finals ? finals : connect_finals, handler, arg, timeout_ms);
+    }
+
+    sim808_at_lock();
+
+    if (data_handler != NULL) {
+        sim808_at_unlock();
+        ESP_LOGW(TAG, "Data mode already open");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    data_handler_arg = arg;
+    data_handler = handler;
+
+    ESP_LOGD(TAG, "Sent: %s", cmd);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact(cmd, strlen(cmd), finals ? finals : connect_finals,
+                                response, sizeof(response), timeout_ms, NULL, NULL, true);
+    record_command(sim808_diag_classify(cmd), ret, start_us);
+    if (ret != ESP_OK) {
+        raw_handler = NULL;
+        data_handler = NULL;
+        ESP_LOGE(TAG, "Data mode not entered: %s", response);
+    }
+
+    sim808_at_unlock();
+    return ret;
+}
+
+/**
+ * Escape from data mode with +++
+ */
+esp_err_t sim808_at_escape_data_mode(void) {
+    char response[32];
+
+    if (data_channel != NULL) {
+        return data_channel->escape();
+    }
+
+    sim808_at_lock();
+
+    if (raw_handler == NULL) {
+        sim808_at_unlock();
+        return (data_handler != NULL) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    // +++ is only recognised after a silent guard period on the line
+    data_tx_paused = true;
+    uart_wait_tx_done(SIM808_UART_NUM, pdMS_TO_TICKS(1000));
+    vTaskDelay(pdMS_TO_TICKS(SIM808_AT_ESCAPE_GUARD_MS));
+
+    raw_handler = NULL;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact("+++", 3, NULL, response, sizeof(response),
+                                SIM808_AT_ESCAPE_GUARD_MS + 1000, NULL, NULL, false);
+    record_command(SIM808_CMD_ESCAPE, ret, start_us);
+    if (ret != ESP_OK) {
+        // Modem never left data mode, keep routing bytes to the session
+        raw_handler = data_handler;
+        data_tx_paused = false;
+        ESP_LOGE(TAG, "Data mode escape failed");
+    }
+
+    sim808_at_unlock();
+    return ret;
+}
+
+/**
+ * Resume data mode with ATO
+ */
+esp_err_t sim808_at_resume_data_mode(void) {
+    char response[32];
+
+    if (data_channel != NULL) {
+        return data_channel->resume();
+    }
+
+    sim808_at_lock();
+
+    if (data_handler == NULL) {
+        sim808_at_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (raw_handler != NULL) {
+        sim808_at_unlock();
+        return ESP_OK;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = at_transact("ATO\r\n", 5, connect_finals, response, sizeof(response),
+                                5000, NULL, NULL, true);
+    record_command(SIM808_CMD_ATO, ret, start_us);
+    if (ret == ESP_OK) {
+        data_tx_paused = false;
+    } else {
+        ESP_LOGE(TAG, "Data mode resume failed");
+    }
+
+    sim808_at_unlock();
+    return ret;
+}
+
+/**
+ * Close the data session
+ */
+void sim808_at_leave_data_mode(void) {
+    if (data_channel != NULL) {
+        data_channel->close();
+    }
+    raw_handler = NULL;
+    data_handler = NULL;
+    data_tx_paused = false;
+}
+
+/**
+ * Check whether received bytes are routed to a data mode handler
+ */
+bool sim808_at_in_data_mode(void) {
+    if (data_channel != NULL) {
+        return data_channel->active();
+    }
+    return raw_handler != NULL;
+}
+
+/**
+ * Write raw bytes in data mode
+ */
+esp_err_t sim808_at_write_data(const void* data, size_t len) {
+    if (data_channel != NULL) {
+        return data_channel->write(data, len);
+    }
+
+    // Don't queue up behind an escape, callers like lwIP must not block for seconds
+    if (raw_handler == NULL || data_tx_paused) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Checked again under the lock, an escape may have started meanwhile
+    sim808_at_lock();
+    if (raw_handler == NULL || data_tx_paused) {
+        sim808_at_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    int written = at_write(data, len);
+    sim808_at_unlock();
+
+    return (written == (int)len) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * Route modem I/O through a transport
+ */
+void sim808_at_set_transport(sim808_at_write_fn_t write, sim808_at_rx_fn_t rx) {
+    sim808_at_lock();
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    transport_write = write;
+    transport_rx = rx;
+    line_len = 0;
+    binary_remaining = 0;
+    skip_lf = false;
+    xSemaphoreGive(state_mutex);
+    sim808_at_unlock();
+}
+
+/**
+ * Feed bytes received by a transport into the line framer
+ */
+void sim808_at_feed(const uint8_t* data, size_t len) {
+    feed_bytes(data, len);
+}
+
+/**
+ * Move data mode to a separate channel
+ */
+void sim808_at_set_data_channel(const sim808_data_channel_t* channel) {
+    sim808_at_lock();
+    data_channel = channel;
+    sim808_at_unlock();
+}
+
+/**
+ * Check whether data mode runs beside the AT channel
+ */
+bool sim808_at_has_data_channel(void) {
+    return data_channel != NULL;
+}
+
+/**
+ * Register URC handler
+ */
+esp_err_t sim808_at_register_urc(const char* prefix, sim808_urc_handler_t handler, void* arg) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    for (int i = 0; i < SIM808_AT_MAX_URC_HANDLERS; i++) {
+        if (urc_handlers[i].handler == NULL) {
+            strncpy(urc_handlers[i].prefix, prefix, sizeof(urc_handlers[i].prefix) - 1);
+            urc_handlers[i].handler = handler;
+            urc_handlers[i].arg = arg;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(state_mutex);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "URC registry full, can't add %s", prefix);
+    }
+    return ret;
+}
+
+/**
+ * Unregister URC handler
+ */
+esp_err_t sim808_at_unregister_urc(const char* prefix) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    for (int i = 0; i < SIM808_AT_MAX_URC_HANDLERS; i++) {
+        if (urc_handlers[i].handler != NULL && strcmp(urc_handlers[i].prefix, prefix) == 0) {
+            memset(&urc_handlers[i], 0, sizeof(urc_handlers[i]));
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(state_mutex);
+
+    return ret;
+}
@@ -0,0 +1,763 @@
+#include "sim808_cmux.h"
+#include "sim808.h"
+#include "sim808_at.h"
+#include "sim808_diag.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+static const char *TAG = "SIM808_CMUX";
+
+// Frame octets
+#define CMUX_FLAG       0xF9
+#define CMUX_EA         0x01
+#define CMUX_CR         0x02
+#define CMUX_PF         0x10
+
+// Control field, P/F bit cleared
+#define CMUX_SABM       0x2F
+#define CMUX_UA         0x63
+#define CMUX_DM         0x0F
+#define CMUX_DISC       0x43
+#define CMUX_UIH        0xEF
+#define CMUX_UI         0x03
+
+// DLCI 0 message types, C/R bit cleared
+#define CMUX_MSG_CLD    0xC1    // Multiplexer close down
+#define CMUX_MSG_FCON   0xA1    // Flow control on, all channels
+#define CMUX_MSG_FCOFF  0x61
+#define CMUX_MSG_MSC    0xE1    // Modem status
+
+// MSC V.24 signal octet
+#define CMUX_V24_FC     0x02    // Sender can't accept frames
+#define CMUX_V24_RTC    0x04
+#define CMUX_V24_RTR    0x08
+#define CMUX_V24_DV     0x80
+
+#define CMUX_HEADER_MAX 4       // Address, control and up to two length octets
+#define CMUX_FRAME_MAX  (SIM808_CMUX_N1 + CMUX_HEADER_MAX + 3)
+#define CMUX_FCS_GOOD   0xCF    // Receiver FCS residue
+
+// Multiplexer events, set by the RX task
+#define UA_BIT(dlci)    (1 << (dlci))
+#define DM_BIT(dlci)    (1 << ((dlci) + 8))
+#define CLD_BIT         (1 << 16)
+
+typedef enum {
+    RX_SYNC = 0,
+    RX_ADDR,
+    RX_CTRL,
+    RX_LEN,
+    RX_LEN2,
+    RX_DATA,
+    RX_FCS,
+    RX_END,
+} rx_state_t;
+
+// Frame parser (RX task only)
+typedef struct {
+    rx_state_t state;
+    uint8_t header[CMUX_HEADER_MAX];
+    size_t header_len;
+    size_t len;
+    size_t pos;
+    bool fcs_ok;
+    uint8_t info[SIM808_CMUX_N1];
+} cmux_parser_t;
+
+typedef struct {
+    SemaphoreHandle_t tx_mutex;
+    uint8_t tx_buf[CMUX_FRAME_MAX];
+    volatile bool flow_stopped;
+} cmux_channel_t;
+
+// Data session on DLCI 2, same states as the engine's own data mode
+typedef enum {
+    DATA_CLOSED = 0,
+    DATA_COMMAND,
+    DATA_ONLINE,
+} data_state_t;
+
+// Command pending on DLCI 2, shared between the caller and the RX task
+typedef struct {
+    bool armed;
+    const char* const* finals;
+    bool go_online;
+    esp_err_t result;
+} data_pending_t;
+
+static const char* const data_error_finals[] = {
+    "ERROR", "+CME ERROR", "CONNECT FAIL", "NO CARRIER", "BUSY", "NO DIALTONE", "NO ANSWER", NULL
+};
+static const char* const data_connect_finals[] = { "CONNECT", NULL };
+static const char* const data_default_finals[] = { "OK", NULL };
+
+static bool cmux_active = false;
+static EventGroupHandle_t cmux_events = NULL;
+static cmux_parser_t parser = {0};
+static cmux_channel_t channels[SIM808_CMUX_CHANNELS] = {0};
+static sim808_cmux_stats_t cmux_stats = {0};
+
+static SemaphoreHandle_t data_mutex = NULL;         // Serializes DLCI 2 commands
+static SemaphoreHandle_t data_state_mutex = NULL;   // Guards data_pending
+static SemaphoreHandle_t data_done_sem = NULL;
+static data_pending_t data_pending = {0};
+static volatile data_state_t data_state = DATA_CLOSED;
+static volatile bool data_tx_paused = false;
+static sim808_raw_handler_t data_handler = NULL;
+static void* data_handler_arg = NULL;
+static char data_line[64];              // DLCI 2 line framer (RX task only)
+static size_t data_line_len = 0;
+
+/**
+ * Update a reflected CRC-8 (polynomial x^8 + x^2 + x + 1) over bytes
+ */
+static uint8_t fcs_update(uint8_t fcs, const uint8_t* data, size_t len) {
+    while (len--) {
+        fcs ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0xE0 : fcs >> 1;
+        }
+    }
+    return fcs;
+}
+
+/**
+ * Build one frame in the channel's buffer and write it to the UART
+ */
+static esp_err_t send_frame(uint8_t dlci, uint8_t ctrl, bool command,
+                            const uint8_t* data, size_t len) {
+    cmux_channel_t* ch = &channels[dlci];
+    uint8_t* frame = ch->tx_buf;
+    size_t n = 0;
+
+    if (len > SIM808_CMUX_N1) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(ch->tx_mutex, portMAX_DELAY);
+
+    frame[n++] = CMUX_FLAG;
+    frame[n++] = (uint8_t)((dlci << 2) | (command ? CMUX_CR : 0) | CMUX_EA);
+    frame[n++] = ctrl;
+    if (len <= 127) {
+        frame[n++] = (uint8_t)((len << 1) | CMUX_EA);
+    } else {
+        frame[n++] = (uint8_t)((len << 1) & 0xFE);
+        frame[n++] = (uint8_t)(len >> 7);
+    }
+    size_t header_len = n - 1;
+
+    if (len > 0) {
+        memcpy(frame + n, data, len);
+        n += len;
+    }
+
+    // UIH frames only protect the header
+    bool uih = (ctrl & ~CMUX_PF) == CMUX_UIH;
+    frame[n] = 0xFF - fcs_update(0xFF, frame + 1, uih ? header_len : n - 1);
+    n++;
+    frame[n++] = CMUX_FLAG;
+
+    int written = uart_write_bytes(SIM808_UART_NUM, frame, n);
+    sim808_diag_record_bytes(0, n);
+    cmux_stats.channels[dlci].tx_frames++;
+    cmux_stats.channels[dlci].tx_bytes += len;
+
+    xSemaphoreGive(ch->tx_mutex);
+
+    return (written == (int)n) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * Write a byte stream to a channel as UIH frames
+ * @return Number of bytes written, -1 on error
+ */
+static int channel_write(uint8_t dlci, const void* data, size_t len) {
+    const uint8_t* p = data;
+    size_t sent = 0;
+
+    while (sent < len) {
+        size_t chunk = len - sent < SIM808_CMUX_N1 ? len - sent : SIM808_CMUX_N1;
+        if (send_frame(dlci, CMUX_UIH, true, p + sent, chunk) != ESP_OK) {
+            return -1;
+        }
+        sent += chunk;
+    }
+    return (int)sent;
+}
+
+/**
+ * AT engine transport write: commands go to DLCI 1
+ */
+static int at_channel_write(const void* data, size_t len) {
+    return channel_write(SIM808_CMUX_DLCI_AT, data, len);
+}
+
+/**
+ * Match a line against a NULL terminated list of prefixes
+ */
+static int match_final(const char* line, const char* const* finals) {
+    for (int i = 0; finals[i] != NULL; i++) {
+        if (strncmp(line, finals[i], strlen(finals[i])) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Complete the pending DLCI 2 command on a final line
+ */
+static void data_handle_line(const char* line) {
+    xSemaphoreTake(data_state_mutex, portMAX_DELAY);
+    if (data_pending.armed) {
+        // Errors first, "CONNECT FAIL" must not match a "CONNECT" final
+        bool done = true;
+        if (match_final(line, data_error_finals) >= 0) {
+            data_pending.result = ESP_FAIL;
+        } else if (match_final(line, data_pending.finals) >= 0) {
+            if (data_pending.go_online) {
+                // Switch before the next byte, it already belongs to the session
+                data_state = DATA_ONLINE;
+            }
+            data_pending.result = ESP_OK;
+        } else {
+            done = false;
+        }
+        if (done) {
+            data_pending.armed = false;
+            xSemaphoreGive(data_done_sem);
+        }
+    } else {
+        ESP_LOGD(TAG, "Unhandled data channel line: %s", line);
+    }
+    xSemaphoreGive(data_state_mutex);
+}
+
+/**
+ * DLCI 2 payload: session bytes while online, command responses otherwise
+ */
+static void data_rx(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        sim808_raw_handler_t handler = data_handler;
+        if (data_state == DATA_ONLINE && handler != NULL) {
+            data_line_len = 0;
+            handler(data + i, len - i, data_handler_arg);
+            return;
+        }
+
+        char c = (char)data[i];
+        if (c == '\r' || c == '\n') {
+            if (data_line_len > 0) {
+                data_line[data_line_len] = '\0';
+                data_handle_line(data_line);
+                data_line_len = 0;
+            }
+        } else if (data_line_len < sizeof(data_line) - 1) {
+            data_line[data_line_len++] = c;
+        }
+    }
+}
+
+/**
+ * DLCI 0 control message; modem commands are acknowledged with a response
+ */
+static void handle_control(const uint8_t* info, size_t len) {
+    if (len < 2) {
+        return;
+    }
+
+    uint8_t type = info[0];
+    size_t value_len = info[1] >> 1;
+    const uint8_t* value = info + 2;
+    bool command = (type & CMUX_CR) != 0;
+
+    if (value_len + 2 > len) {
+        return;
+    }
+
+    switch (type & ~CMUX_CR) {
+        case CMUX_MSG_MSC:
+            if (command && value_len >= 2) {
+                uint8_t dlci = value[0] >> 2;
+                if (dlci < SIM808_CMUX_CHANNELS) {
+                    channels[dlci].flow_stopped = (value[1] & CMUX_V24_FC) != 0;
+                }
+            }
+            break;
+        case CMUX_MSG_FCOFF:
+        case CMUX_MSG_FCON:
+            for (int i = 0; i < SIM808_CMUX_CHANNELS; i++) {
+                channels[i].flow_stopped = (type & ~CMUX_CR) == CMUX_MSG_FCOFF;
+            }
+            break;
+        case CMUX_MSG_CLD:
+            if (!command) {
+                xEventGroupSetBits(cmux_events, CLD_BIT);
+            }
+            break;
+        default:
+            ESP_LOGD(TAG, "Control message 0x%02x ignored", type);
+            break;
+    }
+
+    if (command) {
+        uint8_t response[8];
+        size_t n = value_len + 2 < sizeof(response) ? value_len + 2 : sizeof(response);
+        memcpy(response, info, n);
+        response[0] &= ~CMUX_CR;
+        send_frame(0, CMUX_UIH, true, response, n);
+    }
+}
+
+/**
+ * Dispatch one verified frame
+ */
+static void handle_frame(uint8_t dlci, uint8_t ctrl, const uint8_t* info, size_t len) {
+    if (dlci >= SIM808_CMUX_CHANNELS) {
+        return;
+    }
+
+    cmux_stats.channels[dlci].rx_frames++;
+
+    switch (ctrl & ~CMUX_PF) {
+        case CMUX_UA:
+            xEventGroupSetBits(cmux_events, UA_BIT(dlci));
+            break;
+        case CMUX_DM:
+            xEventGroupSetBits(cmux_events, DM_BIT(dlci));
+            break;
+        case CMUX_DISC:
+            send_frame(dlci, CMUX_UA | CMUX_PF, false, NULL, 0);
+            ESP_LOGW(TAG, "Modem closed DLCI %d", dlci);
+            break;
+        case CMUX_UIH:
+        case CMUX_UI:
+            cmux_stats.channels[dlci].rx_bytes += len;
+            if (dlci == 0) {
+                handle_control(info, len);
+            } else if (dlci == SIM808_CMUX_DLCI_AT) {
+                sim808_at_feed(info, len);
+            } else {
+                data_rx(info, len);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * AT engine transport receive: deframe UART bytes (AT RX task)
+ */
+static void cmux_rx(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        switch (parser.state) {
+            case RX_SYNC:
+                if (b == CMUX_FLAG) {
+                    parser.state = RX_ADDR;
+                }
+                break;
+
+            case RX_ADDR:
+                // Repeated flags between frames
+                if (b == CMUX_FLAG) {
+                    break;
+                }
+                parser.header[0] = b;
+                parser.header_len = 1;
+                parser.state = RX_CTRL;
+                break;
+
+            case RX_CTRL:
+                parser.header[parser.header_len++] = b;
+                parser.state = RX_LEN;
+                break;
+
+            case RX_LEN:
+            case RX_LEN2:
+                parser.header[parser.header_len++] = b;
+                if (parser.state == RX_LEN && !(b & CMUX_EA)) {
+                    parser.state = RX_LEN2;
+                    break;
+                }
+                parser.len = parser.header[2] >> 1;
+                if (parser.state == RX_LEN2) {
+                    parser.len |= (size_t)b << 7;
+                }
+                if (parser.len > SIM808_CMUX_N1) {
+                    cmux_stats.oversized++;
+                    parser.state = RX_SYNC;
+                    break;
+                }
+                parser.pos = 0;
+                parser.state = (parser.len > 0) ? RX_DATA : RX_FCS;
+                break;
+
+            case RX_DATA: {
+                size_t n = len - i < parser.len - parser.pos ? len - i : parser.len - parser.pos;
+                memcpy(parser.info + parser.pos, data + i, n);
+                parser.pos += n;
+                i += n - 1;
+                if (parser.pos == parser.len) {
+                    parser.state = RX_FCS;
+                }
+                break;
+            }
+
+            case RX_FCS: {
+                bool uih = (parser.header[1] & ~CMUX_PF) == CMUX_UIH;
+                uint8_t fcs = fcs_update(0xFF, parser.header, parser.header_len);
+                if (!uih) {
+                    fcs = fcs_update(fcs, parser.info, parser.len);
+                }
+                parser.fcs_ok = fcs_update(fcs, &b, 1) == CMUX_FCS_GOOD;
+                parser.state = RX_END;
+                break;
+            }
+
+            case RX_END:
+                if (b != CMUX_FLAG) {
+                    parser.state = RX_SYNC;
+                    break;
+                }
+                if (parser.fcs_ok) {
+                    handle_frame(parser.header[0] >> 2, parser.header[1], parser.info, parser.len);
+                } else {
+                    cmux_stats.fcs_errors++;
+                }
+                // The closing flag may also open the next frame
+                parser.state = RX_ADDR;
+                break;
+        }
+    }
+}
+
+/**
+ * Run a command on DLCI 2 and wait for a final (data_mutex held)
+ */
+static esp_err_t data_command(const char* cmd, const char* const* finals, bool go_online,
+                              uint32_t timeout_ms) {
+    xSemaphoreTake(data_state_mutex, portMAX_DELAY);
+    xSemaphoreTake(data_done_sem, 0);
+    data_pending.finals = (finals != NULL) ? finals : data_default_finals;
+    data_pending.go_online = go_online;
+    data_pending.result = ESP_ERR_TIMEOUT;
+    data_pending.armed = true;
+    xSemaphoreGive(data_state_mutex);
+
+    int64_t start_us = esp_timer_get_time();
+    channel_write(SIM808_CMUX_DLCI_DATA, cmd, strlen(cmd));
+
+    xSemaphoreTake(data_done_sem, pdMS_TO_TICKS(timeout_ms));
+
+    xSemaphoreTake(data_state_mutex, portMAX_DELAY);
+    esp_err_t result = data_pending.result;
+    data_pending.armed = false;
+    xSemaphoreGive(data_state_mutex);
+
+    sim808_diag_record_cmd(sim808_diag_classify(cmd), result,
+                           (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+
+    return result;
+}
+
+/**
+ * Data channel: dial or connect on DLCI 2
+ */
+static esp_err_t data_open(const char* cmd, const char* const* finals,
+                           sim808_raw_handler_t handler, void* arg, uint32_t timeout_ms) {
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+
+    if (data_state != DATA_CLOSED) {
+        xSemaphoreGive(data_mutex);
+        ESP_LOGW(TAG, "Data channel already open");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    data_handler_arg = arg;
+    data_handler = handler;
+    data_tx_paused = false;
+    data_state = DATA_COMMAND;
+
+    ESP_LOGD(TAG, "Data channel: %s", cmd);
+    esp_err_t ret = data_command(cmd, finals ? finals : data_connect_finals, true, timeout_ms);
+    if (ret != ESP_OK) {
+        data_state = DATA_CLOSED;
+        data_handler = NULL;
+        ESP_LOGE(TAG, "Data channel not connected: %s", esp_err_to_name(ret));
+    }
+
+    xSemaphoreGive(data_mutex);
+    return ret;
+}
+
+/**
+ * Data channel: +++ escape, only needed to end the session
+ */
+static esp_err_t data_escape(void) {
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+
+    if (data_state != DATA_ONLINE) {
+        xSemaphoreGive(data_mutex);
+        return (data_state == DATA_COMMAND) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    // Let a frame in flight finish, then keep the channel silent for the guard time
+    data_tx_paused = true;
+    xSemaphoreTake(channels[SIM808_CMUX_DLCI_DATA].tx_mutex, portMAX_DELAY);
+    xSemaphoreGive(channels[SIM808_CMUX_DLCI_DATA].tx_mutex);
+    vTaskDelay(pdMS_TO_TICKS(SIM808_AT_ESCAPE_GUARD_MS));
+
+    data_state = DATA_COMMAND;
+    esp_err_t ret = data_command("+++", NULL, false, SIM808_AT_ESCAPE_GUARD_MS + 1000);
+    if (ret != ESP_OK) {
+        data_state = DATA_ONLINE;
+        data_tx_paused = false;
+        ESP_LOGE(TAG, "Data channel escape failed");
+    }
+
+    xSemaphoreGive(data_mutex);
+    return ret;
+}
+
+/**
+ * Data channel: ATO after an escape
+ */
+static esp_err_t data_resume(void) {
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+
+    esp_err_t ret = ESP_OK;
+    if (data_state == DATA_CLOSED) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (data_state == DATA_COMMAND) {
+        ret = data_command("ATO\r\n", data_connect_finals, true, 5000);
+        if (ret == ESP_OK) {
+            data_tx_paused = false;
+        } else {
+            ESP_LOGE(TAG, "Data channel resume failed");
+        }
+    }
+
+    xSemaphoreGive(data_mutex);
+    return ret;
+}
+
+/**
+ * Data channel: write session bytes
+ */
+static esp_err_t data_write(const void* data, size_t len) {
+    if (data_state != DATA_ONLINE || data_tx_paused) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (channels[SIM808_CMUX_DLCI_DATA].flow_stopped) {
+        cmux_stats.channels[SIM808_CMUX_DLCI_DATA].tx_dropped++;
+        return ESP_FAIL;
+    }
+    return (channel_write(SIM808_CMUX_DLCI_DATA, data, len) == (int)len) ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * Data channel: forget the session
+ */
+static void data_close(void) {
+    data_state = DATA_CLOSED;
+    data_handler = NULL;
+    data_tx_paused = false;
+}
+
+/**
+ * Data channel: session bytes flowing
+ */
+static bool data_active(void) {
+    return data_state == DATA_ONLINE;
+}
+
+static const sim808_data_channel_t data_channel = {
+    .open = data_open,
+    .escape = data_escape,
+    .resume = data_resume,
+    .write = data_write,
+    .close = data_close,
+    .active = data_active,
+};
+
+/**
+ * Open a DLCI with SABM and wait for the modem's UA
+ */
+static esp_err_t open_dlci(uint8_t dlci) {
+    xEventGroupClearBits(cmux_events, UA_BIT(dlci) | DM_BIT(dlci));
+    send_frame(dlci, CMUX_SABM | CMUX_PF, true, NULL, 0);
+
+    EventBits_t bits = xEventGroupWaitBits(cmux_events, UA_BIT(dlci) | DM_BIT(dlci),
+                                           pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(SIM808_CMUX_OPEN_TIMEOUT_MS));
+    if (!(bits & UA_BIT(dlci))) {
+        ESP_LOGE(TAG, "DLCI %d not opened (%s)", dlci, (bits & DM_BIT(dlci)) ? "DM" : "timeout");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Close a DLCI with DISC
+ */
+static void close_dlci(uint8_t dlci) {
+    xEventGroupClearBits(cmux_events, UA_BIT(dlci) | DM_BIT(dlci));
+    send_frame(dlci, CMUX_DISC | CMUX_PF, true, NULL, 0);
+    xEventGroupWaitBits(cmux_events, UA_BIT(dlci) | DM_BIT(dlci), pdTRUE, pdFALSE,
+                        pdMS_TO_TICKS(1000));
+}
+
+/**
+ * Raise DTR/RTS on a DLCI with a modem status command
+ */
+static void send_msc(uint8_t dlci) {
+    const uint8_t msg[] = {
+        CMUX_MSG_MSC | CMUX_CR,
+        (2 << 1) | CMUX_EA,
+        (uint8_t)((dlci << 2) | CMUX_CR | CMUX_EA),
+        CMUX_V24_DV | CMUX_V24_RTR | CMUX_V24_RTC | CMUX_EA,
+    };
+    send_frame(0, CMUX_UIH, true, msg, sizeof(msg));
+}
+
+/**
+ * Leave multiplexer mode with CLD and hand the UART back to the AT engine
+ */
+static void close_down(void) {
+    const uint8_t msg[] = { CMUX_MSG_CLD | CMUX_CR, CMUX_EA };
+
+    xEventGroupClearBits(cmux_events, CLD_BIT);
+    send_frame(0, CMUX_UIH, true, msg, sizeof(msg));
+    xEventGroupWaitBits(cmux_events, CLD_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(1000));
+
+    sim808_at_set_transport(NULL, NULL);
+}
+
+/**
+ * Allocate the multiplexer's primitives once
+ */
+static esp_err_t cmux_init(void) {
+    if (cmux_events != NULL) {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < SIM808_CMUX_CHANNELS; i++) {
+        channels[i].tx_mutex = xSemaphoreCreateMutex();
+        if (channels[i].tx_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    data_mutex = xSemaphoreCreateMutex();
+    data_state_mutex = xSemaphoreCreateMutex();
+    data_done_sem = xSemaphoreCreateBinary();
+    cmux_events = xEventGroupCreate();
+    if (data_mutex == NULL || data_state_mutex == NULL || data_done_sem == NULL ||
+        cmux_events == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Start multiplexer
+ */
+esp_err_t sim808_cmux_start(void) {
+    char response[32];
+
+    if (cmux_active) {
+        return ESP_OK;
+    }
+
+    if (cmux_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to allocate multiplexer primitives");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // No other command may slip in while the framing changes
+    sim808_at_lock();
+
+    if (sim808_send_command("AT+CMUX=0\r\n", response, sizeof(response), 2000) != ESP_OK) {
+        sim808_at_unlock();
+        ESP_LOGE(TAG, "Modem refused AT+CMUX");
+        return ESP_FAIL;
+    }
+
+    memset(&parser, 0, sizeof(parser));
+    for (int i = 0; i < SIM808_CMUX_CHANNELS; i++) {
+        channels[i].flow_stopped = false;
+    }
+    sim808_at_set_transport(at_channel_write, cmux_rx);
+
+    for (uint8_t dlci = 0; dlci < SIM808_CMUX_CHANNELS; dlci++) {
+        if (open_dlci(dlci) != ESP_OK) {
+            close_down();
+            sim808_at_unlock();
+            return ESP_FAIL;
+        }
+    }
+
+    send_msc(SIM808_CMUX_DLCI_AT);
+    send_msc(SIM808_CMUX_DLCI_DATA);
+
+    data_close();
+    cmux_active = true;
+    sim808_at_set_data_channel(&data_channel);
+    sim808_at_unlock();
+
+    // New channels start with their own settings, echo included
+    sim808_send_command("ATE0\r\n", response, sizeof(response), 1000);
+    xSemaphoreTake(data_mutex, portMAX_DELAY);
+    data_command("ATE0\r\n", NULL, false, 1000);
+    xSemaphoreGive(data_mutex);
+
+    ESP_LOGI(TAG, "Multiplexer running, AT on DLCI %d, data on DLCI %d",
+             SIM808_CMUX_DLCI_AT, SIM808_CMUX_DLCI_DATA);
+    return ESP_OK;
+}
+
+/**
+ * Stop multiplexer
+ */
+esp_err_t sim808_cmux_stop(void) {
+    if (!cmux_active) {
+        return ESP_OK;
+    }
+
+    sim808_at_lock();
+
+    sim808_at_set_data_channel(NULL);
+    data_close();
+    close_dlci(SIM808_CMUX_DLCI_DATA);
+    close_dlci(SIM808_CMUX_DLCI_AT);
+    close_down();
+    cmux_active = false;
+
+    sim808_at_unlock();
+
+    ESP_LOGI(TAG, "Multiplexer stopped");
+    return ESP_OK;
+}
+
+/**
+ * Check if the multiplexer is running
+ */
+bool sim808_cmux_is_active(void) {
+    return cmux_active;
+}
+
+/**
+ * Get multiplexer counters
+ */
+void sim808_cmux_get_stats(sim808_cmux_stats_t* stats) {
+    *stats = cmux_stats;
+}
@@ -0,0 +1,239 @@
+#include "sim808_diag.h"
+#include "esp_timer.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+// Histogram bucket upper limits, the last bucket is open ended
+static const uint32_t bucket_limits_ms[SIM808_DIAG_HIST_BUCKETS] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, UINT32_MAX
+};
+
+// Command names as they follow "AT", indexed by sim808_cmd_id_t
+static const char* const cmd_names[SIM808_CMD_COUNT] = {
+    [SIM808_CMD_OTHER]      = "OTHER",
+    [SIM808_CMD_AT]         = "AT",
+    [SIM808_CMD_ATE]        = "E",
+    [SIM808_CMD_ATD]        = "D",
+    [SIM808_CMD_ATO]        = "O",
+    [SIM808_CMD_ATH]        = "H",
+    [SIM808_CMD_ESCAPE]     = "+++",
+    [SIM808_CMD_IPR]        = "+IPR",
+    [SIM808_CMD_CMUX]       = "+CMUX",
+    [SIM808_CMD_CSQ]        = "+CSQ",
+    [SIM808_CMD_CREG]       = "+CREG",
+    [SIM808_CMD_CGATT]      = "+CGATT",
+    [SIM808_CMD_CGDCONT]    = "+CGDCONT",
+    [SIM808_CMD_SAPBR]      = "+SAPBR",
+    [SIM808_CMD_CIPMODE]    = "+CIPMODE",
+    [SIM808_CMD_CIPRXGET]   = "+CIPRXGET",
+    [SIM808_CMD_CIPSTART]   = "+CIPSTART",
+    [SIM808_CMD_CIPSEND]    = "+CIPSEND",
+    [SIM808_CMD_CIPCLOSE]   = "+CIPCLOSE",
+    [SIM808_CMD_CIPSHUT]    = "+CIPSHUT",
+    [SIM808_CMD_CGNSPWR]    = "+CGNSPWR",
+    [SIM808_CMD_CGNSINF]    = "+CGNSINF",
+    [SIM808_CMD_CGNSTST]    = "+CGNSTST",
+    [SIM808_CMD_HTTPINIT]   = "+HTTPINIT",
+    [SIM808_CMD_HTTPPARA]   = "+HTTPPARA",
+    [SIM808_CMD_HTTPDATA]   = "+HTTPDATA",
+    [SIM808_CMD_HTTPACTION] = "+HTTPACTION",
+    [SIM808_CMD_HTTPTERM]   = "+HTTPTERM",
+    [SIM808_CMD_CPOWD]      = "+CPOWD",
+};
+
+static portMUX_TYPE diag_lock = portMUX_INITIALIZER_UNLOCKED;
+static sim808_cmd_stats_t cmd_stats[SIM808_CMD_COUNT] = {0};
+static sim808_link_stats_t link_stats = {0};
+static sim808_csq_sample_t csq_history[SIM808_DIAG_CSQ_SAMPLES] = {0};
+static size_t csq_head = 0;     // Next slot to write
+static size_t csq_count = 0;
+
+/**
+ * Tag a command with its id
+ */
+sim808_cmd_id_t sim808_diag_classify(const char* cmd) {
+    if (cmd == NULL) {
+        return SIM808_CMD_OTHER;
+    }
+    if (strncmp(cmd, "+++", 3) == 0) {
+        return SIM808_CMD_ESCAPE;
+    }
+    if (strncmp(cmd, "AT", 2) != 0 && strncmp(cmd, "at", 2) != 0) {
+        return SIM808_CMD_OTHER;
+    }
+
+    // Extended commands end at a parameter, query or line end, basic ones are one letter
+    const char* name = cmd + 2;
+    size_t len;
+    if (*name == '+') {
+        len = strcspn(name, "=?\r\n");
+    } else if (*name == '\r' || *name == '\n' || *name == '\0') {
+        return SIM808_CMD_AT;
+    } else {
+        len = 1;
+    }
+
+    for (int id = SIM808_CMD_ATE; id < SIM808_CMD_COUNT; id++) {
+        if (id != SIM808_CMD_ESCAPE && strlen(cmd_names[id]) == len &&
+            strncmp(name, cmd_names[id], len) == 0) {
+            return (sim808_cmd_id_t)id;
+        }
+    }
+    return SIM808_CMD_OTHER;
+}
+
+/**
+ * Record one command
+ */
+void sim808_diag_record_cmd(sim808_cmd_id_t id, esp_err_t result, uint32_t latency_ms) {
+    if (id < 0 || id >= SIM808_CMD_COUNT) {
+        id = SIM808_CMD_OTHER;
+    }
+
+    int bucket = 0;
+    while (latency_ms >= bucket_limits_ms[bucket] && bucket < SIM808_DIAG_HIST_BUCKETS - 1) {
+        bucket++;
+    }
+
+    portENTER_CRITICAL(&diag_lock);
+    sim808_cmd_stats_t* stats = &cmd_stats[id];
+    stats->count++;
+    stats->total_ms += latency_ms;
+    if (latency_ms > stats->max_ms) {
+        stats->max_ms = latency_ms;
+    }
+    stats->hist[bucket]++;
+    link_stats.commands++;
+    if (result == ESP_ERR_TIMEOUT) {
+        stats->timeouts++;
+        link_stats.timeouts++;
+    } else if (result != ESP_OK) {
+        stats->errors++;
+        link_stats.errors++;
+    }
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+/**
+ * Count UART traffic
+ */
+void sim808_diag_record_bytes(size_t in, size_t out) {
+    portENTER_CRITICAL(&diag_lock);
+    link_stats.bytes_in += in;
+    link_stats.bytes_out += out;
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+/**
+ * Add a CSQ sample
+ */
+void sim808_diag_record_csq(int rssi, int ber) {
+    uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    portENTER_CRITICAL(&diag_lock);
+    csq_history[csq_head].uptime_s = uptime_s;
+    csq_history[csq_head].rssi = (int8_t)rssi;
+    csq_history[csq_head].ber = (int8_t)ber;
+    csq_head = (csq_head + 1) % SIM808_DIAG_CSQ_SAMPLES;
+    if (csq_count < SIM808_DIAG_CSQ_SAMPLES) {
+        csq_count++;
+    }
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+/**
+ * Get command name
+ */
+const char* sim808_diag_cmd_name(sim808_cmd_id_t id) {
+    switch (id) {
+        case SIM808_CMD_ATE:    return "ATE";
+        case SIM808_CMD_ATD:    return "ATD";
+        case SIM808_CMD_ATO:    return "ATO";
+        case SIM808_CMD_ATH:    return "ATH";
+        default:                break;
+    }
+    if (id < 0 || id >= SIM808_CMD_COUNT) {
+        return cmd_names[SIM808_CMD_OTHER];
+    }
+    // Report without the '+', it's noise in dashboards
+    const char* name = cmd_names[id];
+    return (name[0] == '+' && name[1] != '+') ? name + 1 : name;
+}
+
+/**
+ * Get bucket limit
+ */
+uint32_t sim808_diag_bucket_limit_ms(int bucket) {
+    if (bucket < 0 || bucket >= SIM808_DIAG_HIST_BUCKETS) {
+        return UINT32_MAX;
+    }
+    return bucket_limits_ms[bucket];
+}
+
+/**
+ * Get command statistics
+ */
+esp_err_t sim808_diag_get_cmd_stats(sim808_cmd_id_t id, sim808_cmd_stats_t* stats) {
+    if (id < 0 || id >= SIM808_CMD_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&diag_lock);
+    *stats = cmd_stats[id];
+    portEXIT_CRITICAL(&diag_lock);
+    return ESP_OK;
+}
+
+/**
+ * Estimate a percentile
+ */
+uint32_t sim808_diag_percentile_ms(const sim808_cmd_stats_t* stats, int percent) {
+    if (stats->count == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (uint32_t)(((uint64_t)stats->count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (int i = 0; i < SIM808_DIAG_HIST_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= rank) {
+            return bucket_limits_ms[i] < stats->max_ms ? bucket_limits_ms[i] : stats->max_ms;
+        }
+    }
+    return stats->max_ms;
+}
+
+/**
+ * Get link counters
+ */
+void sim808_diag_get_link_stats(sim808_link_stats_t* stats) {
+    portENTER_CRITICAL(&diag_lock);
+    *stats = link_stats;
+    portEXIT_CRITICAL(&diag_lock);
+}
+
+/**
+ * Copy the CSQ history
+ */
+size_t sim808_diag_get_csq_history(sim808_csq_sample_t* samples, size_t max) {
+    portENTER_CRITICAL(&diag_lock);
+    size_t n = csq_count < max ? csq_count : max;
+    // Newest n samples, oldest first
+    size_t start = (csq_head + SIM808_DIAG_CSQ_SAMPLES - n) % SIM808_DIAG_CSQ_SAMPLES;
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = csq_history[(start + i) % SIM808_DIAG_CSQ_SAMPLES];
+    }
+    portEXIT_CRITICAL(&diag_lock);
+    return n;
+}
+
+/**
+ * Clear statistics
+ */
+void sim808_diag_reset(void) {
+    portENTER_CRITICAL(&diag_lock);
+    memset(cmd_stats, 0, sizeof(cmd_stats));
+    memset(&link_stats, 0, sizeof(link_stats));
+    csq_head = 0;
+    csq_count = 0;
+    portEXIT_CRITICAL(&diag_lock);
+}
@@ -0,0 +1,399 @@
+#include "sim808_gnss.h"
+#include <string.h>
+
+// CGNSINF field indices
+enum {
+    CGNSINF_RUN_STATUS = 0,
+    CGNSINF_FIX_STATUS,
+    CGNSINF_UTC_DATETIME,
+    CGNSINF_LATITUDE,
+    CGNSINF_LONGITUDE,
+    CGNSINF_ALTITUDE,
+    CGNSINF_SPEED,
+    CGNSINF_COURSE,
+    CGNSINF_FIX_MODE,
+    CGNSINF_RESERVED1,
+    CGNSINF_HDOP,
+    CGNSINF_PDOP,
+    CGNSINF_VDOP,
+    CGNSINF_RESERVED2,
+    CGNSINF_SATS_IN_VIEW,
+    CGNSINF_SATS_USED,
+};
+
+/**
+ * Parse a decimal field into a fixed-point integer with `decimals` digits
+ * Extra fraction digits are truncated, missing ones are zero padded.
+ * @return false if the field is empty or malformed
+ */
+static bool parse_fixed(const char* s, const char* end, int decimals, int32_t* out) {
+    bool negative = false;
+    int32_t value = 0;
+    int frac_digits = -1;   // -1 until the decimal point is seen
+    bool any_digit = false;
+
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = (*s == '-');
+        s++;
+    }
+
+    for (; s < end; s++) {
+        char c = *s;
+        if (c == '.') {
+            if (frac_digits >= 0) {
+                return false;
+            }
+            frac_digits = 0;
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        if (frac_digits >= decimals) {
+            continue;
+        }
+        value = value * 10 + (c - '0');
+        any_digit = true;
+        if (frac_digits >= 0) {
+            frac_digits++;
+        }
+    }
+
+    if (!any_digit) {
+        return false;
+    }
+
+    for (int i = (frac_digits < 0 ? 0 : frac_digits); i < decimals; i++) {
+        value *= 10;
+    }
+
+    *out = negative ? -value : value;
+    return true;
+}
+
+/**
+ * Parse a decimal field into a float (3 decimals is all the modem reports)
+ */
+static float parse_float(const char* s, const char* end) {
+    int32_t value;
+    if (!parse_fixed(s, end, 3, &value)) {
+        return 0.0f;
+    }
+    return value / 1000.0f;
+}
+
+/**
+ * Parse an unsigned integer field
+ */
+static int parse_int(const char* s, const char* end) {
+    int value = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        value = value * 10 + (*s - '0');
+    }
+    return value;
+}
+
+/**
+ * Format yyyyMMddHHmmss.sss into ISO8601 timestamp and date strings
+ */
+static void format_datetime(const char* s, const char* end, sim808_gps_data_t* data) {
+    if (end - s < 14) {
+        return;
+    }
+
+    char* t = data->timestamp;
+    memcpy(t, s, 4);            // YYYY
+    t[4] = '-';
+    memcpy(t + 5, s + 4, 2);    // MM
+    t[7] = '-';
+    memcpy(t + 8, s + 6, 2);    // DD
+    t[10] = 'T';
+    memcpy(t + 11, s + 8, 2);   // HH
+    t[13] = ':';
+    memcpy(t + 14, s + 10, 2);  // MM
+    t[16] = ':';
+    memcpy(t + 17, s + 12, 2);  // SS
+    t[19] = 'Z';
+    t[20] = '\0';
+
+    memcpy(data->date, t, 10);
+    data->date[10] = '\0';
+}
+
+/**
+ * Parse GNSS data from AT+CGNSINF response
+ * Format: +CGNSINF: <GNSS run status>,<Fix status>,<UTC date & Time>,<Latitude>,<Longitude>,
+ *         <MSL Altitude>,<Speed Over Ground>,<Course Over Ground>,<Fix Mode>,<Reserved1>,
+ *         <HDOP>,<PDOP>,<VDOP>,<Reserved2>,<GNSS Satellites in View>,<GNSS Satellites Used>,...
+ */
+bool sim808_gnss_parse_cgnsinf(const char* response, sim808_gps_data_t* data) {
+    const char* p = strstr(response, "+CGNSINF:");
+    if (p == NULL) {
+        return false;
+    }
+    p += strlen("+CGNSINF:");
+    while (*p == ' ') {
+        p++;
+    }
+
+    memset(data, 0, sizeof(*data));
+
+    int field = 0;
+    bool fix = false;
+    bool have_lat = false;
+    bool have_lon = false;
+
+    while (1) {
+        const char* start = p;
+        while (*p != ',' && *p != '\r' && *p != '\n' && *p != '\0') {
+            p++;
+        }
+        const char* end = p;
+
+        if (start < end) {
+            switch (field) {
+                case CGNSINF_FIX_STATUS:
+                    fix = (*start == '1');
+                    break;
+                case CGNSINF_UTC_DATETIME:
+                    format_datetime(start, end, data);
+                    break;
+                case CGNSINF_LATITUDE:
+                    have_lat = parse_fixed(start, end, 6, &data->latitude_e6);
+                    break;
+                case CGNSINF_LONGITUDE:
+                    have_lon = parse_fixed(start, end, 6, &data->longitude_e6);
+                    break;
+                case CGNSINF_ALTITUDE:
+                    data->altitude = parse_float(start, end);
+                    break;
+                case CGNSINF_SPEED:
+                    data->speed = parse_float(start, end);
+                    break;
+                case CGNSINF_COURSE:
+                    data->course = parse_float(start, end);
+                    break;
+                case CGNSINF_HDOP:
+                    data->hdop = parse_float(start, end);
+                    break;
+                case CGNSINF_PDOP:
+                    data->pdop = parse_float(start, end);
+                    break;
+                case CGNSINF_VDOP:
+                    data->vdop = parse_float(start, end);
+                    break;
+                case CGNSINF_SATS_IN_VIEW:
+                    data->satellites = parse_int(start, end);
+                    break;
+                case CGNSINF_SATS_USED:
+                    data->satellites_used = parse_int(start, end);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (*p != ',' || field >= CGNSINF_SATS_USED) {
+            break;
+        }
+        p++;
+        field++;
+    }
+
+    // Anything shorter than the fix status field isn't a CGNSINF report
+    if (field < CGNSINF_FIX_STATUS) {
+        return false;
+    }
+
+    data->latitude = (float)data->latitude_e6 / SIM808_GNSS_COORD_SCALE;
+    data->longitude = (float)data->longitude_e6 / SIM808_GNSS_COORD_SCALE;
+    data->valid = fix && have_lat && have_lon;
+
+    return data->valid;
+}
+
+// NMEA parser states
+enum {
+    NMEA_WAIT_START = 0,
+    NMEA_BODY,
+    NMEA_CHECKSUM_HI,
+    NMEA_CHECKSUM_LO,
+};
+
+#define NMEA_MAX_FIELDS 20
+
+/**
+ * Parse an NMEA coordinate (ddmm.mmmm / dddmm.mmmm) into micro-degrees
+ */
+static bool parse_nmea_coord(const char* s, const char* end, int deg_digits,
+                             const char* hemi, int32_t* out) {
+    if (end - s <= deg_digits) {
+        return false;
+    }
+
+    int32_t minutes_e6;
+    if (!parse_fixed(s + deg_digits, end, 6, &minutes_e6)) {
+        return false;
+    }
+
+    int32_t value = parse_int(s, s + deg_digits) * SIM808_GNSS_COORD_SCALE + (minutes_e6 + 30) / 60;
+    if (*hemi == 'S' || *hemi == 'W') {
+        value = -value;
+    }
+    *out = value;
+    return true;
+}
+
+/**
+ * Convert a hex digit, -1 if invalid
+ */
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * Apply one checksum-validated sentence to the epoch in progress
+ * @return true if the sentence closed the epoch (RMC)
+ */
+static bool apply_sentence(sim808_nmea_parser_t* parser) {
+    const char* field[NMEA_MAX_FIELDS + 1];
+    int count = 0;
+
+    // Field i spans field[i] .. field[i + 1] - 1 (the comma)
+    field[count++] = parser->sentence;
+    for (int i = 0; i < parser->len && count < NMEA_MAX_FIELDS; i++) {
+        if (parser->sentence[i] == ',') {
+            field[count++] = &parser->sentence[i + 1];
+        }
+    }
+    field[count] = &parser->sentence[parser->len] + 1;
+
+    // Talker (GP, GN, GL) is ignored, sentence type follows it
+    if (field[1] - field[0] != 6) {
+        return false;
+    }
+    const char* type = parser->sentence + 2;
+    sim808_gps_data_t* fix = &parser->fix;
+
+    #define F_START(i) (field[i])
+    #define F_END(i)   (field[(i) + 1] - 1)
+    #define F_EMPTY(i) ((i) >= count || F_START(i) == F_END(i))
+
+    if (strncmp(type, "RMC", 3) == 0 && count > 9) {
+        bool have_pos = !F_EMPTY(3) && !F_EMPTY(5) &&
+            parse_nmea_coord(F_START(3), F_END(3), 2, F_START(4), &fix->latitude_e6) &&
+            parse_nmea_coord(F_START(5), F_END(5), 3, F_START(6), &fix->longitude_e6);
+        if (!F_EMPTY(7)) {
+            fix->speed = parse_float(F_START(7), F_END(7)) * 1.852f;   // knots to km/h
+        }
+        if (!F_EMPTY(8)) {
+            fix->course = parse_float(F_START(8), F_END(8));
+        }
+        if (F_END(1) - F_START(1) >= 6 && F_END(9) - F_START(9) >= 6) {
+            // Build yyyyMMddHHmmss from ddmmyy + hhmmss
+            const char* d = F_START(9);
+            const char* t = F_START(1);
+            char datetime[14] = {
+                '2', '0', d[4], d[5], d[2], d[3], d[0], d[1],
+                t[0], t[1], t[2], t[3], t[4], t[5]
+            };
+            format_datetime(datetime, datetime + sizeof(datetime), fix);
+        }
+        fix->latitude = (float)fix->latitude_e6 / SIM808_GNSS_COORD_SCALE;
+        fix->longitude = (float)fix->longitude_e6 / SIM808_GNSS_COORD_SCALE;
+        fix->valid = have_pos && *F_START(2) == 'A';
+        return true;
+    }
+
+    if (strncmp(type, "GGA", 3) == 0 && count > 9) {
+        if (!F_EMPTY(7)) {
+            fix->satellites_used = parse_int(F_START(7), F_END(7));
+        }
+        if (!F_EMPTY(8)) {
+            fix->hdop = parse_float(F_START(8), F_END(8));
+        }
+        if (!F_EMPTY(9)) {
+            fix->altitude = parse_float(F_START(9), F_END(9));
+        }
+    } else if (strncmp(type, "GSA", 3) == 0 && count > 17) {
+        if (!F_EMPTY(15)) fix->pdop = parse_float(F_START(15), F_END(15));
+        if (!F_EMPTY(16)) fix->hdop = parse_float(F_START(16), F_END(16));
+        if (!F_EMPTY(17)) fix->vdop = parse_float(F_START(17), F_END(17));
+    } else if (strncmp(type, "GSV", 3) == 0 && count > 3) {
+        if (!F_EMPTY(3)) {
+            fix->satellites = parse_int(F_START(3), F_END(3));
+        }
+    } else if (strncmp(type, "VTG", 3) == 0 && count > 7) {
+        if (!F_EMPTY(1)) {
+            fix->course = parse_float(F_START(1), F_END(1));
+        }
+        if (!F_EMPTY(7)) {
+            fix->speed = parse_float(F_START(7), F_END(7));
+        }
+    }
+
+    #undef F_START
+    #undef F_END
+    #undef F_EMPTY
+
+    return false;
+}
+
+/**
+ * Reset NMEA parser
+ */
+void sim808_nmea_init(sim808_nmea_parser_t* parser) {
+    memset(parser, 0, sizeof(*parser));
+    parser->state = NMEA_WAIT_START;
+}
+
+/**
+ * Feed one byte to the NMEA parser
+ */
+bool sim808_nmea_feed(sim808_nmea_parser_t* parser, char c) {
+    // A '$' always starts a new sentence, whatever came before
+    if (c == '$') {
+        parser->state = NMEA_BODY;
+        parser->len = 0;
+        parser->checksum = 0;
+        return false;
+    }
+
+    switch (parser->state) {
+        case NMEA_BODY:
+            if (c == '*') {
+                parser->sentence[parser->len] = '\0';
+                parser->state = NMEA_CHECKSUM_HI;
+            } else if (c == '\r' || c == '\n' || parser->len >= sizeof(parser->sentence) - 1) {
+                parser->state = NMEA_WAIT_START;
+            } else {
+                parser->sentence[parser->len++] = c;
+                parser->checksum ^= (uint8_t)c;
+            }
+            return false;
+
+        case NMEA_CHECKSUM_HI: {
+            int v = hex_value(c);
+            parser->rx_checksum = (uint8_t)(v << 4);
+            parser->state = (v < 0) ? NMEA_WAIT_START : NMEA_CHECKSUM_LO;
+            return false;
+        }
+
+        case NMEA_CHECKSUM_LO: {
+            int v = hex_value(c);
+            parser->state = NMEA_WAIT_START;
+            if (v < 0 || (parser->rx_checksum | v) != parser->checksum) {
+                parser->checksum_errors++;
+                return false;
+            }
+            parser->sentences++;
+            return apply_sentence(parser);
+        }
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,313 @@
+#include "sim808.h"
+#include "sim808_at.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "SIM808_GPRS";
+
+// SAPBR=2,1 bearer status values
+enum {
+    BEARER_STATUS_CONNECTING = 0,
+    BEARER_STATUS_CONNECTED,
+    BEARER_STATUS_CLOSING,
+    BEARER_STATUS_CLOSED,
+};
+
+static sim808_bearer_state_t bearer_state = SIM808_BEARER_IDLE;
+static sim808_gprs_stats_t gprs_stats = {0};
+
+// Bearer profile last written with SAPBR=3, kept by the modem until power off
+static sim808_gprs_config_t configured = {0};
+static bool bearer_configured = false;
+
+/**
+ * Enter a new bearer state
+ */
+static void set_state(sim808_bearer_state_t state) {
+    if (state != bearer_state) {
+        ESP_LOGD(TAG, "Bearer state %d -> %d", bearer_state, state);
+        bearer_state = state;
+    }
+}
+
+/**
+ * Query bearer 1 with AT+SAPBR=2,1
+ * @return Bearer status, or -1 if the query failed
+ */
+static int bearer_query(void) {
+    char response[128];
+
+    if (sim808_send_command("AT+SAPBR=2,1\r\n", response, sizeof(response), 2000) != ESP_OK) {
+        return -1;
+    }
+
+    // +SAPBR: <cid>,<status>,"<ip>"
+    char* p = strstr(response, "+SAPBR:");
+    if (p == NULL || (p = strchr(p, ',')) == NULL) {
+        return -1;
+    }
+
+    int status = atoi(p + 1);
+    if (status == BEARER_STATUS_CONNECTED) {
+        char* ip = strchr(p + 1, ',');
+        ESP_LOGD(TAG, "Bearer IP: %s", ip ? ip + 1 : "?");
+    }
+    return status;
+}
+
+/**
+ * Check network registration (home or roaming)
+ */
+static bool network_registered(void) {
+    char response[64];
+
+    if (sim808_send_command("AT+CREG?\r\n", response, sizeof(response), 2000) != ESP_OK) {
+        return false;
+    }
+
+    // +CREG: <n>,<stat>
+    char* p = strstr(response, "+CREG:");
+    if (p == NULL || (p = strchr(p, ',')) == NULL) {
+        return false;
+    }
+
+    int stat = atoi(p + 1);
+    return stat == 1 || stat == 5;
+}
+
+/**
+ * Wait for network registration
+ */
+static bool wait_registered(uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+
+    while (!network_registered()) {
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms)) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    return true;
+}
+
+/**
+ * Make sure the modem is attached to the packet domain
+ */
+static bool gprs_attached(void) {
+    char response[64];
+
+    if (sim808_send_command("AT+CGATT?\r\n", response, sizeof(response), 2000) == ESP_OK &&
+        strstr(response, "+CGATT: 1") != NULL) {
+        return true;
+    }
+
+    return sim808_send_command("AT+CGATT=1\r\n", response, sizeof(response),
+                               SIM808_GPRS_ATTACH_TIMEOUT_MS) == ESP_OK;
+}
+
+/**
+ * Write the bearer profile, skipped when it's unchanged
+ */
+static esp_err_t configure_bearer(const sim808_gprs_config_t* config) {
+    char response[64];
+    char cmd[128];
+
+    if (bearer_configured && strcmp(configured.apn, config->apn) == 0 &&
+        strcmp(configured.username, config->username) == 0 &&
+        strcmp(configured.password, config->password) == 0) {
+        return ESP_OK;
+    }
+
+    if (sim808_send_command("AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\"\r\n",
+                            response, sizeof(response), 2000) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"APN\",\"%s\"\r\n", config->apn);
+    if (sim808_send_command(cmd, response, sizeof(response), 2000) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    if (strlen(config->username) > 0) {
+        snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"USER\",\"%s\"\r\n", config->username);
+        if (sim808_send_command(cmd, response, sizeof(response), 2000) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
+    if (strlen(config->password) > 0) {
+        snprintf(cmd, sizeof(cmd), "AT+SAPBR=3,1,\"PWD\",\"%s\"\r\n", config->password);
+        if (sim808_send_command(cmd, response, sizeof(response), 2000) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+
+    memcpy(&configured, config, sizeof(configured));
+    bearer_configured = true;
+    return ESP_OK;
+}
+
+/**
+ * One registration, attach and open attempt
+ */
+static esp_err_t connect_attempt(const sim808_gprs_config_t* config) {
+    char response[64];
+
+    set_state(SIM808_BEARER_REGISTERING);
+    if (!wait_registered(SIM808_GPRS_REG_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "Not registered to the network");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    set_state(SIM808_BEARER_ATTACHING);
+    if (!gprs_attached()) {
+        ESP_LOGW(TAG, "GPRS attach failed");
+        return ESP_FAIL;
+    }
+
+    if (configure_bearer(config) != ESP_OK) {
+        ESP_LOGW(TAG, "Bearer profile rejected");
+        bearer_configured = false;
+        return ESP_FAIL;
+    }
+
+    set_state(SIM808_BEARER_OPENING);
+    esp_err_t ret = sim808_send_command("AT+SAPBR=1,1\r\n", response, sizeof(response),
+                                        SIM808_GPRS_OPEN_TIMEOUT_MS);
+
+    // ERROR also comes back if the bearer opened meanwhile, so ask the modem
+    int status = bearer_query();
+    if (status == BEARER_STATUS_CONNECTED) {
+        return ESP_OK;
+    }
+
+    // The profile may be why it failed (or gone after a modem reset), so
+    // the next attempt writes it again
+    bearer_configured = false;
+    ESP_LOGW(TAG, "Bearer not open (%s, status %d)", esp_err_to_name(ret), status);
+    return ESP_FAIL;
+}
+
+/**
+ * Backoff before retry n (1-based): exponential, capped, with full jitter
+ * in the upper half so synchronized devices spread out
+ */
+static uint32_t backoff_ms(int retry) {
+    uint32_t delay = SIM808_GPRS_BACKOFF_BASE_MS;
+    for (int i = 1; i < retry && delay < SIM808_GPRS_BACKOFF_MAX_MS; i++) {
+        delay *= 2;
+    }
+    if (delay > SIM808_GPRS_BACKOFF_MAX_MS) {
+        delay = SIM808_GPRS_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/**
+ * Record a successful connect in the metrics
+ */
+static void record_connect(int64_t start_us, bool fast_path) {
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+
+    gprs_stats.connects++;
+    if (fast_path) {
+        gprs_stats.fast_path_hits++;
+    }
+    gprs_stats.last_connect_ms = elapsed_ms;
+    gprs_stats.total_connect_ms += elapsed_ms;
+    if (gprs_stats.connects == 1 || elapsed_ms < gprs_stats.min_connect_ms) {
+        gprs_stats.min_connect_ms = elapsed_ms;
+    }
+    if (elapsed_ms > gprs_stats.max_connect_ms) {
+        gprs_stats.max_connect_ms = elapsed_ms;
+    }
+
+    set_state(SIM808_BEARER_CONNECTED);
+    ESP_LOGI(TAG, "GPRS connected in %lu ms%s", (unsigned long)elapsed_ms,
+             fast_path ? " (bearer reused)" : "");
+}
+
+/**
+ * Connect to GPRS network
+ */
+esp_err_t sim808_gprs_connect(sim808_gprs_config_t* config) {
+    int64_t start_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Connecting to GPRS network...");
+    gprs_stats.attempts++;
+
+    // Fast path: the bearer outlives short coverage gaps and our own restarts
+    if (bearer_query() == BEARER_STATUS_CONNECTED) {
+        record_connect(start_us, true);
+        return ESP_OK;
+    }
+
+    for (int attempt = 0; attempt < SIM808_GPRS_MAX_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            uint32_t delay = backoff_ms(attempt);
+            set_state(SIM808_BEARER_BACKOFF);
+            ESP_LOGI(TAG, "Retrying GPRS in %lu ms (%d/%d)", (unsigned long)delay,
+                     attempt + 1, SIM808_GPRS_MAX_ATTEMPTS);
+            vTaskDelay(pdMS_TO_TICKS(delay));
+            gprs_stats.retries++;
+        }
+
+        if (connect_attempt(config) == ESP_OK) {
+            record_connect(start_us, false);
+            return ESP_OK;
+        }
+    }
+
+    set_state(SIM808_BEARER_IDLE);
+    gprs_stats.failures++;
+    ESP_LOGE(TAG, "Failed to connect to GPRS");
+    return ESP_FAIL;
+}
+
+/**
+ * Disconnect from GPRS network
+ */
+esp_err_t sim808_gprs_disconnect(void) {
+    char response[128];
+
+    esp_err_t ret = sim808_send_command("AT+SAPBR=0,1\r\n", response, sizeof(response), 5000);
+    set_state(SIM808_BEARER_IDLE);
+
+    // ERROR means the bearer was already closed
+    ESP_LOGI(TAG, "GPRS disconnected");
+    return (ret == ESP_ERR_TIMEOUT) ? ESP_FAIL : ESP_OK;
+}
+
+/**
+ * Forget the bearer profile and state, the modem lost both
+ */
+void sim808_gprs_reset_state(void) {
+    bearer_configured = false;
+    set_state(SIM808_BEARER_IDLE);
+}
+
+/**
+ * Check if GPRS is connected
+ */
+bool sim808_gprs_is_connected(void) {
+    return bearer_state == SIM808_BEARER_CONNECTED;
+}
+
+/**
+ * Get bearer state
+ */
+sim808_bearer_state_t sim808_gprs_get_state(void) {
+    return bearer_state;
+}
+
+/**
+ * Get connection metrics
+ */
+void sim808_gprs_get_stats(sim808_gprs_stats_t* stats) {
+    *stats = gprs_stats;
+}
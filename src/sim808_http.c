@@ -0,0 +1,257 @@
+#include "sim808_http.h"
+#include "sim808.h"
+#include "sim808_at.h"
+#include "sim808_ppp.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "SIM808_HTTP";
+
+#define DEFAULT_CONTENT_TYPE    "application/octet-stream"
+#define HTTP_STATUS_CONFLICT    409
+
+// Chunk being posted, too large for a task stack
+static uint8_t chunk_buf[SIM808_HTTP_CHUNK_SIZE];
+
+/**
+ * End the modem's HTTP session
+ */
+static void http_term(void) {
+    char response[32];
+    sim808_send_command("AT+HTTPTERM\r\n", response, sizeof(response), 2000);
+}
+
+/**
+ * Set one HTTPPARA value
+ */
+static esp_err_t http_set_param(const char* tag, const char* value) {
+    char cmd[SIM808_HTTP_URL_MAX + 32];
+    char response[32];
+
+    int len = snprintf(cmd, sizeof(cmd), "AT+HTTPPARA=\"%s\",\"%s\"\r\n", tag, value);
+    if (len >= (int)sizeof(cmd)) {
+        ESP_LOGE(TAG, "HTTP parameter %s too long", tag);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return sim808_send_command(cmd, response, sizeof(response), 2000);
+}
+
+/**
+ * Start an HTTP session on bearer 1
+ */
+static esp_err_t http_init(const char* content_type) {
+    char response[32];
+
+    // A session left open by an earlier failure makes HTTPINIT fail
+    http_term();
+
+    if (sim808_send_command("AT+HTTPINIT\r\n", response, sizeof(response), 2000) != ESP_OK) {
+        ESP_LOGE(TAG, "HTTPINIT failed");
+        return ESP_FAIL;
+    }
+
+    if (http_set_param("CID", "1") != ESP_OK ||
+        http_set_param("CONTENT", content_type ? content_type : DEFAULT_CONTENT_TYPE) != ESP_OK) {
+        http_term();
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/**
+ * POST a body to the URL set last
+ * @param status Output HTTP status
+ * @param body_len Output length of the response body
+ */
+static esp_err_t http_post_body(const void* data, size_t len, int* status, size_t* body_len) {
+    static const char* const action_finals[] = { "+HTTPACTION:", NULL };
+    char cmd[48];
+    char response[96];
+
+    // The modem prompts with DOWNLOAD and takes exactly len bytes
+    snprintf(cmd, sizeof(cmd), "AT+HTTPDATA=%u,%u\r\n", (unsigned)len,
+             (unsigned)SIM808_HTTP_DATA_TIMEOUT_MS);
+    esp_err_t ret = sim808_at_send_data(cmd, "DOWNLOAD", data, len, NULL,
+                                        SIM808_HTTP_DATA_TIMEOUT_MS);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "HTTPDATA failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // OK comes back at once, the result follows as +HTTPACTION: <method>,<status>,<len>
+    ret = sim808_at_exec("AT+HTTPACTION=1\r\n", action_finals, response, sizeof(response),
+                         SIM808_HTTP_ACTION_TIMEOUT_MS, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "HTTPACTION failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    int method = 0;
+    int code = 0;
+    int length = 0;
+    char* p = strstr(response, "+HTTPACTION:");
+    if (p == NULL || sscanf(p + strlen("+HTTPACTION:"), "%d,%d,%d", &method, &code, &length) < 2) {
+        return ESP_FAIL;
+    }
+
+    *status = code;
+    if (body_len != NULL) {
+        *body_len = (length > 0) ? (size_t)length : 0;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Read the offset a 409 response body carries
+ */
+static esp_err_t read_expected_offset(size_t body_len, uint32_t* offset) {
+    char body[24];
+    size_t len = 0;
+
+    if (body_len == 0) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = sim808_at_exec_binary("AT+HTTPREAD\r\n", "+HTTPREAD: ", (uint8_t*)body,
+                                          sizeof(body) - 1, &len, 5000);
+    if (ret != ESP_OK || len == 0) {
+        return ESP_FAIL;
+    }
+    body[len] = '\0';
+
+    char* end;
+    unsigned long value = strtoul(body, &end, 10);
+    if (end == body) {
+        return ESP_FAIL;
+    }
+    *offset = (uint32_t)value;
+    return ESP_OK;
+}
+
+/**
+ * Check that the modem's own IP stack can reach the network
+ * @return ESP_OK with an open bearer, ESP_ERR_INVALID_STATE without one,
+ *         ESP_ERR_NOT_SUPPORTED while PPP holds the data call
+ */
+static esp_err_t bearer_ready(void) {
+#if SIM808_USE_PPP
+    // The PPP session owns the PDP context and turns the AT channel into
+    // a data pipe, bearer 1 never opens
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    return sim808_gprs_is_connected() ? ESP_OK : ESP_ERR_INVALID_STATE;
+#endif
+}
+
+/**
+ * POST one body
+ */
+esp_err_t sim808_http_post(const char* url, const char* content_type,
+                           const void* data, size_t len, int* status) {
+    esp_err_t ready = bearer_ready();
+    if (ready != ESP_OK) {
+        return ready;
+    }
+    
+    if (http_init(content_type) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = http_set_param("URL", url);
+    if (ret == ESP_OK) {
+        ret = http_post_body(data, len, status, NULL);
+    }
+
+    http_term();
+    return ret;
+}
+
+/**
+ * Upload a body in chunks
+ */
+esp_err_t sim808_http_upload(sim808_http_upload_t* upload) {
+    char url[SIM808_HTTP_URL_MAX];
+    int failures = 0;
+    esp_err_t ret = ESP_OK;
+
+    ret = bearer_ready();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (upload->offset >= upload->total_len) {
+        return ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "Uploading %s: %lu of %lu bytes left", upload->upload_id,
+             (unsigned long)(upload->total_len - upload->offset),
+             (unsigned long)upload->total_len);
+
+    if (http_init(upload->content_type) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    while (upload->offset < upload->total_len) {
+        size_t want = upload->total_len - upload->offset;
+        if (want > sizeof(chunk_buf)) {
+            want = sizeof(chunk_buf);
+        }
+
+        int n = upload->read(upload->offset, chunk_buf, want, upload->arg);
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Upload source ended at %lu", (unsigned long)upload->offset);
+            ret = ESP_FAIL;
+            break;
+        }
+
+        snprintf(url, sizeof(url), "%s?id=%s&offset=%lu&total=%lu", upload->url,
+                 upload->upload_id, (unsigned long)upload->offset,
+                 (unsigned long)upload->total_len);
+
+        int status = 0;
+        size_t body_len = 0;
+        esp_err_t r = http_set_param("URL", url);
+        if (r == ESP_OK) {
+            r = http_post_body(chunk_buf, n, &status, &body_len);
+        }
+
+        if (r == ESP_OK && status >= 200 && status < 300) {
+            upload->offset += n;
+            failures = 0;
+            ESP_LOGD(TAG, "Chunk acknowledged, offset %lu", (unsigned long)upload->offset);
+            continue;
+        }
+
+        // The server holds a different amount, continue from there
+        uint32_t expected = 0;
+        if (r == ESP_OK && status == HTTP_STATUS_CONFLICT &&
+            read_expected_offset(body_len, &expected) == ESP_OK &&
+            expected != upload->offset && expected <= upload->total_len) {
+            ESP_LOGW(TAG, "Server expects offset %lu, resuming there (was %lu)",
+                     (unsigned long)expected, (unsigned long)upload->offset);
+            upload->offset = expected;
+            continue;
+        }
+
+        if (++failures >= SIM808_HTTP_MAX_RETRIES) {
+            ESP_LOGE(TAG, "Upload stopped at %lu (status %d)", (unsigned long)upload->offset,
+                     status);
+            ret = ESP_FAIL;
+            break;
+        }
+        ESP_LOGW(TAG, "Chunk at %lu failed (status %d), retrying", (unsigned long)upload->offset,
+                 status);
+        vTaskDelay(pdMS_TO_TICKS(1000 * failures));
+    }
+
+    http_term();
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Upload %s complete", upload->upload_id);
+    }
+    return ret;
+}
@@ -0,0 +1,1228 @@
+#include "sim808.h"
+#include "sim808_at.h"
+#include "mqtt_codec.h"
+#include "esp_log.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+static const char *TAG = "SIM808_MQTT";
+static bool mqtt_connected = false;
+
+// Packet ids and in-flight QoS 1 publishes, used by publishing tasks, the
+// batch task and the receive task (PUBACK); only touch through session_*()
+static mqtt_session_t session;
+static portMUX_TYPE session_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Copies of the QoS 1 PUBLISH packets in flight, sent again with DUP set
+// after a reconnect. Guarded by resend_mutex, which is taken before the AT lock
+typedef struct {
+    uint16_t packet_id;         // 0 = free slot
+    uint16_t len;
+    uint8_t packet[SIM808_MQTT_RESEND_MAX];
+} resend_slot_t;
+
+static resend_slot_t resend_slots[MQTT_INFLIGHT_MAX];
+static SemaphoreHandle_t resend_mutex = NULL;
+
+// Final result of a CIPSEND once the payload has been written
+static const char* const send_ok_finals[] = { "SEND OK", NULL };
+
+// Staging buffer for one CIPSEND, packets larger than this are split
+static uint8_t tx_buf[SIM808_CIPSEND_MAX];
+
+// Publish batching: encoded PUBLISH packets waiting to share one CIPSEND
+typedef struct {
+    sim808_publish_cb_t callback;
+    void* arg;
+    uint16_t packet_id;
+    uint16_t offset;            // Of its PUBLISH in batch_buf
+} batch_entry_t;
+
+static uint8_t batch_buf[SIM808_CIPSEND_MAX];
+static size_t batch_len = 0;
+static batch_entry_t batch_entries[SIM808_BATCH_MAX_MESSAGES];
+static int batch_count = 0;
+static SemaphoreHandle_t batch_mutex = NULL;
+static TaskHandle_t batch_task_handle = NULL;
+static sim808_batch_stats_t batch_stats = {0};
+
+// Transparent mode (CIPMODE=1): the RX task pushes broker bytes into rx_stream
+static bool transparent = false;
+static bool gnss_was_streaming = false;
+static StreamBufferHandle_t rx_stream = NULL;
+static const char closed_marker[] = "\r\nCLOSED\r\n";
+static size_t closed_match = 0;     // Bytes of closed_marker held back
+static volatile bool closed_suspect = false;    // Whole marker held, nothing after it
+static volatile TickType_t closed_tick = 0;
+
+// Received bytes not yet framed into a complete packet, guarded by rx_mutex
+static uint8_t rx_buf[SIM808_MQTT_RX_BUF_SIZE];
+static size_t rx_len = 0;
+static SemaphoreHandle_t rx_mutex = NULL;
+static TaskHandle_t rx_task_handle = NULL;
+static sim808_mqtt_message_handler_t message_handler = NULL;
+
+// Keepalive: a PINGREQ is only sent after a quiet period without other traffic
+static TickType_t last_tx_tick = 0;
+static TickType_t ping_sent_tick = 0;
+static bool ping_outstanding = false;
+
+// Reconnect: a connection lost after sim808_mqtt_connect() (no PINGRESP,
+// CLOSED) is opened again by the receive task until sim808_mqtt_disconnect()
+static sim808_mqtt_config_t session_config;
+static volatile bool reconnect_wanted = false;
+static TickType_t lost_tick = 0;
+static sim808_mqtt_connect_handler_t connect_handler = NULL;
+
+/**
+ * Drop the kept copy of a publish
+ */
+static void resend_drop(uint16_t packet_id) {
+    xSemaphoreTake(resend_mutex, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (resend_slots[i].packet_id == packet_id) {
+            resend_slots[i].packet_id = 0;
+            break;
+        }
+    }
+    xSemaphoreGive(resend_mutex);
+}
+
+/**
+ * Keep a copy of a tracked publish until its PUBACK
+ * Packets over SIM808_MQTT_RESEND_MAX aren't kept and won't be sent again.
+ */
+static void resend_keep(uint16_t packet_id, const uint8_t* header, size_t header_len,
+                        const void* payload, size_t payload_len) {
+    if (header_len + payload_len > SIM808_MQTT_RESEND_MAX) {
+        ESP_LOGW(TAG, "PUBLISH %u too large to keep for a resend", packet_id);
+        return;
+    }
+
+    // One slot per tracked id, so a free one is always there
+    xSemaphoreTake(resend_mutex, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        resend_slot_t* slot = &resend_slots[i];
+        if (slot->packet_id == 0) {
+            slot->packet_id = packet_id;
+            slot->len = (uint16_t)(header_len + payload_len);
+            memcpy(slot->packet, header, header_len);
+            if (payload_len > 0) {
+                memcpy(slot->packet + header_len, payload, payload_len);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(resend_mutex);
+}
+
+/**
+ * Forget every packet id and kept publish, for a new session
+ */
+static void session_reset(void) {
+    portENTER_CRITICAL(&session_lock);
+    mqtt_session_init(&session);
+    portEXIT_CRITICAL(&session_lock);
+
+    xSemaphoreTake(resend_mutex, portMAX_DELAY);
+    memset(resend_slots, 0, sizeof(resend_slots));
+    xSemaphoreGive(resend_mutex);
+}
+
+/**
+ * Carry the in-flight publishes over to a new connection
+ * Ids without a kept copy can't be sent again and are released.
+ */
+static void session_resume(void) {
+    uint16_t inflight[MQTT_INFLIGHT_MAX];
+
+    portENTER_CRITICAL(&session_lock);
+    memcpy(inflight, session.inflight, sizeof(inflight));
+    portEXIT_CRITICAL(&session_lock);
+
+    xSemaphoreTake(resend_mutex, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        for (int j = 0; inflight[i] != 0 && j < MQTT_INFLIGHT_MAX; j++) {
+            if (resend_slots[j].packet_id == inflight[i]) {
+                inflight[i] = 0;
+            }
+        }
+    }
+    xSemaphoreGive(resend_mutex);
+
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (inflight[i] != 0) {
+            ESP_LOGW(TAG, "PUBLISH %u lost with the connection", inflight[i]);
+            portENTER_CRITICAL(&session_lock);
+            mqtt_session_ack(&session, inflight[i]);
+            portEXIT_CRITICAL(&session_lock);
+        }
+    }
+}
+
+/**
+ * Allocate a packet id, tracked until its PUBACK when `track` is set
+ * @return Packet id, 0 if every in-flight slot is taken
+ */
+static uint16_t session_next_id(bool track) {
+    portENTER_CRITICAL(&session_lock);
+    uint16_t packet_id = mqtt_session_next_id(&session);
+    if (track && !mqtt_session_track(&session, packet_id)) {
+        packet_id = 0;
+    }
+    portEXIT_CRITICAL(&session_lock);
+    return packet_id;
+}
+
+/**
+ * Release a tracked packet id (acknowledged or never sent)
+ * @return true if it was in flight
+ */
+static bool session_ack(uint16_t packet_id) {
+    if (packet_id == 0) {
+        return false;
+    }
+    portENTER_CRITICAL(&session_lock);
+    bool found = mqtt_session_ack(&session, packet_id);
+    portEXIT_CRITICAL(&session_lock);
+    resend_drop(packet_id);
+    return found;
+}
+
+/**
+ * Count unacknowledged QoS 1 publishes
+ */
+static int session_inflight(void) {
+    portENTER_CRITICAL(&session_lock);
+    int count = mqtt_session_inflight(&session);
+    portEXIT_CRITICAL(&session_lock);
+    return count;
+}
+
+/**
+ * Send a packet over the TCP connection
+ * The header and payload are staged into CIPSEND sized chunks, so the
+ * payload is never copied into a packet sized buffer.
+ */
+static esp_err_t tcp_send_packet(const uint8_t* header, size_t header_len,
+                                 const uint8_t* payload, size_t payload_len) {
+    char cmd[32];
+    esp_err_t ret = ESP_OK;
+
+    // Chunks of one packet must not interleave with another sender
+    sim808_at_lock();
+
+    if (transparent) {
+        // Raw pipe, no CIPSEND framing or size limit
+        ret = sim808_at_write_data(header, header_len);
+        if (ret == ESP_OK && payload_len > 0) {
+            ret = sim808_at_write_data(payload, payload_len);
+        }
+        if (ret == ESP_OK) {
+            last_tx_tick = xTaskGetTickCount();
+        }
+        sim808_at_unlock();
+        return ret;
+    }
+
+    while (ret == ESP_OK && header_len + payload_len > 0) {
+        size_t chunk = 0;
+
+        size_t n = header_len < sizeof(tx_buf) ? header_len : sizeof(tx_buf);
+        memcpy(tx_buf, header, n);
+        header += n;
+        header_len -= n;
+        chunk += n;
+
+        n = payload_len < sizeof(tx_buf) - chunk ? payload_len : sizeof(tx_buf) - chunk;
+        memcpy(tx_buf + chunk, payload, n);
+        payload += n;
+        payload_len -= n;
+        chunk += n;
+
+        snprintf(cmd, sizeof(cmd), "AT+CIPSEND=%u\r\n", (unsigned)chunk);
+        ret = sim808_at_send_data(cmd, ">", tx_buf, chunk, send_ok_finals, 5000);
+    }
+
+    if (ret == ESP_OK) {
+        last_tx_tick = xTaskGetTickCount();
+    }
+    sim808_at_unlock();
+    return ret;
+}
+
+/**
+ * Read pending bytes from the modem (manual receive mode)
+ * @return Number of bytes read, -1 on error
+ */
+static int tcp_read(uint8_t* buf, size_t size) {
+    char cmd[32];
+    size_t len = 0;
+
+    if (transparent) {
+        if (!mqtt_connected && !sim808_at_in_data_mode()) {
+            return -1;
+        }
+        return (int)xStreamBufferReceive(rx_stream, buf, size, pdMS_TO_TICKS(100));
+    }
+
+    if (size > SIM808_CIPSEND_MAX) {
+        size = SIM808_CIPSEND_MAX;
+    }
+
+    snprintf(cmd, sizeof(cmd), "AT+CIPRXGET=2,%u\r\n", (unsigned)size);
+    if (sim808_at_exec_binary(cmd, "+CIPRXGET: 2,", buf, size, &len, 2000) != ESP_OK) {
+        return -1;
+    }
+    return (int)len;
+}
+
+/**
+ * Drop a processed packet from the front of the receive buffer
+ */
+static void rx_consume(size_t len) {
+    memmove(rx_buf, rx_buf + len, rx_len - len);
+    rx_len -= len;
+}
+
+/**
+ * Take the receive buffer (recursive, message handlers may publish)
+ */
+static void rx_lock(void) {
+    xSemaphoreTakeRecursive(rx_mutex, portMAX_DELAY);
+}
+
+/**
+ * Release the receive buffer
+ */
+static void rx_unlock(void) {
+    xSemaphoreGiveRecursive(rx_mutex);
+}
+
+/**
+ * Acknowledge and deliver an inbound PUBLISH
+ */
+static void deliver_publish(const mqtt_packet_t* pkt) {
+    mqtt_publish_t publish;
+    char topic[SIM808_MQTT_TOPIC_MAX + 1];
+
+    if (mqtt_decode_publish(pkt, &publish) != 0) {
+        ESP_LOGW(TAG, "Malformed PUBLISH dropped");
+        return;
+    }
+
+    if (publish.qos > 0) {
+        uint8_t ack[4];
+        int ack_len = mqtt_encode_puback(ack, sizeof(ack), publish.packet_id);
+        tcp_send_packet(ack, ack_len, NULL, 0);
+    }
+
+    if (publish.topic_len > SIM808_MQTT_TOPIC_MAX) {
+        ESP_LOGW(TAG, "Topic too long (%u bytes), message dropped", publish.topic_len);
+        return;
+    }
+    memcpy(topic, publish.topic, publish.topic_len);
+    topic[publish.topic_len] = '\0';
+
+    ESP_LOGI(TAG, "Message received on topic: %s", topic);
+
+    if (message_handler != NULL) {
+        message_handler(topic, (const char*)publish.payload, (int)publish.payload_len);
+    }
+}
+
+/**
+ * Process a packet nobody is waiting for
+ */
+static void process_packet(const mqtt_packet_t* pkt) {
+    uint16_t packet_id;
+
+    switch (pkt->type) {
+        case MQTT_PKT_PUBLISH:
+            deliver_publish(pkt);
+            return;
+
+        case MQTT_PKT_PUBACK:
+            if (mqtt_decode_ack(pkt, &packet_id) == 0 && !session_ack(packet_id)) {
+                ESP_LOGW(TAG, "PUBACK for unknown packet id %u", packet_id);
+            }
+            return;
+
+        case MQTT_PKT_PINGRESP:
+            ping_outstanding = false;
+            return;
+
+        default:
+            ESP_LOGD(TAG, "Dropping packet type %u (%lu bytes)", pkt->type,
+                     (unsigned long)pkt->total_length);
+            return;
+    }
+}
+
+/**
+ * Wait for a packet of a given type, processing anything received before it
+ * On success the packet stays at the front of rx_buf until rx_consume(),
+ * the caller holds rx_lock() across both.
+ */
+static esp_err_t wait_packet(uint8_t type, mqtt_packet_t* pkt, uint32_t timeout_ms) {
+    TickType_t start = xTaskGetTickCount();
+
+    while (1) {
+        int framed = mqtt_decode_packet(rx_buf, rx_len, pkt);
+
+        if (framed > 0) {
+            if (pkt->type == type) {
+                return ESP_OK;
+            }
+            process_packet(pkt);
+            rx_consume(framed);
+            continue;
+        }
+
+        if (framed < 0 || rx_len == sizeof(rx_buf)) {
+            ESP_LOGE(TAG, "Receive stream corrupt or packet too large, resetting");
+            rx_len = 0;
+        }
+
+        if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        int n = tcp_read(rx_buf + rx_len, sizeof(rx_buf) - rx_len);
+        if (n < 0) {
+            return ESP_FAIL;
+        }
+        if (n == 0 && !transparent) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        rx_len += n;
+    }
+}
+
+/**
+ * Read and process everything the broker has sent
+ */
+static void rx_drain(void) {
+    mqtt_packet_t pkt;
+
+    rx_lock();
+    while (mqtt_connected) {
+        int framed = mqtt_decode_packet(rx_buf, rx_len, &pkt);
+        if (framed > 0) {
+            process_packet(&pkt);
+            rx_consume(framed);
+            continue;
+        }
+
+        if (framed < 0 || rx_len == sizeof(rx_buf)) {
+            ESP_LOGE(TAG, "Receive stream corrupt or packet too large, resetting");
+            rx_len = 0;
+        }
+
+        int n = tcp_read(rx_buf + rx_len, sizeof(rx_buf) - rx_len);
+        if (n <= 0) {
+            break;
+        }
+        rx_len += n;
+    }
+    rx_unlock();
+}
+
+/**
+ * Mark the broker connection lost, the receive task reconnects
+ */
+static void connection_lost(const char* reason) {
+    if (mqtt_connected) {
+        ESP_LOGW(TAG, "%s, connection lost", reason);
+        lost_tick = xTaskGetTickCount();
+        mqtt_connected = false;
+    }
+}
+
+/**
+ * Send a PINGREQ once the link has been quiet, drop the session if unanswered
+ */
+static void keepalive_check(void) {
+    TickType_t now = xTaskGetTickCount();
+
+    if (ping_outstanding) {
+        if ((now - ping_sent_tick) >= pdMS_TO_TICKS(SIM808_MQTT_ACK_TIMEOUT_MS)) {
+            ping_outstanding = false;
+            connection_lost("No PINGRESP from broker");
+        }
+        return;
+    }
+
+    // Any packet we send resets the broker's keepalive timer, so only ping when idle
+    if ((now - last_tx_tick) < pdMS_TO_TICKS(SIM808_MQTT_PING_IDLE_MS)) {
+        return;
+    }
+
+    uint8_t packet[2];
+    int packet_len = mqtt_encode_empty(packet, sizeof(packet), MQTT_PKT_PINGREQ);
+    if (tcp_send_packet(packet, packet_len, NULL, 0) == ESP_OK) {
+        ping_outstanding = true;
+        ping_sent_tick = now;
+        ESP_LOGD(TAG, "PINGREQ sent");
+    }
+}
+
+/**
+ * Send the kept publishes again, DUP set, on a new connection
+ */
+static void resend_unacked(void) {
+    int count = 0;
+
+    xSemaphoreTake(resend_mutex, portMAX_DELAY);
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        resend_slot_t* slot = &resend_slots[i];
+        if (slot->packet_id == 0) {
+            continue;
+        }
+        slot->packet[0] |= 0x08;
+        if (tcp_send_packet(slot->packet, slot->len, NULL, 0) != ESP_OK) {
+            break;
+        }
+        count++;
+    }
+    xSemaphoreGive(resend_mutex);
+
+    if (count > 0) {
+        ESP_LOGI(TAG, "Resent %d unacknowledged publishes", count);
+    }
+}
+
+static void close_transparent(void);
+static void confirm_closed(void);
+static esp_err_t connect_broker(sim808_mqtt_config_t* config, bool resume);
+
+/**
+ * Open the lost connection again and let the application resubscribe
+ */
+static esp_err_t reconnect(void) {
+    // Publishes batched for the old connection can't be delivered anymore
+    sim808_mqtt_flush();
+    close_transparent();
+
+    if (connect_broker(&session_config, true) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    resend_unacked();
+    if (connect_handler != NULL) {
+        connect_handler();
+    }
+    return ESP_OK;
+}
+
+/**
+ * Receive task: reads broker traffic when the modem reports it, runs the
+ * keepalive schedule and reconnects a lost connection with backoff
+ */
+static void mqtt_rx_task(void* pvParameters) {
+    TickType_t last_poll = xTaskGetTickCount();
+    uint32_t backoff_ms = SIM808_MQTT_RECONNECT_MIN_MS;
+
+    while (1) {
+        // Woken by the data-available URC, or once per tick for keepalive
+        uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SIM808_MQTT_TICK_MS));
+
+        if (!mqtt_connected) {
+            if (reconnect_wanted &&
+                (xTaskGetTickCount() - lost_tick) >= pdMS_TO_TICKS(backoff_ms)) {
+                ESP_LOGI(TAG, "Reconnecting to broker...");
+                if (reconnect() == ESP_OK) {
+                    backoff_ms = SIM808_MQTT_RECONNECT_MIN_MS;
+                } else {
+                    lost_tick = xTaskGetTickCount();
+                    backoff_ms *= 2;
+                    if (backoff_ms > SIM808_MQTT_RECONNECT_MAX_MS) {
+                        backoff_ms = SIM808_MQTT_RECONNECT_MAX_MS;
+                    }
+                    ESP_LOGW(TAG, "Reconnect failed, next attempt in %lu ms",
+                             (unsigned long)backoff_ms);
+                }
+            }
+            continue;
+        }
+
+        // The URC can be missed while the AT channel is busy, so poll now and then
+        TickType_t now = xTaskGetTickCount();
+        if (notified > 0 || transparent ||
+            (now - last_poll) >= pdMS_TO_TICKS(SIM808_MQTT_RX_POLL_MS)) {
+            last_poll = now;
+            rx_drain();
+        }
+
+        if (transparent && closed_suspect &&
+            (now - closed_tick) >= pdMS_TO_TICKS(SIM808_MQTT_CLOSED_CONFIRM_MS)) {
+            confirm_closed();
+        }
+
+        keepalive_check();
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * URC: broker data waiting in the modem (+CIPRXGET: 1)
+ */
+static void rx_data_urc(const char* line, void* arg) {
+    if (rx_task_handle != NULL) {
+        xTaskNotifyGive(rx_task_handle);
+    }
+}
+
+/**
+ * URC: TCP connection closed by the peer
+ */
+static void closed_urc(const char* line, void* arg) {
+    connection_lost("Broker connection closed");
+}
+
+/**
+ * Create the receive task and URC hooks on first connect
+ */
+static esp_err_t rx_init(void) {
+    if (rx_task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    rx_mutex = xSemaphoreCreateRecursiveMutex();
+    resend_mutex = xSemaphoreCreateMutex();
+    if (rx_mutex == NULL || resend_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(
+        mqtt_rx_task,
+        "sim808_mqtt_rx",
+        SIM808_MQTT_RX_TASK_STACK_SIZE,
+        NULL,
+        SIM808_MQTT_RX_TASK_PRIORITY,
+        &rx_task_handle
+    );
+
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create MQTT receive task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    sim808_at_register_urc("+CIPRXGET: 1", rx_data_urc, NULL);
+    sim808_at_register_urc("CLOSED", closed_urc, NULL);
+    return ESP_OK;
+}
+
+/**
+ * Data mode handler: queue broker bytes and watch for the modem's CLOSED report
+ */
+static void transparent_rx(const uint8_t* data, size_t len, void* arg) {
+    uint8_t out[64];
+    size_t out_len = 0;
+    size_t dropped = 0;
+
+    // Bytes that may be the modem's CLOSED are held back until the next
+    // byte shows they were payload, or confirm_closed() settles it
+    for (size_t i = 0; i < len; i++) {
+        size_t release = 0;     // Held bytes that turned out to be payload
+
+        if (closed_suspect) {
+            closed_suspect = false;
+            release = closed_match;
+            closed_match = 0;
+        }
+        if (data[i] == (uint8_t)closed_marker[closed_match]) {
+            if (++closed_match == sizeof(closed_marker) - 1) {
+                closed_tick = xTaskGetTickCount();
+                closed_suspect = true;
+            }
+        } else {
+            release += closed_match;
+            closed_match = 0;
+        }
+
+        if (out_len + release + 1 > sizeof(out)) {
+            dropped += out_len - xStreamBufferSend(rx_stream, out, out_len, 0);
+            out_len = 0;
+        }
+        memcpy(out + out_len, closed_marker, release);
+        out_len += release;
+        if (closed_match == 0) {
+            if (data[i] == (uint8_t)closed_marker[0]) {
+                closed_match = 1;
+            } else {
+                out[out_len++] = data[i];
+            }
+        }
+    }
+    dropped += out_len - xStreamBufferSend(rx_stream, out, out_len, 0);
+
+    if (dropped > 0) {
+        ESP_LOGW(TAG, "Receive stream full, dropping %u bytes", (unsigned)dropped);
+    }
+    xTaskNotifyGive(rx_task_handle);
+}
+
+/**
+ * Settle a CLOSED held back by transparent_rx(). The modem sends it on
+ * its way back to command mode, where +++ gets no OK; if the escape
+ * works the connection is still up and the bytes were payload
+ */
+static void confirm_closed(void) {
+    if (sim808_at_escape_data_mode() != ESP_OK) {
+        closed_suspect = false;
+        closed_match = 0;
+        sim808_at_leave_data_mode();
+        connection_lost("Broker connection closed");
+        return;
+    }
+
+    // Nothing reaches transparent_rx() while escaped
+    if (closed_suspect) {
+        closed_suspect = false;
+        closed_match = 0;
+        xStreamBufferSend(rx_stream, closed_marker, sizeof(closed_marker) - 1, 0);
+    }
+    if (sim808_at_resume_data_mode() != ESP_OK) {
+        sim808_at_leave_data_mode();
+        connection_lost("Broker connection closed");
+    }
+}
+
+/**
+ * Open the TCP connection in transparent mode
+ */
+static esp_err_t open_transparent(const char* cmd) {
+    if (rx_stream == NULL) {
+        rx_stream = xStreamBufferCreate(SIM808_MQTT_RX_BUF_SIZE * 2, 1);
+        if (rx_stream == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xStreamBufferReset(rx_stream);
+    closed_match = 0;
+    closed_suspect = false;
+
+    // NMEA output would be mixed into the data pipe, unless it has a channel of its own
+    gnss_was_streaming = !sim808_at_has_data_channel() && sim808_gps_is_streaming();
+    if (gnss_was_streaming) {
+        sim808_gps_stream_stop();
+    }
+
+    esp_err_t ret = sim808_at_enter_data_mode(cmd, NULL, transparent_rx, NULL, 20000);
+    if (ret != ESP_OK && gnss_was_streaming) {
+        sim808_gps_stream_start(NULL, NULL);
+    }
+    return ret;
+}
+
+/**
+ * Leave a transparent session that ended without sim808_mqtt_disconnect()
+ */
+static void close_transparent(void) {
+    if (!transparent) {
+        return;
+    }
+    if (sim808_at_in_data_mode()) {
+        sim808_at_escape_data_mode();
+        sim808_at_leave_data_mode();
+    }
+    if (gnss_was_streaming) {
+        sim808_gps_stream_start(NULL, NULL);
+        gnss_was_streaming = false;
+    }
+}
+
+/**
+ * Open the TCP connection and the MQTT session
+ * A resumed connection keeps the publishes still waiting for their PUBACK.
+ */
+static esp_err_t connect_broker(sim808_mqtt_config_t* config, bool resume) {
+    char response[256];
+    char cmd[256];
+
+    if (!sim808_gprs_is_connected()) {
+        ESP_LOGE(TAG, "GPRS is not connected");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGI(TAG, "Connecting to MQTT broker (RabbitMQ)...");
+
+    if (rx_init() != ESP_OK) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Initialize TCP/IP application
+    static const char* const shut_finals[] = { "SHUT OK", NULL };
+    sim808_at_exec("AT+CIPSHUT\r\n", shut_finals, response, sizeof(response), 2000, NULL);
+
+    // Set single connection mode
+    sim808_send_command("AT+CIPMUX=0\r\n", response, sizeof(response), 2000);
+
+    snprintf(cmd, sizeof(cmd), "AT+CIPSTART=\"TCP\",\"%s\",%d\r\n",
+             config->broker, config->port);
+
+    transparent = SIM808_MQTT_TRANSPARENT;
+    if (transparent) {
+        // The UART becomes a raw pipe to the broker once CIPSTART says CONNECT
+        sim808_send_command("AT+CIPMODE=1\r\n", response, sizeof(response), 2000);
+
+        if (open_transparent(cmd) != ESP_OK) {
+            ESP_LOGE(TAG, "TCP connection failed");
+            return ESP_FAIL;
+        }
+    } else {
+        sim808_send_command("AT+CIPMODE=0\r\n", response, sizeof(response), 2000);
+
+        // Manual receive, so broker traffic is read with AT+CIPRXGET instead of
+        // being pushed into the AT stream
+        sim808_send_command("AT+CIPRXGET=1\r\n", response, sizeof(response), 2000);
+
+        // Start TCP connection to MQTT broker, "OK" is only an intermediate here
+        static const char* const connect_finals[] = { "CONNECT OK", "ALREADY CONNECT", NULL };
+        if (sim808_at_exec(cmd, connect_finals, response, sizeof(response), 20000, NULL) != ESP_OK) {
+            ESP_LOGE(TAG, "TCP connection failed");
+            return ESP_FAIL;
+        }
+    }
+
+    rx_lock();
+    if (resume) {
+        session_resume();
+    } else {
+        session_reset();
+    }
+    rx_len = 0;
+    ping_outstanding = false;
+
+    // Build MQTT CONNECT packet
+    mqtt_connect_options_t options = {
+        .client_id = config->client_id,
+        .username = config->username,
+        .password = config->password,
+        .keepalive = SIM808_MQTT_KEEPALIVE,
+        .clean_session = true,
+    };
+
+    uint8_t packet[256];
+    int packet_len = mqtt_encode_connect(packet, sizeof(packet), &options);
+    if (packet_len < 0) {
+        rx_unlock();
+        ESP_LOGE(TAG, "Failed to encode CONNECT (%d)", packet_len);
+        return ESP_FAIL;
+    }
+
+    if (tcp_send_packet(packet, packet_len, NULL, 0) != ESP_OK) {
+        rx_unlock();
+        ESP_LOGE(TAG, "MQTT connection failed");
+        return ESP_FAIL;
+    }
+
+    // Wait for CONNACK
+    mqtt_packet_t pkt;
+    if (wait_packet(MQTT_PKT_CONNACK, &pkt, SIM808_MQTT_ACK_TIMEOUT_MS) != ESP_OK) {
+        rx_unlock();
+        ESP_LOGE(TAG, "No CONNACK from broker");
+        return ESP_FAIL;
+    }
+
+    bool session_present = false;
+    uint8_t return_code = 0xFF;
+    int decoded = mqtt_decode_connack(&pkt, &session_present, &return_code);
+    rx_consume(pkt.total_length);
+    rx_unlock();
+
+    if (decoded != 0 || return_code != MQTT_CONNACK_ACCEPTED) {
+        ESP_LOGE(TAG, "MQTT connection refused: %s", mqtt_connack_reason(return_code));
+        return ESP_FAIL;
+    }
+
+    // Kept for reconnects (config may already point at it)
+    memmove(&session_config, config, sizeof(session_config));
+    reconnect_wanted = true;
+
+    mqtt_connected = true;
+    ESP_LOGI(TAG, "MQTT connected to RabbitMQ");
+    return ESP_OK;
+}
+
+/**
+ * Connect to MQTT broker (RabbitMQ)
+ */
+esp_err_t sim808_mqtt_connect(sim808_mqtt_config_t* config) {
+    return connect_broker(config, false);
+}
+
+/**
+ * Disconnect from MQTT broker
+ */
+esp_err_t sim808_mqtt_disconnect(void) {
+    char response[128];
+
+    reconnect_wanted = false;
+
+    // Don't drop publishes still waiting for their batch window
+    sim808_mqtt_flush();
+
+    // Send MQTT DISCONNECT packet
+    uint8_t packet[2];
+    int packet_len = mqtt_encode_empty(packet, sizeof(packet), MQTT_PKT_DISCONNECT);
+    tcp_send_packet(packet, packet_len, NULL, 0);
+
+    mqtt_connected = false;
+
+    // Close TCP connection, from command mode in transparent mode
+    if (transparent) {
+        sim808_at_escape_data_mode();
+    }
+    static const char* const close_finals[] = { "CLOSE OK", NULL };
+    sim808_at_exec("AT+CIPCLOSE\r\n", close_finals, response, sizeof(response), 5000, NULL);
+
+    if (transparent) {
+        sim808_at_leave_data_mode();
+        if (gnss_was_streaming) {
+            sim808_gps_stream_start(NULL, NULL);
+            gnss_was_streaming = false;
+        }
+    }
+
+    ESP_LOGI(TAG, "MQTT disconnected");
+    return ESP_OK;
+}
+
+/**
+ * Publish message to MQTT topic
+ */
+esp_err_t sim808_mqtt_publish(const char* topic, const char* payload) {
+    return sim808_mqtt_publish_qos(topic, payload, strlen(payload), 0);
+}
+
+/**
+ * Publish message with QoS
+ */
+esp_err_t sim808_mqtt_publish_qos(const char* topic, const void* payload, size_t len, int qos) {
+    if (!mqtt_connected) {
+        ESP_LOGW(TAG, "MQTT is not connected");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t packet_id = 0;
+    if (qos > 0) {
+        // All slots taken: collect outstanding PUBACKs before sending more
+        if (session_inflight() >= MQTT_INFLIGHT_MAX) {
+            mqtt_packet_t pkt;
+            rx_lock();
+            if (wait_packet(MQTT_PKT_PUBACK, &pkt, SIM808_MQTT_ACK_TIMEOUT_MS) == ESP_OK) {
+                process_packet(&pkt);
+                rx_consume(pkt.total_length);
+            }
+            rx_unlock();
+        }
+        packet_id = session_next_id(true);
+        if (packet_id == 0) {
+            ESP_LOGE(TAG, "Too many unacknowledged publishes");
+            return ESP_FAIL;
+        }
+    }
+
+    uint8_t header[MQTT_MAX_FIXED_HEADER + 2 + SIM808_MQTT_TOPIC_MAX + 2];
+    int header_len = mqtt_encode_publish_header(header, sizeof(header), topic, len,
+                                                qos, false, packet_id);
+    if (header_len < 0) {
+        ESP_LOGE(TAG, "Failed to encode PUBLISH for %s (%d)", topic, header_len);
+        session_ack(packet_id);
+        return ESP_FAIL;
+    }
+
+    if (packet_id != 0) {
+        resend_keep(packet_id, header, header_len, payload, len);
+    }
+    if (tcp_send_packet(header, header_len, payload, len) == ESP_OK) {
+        ESP_LOGD(TAG, "Published %u bytes to %s (qos %d)", (unsigned)len, topic, qos);
+        return ESP_OK;
+    }
+
+    session_ack(packet_id);
+    ESP_LOGE(TAG, "Publish failed");
+    return ESP_FAIL;
+}
+
+/**
+ * Subscribe to MQTT topic
+ */
+esp_err_t sim808_mqtt_subscribe(const char* topic) {
+    if (!mqtt_connected) {
+        ESP_LOGW(TAG, "MQTT is not connected");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t packet[256];
+    uint16_t packet_id = session_next_id(false);
+    int packet_len = mqtt_encode_subscribe(packet, sizeof(packet), packet_id, topic, 1);
+    if (packet_len < 0) {
+        ESP_LOGE(TAG, "Failed to encode SUBSCRIBE for %s (%d)", topic, packet_len);
+        return ESP_FAIL;
+    }
+
+    // Hold the receive buffer so the receive task can't swallow the SUBACK
+    rx_lock();
+
+    if (tcp_send_packet(packet, packet_len, NULL, 0) != ESP_OK) {
+        rx_unlock();
+        ESP_LOGE(TAG, "Subscribe failed");
+        return ESP_FAIL;
+    }
+
+    mqtt_packet_t pkt;
+    if (wait_packet(MQTT_PKT_SUBACK, &pkt, SIM808_MQTT_ACK_TIMEOUT_MS) != ESP_OK) {
+        rx_unlock();
+        ESP_LOGE(TAG, "No SUBACK for %s", topic);
+        return ESP_FAIL;
+    }
+
+    uint16_t ack_id = 0;
+    uint8_t granted = 0x80;
+    mqtt_decode_suback(&pkt, &ack_id, &granted);
+    rx_consume(pkt.total_length);
+    rx_unlock();
+
+    if (ack_id != packet_id || granted == 0x80) {
+        ESP_LOGE(TAG, "Subscription to %s rejected", topic);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Subscribed to topic: %s (qos %u)", topic, granted);
+    return ESP_OK;
+}
+
+/**
+ * Set the handler for inbound PUBLISH messages
+ */
+void sim808_mqtt_set_message_handler(sim808_mqtt_message_handler_t handler) {
+    message_handler = handler;
+}
+
+/**
+ * Set the handler run after an automatic reconnect
+ */
+void sim808_mqtt_set_connect_handler(sim808_mqtt_connect_handler_t handler) {
+    connect_handler = handler;
+}
+
+/**
+ * Check if MQTT is connected
+ */
+bool sim808_mqtt_is_connected(void) {
+    return mqtt_connected;
+}
+
+/**
+ * Get number of unacknowledged QoS 1 publishes
+ */
+int sim808_mqtt_inflight(void) {
+    return session_inflight();
+}
+
+/**
+ * Hand a batched message back to its callback, decoded from batch_buf
+ */
+static void batch_complete(const batch_entry_t* entry, esp_err_t result) {
+    mqtt_packet_t pkt;
+    mqtt_publish_t publish;
+    char topic[SIM808_MQTT_TOPIC_MAX + 1];
+
+    // Encoded by us and length checked on the way in, so this can't fail
+    mqtt_decode_packet(batch_buf + entry->offset, batch_len - entry->offset, &pkt);
+    mqtt_decode_publish(&pkt, &publish);
+    memcpy(topic, publish.topic, publish.topic_len);
+    topic[publish.topic_len] = '\0';
+
+    entry->callback(result, topic, publish.payload, publish.payload_len, entry->arg);
+}
+
+/**
+ * Send everything queued in the batch as one CIPSEND (batch_mutex held)
+ */
+static esp_err_t batch_flush_locked(void) {
+    if (batch_count == 0) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = tcp_send_packet(batch_buf, batch_len, NULL, 0);
+
+    batch_stats.sends++;
+    batch_stats.handshakes_saved += batch_count - 1;
+    if (ret != ESP_OK) {
+        batch_stats.failed_messages += batch_count;
+    }
+
+    for (int i = 0; i < batch_count; i++) {
+        if (ret != ESP_OK) {
+            session_ack(batch_entries[i].packet_id);
+        }
+        if (batch_entries[i].callback != NULL) {
+            batch_complete(&batch_entries[i], ret);
+        }
+    }
+
+    ESP_LOGD(TAG, "Flushed %d publishes (%u bytes) in one CIPSEND", batch_count, (unsigned)batch_len);
+    batch_count = 0;
+    batch_len = 0;
+    return ret;
+}
+
+/**
+ * Batch task: flushes the batch once its window has passed
+ */
+static void batch_task(void* pvParameters) {
+    while (1) {
+        // Woken by the first publish of a new batch
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(SIM808_BATCH_WINDOW_MS));
+
+        xSemaphoreTake(batch_mutex, portMAX_DELAY);
+        batch_flush_locked();
+        xSemaphoreGive(batch_mutex);
+    }
+
+    vTaskDelete(NULL);
+}
+
+/**
+ * Create batching resources on first use
+ */
+static esp_err_t batch_init(void) {
+    if (batch_task_handle != NULL) {
+        return ESP_OK;
+    }
+
+    batch_mutex = xSemaphoreCreateMutex();
+    if (batch_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(
+        batch_task,
+        "sim808_batch",
+        SIM808_BATCH_TASK_STACK_SIZE,
+        NULL,
+        SIM808_BATCH_TASK_PRIORITY,
+        &batch_task_handle
+    );
+
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create batch task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Queue a publish for the next batched CIPSEND
+ */
+esp_err_t sim808_mqtt_publish_batched(const char* topic, const void* payload, size_t len, int qos,
+                                      sim808_publish_cb_t callback, void* arg) {
+    if (!mqtt_connected) {
+        ESP_LOGW(TAG, "MQTT is not connected");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (strlen(topic) > SIM808_MQTT_TOPIC_MAX) {
+        ESP_LOGE(TAG, "Topic too long for a batched publish: %s", topic);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = batch_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(batch_mutex, portMAX_DELAY);
+
+    uint16_t packet_id = 0;
+    if (qos > 0) {
+        packet_id = session_next_id(true);
+        if (packet_id == 0) {
+            xSemaphoreGive(batch_mutex);
+            ESP_LOGE(TAG, "Too many unacknowledged publishes");
+            return ESP_FAIL;
+        }
+    }
+
+    // Encode in place; if it doesn't fit, flush what's queued and retry
+    int packet_len = mqtt_encode_publish(batch_buf + batch_len, sizeof(batch_buf) - batch_len,
+                                         topic, payload, len, qos, false, packet_id);
+    if ((packet_len == MQTT_CODEC_ERR_BUFFER || batch_count == SIM808_BATCH_MAX_MESSAGES) &&
+        batch_count > 0) {
+        batch_flush_locked();
+        packet_len = mqtt_encode_publish(batch_buf, sizeof(batch_buf), topic, payload, len,
+                                         qos, false, packet_id);
+    }
+
+    if (packet_len == MQTT_CODEC_ERR_BUFFER) {
+        // Larger than one CIPSEND on its own: send it directly, still in order
+        session_ack(packet_id);
+        xSemaphoreGive(batch_mutex);
+        ret = sim808_mqtt_publish_qos(topic, payload, len, qos);
+        if (callback != NULL) {
+            callback(ret, topic, payload, len, arg);
+        }
+        return ret;
+    }
+
+    if (packet_len < 0) {
+        session_ack(packet_id);
+        xSemaphoreGive(batch_mutex);
+        ESP_LOGE(TAG, "Failed to encode PUBLISH for %s (%d)", topic, packet_len);
+        return ESP_FAIL;
+    }
+
+    batch_entries[batch_count].callback = callback;
+    batch_entries[batch_count].arg = arg;
+    batch_entries[batch_count].packet_id = packet_id;
+    batch_entries[batch_count].offset = (uint16_t)batch_len;
+    if (packet_id != 0) {
+        resend_keep(packet_id, batch_buf + batch_len, packet_len, NULL, 0);
+    }
+    batch_count++;
+    batch_len += packet_len;
+    batch_stats.messages++;
+
+    bool first = (batch_count == 1);
+    xSemaphoreGive(batch_mutex);
+
+    if (first) {
+        xTaskNotifyGive(batch_task_handle);
+    }
+    return ESP_OK;
+}
+
+/**
+ * Send queued publishes now
+ */
+esp_err_t sim808_mqtt_flush(void) {
+    if (batch_mutex == NULL) {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(batch_mutex, portMAX_DELAY);
+    esp_err_t ret = batch_flush_locked();
+    xSemaphoreGive(batch_mutex);
+    return ret;
+}
+
+/**
+ * Get publish batching statistics
+ */
+void sim808_mqtt_get_batch_stats(sim808_batch_stats_t* stats) {
+    if (batch_mutex == NULL) {
+        *stats = batch_stats;
+        return;
+    }
+    xSemaphoreTake(batch_mutex, portMAX_DELAY);
+    *stats = batch_stats;
+    xSemaphoreGive(batch_mutex);
+}
@@ -0,0 +1,359 @@
+#include "sim808_ppp.h"
+#include "sim808_at.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif_ppp.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "SIM808_PPP";
+
+#define PPP_CONNECTED_BIT   (1 << 0)
+#define PPP_STOPPED_BIT     (1 << 1)
+#define PPP_REDIAL_BIT      (1 << 2)    // Session lost while it should be up
+
+// esp_netif IO driver, esp_netif expects the base as the first member
+typedef struct {
+    esp_netif_driver_base_t base;
+} ppp_driver_t;
+
+static ppp_driver_t ppp_driver = {0};
+static esp_netif_t* ppp_netif = NULL;
+static EventGroupHandle_t ppp_events = NULL;
+static bool ppp_connected = false;
+static bool gnss_was_streaming = false;
+
+// Redial supervisor: keeps the link up between sim808_ppp_start() and
+// sim808_ppp_stop()
+static SemaphoreHandle_t link_mutex = NULL;    // Serializes dial and hangup
+static TaskHandle_t supervisor_handle = NULL;
+static sim808_gprs_config_t link_config;
+static volatile bool ppp_wanted = false;
+static uint32_t redial_count = 0;
+
+/**
+ * Netif transmit: write one PPP frame to the modem (lwIP task)
+ */
+static esp_err_t ppp_transmit(void* h, void* buffer, size_t len) {
+    // During an AT escape the frame is dropped, PPP/TCP retransmit it
+    if (sim808_at_write_data(buffer, len) != ESP_OK) {
+        ESP_LOGD(TAG, "Link in command mode, dropped %u byte frame", (unsigned)len);
+    }
+    return ESP_OK;
+}
+
+/**
+ * Data mode handler: hand received bytes to the PPP stack (AT RX task)
+ */
+static void ppp_rx(const uint8_t* data, size_t len, void* arg) {
+    esp_netif_receive(ppp_netif, (void*)data, len, NULL);
+}
+
+/**
+ * Connect the driver to the netif once esp_netif_attach() runs
+ */
+static esp_err_t ppp_post_attach(esp_netif_t* netif, esp_netif_iodriver_handle h) {
+    ppp_driver_t* driver = (ppp_driver_t*)h;
+    driver->base.netif = netif;
+
+    const esp_netif_driver_ifconfig_t ifconfig = {
+        .handle = h,
+        .transmit = ppp_transmit,
+    };
+    return esp_netif_set_driver_config(netif, &ifconfig);
+}
+
+/**
+ * IP events of the PPP netif
+ */
+static void on_ip_event(void* arg, esp_event_base_t event_base,
+                        int32_t event_id, void* event_data) {
+    if (event_id == IP_EVENT_PPP_GOT_IP) {
+        ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
+        if (event->esp_netif != ppp_netif) {
+            return;
+        }
+        ESP_LOGI(TAG, "PPP connected with IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        ppp_connected = true;
+        xEventGroupSetBits(ppp_events, PPP_CONNECTED_BIT);
+    } else if (event_id == IP_EVENT_PPP_LOST_IP) {
+        ESP_LOGW(TAG, "PPP lost IP address");
+        ppp_connected = false;
+        xEventGroupClearBits(ppp_events, PPP_CONNECTED_BIT);
+    }
+}
+
+/**
+ * PPP status events, every error ends the session
+ */
+static void on_ppp_status(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data) {
+    if (event_id == NETIF_PPP_ERRORNONE || event_id >= NETIF_PP_PHASE_OFFSET) {
+        return;
+    }
+
+    if (event_id == NETIF_PPP_ERRORUSER) {
+        ESP_LOGI(TAG, "PPP closed");
+    } else {
+        // Carrier loss, LCP echo timeout, auth failure...: the modem is back
+        // in command mode, so stop routing its output into PPP
+        ESP_LOGW(TAG, "PPP session ended (error %ld)", (long)event_id);
+        sim808_at_leave_data_mode();
+    }
+
+    ppp_connected = false;
+    xEventGroupClearBits(ppp_events, PPP_CONNECTED_BIT);
+    xEventGroupSetBits(ppp_events, PPP_STOPPED_BIT);
+
+    if (event_id != NETIF_PPP_ERRORUSER && ppp_wanted) {
+        xEventGroupSetBits(ppp_events, PPP_REDIAL_BIT);
+    }
+}
+
+/**
+ * Create the PPP netif and register its event handlers
+ */
+static esp_err_t ppp_init(void) {
+    esp_netif_init();
+
+    // WiFi may already have created the default loop
+    esp_err_t ret = esp_event_loop_create_default();
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to create event loop");
+        return ret;
+    }
+
+    ppp_events = xEventGroupCreate();
+    link_mutex = xSemaphoreCreateMutex();
+    if (ppp_events == NULL || link_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_netif_config_t netif_config = ESP_NETIF_DEFAULT_PPP();
+    ppp_netif = esp_netif_new(&netif_config);
+    if (ppp_netif == NULL) {
+        ESP_LOGE(TAG, "Failed to create PPP netif");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ppp_driver.base.post_attach = ppp_post_attach;
+    ret = esp_netif_attach(ppp_netif, &ppp_driver);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to attach PPP driver");
+        return ret;
+    }
+
+    esp_netif_ppp_config_t ppp_params = {
+        .ppp_phase_event_enabled = false,
+        .ppp_error_event_enabled = true,
+    };
+    esp_netif_ppp_set_params(ppp_netif, &ppp_params);
+
+    esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, on_ip_event, NULL);
+    esp_event_handler_register(NETIF_PPP_STATUS, ESP_EVENT_ANY_ID, on_ppp_status, NULL);
+
+    return ESP_OK;
+}
+
+/**
+ * Hang up the data call and give the UART back to AT commands
+ * @param terminate_lcp Close PPP first (skipped when the session already died)
+ */
+static void ppp_hangup(bool terminate_lcp) {
+    char response[64];
+
+    if (terminate_lcp) {
+        // Terminate LCP, the modem normally hangs up after it
+        xEventGroupClearBits(ppp_events, PPP_STOPPED_BIT);
+        esp_netif_action_stop(ppp_netif, 0, 0, NULL);
+        xEventGroupWaitBits(ppp_events, PPP_STOPPED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(5000));
+    }
+
+    // Make sure the call is down even if it didn't
+    sim808_at_escape_data_mode();
+    sim808_at_leave_data_mode();
+    sim808_send_command("ATH\r\n", response, sizeof(response), 5000);
+
+    ppp_connected = false;
+
+    if (gnss_was_streaming) {
+        sim808_gps_stream_start(NULL, NULL);
+        gnss_was_streaming = false;
+    }
+}
+
+/**
+ * Dial with link_config and wait for an IP address (link_mutex held)
+ */
+static esp_err_t ppp_dial(void) {
+    char response[128];
+    char cmd[128];
+
+    ESP_LOGI(TAG, "Starting PPP (APN: %s)...", link_config.apn);
+
+    snprintf(cmd, sizeof(cmd), "AT+CGDCONT=1,\"IP\",\"%s\"\r\n", link_config.apn);
+    if (sim808_send_command(cmd, response, sizeof(response), 2000) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set PDP context");
+        return ESP_FAIL;
+    }
+
+    if (link_config.username[0] != '\0') {
+        esp_netif_ppp_set_auth(ppp_netif, NETIF_PPP_AUTHTYPE_PAP,
+                               link_config.username, link_config.password);
+    } else {
+        esp_netif_ppp_set_auth(ppp_netif, NETIF_PPP_AUTHTYPE_NONE, NULL, NULL);
+    }
+
+    // NMEA output would be mixed into the PPP frames, unless PPP has a channel of its own
+    gnss_was_streaming = !sim808_at_has_data_channel() && sim808_gps_is_streaming();
+    if (gnss_was_streaming) {
+        sim808_gps_stream_stop();
+    }
+
+    xEventGroupClearBits(ppp_events, PPP_CONNECTED_BIT | PPP_STOPPED_BIT);
+
+    if (sim808_at_enter_data_mode("ATD*99***1#\r\n", NULL, ppp_rx, NULL,
+                                  SIM808_PPP_DIAL_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGE(TAG, "Data call refused");
+        if (gnss_was_streaming) {
+            sim808_gps_stream_start(NULL, NULL);
+            gnss_was_streaming = false;
+        }
+        return ESP_FAIL;
+    }
+
+    esp_netif_action_start(ppp_netif, 0, 0, NULL);
+
+    EventBits_t bits = xEventGroupWaitBits(ppp_events, PPP_CONNECTED_BIT | PPP_STOPPED_BIT,
+                                           pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(SIM808_PPP_CONNECT_TIMEOUT_MS));
+    if (!(bits & PPP_CONNECTED_BIT)) {
+        ESP_LOGE(TAG, "PPP negotiation failed");
+        ppp_hangup(!(bits & PPP_STOPPED_BIT));
+        return (bits & PPP_STOPPED_BIT) ? ESP_FAIL : ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * Redial supervisor: after a session ends on an error (carrier loss, LCP
+ * echo timeout) hang up and dial again, backing off while dialing fails
+ */
+static void ppp_supervisor_task(void* pvParameters) {
+    while (1) {
+        xEventGroupWaitBits(ppp_events, PPP_REDIAL_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
+
+        uint32_t backoff_ms = SIM808_PPP_REDIAL_MIN_MS;
+        bool hung_up = false;
+
+        while (ppp_wanted) {
+            xSemaphoreTake(link_mutex, portMAX_DELAY);
+            if (!hung_up) {
+                // The session is already dead, only the call is left
+                ppp_hangup(false);
+                hung_up = true;
+            }
+            xSemaphoreGive(link_mutex);
+
+            ESP_LOGW(TAG, "Redialing in %lu ms", (unsigned long)backoff_ms);
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+
+            xSemaphoreTake(link_mutex, portMAX_DELAY);
+            esp_err_t ret = ESP_FAIL;
+            if (ppp_wanted) {
+                // A failed attempt reports its own error, the retry below covers it
+                xEventGroupClearBits(ppp_events, PPP_REDIAL_BIT);
+                ret = ppp_dial();
+            }
+            xSemaphoreGive(link_mutex);
+
+            if (ret == ESP_OK) {
+                redial_count++;
+                ESP_LOGI(TAG, "PPP redialed (%lu redials)", (unsigned long)redial_count);
+                break;
+            }
+
+            backoff_ms *= 2;
+            if (backoff_ms > SIM808_PPP_REDIAL_MAX_MS) {
+                backoff_ms = SIM808_PPP_REDIAL_MAX_MS;
+            }
+        }
+    }
+}
+
+/**
+ * Start PPP link
+ */
+esp_err_t sim808_ppp_start(const sim808_gprs_config_t* config) {
+    if (ppp_netif == NULL && ppp_init() != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+
+    if (ppp_connected) {
+        xSemaphoreGive(link_mutex);
+        return ESP_OK;
+    }
+
+    link_config = *config;
+    esp_err_t ret = ppp_dial();
+    if (ret == ESP_OK) {
+        ppp_wanted = true;
+        xEventGroupClearBits(ppp_events, PPP_REDIAL_BIT);
+    }
+
+    xSemaphoreGive(link_mutex);
+
+    if (ret == ESP_OK && supervisor_handle == NULL &&
+        xTaskCreate(ppp_supervisor_task, "ppp_supervisor", SIM808_PPP_TASK_STACK_SIZE, NULL,
+                    SIM808_PPP_TASK_PRIORITY, &supervisor_handle) != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create redial task, a lost link stays down");
+    }
+
+    return ret;
+}
+
+/**
+ * Stop PPP link
+ */
+esp_err_t sim808_ppp_stop(void) {
+    if (ppp_netif == NULL) {
+        return ESP_OK;
+    }
+
+    // Stop the supervisor from redialing, then wait out an attempt in progress
+    ppp_wanted = false;
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+    ppp_hangup(true);
+    xEventGroupClearBits(ppp_events, PPP_REDIAL_BIT);
+    xSemaphoreGive(link_mutex);
+
+    ESP_LOGI(TAG, "PPP stopped");
+    return ESP_OK;
+}
+
+/**
+ * Get the number of times the supervisor brought a lost link back
+ */
+uint32_t sim808_ppp_get_redial_count(void) {
+    return redial_count;
+}
+
+/**
+ * Check if PPP is connected
+ */
+bool sim808_ppp_is_connected(void) {
+    return ppp_connected;
+}
+
+/**
+ * Get PPP netif
+ */
+esp_netif_t* sim808_ppp_get_netif(void) {
+    return ppp_netif;
+}
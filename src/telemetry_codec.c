@@ -0,0 +1,419 @@
+#include "telemetry_codec.h"
+#include <math.h>
+#include <string.h>
+
+// Write position, overflow sticks until the caller checks it
+typedef struct {
+    uint8_t* p;
+    uint8_t* end;
+    bool overflow;
+} writer_t;
+
+// Read position, any short read marks the message malformed
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool error;
+} reader_t;
+
+/**
+ * Write one byte
+ */
+static void put_u8(writer_t* w, uint8_t value) {
+    if (w->p >= w->end) {
+        w->overflow = true;
+        return;
+    }
+    *w->p++ = value;
+}
+
+/**
+ * Write an unsigned varint
+ */
+static void put_varint(writer_t* w, uint64_t value) {
+    uint8_t tmp[TELEMETRY_MAX_VARINT];
+    int n = telemetry_encode_varint(value, tmp);
+    if (w->end - w->p < n) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, tmp, n);
+    w->p += n;
+}
+
+/**
+ * Scale a float to its fixed point value
+ */
+static int64_t to_fixed(float value, int32_t scale) {
+    return isfinite(value) ? llround((double)value * scale) : 0;
+}
+
+/**
+ * Write a float as a zigzag fixed point varint
+ */
+static void put_fixed(writer_t* w, float value, int32_t scale) {
+    put_varint(w, telemetry_zigzag(to_fixed(value, scale)));
+}
+
+/**
+ * Write a length-prefixed string
+ */
+static void put_string(writer_t* w, const char* str, size_t max_len) {
+    size_t len = strnlen(str, max_len);
+    put_varint(w, len);
+    if ((size_t)(w->end - w->p) < len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, str, len);
+    w->p += len;
+}
+
+/**
+ * Write version, type and timestamp
+ */
+static writer_t begin_message(uint8_t* buf, size_t size, telemetry_msg_type_t type,
+                              uint64_t timestamp_ms) {
+    writer_t w = { .p = buf, .end = buf + size, .overflow = false };
+    put_u8(&w, TELEMETRY_CODEC_VERSION);
+    put_u8(&w, type);
+    put_varint(&w, timestamp_ms);
+    return w;
+}
+
+/**
+ * Message length or the overflow error
+ */
+static int end_message(const writer_t* w, const uint8_t* buf) {
+    if (w->overflow) {
+        return TELEMETRY_CODEC_ERR_BUFFER;
+    }
+    return (int)(w->p - buf);
+}
+
+/**
+ * Read one byte
+ */
+static uint8_t get_u8(reader_t* r) {
+    if (r->p >= r->end) {
+        r->error = true;
+        return 0;
+    }
+    return *r->p++;
+}
+
+/**
+ * Read an unsigned varint
+ */
+static uint64_t get_varint(reader_t* r) {
+    uint64_t value = 0;
+    int n = telemetry_decode_varint(r->p, r->end - r->p, &value);
+    if (n < 0) {
+        r->error = true;
+        return 0;
+    }
+    r->p += n;
+    return value;
+}
+
+/**
+ * Read a zigzag fixed point varint back into a float
+ */
+static float get_fixed(reader_t* r, int32_t scale) {
+    return (float)((double)telemetry_unzigzag(get_varint(r)) / scale);
+}
+
+/**
+ * Read a length-prefixed string into a NUL terminated buffer
+ */
+static void get_string(reader_t* r, char* out, size_t size) {
+    uint64_t len = get_varint(r);
+    if (r->error || len >= size || len > (uint64_t)(r->end - r->p)) {
+        r->error = true;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, r->p, len);
+    out[len] = '\0';
+    r->p += len;
+}
+
+/**
+ * Encode an unsigned varint
+ */
+int telemetry_encode_varint(uint64_t value, uint8_t* out) {
+    int len = 0;
+
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value > 0) {
+            byte |= 0x80;
+        }
+        out[len++] = byte;
+    } while (value > 0);
+
+    return len;
+}
+
+/**
+ * Decode an unsigned varint
+ */
+int telemetry_decode_varint(const uint8_t* in, size_t len, uint64_t* value) {
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < len && i < TELEMETRY_MAX_VARINT; i++) {
+        result |= (uint64_t)(in[i] & 0x7F) << (7 * i);
+        if ((in[i] & 0x80) == 0) {
+            *value = result;
+            return (int)i + 1;
+        }
+    }
+    return TELEMETRY_CODEC_ERR_MALFORMED;
+}
+
+/**
+ * Write the fields of a location, status or battery reading
+ */
+static void put_location(writer_t* w, const telemetry_location_t* location) {
+    put_fixed(w, location->latitude, TELEMETRY_COORD_SCALE);
+    put_fixed(w, location->longitude, TELEMETRY_COORD_SCALE);
+    put_fixed(w, location->altitude, TELEMETRY_ALTITUDE_SCALE);
+}
+
+static void put_status(writer_t* w, const telemetry_status_t* status) {
+    uint8_t flags = 0;
+    if (status->is_active) flags |= TELEMETRY_STATUS_ACTIVE;
+    if (status->is_locked) flags |= TELEMETRY_STATUS_LOCKED;
+    if (status->is_killed) flags |= TELEMETRY_STATUS_KILLED;
+    put_u8(w, flags);
+}
+
+static void put_battery(writer_t* w, const telemetry_battery_t* battery) {
+    put_fixed(w, battery->voltage, TELEMETRY_VOLTAGE_SCALE);
+    put_fixed(w, battery->battery_level, TELEMETRY_LEVEL_SCALE);
+}
+
+/**
+ * Encode realtime.location
+ */
+int telemetry_encode_location(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                              const telemetry_location_t* location) {
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_LOCATION, timestamp_ms);
+    put_location(&w, location);
+    return end_message(&w, buf);
+}
+
+/**
+ * Encode realtime.status
+ */
+int telemetry_encode_status(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                            const telemetry_status_t* status) {
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_STATUS, timestamp_ms);
+    put_status(&w, status);
+    return end_message(&w, buf);
+}
+
+/**
+ * Encode realtime.battery
+ */
+int telemetry_encode_battery(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                             const telemetry_battery_t* battery) {
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_BATTERY, timestamp_ms);
+    put_battery(&w, battery);
+    return end_message(&w, buf);
+}
+
+/**
+ * Encode report.performance
+ */
+int telemetry_encode_performance(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                                 const telemetry_performance_t* performance) {
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_PERFORMANCE, timestamp_ms);
+    put_string(&w, performance->order_id, sizeof(performance->order_id) - 1);
+    put_string(&w, performance->weight_score, sizeof(performance->weight_score) - 1);
+    put_fixed(&w, performance->front_tire, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->rear_tire, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->brake_pad, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->engine_oil, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->chain_or_cvt, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->engine, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->distance_travelled, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->average_speed, TELEMETRY_PERF_SCALE);
+    put_fixed(&w, performance->max_speed, TELEMETRY_PERF_SCALE);
+    return end_message(&w, buf);
+}
+
+/**
+ * Encode realtime.frame
+ */
+int telemetry_encode_frame(uint8_t* buf, size_t size, uint64_t timestamp_ms,
+                           const telemetry_frame_t* frame) {
+    uint8_t fields = frame->fields &
+                     (TELEMETRY_FRAME_LOCATION | TELEMETRY_FRAME_STATUS | TELEMETRY_FRAME_BATTERY);
+    if (fields == 0) {
+        return TELEMETRY_CODEC_ERR_MALFORMED;
+    }
+
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_FRAME, timestamp_ms);
+    put_u8(&w, fields);
+    if (fields & TELEMETRY_FRAME_LOCATION) put_location(&w, &frame->location);
+    if (fields & TELEMETRY_FRAME_STATUS) put_status(&w, &frame->status);
+    if (fields & TELEMETRY_FRAME_BATTERY) put_battery(&w, &frame->battery);
+    return end_message(&w, buf);
+}
+
+/**
+ * Encode realtime.track
+ */
+int telemetry_encode_track(uint8_t* buf, size_t size, const telemetry_track_point_t* points,
+                           size_t count) {
+    if (count == 0 || count > TELEMETRY_TRACK_MAX_POINTS) {
+        return TELEMETRY_CODEC_ERR_MALFORMED;
+    }
+
+    writer_t w = begin_message(buf, size, TELEMETRY_MSG_TRACK, points[0].timestamp_ms);
+    put_varint(&w, count);
+    put_fixed(&w, points[0].latitude, TELEMETRY_COORD_SCALE);
+    put_fixed(&w, points[0].longitude, TELEMETRY_COORD_SCALE);
+    put_fixed(&w, points[0].altitude, TELEMETRY_ALTITUDE_SCALE);
+
+    for (size_t i = 1; i < count; i++) {
+        const telemetry_track_point_t* prev = &points[i - 1];
+        const telemetry_track_point_t* cur = &points[i];
+        put_varint(&w, telemetry_zigzag((int64_t)(cur->timestamp_ms - prev->timestamp_ms)));
+        put_varint(&w, telemetry_zigzag(to_fixed(cur->latitude, TELEMETRY_COORD_SCALE) -
+                                        to_fixed(prev->latitude, TELEMETRY_COORD_SCALE)));
+        put_varint(&w, telemetry_zigzag(to_fixed(cur->longitude, TELEMETRY_COORD_SCALE) -
+                                        to_fixed(prev->longitude, TELEMETRY_COORD_SCALE)));
+        put_varint(&w, telemetry_zigzag(to_fixed(cur->altitude, TELEMETRY_ALTITUDE_SCALE) -
+                                        to_fixed(prev->altitude, TELEMETRY_ALTITUDE_SCALE)));
+    }
+    return end_message(&w, buf);
+}
+
+/**
+ * Read the fields of a location, status or battery reading
+ */
+static void get_location(reader_t* r, telemetry_location_t* location) {
+    location->latitude = get_fixed(r, TELEMETRY_COORD_SCALE);
+    location->longitude = get_fixed(r, TELEMETRY_COORD_SCALE);
+    location->altitude = get_fixed(r, TELEMETRY_ALTITUDE_SCALE);
+}
+
+static void get_status(reader_t* r, telemetry_status_t* status) {
+    uint8_t flags = get_u8(r);
+    status->is_active = (flags & TELEMETRY_STATUS_ACTIVE) != 0;
+    status->is_locked = (flags & TELEMETRY_STATUS_LOCKED) != 0;
+    status->is_killed = (flags & TELEMETRY_STATUS_KILLED) != 0;
+}
+
+static void get_battery(reader_t* r, telemetry_battery_t* battery) {
+    battery->voltage = get_fixed(r, TELEMETRY_VOLTAGE_SCALE);
+    battery->battery_level = get_fixed(r, TELEMETRY_LEVEL_SCALE);
+}
+
+/**
+ * Decode the parts of realtime.frame its fields byte lists
+ */
+static void get_frame(reader_t* r, telemetry_frame_t* frame) {
+    frame->fields = get_u8(r);
+    if (frame->fields == 0 || (frame->fields & ~(TELEMETRY_FRAME_LOCATION | TELEMETRY_FRAME_STATUS |
+                                                 TELEMETRY_FRAME_BATTERY))) {
+        r->error = true;
+        return;
+    }
+    if (frame->fields & TELEMETRY_FRAME_LOCATION) get_location(r, &frame->location);
+    if (frame->fields & TELEMETRY_FRAME_STATUS) get_status(r, &frame->status);
+    if (frame->fields & TELEMETRY_FRAME_BATTERY) get_battery(r, &frame->battery);
+}
+
+/**
+ * Decode the points of realtime.track, deltas are summed in fixed point
+ */
+static void get_track(reader_t* r, uint64_t timestamp_ms, telemetry_track_t* track) {
+    uint64_t count = get_varint(r);
+    if (r->error || count == 0 || count > TELEMETRY_TRACK_MAX_POINTS) {
+        r->error = true;
+        return;
+    }
+
+    int64_t lat = telemetry_unzigzag(get_varint(r));
+    int64_t lon = telemetry_unzigzag(get_varint(r));
+    int64_t alt = telemetry_unzigzag(get_varint(r));
+    uint64_t ts = timestamp_ms;
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (i > 0) {
+            ts += telemetry_unzigzag(get_varint(r));
+            lat += telemetry_unzigzag(get_varint(r));
+            lon += telemetry_unzigzag(get_varint(r));
+            alt += telemetry_unzigzag(get_varint(r));
+        }
+        track->points[i].timestamp_ms = ts;
+        track->points[i].latitude = (float)((double)lat / TELEMETRY_COORD_SCALE);
+        track->points[i].longitude = (float)((double)lon / TELEMETRY_COORD_SCALE);
+        track->points[i].altitude = (float)((double)alt / TELEMETRY_ALTITUDE_SCALE);
+    }
+    track->count = (uint16_t)count;
+}
+
+/**
+ * Decode a message
+ */
+int telemetry_decode(const uint8_t* buf, size_t len, telemetry_message_t* msg) {
+    reader_t r = { .p = buf, .end = buf + len, .error = false };
+
+    memset(msg, 0, sizeof(*msg));
+    msg->version = get_u8(&r);
+    msg->type = get_u8(&r);
+    msg->timestamp_ms = get_varint(&r);
+    if (r.error || msg->version != TELEMETRY_CODEC_VERSION) {
+        return TELEMETRY_CODEC_ERR_MALFORMED;
+    }
+
+    switch (msg->type) {
+        case TELEMETRY_MSG_LOCATION:
+            get_location(&r, &msg->location);
+            break;
+
+        case TELEMETRY_MSG_STATUS:
+            get_status(&r, &msg->status);
+            break;
+
+        case TELEMETRY_MSG_BATTERY:
+            get_battery(&r, &msg->battery);
+            break;
+
+        case TELEMETRY_MSG_PERFORMANCE:
+            get_string(&r, msg->performance.order_id, sizeof(msg->performance.order_id));
+            get_string(&r, msg->performance.weight_score, sizeof(msg->performance.weight_score));
+            msg->performance.front_tire = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.rear_tire = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.brake_pad = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.engine_oil = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.chain_or_cvt = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.engine = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.distance_travelled = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.average_speed = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            msg->performance.max_speed = get_fixed(&r, TELEMETRY_PERF_SCALE);
+            break;
+
+        case TELEMETRY_MSG_TRACK:
+            get_track(&r, msg->timestamp_ms, &msg->track);
+            break;
+
+        case TELEMETRY_MSG_FRAME:
+            get_frame(&r, &msg->frame);
+            break;
+
+        default:
+            return TELEMETRY_CODEC_ERR_MALFORMED;
+    }
+
+    // Trailing bytes mean the sender used a layout this decoder doesn't know
+    if (r.error || r.p != r.end) {
+        return TELEMETRY_CODEC_ERR_MALFORMED;
+    }
+    return 0;
+}
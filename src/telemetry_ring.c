@@ -0,0 +1,78 @@
+#include "telemetry_ring.h"
+#include <string.h>
+
+#define RING_MASK   (TELEMETRY_RING_SIZE - 1)
+
+_Static_assert((TELEMETRY_RING_SIZE & RING_MASK) == 0, "TELEMETRY_RING_SIZE must be a power of two");
+
+void telemetry_ring_init(telemetry_ring_t* ring, telemetry_ring_policy_t policy) {
+    memset(ring->records, 0, sizeof(ring->records));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->policy = policy;
+    ring->pushed = 0;
+    ring->popped = 0;
+    ring->dropped = 0;
+    ring->high_water = 0;
+}
+
+bool telemetry_ring_push(telemetry_ring_t* ring, const telemetry_record_t* record) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail >= TELEMETRY_RING_SIZE) {
+        if (ring->policy == TELEMETRY_RING_DROP_NEWEST) {
+            ring->dropped++;
+            return false;
+        }
+
+        // Take the oldest slot; losing the race means the consumer just
+        // freed one
+        if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            ring->dropped++;
+        }
+    }
+
+    ring->records[head & RING_MASK] = *record;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    ring->pushed++;
+    uint32_t depth = head + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (depth > ring->high_water) {
+        ring->high_water = depth;
+    }
+    return true;
+}
+
+bool telemetry_ring_pop(telemetry_ring_t* ring, telemetry_record_t* out) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    for (;;) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+
+        *out = ring->records[tail & RING_MASK];
+
+        // Fails if the producer dropped this record meanwhile, tail is
+        // reloaded and the copy discarded
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            ring->popped++;
+            return true;
+        }
+    }
+}
+
+void telemetry_ring_get_stats(telemetry_ring_t* ring, telemetry_ring_stats_t* stats) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    stats->depth = head - tail;
+    stats->high_water = ring->high_water;
+    stats->pushed = ring->pushed;
+    stats->popped = ring->popped;
+    stats->dropped = ring->dropped;
+}
@@ -1,10 +1,56 @@
 #include "vehicle_performance.h"
+#include "seqlock.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <math.h>
 #include <string.h>
 
 static const char *TAG = "PERFORMANCE";
-static vehicle_performance_t perf_data = {0};
+
+// Double buffered so performance_get_data() never blocks or tears; the
+// tracking task and the command handler both write, under perf_mutex
+static vehicle_performance_t perf_data[2] = {0};
+static seqlock_t perf_seq;
+static SemaphoreHandle_t perf_mutex = NULL;
+
+/**
+ * Start changing the performance data, returns the copy to modify
+ */
+static vehicle_performance_t* perf_write_begin(void) {
+    xSemaphoreTake(perf_mutex, portMAX_DELAY);
+    uint32_t seq = seqlock_write_begin(&perf_seq);
+    perf_data[(seq + 1) & 1] = perf_data[seq & 1];
+    return &perf_data[(seq + 1) & 1];
+}
+
+/**
+ * Publish the modified copy
+ */
+static void perf_write_end(void) {
+    seqlock_write_end(&perf_seq);
+    xSemaphoreGive(perf_mutex);
+}
+
+/**
+ * Clear the counters of a copy being written
+ */
+static void reset_counters(vehicle_performance_t* perf) {
+    perf->s_rear_tire = 0;
+    perf->s_front_tire = 0;
+    perf->s_front_brake_pad = 0;
+    perf->s_rear_brake_pad = 0;
+    perf->s_chain_or_cvt = 0;
+    perf->s_engine_oil = 0;
+    perf->s_engine = 0;
+    perf->v_start = 0;
+    perf->total_distance_km = 0;
+    perf->average_speed = 0;
+    perf->max_speed = 0;
+    perf->trip_count = 0;
+    // strcpy(perf->weight_score, "ringan");
+    memset(perf->order_id, 0, sizeof(perf->order_id));
+}
 
 /**
  * Calculate rear tire force based on acceleration and elevation.
@@ -70,9 +116,12 @@ float count_s_oil(float s_real, float temp_machine) {
  * Initialize performance tracking system.
  */
 void performance_init(void) {
-    memset(&perf_data, 0, sizeof(vehicle_performance_t));
-    // strcpy(perf_data.weight_score, "ringan");
-    perf_data.is_tracking = false;
+    if (perf_mutex == NULL) {
+        perf_mutex = xSemaphoreCreateMutex();
+    }
+    seqlock_init(&perf_seq);
+    memset(perf_data, 0, sizeof(perf_data));
+    // strcpy(perf_data[0].weight_score, "ringan");
     ESP_LOGI(TAG, "Performance tracking initialized");
 }
 
@@ -80,20 +129,8 @@ void performance_init(void) {
  * Reset all performance counters.
  */
 void performance_reset(void) {
-    perf_data.s_rear_tire = 0;
-    perf_data.s_front_tire = 0;
-    perf_data.s_front_brake_pad = 0;
-    perf_data.s_rear_brake_pad = 0;
-    perf_data.s_chain_or_cvt = 0;
-    perf_data.s_engine_oil = 0;
-    perf_data.s_engine = 0;
-    perf_data.v_start = 0;
-    perf_data.total_distance_km = 0;
-    perf_data.average_speed = 0;
-    perf_data.max_speed = 0;
-    perf_data.trip_count = 0;
-    // strcpy(perf_data.weight_score, "ringan");
-    memset(perf_data.order_id, 0, sizeof(perf_data.order_id));
+    reset_counters(perf_write_begin());
+    perf_write_end();
     ESP_LOGI(TAG, "Performance counters reset");
 }
 
@@ -101,39 +138,45 @@ void performance_reset(void) {
  * Start tracking for a new rental order.
  */
 void performance_start_tracking(const char* order_id) {
-    performance_reset();
+    vehicle_performance_t* perf = perf_write_begin();
+    reset_counters(perf);
     if (order_id != NULL) {
-        strncpy(perf_data.order_id, order_id, sizeof(perf_data.order_id) - 1);
+        strncpy(perf->order_id, order_id, sizeof(perf->order_id) - 1);
     }
-    perf_data.is_tracking = true;
-    ESP_LOGI(TAG, "Started tracking for order: %s", perf_data.order_id);
+    perf->is_tracking = true;
+    ESP_LOGI(TAG, "Started tracking for order: %s", perf->order_id);
+    perf_write_end();
 }
 
 /**
  * Stop tracking and finalize data.
  */
 void performance_stop_tracking(void) {
-    perf_data.is_tracking = false;
+    vehicle_performance_t* perf = perf_write_begin();
+    perf->is_tracking = false;
     update_weight_score();
     
     // Calculate final statistics
-    if (perf_data.trip_count > 0) {
-        perf_data.average_speed = perf_data.average_speed / perf_data.trip_count;
+    if (perf->trip_count > 0) {
+        perf->average_speed = perf->average_speed / perf->trip_count;
     }
     
-    ESP_LOGI(TAG, "Stopped tracking. Total distance: %.2f km", perf_data.total_distance_km);
-    // ESP_LOGI(TAG, "Weight score: %s", perf_data.weight_score);
+    ESP_LOGI(TAG, "Stopped tracking. Total distance: %.2f km", perf->total_distance_km);
+    // ESP_LOGI(TAG, "Weight score: %s", perf->weight_score);
+    perf_write_end();
 }
 
 /**
  * Update performance data with new measurement when it is not using brake.
  */
 void performance_without_brake_update(float s_real, float h, float v_end, float temp_machine, int time) {
-    if (!perf_data.is_tracking) {
+    vehicle_performance_t* perf = perf_write_begin();
+    if (!perf->is_tracking) {
+        perf_write_end();
         return;
     }
     
-    float v_start = perf_data.v_start;
+    float v_start = perf->v_start;
     
     // Initialize deltas
     float delta_rear_tire = s_real;
@@ -154,74 +197,84 @@ void performance_without_brake_update(float s_real, float h, float v_end, float
     }
     
     // Update cumulative values
-    perf_data.s_rear_tire += delta_rear_tire;
-    perf_data.s_front_tire += s_real;
-    perf_data.s_chain_or_cvt += delta_rear_tire;
-    perf_data.s_engine_oil += count_s_oil(s_real, temp_machine);
-    perf_data.s_engine += s_real;
-    perf_data.s_air_filter += s_real;
+    perf->s_rear_tire += delta_rear_tire;
+    perf->s_front_tire += s_real;
+    perf->s_chain_or_cvt += delta_rear_tire;
+    perf->s_engine_oil += count_s_oil(s_real, temp_machine);
+    perf->s_engine += s_real;
+    perf->s_air_filter += s_real;
     
     // Update statistics
-    perf_data.total_distance_km = perf_data.s_engine / 1000.0;
-    perf_data.average_speed += v_end;
-    perf_data.trip_count++;
+    perf->total_distance_km = perf->s_engine / 1000.0;
+    perf->average_speed += v_end;
+    perf->trip_count++;
     
-    if (v_end > perf_data.max_speed) {
-        perf_data.max_speed = v_end;
+    if (v_end > perf->max_speed) {
+        perf->max_speed = v_end;
     }
     
     // Update starting velocity for next iteration
-    perf_data.v_start = v_end;
+    perf->v_start = v_end;
     
     ESP_LOGI(TAG, "Updated: v start= %.2f, v end = %.2f, time = %.2f, distance = %.2f, temperature = %.2f, rear tire work = %.2f, total rear tire = %.2f, total front tire = %.2f, total chain = %.2f, total oil = %.2f, total engine = %.2f, total air filter = %.2f",
-             v_start, v_end, time, s_real, temp_machine, delta_rear_tire, perf_data.s_rear_tire, perf_data.s_front_tire, perf_data.s_chain_or_cvt, perf_data.s_engine_oil, perf_data.s_engine, perf_data.s_air_filter);
+             v_start, v_end, time, s_real, temp_machine, delta_rear_tire, perf->s_rear_tire, perf->s_front_tire, perf->s_chain_or_cvt, perf->s_engine_oil, perf->s_engine, perf->s_air_filter);
+    perf_write_end();
 }
 
 /**
  * Update performance data with new measurement when it is using brake.
  */
 void performance_with_brake_update(float s_real, float h, float v_end, float temp_machine, int time, float mass, float wheelbase) {
-    if (!perf_data.is_tracking) {
+    vehicle_performance_t* perf = perf_write_begin();
+    if (!perf->is_tracking) {
+        perf_write_end();
         return;
     }
     
-    float v_start = perf_data.v_start;
+    float v_start = perf->v_start;
     
     // Initialize deltas
     float delta_rear_brake = rear_brake_work(s_real, h, v_start, v_end, time, mass, wheelbase);
     float delta_front_brake = front_brake_work(s_real, h, v_start, v_end, time, mass, wheelbase);
     
     // Update cumulative values
-    perf_data.s_rear_tire += delta_rear_brake;
-    perf_data.s_front_tire += delta_front_brake;
-    perf_data.s_rear_brake_pad += delta_rear_brake;
-    perf_data.s_front_brake_pad += delta_front_brake;
-    perf_data.s_chain_or_cvt += delta_rear_brake;
-    perf_data.s_engine_oil += count_s_oil(s_real, temp_machine);
-    perf_data.s_engine += s_real;
-    perf_data.s_air_filter += s_real;
+    perf->s_rear_tire += delta_rear_brake;
+    perf->s_front_tire += delta_front_brake;
+    perf->s_rear_brake_pad += delta_rear_brake;
+    perf->s_front_brake_pad += delta_front_brake;
+    perf->s_chain_or_cvt += delta_rear_brake;
+    perf->s_engine_oil += count_s_oil(s_real, temp_machine);
+    perf->s_engine += s_real;
+    perf->s_air_filter += s_real;
     
     // Update statistics
-    perf_data.total_distance_km = perf_data.s_engine / 1000.0;
-    perf_data.average_speed += v_end;
-    perf_data.trip_count++;
+    perf->total_distance_km = perf->s_engine / 1000.0;
+    perf->average_speed += v_end;
+    perf->trip_count++;
     
-    if (v_end > perf_data.max_speed) {
-        perf_data.max_speed = v_end;
+    if (v_end > perf->max_speed) {
+        perf->max_speed = v_end;
     }
     
     // Update starting velocity for next iteration
-    perf_data.v_start = v_end;
+    perf->v_start = v_end;
     
     ESP_LOGI(TAG, "Updated: v start= %.2f, v end = %.2f, time = %.2f, distance = %.2f, temperature = %.2f, rear brake work = %.2f, front brake work = %.2f, total rear tire = %.2f, total front tire = %.2f, total chain = %.2f, total oil = %.2f, total engine = %.2f, total air filter = %.2f",
-             v_start, v_end, time, s_real, temp_machine, delta_rear_brake, delta_front_brake, perf_data.s_rear_tire, perf_data.s_front_tire, perf_data.s_chain_or_cvt, perf_data.s_engine_oil, perf_data.s_engine, perf_data.s_air_filter);
+             v_start, v_end, time, s_real, temp_machine, delta_rear_brake, delta_front_brake, perf->s_rear_tire, perf->s_front_tire, perf->s_chain_or_cvt, perf->s_engine_oil, perf->s_engine, perf->s_air_filter);
+    perf_write_end();
 }
 
 /**
  * Get current performance data.
  */
 vehicle_performance_t performance_get_data(void) {
-    return perf_data;
+    vehicle_performance_t snapshot;
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&perf_seq);
+        snapshot = perf_data[seq & 1];
+    } while (seqlock_read_retry(&perf_seq, seq));
+    return snapshot;
 }
 
 /**
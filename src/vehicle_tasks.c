@@ -3,10 +3,15 @@
 #include "mpu6050.h"
 #include "vehicle_performance.h"
 #include "mqtt_vehicle_client.h"
+#include "sim808.h"
+#include "report_filter.h"
+#include "rate_controller.h"
+#include "telemetry_ring.h"
 #include "driver/uart.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include <math.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -16,17 +21,48 @@ static const char *TAG = "VEHICLE_TASKS";
 TaskHandle_t gps_task_handle = NULL;
 TaskHandle_t tracking_task_handle = NULL;
 TaskHandle_t monitor_task_handle = NULL;
+TaskHandle_t publisher_task_handle = NULL;
 
-// Update intervals (in milliseconds)
-#define GPS_UPDATE_INTERVAL     5000    // 5 seconds
-#define STATUS_UPDATE_INTERVAL  5000    // 5 seconds
-#define BATTERY_UPDATE_INTERVAL 10000   // 10 seconds
+// Update intervals (in milliseconds), GNSS and realtime.* intervals come
+// from the rate controller
+#define MOTION_SAMPLE_INTERVAL  200     // 200 ms
 #define TEMP_CHECK_INTERVAL     5000    // 5 seconds
+#define CSQ_SAMPLE_INTERVAL     30000   // 30 seconds
+#define DIAG_UPDATE_INTERVAL    300000  // 5 minutes
+#define BACKLOG_REPLAY_INTERVAL 1000    // 1 second
+#define PUBLISHER_IDLE_WAIT     1000    // Publisher timers run at least this often
+
+// Records from the tracking task to the publisher task; when the network
+// can't keep up, the freshest readings win
+#define PUBLISH_RING_POLICY     TELEMETRY_RING_DROP_OLDEST
+
+// A scheduled kill waits until the vehicle is slower than this (km/h)
+#define KILL_MAX_SPEED          10.0
+
+// Report-by-exception: samples inside the dead-band are not published,
+// the heartbeat still goes out after this much silence
+#define LOCATION_DEADBAND_M     25.0    // Meters moved
+#define HEADING_DEADBAND_DEG    15.0    // Degrees turned...
+#define HEADING_MIN_SPEED       5.0     // ...while faster than this (km/h)
+#define BATTERY_DEADBAND_V      0.05    // Volts
+#define LOCATION_HEARTBEAT      300000  // 5 minutes
+#define STATUS_HEARTBEAT        300000  // 5 minutes
+#define BATTERY_HEARTBEAT       600000  // 10 minutes
 
 // Battery simulation (TODO: replace with real ADC reading)
 static float battery_voltage = 12.6;
 static float battery_level = 100.0;
 
+// Current sampling rates, read by diagnostics
+static rate_controller_t rates;
+static portMUX_TYPE rates_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Tracking task (producer) to publisher task (consumer)
+static telemetry_ring_t publish_ring;
+
+// Set by command handlers, see vehicle_tasks_notify_state_change()
+static atomic_bool state_changed = false;
+
 /**
  * Calculate distance between two GPS coordinates using Haversine formula
  */
@@ -54,34 +90,134 @@ static float calculate_speed(float distance, float time_diff) {
 }
 
 
+/**
+ * Add the vehicle state to a frame
+ */
+static void set_frame_status(telemetry_frame_t* frame, const vehicle_state_t* state) {
+    frame->fields |= TELEMETRY_FRAME_STATUS;
+    frame->status.is_active = state->is_active;
+    frame->status.is_locked = state->is_locked;
+    frame->status.is_killed = state->is_killed;
+}
+
+/**
+ * Hand a record to the publisher task, never blocks
+ */
+static void enqueue_publish(telemetry_record_kind_t kind, const telemetry_frame_t* frame) {
+    telemetry_record_t record = {
+        .kind = kind,
+        .timestamp_ms = mqtt_get_epoch_ms()
+    };
+    if (frame) {
+        record.frame = *frame;
+    }
+    
+    if (!telemetry_ring_push(&publish_ring, &record)) {
+        ESP_LOGW(TAG, "Publish queue full, record dropped");
+    }
+    if (publisher_task_handle != NULL) {
+        xTaskNotifyGive(publisher_task_handle);
+    }
+}
+
 /**
  * Main vehicle tracking task
- * Handles GPS updates, sensor readings, and MQTT publishing
+ * Handles GPS updates and sensor readings, publishing is left to the
+ * publisher task
  */
 void vehicle_tracking_task(void *pvParameters) {
-    gps_data_t last_gps = {0};
+    sim808_gps_data_t last_gps = {0};
     TickType_t last_gps_time = 0;
+    TickType_t last_location_time = 0;
     TickType_t last_status_time = 0;
     TickType_t last_battery_time = 0;
     TickType_t last_temp_check = 0;
+    TickType_t last_csq_time = 0;
+    TickType_t last_diag_time = 0;
+    TickType_t last_motion_time = 0;
     
     bool gps_initialized = false;
     float last_speed = 0;
+    float distance_carry = 0;       // Meters not yet given to performance_update()
+    float elevation_carry = 0;
     float engine_temp = 0;
     
+    report_location_filter_t location_filter;
+    report_status_filter_t status_filter;
+    report_battery_filter_t battery_filter;
+    report_location_filter_init(&location_filter, LOCATION_DEADBAND_M, HEADING_DEADBAND_DEG,
+                                HEADING_MIN_SPEED, LOCATION_HEARTBEAT);
+    report_status_filter_init(&status_filter, STATUS_HEARTBEAT);
+    report_battery_filter_init(&battery_filter, BATTERY_DEADBAND_V, BATTERY_HEARTBEAT);
+    
+    rate_controller_t rc;
+    rate_controller_init(&rc, pdTICKS_TO_MS(xTaskGetTickCount()));
+    portENTER_CRITICAL(&rates_lock);
+    rates = rc;
+    portEXIT_CRITICAL(&rates_lock);
+    
     ESP_LOGI(TAG, "Vehicle tracking task started");
     
     while (1) {
         TickType_t current_time = xTaskGetTickCount();
-        vehicle_state_t *state = mqtt_get_vehicle_state();
+        uint32_t now_ms = pdTICKS_TO_MS(current_time);
+        bool commanded = atomic_exchange(&state_changed, false);
+        vehicle_state_t snapshot;
+        vehicle_state_t *state = &snapshot;
+        mqtt_get_vehicle_state(state);
+        telemetry_frame_t frame = { .fields = 0 };
+        
+        // A command answers with the state, as a status-only frame queued
+        // behind the fixes taken before it. The filter takes it as the last
+        // report, so the status update below doesn't send it again
+        if (commanded) {
+            telemetry_frame_t status_frame = { .fields = 0 };
+            report_status_due(&status_filter, now_ms, state->is_active,
+                              state->is_locked, state->is_killed);
+            set_frame_status(&status_frame, state);
+            enqueue_publish(TELEMETRY_RECORD_FLUSH_TRACK, NULL);
+            enqueue_publish(TELEMETRY_RECORD_FRAME, &status_frame);
+        }
+        
+        // Rates follow speed, IMU motion and rental state
+        if ((current_time - last_motion_time) >= pdMS_TO_TICKS(MOTION_SAMPLE_INTERVAL)) {
+            mpu6050_data_t motion;
+            if (mpu6050_read_data(&motion) == ESP_OK) {
+                rate_controller_add_motion(&rc, motion.accel_x, motion.accel_y, motion.accel_z);
+            }
+            
+            float speed = gps_initialized ? last_gps.speed : 0;
+            if (rate_controller_update(&rc, now_ms, speed, state->is_active)) {
+                ESP_LOGI(TAG, "Rate tier %s: GNSS %lu ms, location %lu ms",
+                         rate_controller_tier_name(rc.tier),
+                         (unsigned long)rc.intervals.gps_ms, (unsigned long)rc.intervals.location_ms);
+            }
+            
+            portENTER_CRITICAL(&rates_lock);
+            rates = rc;
+            portEXIT_CRITICAL(&rates_lock);
+            last_motion_time = current_time;
+        }
         
         // GPS Update
-        if ((current_time - last_gps_time) >= pdMS_TO_TICKS(GPS_UPDATE_INTERVAL)) {
-            gps_data_t current_gps = gps_get_data();
+        if ((current_time - last_gps_time) >= pdMS_TO_TICKS(rc.intervals.gps_ms)) {
+            sim808_gps_data_t current_gps = {0};
+            sim808_gps_get_data(&current_gps);
             
             if (current_gps.valid) {
-                // Publish location
-                mqtt_publish_location(current_gps.latitude, current_gps.longitude, current_gps.altitude);
+                // Publish location once moved or turned
+                if ((current_time - last_location_time) >= pdMS_TO_TICKS(rc.intervals.location_ms)) {
+                    if (report_location_due(&location_filter, now_ms, current_gps.latitude,
+                                            current_gps.longitude, current_gps.speed, current_gps.course)) {
+                        frame.fields |= TELEMETRY_FRAME_LOCATION;
+                        frame.location = (telemetry_location_t){
+                            .latitude = current_gps.latitude,
+                            .longitude = current_gps.longitude,
+                            .altitude = current_gps.altitude
+                        };
+                    }
+                    last_location_time = current_time;
+                }
                 
                 // Calculate performance if tracking is active
                 if (gps_initialized && state->is_active) {
@@ -95,31 +231,34 @@ void vehicle_tracking_task(void *pvParameters) {
                     
                     // Get pitch angle from MPU6050 to estimate elevation change
                     mpu6050_data_t mpu_data;
-                    int elevation_change = 0;
                     if (mpu6050_read_data(&mpu_data) == ESP_OK) {
                         // Approximate elevation change from pitch angle and distance
-                        elevation_change = (int)(distance * sin(mpu_data.pitch * M_PI / 180.0));
+                        elevation_carry += distance * sin(mpu_data.pitch * M_PI / 180.0);
                     }
                     
-                    // Update performance calculator
-                    performance_update(
-                        (int)distance,                    // s_real
-                        elevation_change,                 // h
-                        (int)speed,                       // v_end
-                        engine_temp                       // T_machine
-                    );
+                    // Whole meters only, the remainder carries over to the
+                    // next fix instead of being cut off at every step
+                    distance_carry += distance;
+                    int meters = (int)distance_carry;
+                    if (meters > 0) {
+                        int elevation_change = (int)elevation_carry;
+                        distance_carry -= meters;
+                        elevation_carry -= elevation_change;
+                        
+                        // Update performance calculator
+                        performance_update(
+                            meters,                       // s_real
+                            elevation_change,             // h
+                            (int)speed,                   // v_end
+                            engine_temp                   // T_machine
+                        );
+                    }
                     
                     last_speed = speed;
-                    
-                    // Check if kill is scheduled and speed is low enough
-                    if (state->kill_scheduled && speed < 10) {
-                        state->is_active = false;
-                        state->is_locked = true;
-                        state->is_killed = true;
-                        state->kill_scheduled = false;
-                        ESP_LOGW(TAG, "Vehicle killed (speed < 10 km/h)");
-                        mqtt_publish_status(state->is_active, state->is_locked, state->is_killed);
-                    }
+                } else {
+                    last_speed = current_gps.speed;
+                    distance_carry = 0;
+                    elevation_carry = 0;
                 }
                 
                 last_gps = current_gps;
@@ -133,14 +272,30 @@ void vehicle_tracking_task(void *pvParameters) {
             last_gps_time = current_time;
         }
         
-        // Status Update
-        if ((current_time - last_status_time) >= pdMS_TO_TICKS(STATUS_UPDATE_INTERVAL)) {
-            mqtt_publish_status(state->is_active, state->is_locked, state->is_killed);
+        // A scheduled kill runs as soon as the vehicle is slow enough, not
+        // only on GNSS ticks (up to minutes apart when parked)
+        if (state->kill_scheduled && gps_initialized && last_speed < KILL_MAX_SPEED &&
+            mqtt_vehicle_execute_kill()) {
+            mqtt_get_vehicle_state(state);
+            ESP_LOGW(TAG, "Vehicle killed (speed < %.0f km/h)", KILL_MAX_SPEED);
+            enqueue_publish(TELEMETRY_RECORD_FLUSH_TRACK, NULL);
+            if (report_status_due(&status_filter, now_ms, state->is_active,
+                                  state->is_locked, state->is_killed)) {
+                set_frame_status(&frame, state);
+            }
+        }
+        
+        // Status Update, on any change
+        if ((current_time - last_status_time) >= pdMS_TO_TICKS(rc.intervals.status_ms)) {
+            if (report_status_due(&status_filter, now_ms, state->is_active,
+                                  state->is_locked, state->is_killed)) {
+                set_frame_status(&frame, state);
+            }
             last_status_time = current_time;
         }
         
         // Battery Update
-        if ((current_time - last_battery_time) >= pdMS_TO_TICKS(BATTERY_UPDATE_INTERVAL)) {
+        if ((current_time - last_battery_time) >= pdMS_TO_TICKS(rc.intervals.battery_ms)) {
             // Simulate battery drain when active (TODO: implement real ADC reading)
             if (state->is_active) {
                 battery_level -= 0.1;
@@ -148,10 +303,19 @@ void vehicle_tracking_task(void *pvParameters) {
                 battery_voltage = 10.5 + (battery_level / 100.0) * 2.1;
             }
             
-            mqtt_publish_battery(battery_voltage, battery_level);
+            if (report_battery_due(&battery_filter, now_ms, battery_voltage)) {
+                frame.fields |= TELEMETRY_FRAME_BATTERY;
+                frame.battery.voltage = battery_voltage;
+                frame.battery.battery_level = battery_level;
+            }
             last_battery_time = current_time;
         }
         
+        // Everything due this cycle in one message
+        if (frame.fields) {
+            enqueue_publish(TELEMETRY_RECORD_FRAME, &frame);
+        }
+        
         // Temperature Check
         if ((current_time - last_temp_check) >= pdMS_TO_TICKS(TEMP_CHECK_INTERVAL)) {
             engine_temp = max6675_read_temperature();
@@ -162,12 +326,73 @@ void vehicle_tracking_task(void *pvParameters) {
             last_temp_check = current_time;
         }
         
+        // Signal sample for the modem diagnostics history
+        if ((current_time - last_csq_time) >= pdMS_TO_TICKS(CSQ_SAMPLE_INTERVAL)) {
+            int rssi, ber;
+            sim808_get_signal_quality(&rssi, &ber);
+            last_csq_time = current_time;
+        }
+        
+        // Modem diagnostics
+        if ((current_time - last_diag_time) >= pdMS_TO_TICKS(DIAG_UPDATE_INTERVAL)) {
+            enqueue_publish(TELEMETRY_RECORD_DIAG, NULL);
+            last_diag_time = current_time;
+        }
+        
         vTaskDelay(pdMS_TO_TICKS(100));
     }
     
     vTaskDelete(NULL);
 }
 
+/**
+ * Telemetry publisher task
+ * Serializes and sends what the tracking task queued, so a slow network
+ * only delays publishing
+ */
+void telemetry_publisher_task(void *pvParameters) {
+    TickType_t last_replay_time = 0;
+    telemetry_record_t record;
+    
+    ESP_LOGI(TAG, "Telemetry publisher task started");
+    
+    while (1) {
+        // Woken per queued record, or for the timers below
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PUBLISHER_IDLE_WAIT));
+        
+        // Command replies first, they don't wait behind telemetry
+        mqtt_publish_pending();
+        
+        while (telemetry_ring_pop(&publish_ring, &record)) {
+            switch (record.kind) {
+                case TELEMETRY_RECORD_FRAME:
+                    mqtt_publish_frame(&record.frame, record.timestamp_ms);
+                    break;
+                case TELEMETRY_RECORD_FLUSH_TRACK:
+                    mqtt_flush_track();
+                    break;
+                case TELEMETRY_RECORD_DIAG:
+                    mqtt_publish_modem_diag();
+                    break;
+                default:
+                    break;
+            }
+        }
+        
+        // Send a track batch whose fixes waited long enough
+        mqtt_poll_track();
+        
+        // Stored messages, a burst at a time
+        TickType_t current_time = xTaskGetTickCount();
+        if ((current_time - last_replay_time) >= pdMS_TO_TICKS(BACKLOG_REPLAY_INTERVAL)) {
+            mqtt_replay_backlog();
+            last_replay_time = current_time;
+        }
+    }
+    
+    vTaskDelete(NULL);
+}
+
 /**
  * System monitor task
  * Monitors system health and logs periodic status
@@ -200,6 +425,38 @@ void system_monitor_task(void *pvParameters) {
     vTaskDelete(NULL);
 }
 
+/**
+ * Get the tracking task's current rates
+ */
+void vehicle_tasks_get_rates(rate_controller_t* out) {
+    portENTER_CRITICAL(&rates_lock);
+    *out = rates;
+    portEXIT_CRITICAL(&rates_lock);
+}
+
+/**
+ * Wake the publisher task
+ */
+void vehicle_tasks_wake_publisher(void) {
+    if (publisher_task_handle != NULL) {
+        xTaskNotifyGive(publisher_task_handle);
+    }
+}
+
+/**
+ * Have the tracking task report a state change
+ */
+void vehicle_tasks_notify_state_change(void) {
+    atomic_store(&state_changed, true);
+}
+
+/**
+ * Get the publish queue's depth and drop counters
+ */
+void vehicle_tasks_get_publisher_stats(telemetry_ring_stats_t* stats) {
+    telemetry_ring_get_stats(&publish_ring, stats);
+}
+
 /**
  * Initialize vehicle tasks
  */
@@ -210,6 +467,9 @@ void vehicle_tasks_init(void) {
     gps_task_handle = NULL;
     tracking_task_handle = NULL;
     monitor_task_handle = NULL;
+    publisher_task_handle = NULL;
+    
+    telemetry_ring_init(&publish_ring, PUBLISH_RING_POLICY);
 }
 
 /**
@@ -250,6 +510,22 @@ void vehicle_tasks_start(void) {
         ESP_LOGI(TAG, "Tracking task created");
     }
     
+    // Create telemetry publisher task
+    ret = xTaskCreate(
+        telemetry_publisher_task,
+        "publisher_task",
+        PUBLISHER_TASK_STACK_SIZE,
+        NULL,
+        PUBLISHER_TASK_PRIORITY,
+        &publisher_task_handle
+    );
+    
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create publisher task");
+    } else {
+        ESP_LOGI(TAG, "Publisher task created");
+    }
+    
     // Create system monitor task
     ret = xTaskCreate(
         system_monitor_task,
@@ -288,5 +564,10 @@ void vehicle_tasks_stop(void) {
         monitor_task_handle = NULL;
     }
     
+    if (publisher_task_handle != NULL) {
+        vTaskDelete(publisher_task_handle);
+        publisher_task_handle = NULL;
+    }
+    
     ESP_LOGI(TAG, "All vehicle tasks stopped");
 }
\ No newline at end of file
@@ -0,0 +1,276 @@
+/*
+ * Host check of the flash store-and-forward queue against a RAM model of
+ * NOR flash: erase sets a sector to 0xFF, writes can only clear bits, and a
+ * power cut stops a write or erase part way through.
+ *
+ *   fifo    push and drain records of random length, order and content kept
+ *   wrap    push far past capacity, the survivors are the newest records
+ *   power   random pushes and pops with a power cut in every cycle; after
+ *           each remount the queue holds exactly the acknowledged records
+ *   wear    erase counts per sector after all of the above
+ *
+ *   gcc -O2 -Iinclude tools/flash_queue_sim.c src/flash_queue.c -o flash_queue_sim
+ *   ./flash_queue_sim [power_cycles]
+ */
+
+#include "flash_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE     4096
+#define SECTOR_COUNT    16
+#define MAX_RECORD      300
+
+typedef struct {
+    uint8_t mem[SECTOR_SIZE * SECTOR_COUNT];
+    uint32_t erases[SECTOR_COUNT];
+    long budget;                // Bytes until the power cut, -1 for none
+    bool dead;                  // Power is off until remount
+} nor_t;
+
+static nor_t nor;
+static int failures;
+
+static int nor_read(void* ctx, uint32_t offset, void* buf, size_t len) {
+    (void)ctx;
+    if (nor.dead) return -1;
+    memcpy(buf, nor.mem + offset, len);
+    return 0;
+}
+
+// Charge n bytes of work, false once the power is cut
+static bool nor_spend(size_t* n) {
+    if (nor.budget < 0) return true;
+    if ((long)*n <= nor.budget) {
+        nor.budget -= *n;
+        return true;
+    }
+    *n = nor.budget;
+    nor.budget = 0;
+    nor.dead = true;
+    return false;
+}
+
+static int nor_write(void* ctx, uint32_t offset, const void* buf, size_t len) {
+    (void)ctx;
+    if (nor.dead) return -1;
+    bool ok = nor_spend(&len);
+    for (size_t i = 0; i < len; i++) {
+        nor.mem[offset + i] &= ((const uint8_t*)buf)[i];
+    }
+    return ok ? 0 : -1;
+}
+
+static int nor_erase(void* ctx, uint32_t offset, size_t len) {
+    (void)ctx;
+    if (nor.dead) return -1;
+    // An erase costs as much as writing the sector and stops part way
+    bool ok = nor_spend(&len);
+    memset(nor.mem + offset, 0xFF, len);
+    if (!ok) {
+        // The rest of an interrupted erase is left as noise
+        for (size_t i = len; i < SECTOR_SIZE; i++) {
+            nor.mem[offset + i] = (uint8_t)rand();
+        }
+    }
+    nor.erases[offset / SECTOR_SIZE]++;
+    return ok ? 0 : -1;
+}
+
+static const flash_queue_storage_t storage = {
+    .read = nor_read,
+    .write = nor_write,
+    .erase = nor_erase,
+    .size = sizeof(nor.mem),
+    .sector_size = SECTOR_SIZE,
+};
+
+// Record content is derived from its sequence number
+static size_t make_record(uint32_t seq, uint8_t* buf) {
+    size_t len = 4 + (seq * 2654435761u) % (MAX_RECORD - 4);
+    memcpy(buf, &seq, 4);
+    for (size_t i = 4; i < len; i++) {
+        buf[i] = (uint8_t)(seq * 31 + i);
+    }
+    return len;
+}
+
+static bool check_record(const uint8_t* buf, size_t len, uint32_t* seq) {
+    uint8_t expected[MAX_RECORD];
+    memcpy(seq, buf, 4);
+    return make_record(*seq, expected) == len && memcmp(buf, expected, len) == 0;
+}
+
+static void fail(const char* what, uint32_t a, uint32_t b) {
+    printf("FAIL %s (%u, %u)\n", what, a, b);
+    failures++;
+}
+
+static void remount(flash_queue_t* q) {
+    nor.dead = false;
+    nor.budget = -1;
+    if (flash_queue_mount(q, &storage) != FLASH_QUEUE_OK) {
+        fail("mount", 0, 0);
+        exit(1);
+    }
+}
+
+static void test_fifo(flash_queue_t* q) {
+    uint8_t buf[MAX_RECORD];
+    uint32_t next_pop = 0;
+
+    remount(q);
+    flash_queue_format(q);
+    for (uint32_t seq = 0; seq < 20000; seq++) {
+        size_t len = make_record(seq, buf);
+        if (flash_queue_push(q, buf, len) != FLASH_QUEUE_OK) {
+            fail("fifo push", seq, 0);
+        }
+        // Drain in bursts so the backlog crosses sectors
+        if (seq % 40 == 39) {
+            while (flash_queue_peek(q, buf, sizeof(buf), &len) == FLASH_QUEUE_OK) {
+                uint32_t got;
+                if (!check_record(buf, len, &got) || got != next_pop) {
+                    fail("fifo order", got, next_pop);
+                }
+                next_pop = got + 1;
+                flash_queue_pop(q);
+            }
+        }
+    }
+    flash_queue_stats_t stats;
+    flash_queue_get_stats(q, &stats);
+    printf("fifo    %u pushed, %u popped, %u dropped, %u corrupt\n", stats.pushed, stats.popped,
+           stats.dropped, stats.corrupt);
+}
+
+static void test_wrap(flash_queue_t* q) {
+    uint8_t buf[MAX_RECORD];
+    const uint32_t total = 5000;
+
+    remount(q);
+    flash_queue_format(q);
+    for (uint32_t seq = 0; seq < total; seq++) {
+        size_t len = make_record(seq, buf);
+        flash_queue_push(q, buf, len);
+    }
+
+    // Survive a reboot before draining
+    remount(q);
+    flash_queue_stats_t stats;
+    flash_queue_get_stats(q, &stats);
+    uint32_t pending = stats.pending;
+
+    size_t len;
+    uint32_t expected = total - pending, drained = 0;
+    while (flash_queue_peek(q, buf, sizeof(buf), &len) == FLASH_QUEUE_OK) {
+        uint32_t got;
+        if (!check_record(buf, len, &got) || got != expected) {
+            fail("wrap order", got, expected);
+        }
+        expected = got + 1;
+        drained++;
+        flash_queue_pop(q);
+    }
+    if (expected != total || drained != pending) {
+        fail("wrap newest kept", expected, total);
+    }
+    printf("wrap    %u pushed into %u bytes, newest %u kept in order\n", total,
+           (unsigned)storage.size, drained);
+}
+
+static void test_power(flash_queue_t* q, int cycles) {
+    static uint32_t expected[1 << 16];
+    uint32_t head = 0, tail = 0;        // Acknowledged pending records
+    uint32_t next_seq = 0;
+    uint32_t cuts_in_push = 0, cuts_in_pop = 0, replayed = 0;
+    uint8_t buf[MAX_RECORD];
+    size_t len;
+
+    remount(q);
+    flash_queue_format(q);
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        nor.budget = rand() % 20000;
+
+        // Random traffic until the power goes
+        bool popping = false;
+        while (!nor.dead) {
+            if (rand() % 100 < 55) {
+                uint32_t seq = next_seq++;
+                len = make_record(seq, buf);
+                if (flash_queue_push(q, buf, len) == FLASH_QUEUE_OK) {
+                    expected[head++ & 0xFFFF] = seq;
+                } else {
+                    cuts_in_push++;
+                }
+            } else if (flash_queue_peek(q, buf, sizeof(buf), &len) == FLASH_QUEUE_OK) {
+                popping = true;
+                if (flash_queue_pop(q) == FLASH_QUEUE_OK) {
+                    tail++;
+                    popping = false;
+                } else {
+                    cuts_in_pop++;
+                }
+            }
+        }
+
+        remount(q);
+
+        // A pop cut off before its write may come back, nothing else may
+        if (popping && tail < head &&
+            flash_queue_peek(q, buf, sizeof(buf), &len) == FLASH_QUEUE_OK) {
+            uint32_t got;
+            check_record(buf, len, &got);
+            if (got == expected[tail & 0xFFFF]) {
+                replayed++;
+            }
+        }
+
+        flash_queue_stats_t stats;
+        flash_queue_get_stats(q, &stats);
+        if (stats.pending != head - tail) {
+            fail("power pending", stats.pending, head - tail);
+        }
+
+        // Drain half of it, the rest stays for the next cycle
+        uint32_t drain = (head - tail) / 2;
+        for (uint32_t i = 0; i < drain; i++) {
+            uint32_t got = 0;
+            if (flash_queue_peek(q, buf, sizeof(buf), &len) != FLASH_QUEUE_OK ||
+                !check_record(buf, len, &got) || got != expected[tail & 0xFFFF]) {
+                fail("power order", got, expected[tail & 0xFFFF]);
+                break;
+            }
+            flash_queue_pop(q);
+            tail++;
+        }
+    }
+
+    flash_queue_stats_t stats;
+    flash_queue_get_stats(q, &stats);
+    printf("power   %d cuts (%u in push, %u in pop, %u pops replayed), %u pending, %u dropped\n",
+           cycles, cuts_in_push, cuts_in_pop, replayed, head - tail, stats.dropped);
+}
+
+int main(int argc, char** argv) {
+    int cycles = (argc > 1) ? atoi(argv[1]) : 2000;
+    flash_queue_t q;
+
+    srand(1);
+    memset(nor.mem, 0xFF, sizeof(nor.mem));
+    nor.budget = -1;
+
+    test_fifo(&q);
+    test_wrap(&q);
+    test_power(&q, cycles);
+
+    uint32_t min = UINT32_MAX, max = 0;
+    for (int s = 0; s < SECTOR_COUNT; s++) {
+        if (nor.erases[s] < min) min = nor.erases[s];
+        if (nor.erases[s] > max) max = nor.erases[s];
+    }
+    printf("wear    %u..%u erases per sector over %d sectors\n", min, max, SECTOR_COUNT);
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
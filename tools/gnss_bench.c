@@ -0,0 +1,265 @@
+/*
+ * Host check and benchmark of the GNSS parsers against a recorded-format
+ * corpus (tools/gnss_corpus.txt): AT+CGNSINF responses, with and without
+ * a fix (",,," fields), and the NMEA sentences of the same drive.
+ *
+ * Every CGNSINF line is parsed by sim808_gnss_parse_cgnsinf() and by a
+ * strtod() reference, and all fields must agree. The sscanf() parser it
+ * replaced is timed alongside and its accepted lines counted. The NMEA
+ * lines are fed byte by byte through sim808_nmea_feed(): every RMC epoch
+ * must produce the fix of the matching CGNSINF line, and the corrupted
+ * sentence must be dropped on its checksum.
+ *
+ *   gcc -O2 -Iinclude tools/gnss_bench.c src/sim808_gnss.c -lm -o gnss_bench
+ *   ./gnss_bench [corpus] [iterations]
+ */
+
+#include "sim808_gnss.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LINES       512
+#define MAX_LINE_LEN    160
+
+static char cgnsinf[MAX_LINES][MAX_LINE_LEN];
+static int cgnsinf_count;
+static char nmea[MAX_LINES * MAX_LINE_LEN];     // Sentences, CRLF terminated
+static size_t nmea_len;
+static int failures;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Load the corpus, CGNSINF lines and the NMEA stream apart
+ */
+static bool load_corpus(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[MAX_LINE_LEN - 16];      // Room for the OK trailer
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "+CGNSINF:", 9) == 0 && cgnsinf_count < MAX_LINES) {
+            snprintf(cgnsinf[cgnsinf_count++], MAX_LINE_LEN, "%s\r\n\r\nOK\r\n", line);
+        } else if (line[0] == '$' && nmea_len + strlen(line) + 2 < sizeof(nmea)) {
+            nmea_len += (size_t)sprintf(nmea + nmea_len, "%s\r\n", line);
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/**
+ * The sscanf() parser sim808_gnss_parse_cgnsinf() replaced
+ */
+static bool sscanf_cgnsinf(const char* response, sim808_gps_data_t* data) {
+    const char* line = strstr(response, "+CGNSINF:");
+    if (line == NULL) {
+        return false;
+    }
+    line += strlen("+CGNSINF:");
+
+    int run_status, fix_status;
+    char datetime[24];
+    float lat, lon, alt, speed, course;
+    int fix_mode, sat_view;
+    float hdop, pdop, vdop;
+
+    int parsed = sscanf(line, "%d,%d,%[^,],%f,%f,%f,%f,%f,%d,%*f,%f,%f,%f,%*d,%d",
+                        &run_status, &fix_status, datetime, &lat, &lon, &alt,
+                        &speed, &course, &fix_mode, &hdop, &pdop, &vdop, &sat_view);
+    if (parsed < 13) {
+        return false;
+    }
+
+    data->valid = (fix_status == 1);
+    data->latitude = lat;
+    data->longitude = lon;
+    data->altitude = alt;
+    data->speed = speed;
+    data->satellites = sat_view;
+    if (strlen(datetime) >= 14) {
+        snprintf(data->timestamp, sizeof(data->timestamp), "%.4s-%.2s-%.2sT%.2s:%.2s:%.2sZ",
+                 datetime, datetime + 4, datetime + 6, datetime + 8, datetime + 10, datetime + 12);
+    }
+    return data->valid;
+}
+
+/**
+ * Obvious field-by-field CGNSINF parser, the expected values
+ */
+static void reference_cgnsinf(const char* response, sim808_gps_data_t* data) {
+    char fields[24][32] = {{0}};
+    const char* p = strstr(response, "+CGNSINF:") + strlen("+CGNSINF:");
+    int n = 0;
+
+    while (*p == ' ') {
+        p++;
+    }
+    for (int len = 0; *p && *p != '\r' && n < 24; p++) {
+        if (*p == ',') {
+            n++;
+            len = 0;
+        } else if (len < 31) {
+            fields[n][len++] = *p;
+        }
+    }
+
+    memset(data, 0, sizeof(*data));
+    data->latitude_e6 = (int32_t)llround(strtod(fields[3], NULL) * SIM808_GNSS_COORD_SCALE);
+    data->longitude_e6 = (int32_t)llround(strtod(fields[4], NULL) * SIM808_GNSS_COORD_SCALE);
+    data->altitude = strtof(fields[5], NULL);
+    data->speed = strtof(fields[6], NULL);
+    data->course = strtof(fields[7], NULL);
+    data->hdop = strtof(fields[10], NULL);
+    data->pdop = strtof(fields[11], NULL);
+    data->vdop = strtof(fields[12], NULL);
+    data->satellites = atoi(fields[14]);
+    data->satellites_used = atoi(fields[15]);
+    data->valid = fields[1][0] == '1' && fields[3][0] && fields[4][0];
+    if (strlen(fields[2]) >= 14) {
+        snprintf(data->timestamp, sizeof(data->timestamp), "%.4s-%.2s-%.2sT%.2s:%.2s:%.2sZ",
+                 fields[2], fields[2] + 4, fields[2] + 6, fields[2] + 8, fields[2] + 10,
+                 fields[2] + 12);
+    }
+}
+
+static void expect(bool ok, const char* what, int line) {
+    if (!ok) {
+        printf("FAIL %s (CGNSINF line %d)\n", what, line + 1);
+        failures++;
+    }
+}
+
+static void check_cgnsinf(void) {
+    int fixes = 0;
+    int sscanf_accepted = 0;
+
+    for (int i = 0; i < cgnsinf_count; i++) {
+        sim808_gps_data_t got, want, old = {0};
+        bool valid = sim808_gnss_parse_cgnsinf(cgnsinf[i], &got);
+        reference_cgnsinf(cgnsinf[i], &want);
+
+        expect(valid == want.valid && got.valid == want.valid, "fix status", i);
+        expect(got.latitude_e6 == want.latitude_e6, "latitude", i);
+        expect(got.longitude_e6 == want.longitude_e6, "longitude", i);
+        expect(fabsf(got.altitude - want.altitude) < 1e-3f, "altitude", i);
+        expect(fabsf(got.speed - want.speed) < 1e-3f, "speed", i);
+        expect(fabsf(got.course - want.course) < 1e-3f, "course", i);
+        expect(fabsf(got.hdop - want.hdop) < 1e-3f, "HDOP", i);
+        expect(fabsf(got.pdop - want.pdop) < 1e-3f, "PDOP", i);
+        expect(fabsf(got.vdop - want.vdop) < 1e-3f, "VDOP", i);
+        expect(got.satellites == want.satellites, "satellites in view", i);
+        expect(got.satellites_used == want.satellites_used, "satellites used", i);
+        expect(strcmp(got.timestamp, want.timestamp) == 0, "timestamp", i);
+
+        fixes += valid;
+        sscanf_accepted += sscanf_cgnsinf(cgnsinf[i], &old);
+    }
+
+    printf("CGNSINF  %3d lines, %d fixes (sscanf parser accepted %d)\n",
+           cgnsinf_count, fixes, sscanf_accepted);
+}
+
+static void check_nmea(void) {
+    sim808_nmea_parser_t parser;
+    int epochs = 0;
+    int fixes = 0;
+    int next = 0;       // CGNSINF line the next fix should match
+
+    sim808_nmea_init(&parser);
+    for (size_t i = 0; i < nmea_len; i++) {
+        if (!sim808_nmea_feed(&parser, nmea[i])) {
+            continue;
+        }
+        epochs++;
+        if (!parser.fix.valid) {
+            continue;
+        }
+        fixes++;
+
+        // NMEA has 4 decimals of minutes, within 2 micro-degrees
+        sim808_gps_data_t want;
+        do {
+            reference_cgnsinf(cgnsinf[next++], &want);
+        } while (!want.valid && next < cgnsinf_count);
+        if (abs(parser.fix.latitude_e6 - want.latitude_e6) > 2 ||
+            abs(parser.fix.longitude_e6 - want.longitude_e6) > 2 ||
+            fabsf(parser.fix.altitude - want.altitude) > 0.05f ||
+            fabsf(parser.fix.speed - want.speed) > 0.05f ||
+            parser.fix.satellites_used != want.satellites_used ||
+            fabsf(parser.fix.pdop - want.pdop) > 1e-3f ||
+            strcmp(parser.fix.timestamp + 11, want.timestamp + 11) != 0) {
+            printf("FAIL NMEA fix %d differs from CGNSINF line %d\n", fixes, next);
+            failures++;
+        }
+    }
+
+    printf("NMEA     %3u sentences, %d epochs, %d fixes, %u checksum errors\n",
+           (unsigned)parser.sentences, epochs, fixes, (unsigned)parser.checksum_errors);
+    if (parser.checksum_errors != 1) {
+        printf("FAIL expected the one corrupted sentence to be dropped\n");
+        failures++;
+    }
+}
+
+static void bench(long iterations) {
+    sim808_gps_data_t data;
+    sim808_nmea_parser_t parser;
+    volatile int sink = 0;
+
+    double t0 = now_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < cgnsinf_count; i++) {
+            sink += sim808_gnss_parse_cgnsinf(cgnsinf[i], &data);
+        }
+    }
+    double t1 = now_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (int i = 0; i < cgnsinf_count; i++) {
+            memset(&data, 0, sizeof(data));
+            sink += sscanf_cgnsinf(cgnsinf[i], &data);
+        }
+    }
+    double t2 = now_ns();
+    sim808_nmea_init(&parser);
+    for (long n = 0; n < iterations; n++) {
+        for (size_t i = 0; i < nmea_len; i++) {
+            sink += sim808_nmea_feed(&parser, nmea[i]);
+        }
+    }
+    double t3 = now_ns();
+
+    double lines = (double)iterations * cgnsinf_count;
+    printf("\n%ld iterations\n", iterations);
+    printf("  CGNSINF tokenizer  %7.1f ns/line\n", (t1 - t0) / lines);
+    printf("  CGNSINF sscanf     %7.1f ns/line\n", (t2 - t1) / lines);
+    printf("  NMEA stream        %7.1f ns/byte\n", (t3 - t2) / ((double)iterations * nmea_len));
+    (void)sink;
+}
+
+int main(int argc, char** argv) {
+    const char* path = (argc > 1) ? argv[1] : "tools/gnss_corpus.txt";
+    long iterations = (argc > 2) ? atol(argv[2]) : 10000;
+
+    if (!load_corpus(path)) {
+        return 2;
+    }
+
+    check_cgnsinf();
+    check_nmea();
+    bench(iterations);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Local ingest endpoint for sim808_http_upload().
+
+Accepts chunked uploads addressed as
+
+  POST <path>?id=<upload_id>&offset=<offset>&total=<total>
+
+A chunk is appended when offset equals the bytes already held for the
+upload id and answered 204. Any other offset is answered 409 with the
+expected offset as the body, which is how the device resumes. Completed
+uploads are written to --out/<upload_id>.
+
+Example, with the modem emulator forwarding HTTPACTION here:
+  tools/http_ingest_server.py --port 8080 --out /tmp/ingest
+  tools/sim808_emulator.py --link /tmp/sim808 --http 127.0.0.1:8080
+"""
+
+import argparse
+import http.server
+import os
+import sys
+import urllib.parse
+
+
+class IngestHandler(http.server.BaseHTTPRequestHandler):
+    uploads = {}        # upload id -> bytearray
+    out_dir = "."
+    drop_rate = 0       # Answer every n-th chunk with 500, 0 disables
+    requests = 0
+
+    def reply(self, status, body=b""):
+        self.send_response(status)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_POST(self):
+        query = urllib.parse.parse_qs(urllib.parse.urlsplit(self.path).query)
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        try:
+            upload_id = query["id"][0]
+            offset = int(query["offset"][0])
+            total = int(query["total"][0])
+        except (KeyError, ValueError):
+            self.reply(400)
+            return
+
+        cls = type(self)
+        cls.requests += 1
+        if cls.drop_rate and cls.requests % cls.drop_rate == 0:
+            self.reply(500)
+            return
+
+        data = cls.uploads.setdefault(upload_id, bytearray())
+        if offset != len(data):
+            self.reply(409, str(len(data)).encode())
+            return
+
+        data += body
+        if len(data) >= total:
+            path = os.path.join(cls.out_dir, os.path.basename(upload_id))
+            with open(path, "wb") as f:
+                f.write(data)
+            sys.stdout.write("upload %s complete, %d bytes -> %s\n" % (upload_id, len(data), path))
+            del cls.uploads[upload_id]
+        self.reply(204)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--out", default=".", help="directory for completed uploads")
+    parser.add_argument("--drop", type=int, default=0,
+                        help="answer every n-th chunk with 500 to exercise retries")
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+    IngestHandler.out_dir = args.out
+    IngestHandler.drop_rate = args.drop
+
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", args.port), IngestHandler)
+    print("Ingest server on 127.0.0.1:%d" % args.port, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
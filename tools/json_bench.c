@@ -0,0 +1,125 @@
+/*
+ * Host benchmark: cJSON tree + PrintUnformatted vs. json_writer for the
+ * realtime.location payload. Counts heap calls through cJSON_InitHooks,
+ * times both paths and checks the output is byte-identical.
+ *
+ * Builds on the host with the cJSON subset in tools/cJSON, or point -I and
+ * the cJSON.c path at $IDF_PATH/components/json/cJSON for the exact copy:
+ *   gcc -O2 -Iinclude -Itools/cJSON tools/json_bench.c src/json_writer.c \
+ *       tools/cJSON/cJSON.c -lm -o json_bench
+ *   ./json_bench [iterations]
+ */
+
+#include "cJSON.h"
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned long malloc_calls;
+static unsigned long free_calls;
+
+static void* counting_malloc(size_t size) {
+    malloc_calls++;
+    return malloc(size);
+}
+
+static void counting_free(void* ptr) {
+    if (ptr != NULL) {
+        free_calls++;
+    }
+    free(ptr);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Same sample the tracking task publishes, floats as on the device
+static const char* vehicle_id = "VH-000123";
+static const char* timestamp = "2024-05-01T12:34:56Z";
+static const float latitude = -7.2575f;
+static const float longitude = 112.7521f;
+static const float altitude = 12.6f;
+
+static char* build_cjson(void) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "vehicle_id", vehicle_id);
+    cJSON_AddNumberToObject(root, "latitude", latitude);
+    cJSON_AddNumberToObject(root, "longitude", longitude);
+    cJSON_AddNumberToObject(root, "altitude", altitude);
+    cJSON_AddStringToObject(root, "timestamp", timestamp);
+    char *payload = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return payload;
+}
+
+static const char* build_writer(char* buf, size_t size) {
+    json_writer_t w;
+    json_writer_init(&w, buf, size);
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_number(&w, "latitude", latitude);
+    json_add_number(&w, "longitude", longitude);
+    json_add_number(&w, "altitude", altitude);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+int main(int argc, char** argv) {
+    long iterations = (argc > 1) ? atol(argv[1]) : 100000;
+    char buf[512];
+
+    cJSON_Hooks hooks = { .malloc_fn = counting_malloc, .free_fn = counting_free };
+    cJSON_InitHooks(&hooks);
+
+    // Byte-for-byte check first
+    char *reference = build_cjson();
+    const char *ours = build_writer(buf, sizeof(buf));
+    if (ours == NULL || strcmp(reference, ours) != 0) {
+        fprintf(stderr, "MISMATCH\n  cJSON:  %s\n  writer: %s\n", reference, ours ? ours : "(null)");
+        return 1;
+    }
+    printf("payload (%zu bytes): %s\n", strlen(ours), ours);
+    cJSON_free(reference);
+
+    // Not representable in JSON, written as null like cJSON does
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    json_begin_object(&w, NULL);
+    json_add_number(&w, "nan", NAN);
+    json_add_number(&w, "inf", -INFINITY);
+    json_end_object(&w);
+    ours = json_writer_finish(&w);
+    if (ours == NULL || strcmp(ours, "{\"nan\":null,\"inf\":null}") != 0) {
+        fprintf(stderr, "MISMATCH non-finite: %s\n", ours ? ours : "(null)");
+        return 1;
+    }
+
+    malloc_calls = free_calls = 0;
+    double start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        char *payload = build_cjson();
+        cJSON_free(payload);
+    }
+    double cjson_ns = (now_ns() - start) / iterations;
+    unsigned long cjson_mallocs = malloc_calls;
+
+    malloc_calls = free_calls = 0;
+    start = now_ns();
+    for (long i = 0; i < iterations; i++) {
+        build_writer(buf, sizeof(buf));
+    }
+    double writer_ns = (now_ns() - start) / iterations;
+
+    printf("cJSON:       %8.1f ns/payload, %.1f mallocs/payload\n",
+           cjson_ns, (double)cjson_mallocs / iterations);
+    printf("json_writer: %8.1f ns/payload, %.1f mallocs/payload\n",
+           writer_ns, (double)malloc_calls / iterations);
+    return 0;
+}
@@ -0,0 +1,407 @@
+/*
+ * Byte count of the MQTT session options in mqtt_vehicle_client: replays
+ * an hour of riding (a frame every second, one carrying a status change
+ * every 30 s, diagnostics every 5 minutes, a performance report at the
+ * end) over a cellular link that drops every 10 minutes, and counts the
+ * bytes on the wire for
+ *
+ *   3.1.1 clean     clean session, resubscribes after every reconnect
+ *   3.1.1 session   persistent session, resubscribes only when the
+ *                   broker lost it (the default)
+ *   5 + aliases     session expiry, topic aliases (MQTT_TOPIC_ALIASES,
+ *                   on when readings go out at QoS 0)
+ *
+ * once with readings at QoS 1 and once at QoS 0. As on the device, an
+ * alias is bound by the first publish of a topic on each connection and
+ * only QoS 0 publishes go out alias-only.
+ *
+ * Without arguments every packet the device sends is encoded and counted,
+ * broker replies are counted at their minimal size. With --broker the
+ * packets go to a real broker (mosquitto) and both directions are counted
+ * on the socket, so CONNACK properties and the broker's PUBACK forms are
+ * included. The ride runs back to back there, keepalive traffic is the
+ * same for all three and left out.
+ *
+ *   gcc -O2 -Iinclude tools/mqtt5_alias_bytes.c src/mqtt_codec.c -o mqtt5_alias_bytes
+ *   ./mqtt5_alias_bytes [vehicle_id]
+ *   mosquitto -p 1883 &
+ *   ./mqtt5_alias_bytes --broker 127.0.0.1:1883 [vehicle_id]
+ */
+
+#include "mqtt_codec.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define RIDE_S              3600
+#define RECONNECT_EVERY_S   600
+#define KEEPALIVE_S         60
+#define SESSION_EXPIRY_S    3600    // MQTT_SESSION_EXPIRY_S
+
+// Typical JSON payload sizes in bytes
+#define READING_BYTES       150
+#define STATUS_BYTES        190
+#define DIAG_BYTES          2900
+#define REPORT_BYTES        440
+
+static const char* const commands[] = {
+    "start_rent", "end_rent", "kill_vehicle", "set_encoding"
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+typedef enum { SCHEME_V3_CLEAN, SCHEME_V3_SESSION, SCHEME_V5_ALIASES, SCHEME_COUNT } scheme_t;
+
+static const char* const scheme_names[SCHEME_COUNT] = {
+    "3.1.1 clean", "3.1.1 session", "5 + aliases"
+};
+
+enum { TOPIC_FRAME, TOPIC_DIAG, TOPIC_PERFORMANCE, TOPIC_COUNT };
+
+typedef struct {
+    scheme_t scheme;
+    const char* vehicle_id;
+    char client_id[64];
+    char topics[TOPIC_COUNT][64];
+    int fd;                         // Broker socket, -1 to count offline
+    uint8_t rx[4096];
+    size_t rx_len;
+    uint16_t next_id;
+    unsigned bound;                 // Aliases bound on this connection
+    bool connected_before;
+    unsigned long up;
+    unsigned long down;
+    unsigned alias_only;
+    unsigned resumed;
+} link_t;
+
+static const char* broker_host = NULL;
+static const char* broker_port = "1883";
+static uint8_t tx[8192];
+static uint8_t zeros[DIAG_BYTES];
+
+static bool persistent(const link_t* l) {
+    return l->scheme != SCHEME_V3_CLEAN;
+}
+
+static bool v5(const link_t* l) {
+    return l->scheme == SCHEME_V5_ALIASES;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t v) {
+    *p++ = (uint8_t)(v >> 8);
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t* put_string(uint8_t* p, const char* s) {
+    size_t len = strlen(s);
+    p = put_u16(p, (uint16_t)len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/**
+ * Prepend the fixed header to a body staged at tx + 5
+ */
+static size_t finish_packet(uint8_t first, size_t body_len) {
+    uint8_t varint[4];
+    int n = mqtt_encode_varint((uint32_t)body_len, varint);
+    uint8_t* start = tx + 5 - 1 - n;
+    start[0] = first;
+    memcpy(start + 1, varint, n);
+    memmove(tx, start, 1 + n + body_len);
+    return 1 + n + body_len;
+}
+
+// ============================================
+// Packets the device sends
+// ============================================
+
+static size_t encode_connect(const link_t* l, bool clean) {
+    if (!v5(l)) {
+        mqtt_connect_options_t options = {
+            .client_id = l->client_id,
+            .username = "vehicle",
+            .password = "vehicle123",
+            .keepalive = KEEPALIVE_S,
+            .clean_session = clean,
+        };
+        return (size_t)mqtt_encode_connect(tx, sizeof(tx), &options);
+    }
+
+    uint8_t* p = tx + 5;
+    p = put_string(p, "MQTT");
+    *p++ = 5;
+    *p++ = 0xC0 | (clean ? 0x02 : 0x00);    // Username, password
+    p = put_u16(p, KEEPALIVE_S);
+    *p++ = 5;                               // Properties: Session Expiry Interval
+    *p++ = 0x11;
+    uint32_t expiry = clean ? 0 : SESSION_EXPIRY_S;
+    *p++ = (uint8_t)(expiry >> 24);
+    *p++ = (uint8_t)(expiry >> 16);
+    *p++ = (uint8_t)(expiry >> 8);
+    *p++ = (uint8_t)expiry;
+    p = put_string(p, l->client_id);
+    p = put_string(p, "vehicle");
+    p = put_string(p, "vehicle123");
+    return finish_packet(MQTT_PKT_CONNECT << 4, p - (tx + 5));
+}
+
+static size_t encode_subscribe(link_t* l, const char* topic) {
+    uint16_t id = ++l->next_id ? l->next_id : ++l->next_id;
+    if (!v5(l)) {
+        return (size_t)mqtt_encode_subscribe(tx, sizeof(tx), id, topic, 1);
+    }
+
+    uint8_t* p = tx + 5;
+    p = put_u16(p, id);
+    *p++ = 0;                               // No properties
+    p = put_string(p, topic);
+    *p++ = 1;                               // QoS 1
+    return finish_packet((MQTT_PKT_SUBSCRIBE << 4) | 0x02, p - (tx + 5));
+}
+
+static size_t encode_publish(link_t* l, int topic, size_t payload_len, int qos) {
+    uint16_t id = 0;
+    if (qos > 0) {
+        id = ++l->next_id ? l->next_id : ++l->next_id;
+    }
+    if (!v5(l)) {
+        return (size_t)mqtt_encode_publish(tx, sizeof(tx), l->topics[topic], zeros, payload_len,
+                                           (uint8_t)qos, false, id);
+    }
+
+    const char* wire_topic = l->topics[topic];
+    bool alias = false;
+    if (!(l->bound & (1u << topic))) {
+        l->bound |= 1u << topic;
+        alias = true;
+    } else if (qos == 0) {
+        wire_topic = "";
+        alias = true;
+        l->alias_only++;
+    }
+
+    uint8_t* p = tx + 5;
+    p = put_string(p, wire_topic);
+    if (qos > 0) {
+        p = put_u16(p, id);
+    }
+    if (alias) {
+        *p++ = 3;                           // Properties: Topic Alias
+        *p++ = 0x23;
+        p = put_u16(p, (uint16_t)(topic + 1));
+    } else {
+        *p++ = 0;
+    }
+    memcpy(p, zeros, payload_len);
+    p += payload_len;
+    return finish_packet((MQTT_PKT_PUBLISH << 4) | (qos << 1), p - (tx + 5));
+}
+
+// ============================================
+// Transport
+// ============================================
+
+static bool broker_open(link_t* l) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res;
+    if (getaddrinfo(broker_host, broker_port, &hints, &res) != 0) {
+        return false;
+    }
+    l->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    bool ok = l->fd >= 0 && connect(l->fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    if (!ok) {
+        return false;
+    }
+    struct timeval timeout = { .tv_sec = 5 };
+    setsockopt(l->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    l->rx_len = 0;
+    return true;
+}
+
+static void broker_close(link_t* l) {
+    if (l->fd >= 0) {
+        close(l->fd);
+        l->fd = -1;
+    }
+}
+
+static void send_packet(link_t* l, size_t len) {
+    l->up += len;
+    if (l->fd >= 0 && write(l->fd, tx, len) != (ssize_t)len) {
+        fprintf(stderr, "write to broker failed\n");
+        exit(1);
+    }
+}
+
+/**
+ * Wait for a reply, offline count its minimal size
+ * @return First body byte (CONNACK session present flag)
+ */
+static int await(link_t* l, uint8_t type, size_t offline_len) {
+    if (l->fd < 0) {
+        l->down += offline_len;
+        return 0;
+    }
+
+    while (1) {
+        mqtt_packet_t pkt;
+        int framed = mqtt_decode_packet(l->rx, l->rx_len, &pkt);
+        if (framed > 0) {
+            int first = pkt.remaining_length > 0 ? pkt.body[0] : 0;
+            l->down += framed;
+            memmove(l->rx, l->rx + framed, l->rx_len - framed);
+            l->rx_len -= framed;
+            if (pkt.type == type) {
+                return first;
+            }
+            continue;
+        }
+        ssize_t n = read(l->fd, l->rx + l->rx_len, sizeof(l->rx) - l->rx_len);
+        if (n <= 0) {
+            fprintf(stderr, "no reply (packet type %u) from broker\n", type);
+            exit(1);
+        }
+        l->rx_len += n;
+    }
+}
+
+// ============================================
+// Ride
+// ============================================
+
+static void session_connect(link_t* l) {
+    if (broker_host != NULL && !broker_open(l)) {
+        fprintf(stderr, "can't connect to %s:%s\n", broker_host, broker_port);
+        exit(1);
+    }
+    l->bound = 0;
+
+    // The first connect of a run starts from nothing, also on the broker
+    bool clean = !persistent(l) || !l->connected_before;
+    send_packet(l, encode_connect(l, clean));
+    bool session_present = await(l, MQTT_PKT_CONNACK, v5(l) ? 5 : 4) & 0x01;
+    if (l->fd < 0) {
+        session_present = !clean;
+    }
+    l->connected_before = true;
+
+    if (session_present) {
+        l->resumed++;
+        return;
+    }
+    for (size_t i = 0; i < COMMAND_COUNT; i++) {
+        char topic[128];
+        snprintf(topic, sizeof(topic), "control.%s.%s", commands[i], l->vehicle_id);
+        send_packet(l, encode_subscribe(l, topic));
+        await(l, MQTT_PKT_SUBACK, v5(l) ? 6 : 5);
+    }
+}
+
+static void session_disconnect(link_t* l) {
+    tx[0] = MQTT_PKT_DISCONNECT << 4;
+    tx[1] = 0;
+    send_packet(l, 2);
+    broker_close(l);
+}
+
+static void publish(link_t* l, int topic, size_t payload_len, int qos) {
+    send_packet(l, encode_publish(l, topic, payload_len, qos));
+    if (qos > 0) {
+        await(l, MQTT_PKT_PUBACK, 4);
+    }
+}
+
+static unsigned long run(scheme_t scheme, const char* vehicle_id, int reading_qos,
+                         unsigned long baseline) {
+    static link_t l;
+    memset(&l, 0, sizeof(l));
+    l.scheme = scheme;
+    l.vehicle_id = vehicle_id;
+    l.fd = -1;
+    snprintf(l.client_id, sizeof(l.client_id), "%s-bytes-%d%d-%d", vehicle_id, scheme,
+             reading_qos, (int)getpid());
+    snprintf(l.topics[TOPIC_FRAME], sizeof(l.topics[0]), "realtime.frame.%s", vehicle_id);
+    snprintf(l.topics[TOPIC_DIAG], sizeof(l.topics[0]), "diag.modem.%s", vehicle_id);
+    snprintf(l.topics[TOPIC_PERFORMANCE], sizeof(l.topics[0]), "report.performance.%s",
+             vehicle_id);
+
+    session_connect(&l);
+    for (int t = 1; t <= RIDE_S; t++) {
+        if (t % RECONNECT_EVERY_S == 0) {
+            // Coverage gap: the link is gone, the broker may keep the session
+            broker_close(&l);
+            session_connect(&l);
+        }
+        if (t % 30 == 0) {
+            publish(&l, TOPIC_FRAME, STATUS_BYTES, 1);
+        } else {
+            publish(&l, TOPIC_FRAME, READING_BYTES, reading_qos);
+        }
+        if (t % 300 == 0) {
+            publish(&l, TOPIC_DIAG, DIAG_BYTES, 0);
+        }
+    }
+    publish(&l, TOPIC_PERFORMANCE, REPORT_BYTES, 1);
+    session_disconnect(&l);
+
+    // Don't leave a session behind on the broker
+    if (broker_host != NULL && persistent(&l)) {
+        unsigned long up = l.up, down = l.down;
+        if (broker_open(&l)) {
+            send_packet(&l, encode_connect(&l, true));
+            await(&l, MQTT_PKT_CONNACK, 0);
+            session_disconnect(&l);
+        }
+        l.up = up;
+        l.down = down;
+    }
+
+    unsigned long total = l.up + l.down;
+    printf("  %-14s %8lu up %7lu down %8lu total", scheme_names[scheme], l.up, l.down, total);
+    if (baseline > 0) {
+        printf("  (%+.1f%%)", 100.0 * ((double)total - (double)baseline) / (double)baseline);
+    }
+    printf("  %u resumed", l.resumed);
+    if (v5(&l)) {
+        printf(", %u alias-only", l.alias_only);
+    }
+    printf("\n");
+    return total;
+}
+
+int main(int argc, char** argv) {
+    const char* vehicle_id = "VH-24A1C3F09B";
+    static char host[256];
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--broker") == 0 && i + 1 < argc) {
+            snprintf(host, sizeof(host), "%s", argv[++i]);
+            char* colon = strrchr(host, ':');
+            if (colon != NULL) {
+                *colon = '\0';
+                broker_port = colon + 1;
+            }
+            broker_host = host;
+        } else {
+            vehicle_id = argv[i];
+        }
+    }
+
+    printf("vehicle %s, %d s ride, reconnect every %d s, %s\n", vehicle_id, RIDE_S,
+           RECONNECT_EVERY_S, broker_host ? "measured on the broker socket" : "encoded offline");
+    for (int qos = 1; qos >= 0; qos--) {
+        printf("readings at QoS %d\n", qos);
+        unsigned long baseline = run(SCHEME_V3_CLEAN, vehicle_id, qos, 0);
+        run(SCHEME_V3_SESSION, vehicle_id, qos, baseline);
+        run(SCHEME_V5_ALIASES, vehicle_id, qos, baseline);
+    }
+    return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * Host unit tests and throughput benchmark of the MQTT 3.1.1 codec used by
+ * the SIM808 transport (sim808_mqtt.c).
+ *
+ * The tests cover varint limits, every encoder against hand-assembled
+ * packets from the specification, buffer-too-small and invalid-argument
+ * errors, stream framing fed one byte at a time, the decoders on truncated
+ * and malformed input, and packet id allocation and in-flight tracking.
+ * The benchmark then encodes and frames realtime.frame-sized PUBLISH
+ * packets the way the batcher and the receive task do.
+ *
+ *   gcc -O2 -Iinclude tools/mqtt_codec_test.c src/mqtt_codec.c -o mqtt_codec_test
+ *   ./mqtt_codec_test [iterations]
+ */
+
+#include "mqtt_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static int tests;
+static int failures;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char* what, int line) {
+    tests++;
+    if (!ok) {
+        printf("FAIL line %d: %s\n", line, what);
+        failures++;
+    }
+}
+
+static bool bytes_equal(const uint8_t* got, int got_len, const uint8_t* want, size_t want_len) {
+    return got_len == (int)want_len && memcmp(got, want, want_len) == 0;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void test_varint(void) {
+    static const struct {
+        uint32_t value;
+        uint8_t bytes[4];
+        int len;
+    } cases[] = {
+        { 0, { 0x00 }, 1 },
+        { 127, { 0x7F }, 1 },
+        { 128, { 0x80, 0x01 }, 2 },
+        { 16383, { 0xFF, 0x7F }, 2 },
+        { 16384, { 0x80, 0x80, 0x01 }, 3 },
+        { 2097151, { 0xFF, 0xFF, 0x7F }, 3 },
+        { 2097152, { 0x80, 0x80, 0x80, 0x01 }, 4 },
+        { MQTT_MAX_REMAINING_LENGTH, { 0xFF, 0xFF, 0xFF, 0x7F }, 4 },
+    };
+    uint8_t out[4];
+    uint32_t value;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int len = mqtt_encode_varint(cases[i].value, out);
+        CHECK(bytes_equal(out, len, cases[i].bytes, cases[i].len));
+        CHECK(mqtt_decode_varint(cases[i].bytes, cases[i].len, &value) == cases[i].len);
+        CHECK(value == cases[i].value);
+        // One byte short
+        CHECK(mqtt_decode_varint(cases[i].bytes, cases[i].len - 1, &value) == MQTT_CODEC_INCOMPLETE);
+    }
+
+    CHECK(mqtt_encode_varint(MQTT_MAX_REMAINING_LENGTH + 1, out) == MQTT_CODEC_ERR_MALFORMED);
+    static const uint8_t five_bytes[] = { 0x80, 0x80, 0x80, 0x80, 0x01 };
+    CHECK(mqtt_decode_varint(five_bytes, sizeof(five_bytes), &value) == MQTT_CODEC_ERR_MALFORMED);
+}
+
+static void test_connect(void) {
+    static const uint8_t want[] = {
+        0x10, 0x1D,                                     // CONNECT, remaining 29
+        0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04,           // Protocol name, level 4
+        0xC2, 0x00, 0x3C,                               // User, password, clean; 60 s
+        0x00, 0x05, 'V', 'H', '-', '0', '1',
+        0x00, 0x03, 'v', 'e', 'h',
+        0x00, 0x05, 'p', 'a', 's', 's', '1',
+    };
+    mqtt_connect_options_t opts = {
+        .client_id = "VH-01",
+        .username = "veh",
+        .password = "pass1",
+        .keepalive = 60,
+        .clean_session = true,
+    };
+    uint8_t buf[64];
+
+    CHECK(bytes_equal(buf, mqtt_encode_connect(buf, sizeof(buf), &opts), want, sizeof(want)));
+    CHECK(mqtt_encode_connect(buf, sizeof(want) - 1, &opts) == MQTT_CODEC_ERR_BUFFER);
+
+    // No credentials, persistent session
+    static const uint8_t bare[] = {
+        0x10, 0x0E, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x00, 0x00, 0x0A,
+        0x00, 0x02, 'i', 'd',
+    };
+    opts = (mqtt_connect_options_t){ .client_id = "id", .username = "", .keepalive = 10 };
+    CHECK(bytes_equal(buf, mqtt_encode_connect(buf, sizeof(buf), &opts), bare, sizeof(bare)));
+}
+
+static void test_publish(void) {
+    static const uint8_t qos0[] = {
+        0x30, 0x07, 0x00, 0x03, 'a', '/', 'b', 'h', 'i',
+    };
+    static const uint8_t qos1_retain[] = {
+        0x33, 0x09, 0x00, 0x03, 'a', '/', 'b', 0x12, 0x34, 'h', 'i',
+    };
+    uint8_t buf[600];
+    uint8_t header[16];
+
+    CHECK(bytes_equal(buf, mqtt_encode_publish(buf, sizeof(buf), "a/b", "hi", 2, 0, false, 0),
+                      qos0, sizeof(qos0)));
+    CHECK(bytes_equal(buf, mqtt_encode_publish(buf, sizeof(buf), "a/b", "hi", 2, 1, true, 0x1234),
+                      qos1_retain, sizeof(qos1_retain)));
+
+    // Header alone plus the payload streamed after it is the same packet
+    int header_len = mqtt_encode_publish_header(header, sizeof(header), "a/b", 2, 1, true, 0x1234);
+    CHECK(header_len == (int)sizeof(qos1_retain) - 2);
+    CHECK(memcmp(header, qos1_retain, header_len) == 0);
+
+    // Two byte remaining length from 128 bytes on
+    char payload[500];
+    memset(payload, 'x', sizeof(payload));
+    int len = mqtt_encode_publish(buf, sizeof(buf), "t", payload, 123, 0, false, 0);
+    CHECK(len == 2 + 3 + 123 && buf[1] == 126);
+    len = mqtt_encode_publish(buf, sizeof(buf), "t", payload, 500, 1, false, 7);
+    CHECK(len == 3 + 5 + 500 && buf[1] == 0xF9 && buf[2] == 0x03);
+
+    // Errors: empty topic, QoS 2, QoS 1 without id, no room for the payload
+    CHECK(mqtt_encode_publish(buf, sizeof(buf), "", "hi", 2, 0, false, 0) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_publish(buf, sizeof(buf), "a", "hi", 2, 2, false, 1) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_publish(buf, sizeof(buf), "a", "hi", 2, 1, false, 0) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_publish(buf, 4, "a/b", "hi", 2, 0, false, 0) == MQTT_CODEC_ERR_BUFFER);
+    CHECK(mqtt_encode_publish(buf, sizeof(qos0) - 1, "a/b", "hi", 2, 0, false, 0) == MQTT_CODEC_ERR_BUFFER);
+}
+
+static void test_small_packets(void) {
+    static const uint8_t subscribe[] = {
+        0x82, 0x0A, 0x00, 0x01, 0x00, 0x05, 'c', 't', 'l', '/', '#', 0x01,
+    };
+    static const uint8_t puback[] = { 0x40, 0x02, 0xBE, 0xEF };
+    static const uint8_t pingreq[] = { 0xC0, 0x00 };
+    static const uint8_t disconnect[] = { 0xE0, 0x00 };
+    uint8_t buf[32];
+
+    CHECK(bytes_equal(buf, mqtt_encode_subscribe(buf, sizeof(buf), 1, "ctl/#", 1),
+                      subscribe, sizeof(subscribe)));
+    CHECK(mqtt_encode_subscribe(buf, sizeof(buf), 0, "ctl/#", 1) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_subscribe(buf, sizeof(buf), 1, "ctl/#", 3) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_subscribe(buf, sizeof(subscribe) - 1, 1, "ctl/#", 1) == MQTT_CODEC_ERR_BUFFER);
+
+    CHECK(bytes_equal(buf, mqtt_encode_puback(buf, sizeof(buf), 0xBEEF), puback, sizeof(puback)));
+    CHECK(mqtt_encode_puback(buf, 3, 1) == MQTT_CODEC_ERR_BUFFER);
+    CHECK(bytes_equal(buf, mqtt_encode_empty(buf, sizeof(buf), MQTT_PKT_PINGREQ),
+                      pingreq, sizeof(pingreq)));
+    CHECK(bytes_equal(buf, mqtt_encode_empty(buf, sizeof(buf), MQTT_PKT_DISCONNECT),
+                      disconnect, sizeof(disconnect)));
+    CHECK(mqtt_encode_empty(buf, sizeof(buf), MQTT_PKT_PUBACK) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_encode_empty(buf, 1, MQTT_PKT_PINGREQ) == MQTT_CODEC_ERR_BUFFER);
+}
+
+static void test_decode(void) {
+    // What the broker sends after CONNECT and SUBSCRIBE, back to back
+    static const uint8_t stream[] = {
+        0x20, 0x02, 0x01, 0x00,                         // CONNACK, session present
+        0x90, 0x03, 0x00, 0x01, 0x01,                   // SUBACK id 1, QoS 1
+        0x32, 0x0A, 0x00, 0x03, 'c', '/', 'k',          // PUBLISH QoS 1 id 5
+        0x00, 0x05, '{', '}', '!',
+        0x40, 0x02, 0x00, 0x07,                         // PUBACK id 7
+        0xD0, 0x00,                                     // PINGRESP
+    };
+    mqtt_packet_t pkt;
+    mqtt_publish_t pub;
+    bool session_present;
+    uint8_t code, qos;
+    uint16_t id;
+    size_t offset = 0;
+    int len;
+
+    // Incomplete until the last byte of each packet is there
+    for (size_t avail = 0; avail < 4; avail++) {
+        CHECK(mqtt_decode_packet(stream, avail, &pkt) == MQTT_CODEC_INCOMPLETE);
+    }
+
+    len = mqtt_decode_packet(stream + offset, sizeof(stream) - offset, &pkt);
+    CHECK(len == 4 && pkt.type == MQTT_PKT_CONNACK);
+    CHECK(mqtt_decode_connack(&pkt, &session_present, &code) == 0 && session_present &&
+          code == MQTT_CONNACK_ACCEPTED);
+    CHECK(mqtt_decode_ack(&pkt, &id) == MQTT_CODEC_ERR_MALFORMED);
+    offset += len;
+
+    len = mqtt_decode_packet(stream + offset, sizeof(stream) - offset, &pkt);
+    CHECK(len == 5 && mqtt_decode_suback(&pkt, &id, &qos) == 0 && id == 1 && qos == 1);
+    offset += len;
+
+    len = mqtt_decode_packet(stream + offset, sizeof(stream) - offset, &pkt);
+    CHECK(len == 12 && mqtt_decode_publish(&pkt, &pub) == 0);
+    CHECK(pub.qos == 1 && !pub.retain && !pub.dup && pub.packet_id == 5);
+    CHECK(pub.topic_len == 3 && memcmp(pub.topic, "c/k", 3) == 0);
+    CHECK(pub.payload_len == 3 && memcmp(pub.payload, "{}!", 3) == 0);
+    offset += len;
+
+    len = mqtt_decode_packet(stream + offset, sizeof(stream) - offset, &pkt);
+    CHECK(len == 4 && mqtt_decode_ack(&pkt, &id) == 0 && id == 7);
+    CHECK(mqtt_decode_connack(&pkt, &session_present, &code) == MQTT_CODEC_ERR_MALFORMED);
+    offset += len;
+
+    len = mqtt_decode_packet(stream + offset, sizeof(stream) - offset, &pkt);
+    CHECK(len == 2 && pkt.type == MQTT_PKT_PINGRESP);
+    offset += len;
+    CHECK(offset == sizeof(stream));
+
+    // Malformed: reserved type 0 and 15, topic longer than the packet,
+    // QoS 1 without room for its id, QoS 3
+    static const uint8_t type0[] = { 0x00, 0x00 };
+    static const uint8_t type15[] = { 0xF0, 0x00 };
+    static const uint8_t long_topic[] = { 0x30, 0x04, 0x00, 0x09, 'a', 'b' };
+    static const uint8_t no_id[] = { 0x32, 0x03, 0x00, 0x01, 'a' };
+    static const uint8_t qos3[] = { 0x36, 0x05, 0x00, 0x01, 'a', 0x00, 0x01 };
+    CHECK(mqtt_decode_packet(type0, sizeof(type0), &pkt) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_decode_packet(type15, sizeof(type15), &pkt) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_decode_packet(long_topic, sizeof(long_topic), &pkt) > 0 &&
+          mqtt_decode_publish(&pkt, &pub) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_decode_packet(no_id, sizeof(no_id), &pkt) > 0 &&
+          mqtt_decode_publish(&pkt, &pub) == MQTT_CODEC_ERR_MALFORMED);
+    CHECK(mqtt_decode_packet(qos3, sizeof(qos3), &pkt) > 0 &&
+          mqtt_decode_publish(&pkt, &pub) == MQTT_CODEC_ERR_MALFORMED);
+
+    CHECK(strcmp(mqtt_connack_reason(MQTT_CONNACK_NOT_AUTHORIZED), "not authorized") == 0);
+    CHECK(strcmp(mqtt_connack_reason(42), "unknown") == 0);
+}
+
+static void test_round_trip(void) {
+    uint8_t buf[300];
+    char payload[200];
+    mqtt_packet_t pkt;
+    mqtt_publish_t pub;
+
+    srand(1);
+    for (int i = 0; i < 1000; i++) {
+        size_t payload_len = (size_t)(rand() % (int)sizeof(payload));
+        uint8_t qos = (uint8_t)(rand() % 2);
+        uint16_t id = (uint16_t)(1 + rand() % 65535);
+        for (size_t j = 0; j < payload_len; j++) {
+            payload[j] = (char)rand();
+        }
+
+        int len = mqtt_encode_publish(buf, sizeof(buf), "realtime.frame.VH-01", payload,
+                                      payload_len, qos, i & 1, id);
+        bool ok = len > 0 && mqtt_decode_packet(buf, (size_t)len, &pkt) == len &&
+                  mqtt_decode_publish(&pkt, &pub) == 0 && pub.qos == qos &&
+                  pub.retain == (i & 1) && pub.packet_id == (qos ? id : 0) &&
+                  pub.topic_len == 20 && memcmp(pub.topic, "realtime.frame.VH-01", 20) == 0 &&
+                  pub.payload_len == payload_len && memcmp(pub.payload, payload, payload_len) == 0;
+        CHECK(ok);
+        if (!ok) {
+            break;
+        }
+    }
+}
+
+static void test_session(void) {
+    mqtt_session_t session;
+    uint16_t ids[MQTT_INFLIGHT_MAX];
+
+    mqtt_session_init(&session);
+    CHECK(mqtt_session_next_id(&session) == 1);
+    CHECK(mqtt_session_inflight(&session) == 0);
+
+    // Fill every slot, the next one is refused
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        ids[i] = mqtt_session_next_id(&session);
+        CHECK(mqtt_session_track(&session, ids[i]));
+    }
+    CHECK(mqtt_session_inflight(&session) == MQTT_INFLIGHT_MAX);
+    CHECK(!mqtt_session_track(&session, mqtt_session_next_id(&session)));
+
+    // Acks free slots once, unknown ids are ignored
+    CHECK(mqtt_session_ack(&session, ids[3]));
+    CHECK(!mqtt_session_ack(&session, ids[3]));
+    CHECK(!mqtt_session_ack(&session, 0xFFFF));
+    CHECK(mqtt_session_inflight(&session) == MQTT_INFLIGHT_MAX - 1);
+
+    // Wrap-around skips 0 and ids still in flight
+    mqtt_session_init(&session);
+    CHECK(mqtt_session_track(&session, 1));
+    session.next_id = 0xFFFF;
+    CHECK(mqtt_session_next_id(&session) == 0xFFFF);
+    CHECK(mqtt_session_next_id(&session) == 2);
+}
+
+/**
+ * Encode and frame frame-sized publishes, as the batcher and rx task do
+ */
+static void bench(long iterations) {
+    static uint8_t stream[64 * 1024];
+    char payload[180];
+    mqtt_session_t session;
+    mqtt_packet_t pkt;
+    mqtt_publish_t pub;
+    size_t len = 0;
+    long packets = 0;
+    volatile size_t sink = 0;
+
+    memset(payload, 'x', sizeof(payload));
+    mqtt_session_init(&session);
+
+    double t0 = now_ns();
+    for (long n = 0; n < iterations; n++) {
+        len = 0;
+        packets = 0;
+        for (;;) {
+            uint16_t id = mqtt_session_next_id(&session);
+            int w = mqtt_encode_publish(stream + len, sizeof(stream) - len,
+                                        "realtime.frame.VH-000123", payload, sizeof(payload),
+                                        1, false, id);
+            if (w < 0) {
+                break;
+            }
+            len += (size_t)w;
+            packets++;
+        }
+    }
+    double t1 = now_ns();
+    for (long n = 0; n < iterations; n++) {
+        for (size_t offset = 0; offset < len;) {
+            int r = mqtt_decode_packet(stream + offset, len - offset, &pkt);
+            if (r <= 0 || mqtt_decode_publish(&pkt, &pub) != 0) {
+                break;
+            }
+            sink += pub.payload_len;
+            offset += (size_t)r;
+        }
+    }
+    double t2 = now_ns();
+
+    double total = (double)iterations * packets;
+    printf("\n%ld x %ld PUBLISH packets of %zu bytes\n", iterations, packets, len / packets);
+    printf("  encode  %6.1f ns/packet  %7.1f MB/s\n", (t1 - t0) / total,
+           total * (len / packets) / ((t1 - t0) / 1e3));
+    printf("  decode  %6.1f ns/packet  %7.1f MB/s\n", (t2 - t1) / total,
+           total * (len / packets) / ((t2 - t1) / 1e3));
+    (void)sink;
+}
+
+int main(int argc, char** argv) {
+    long iterations = (argc > 1) ? atol(argv[1]) : 2000;
+
+    test_varint();
+    test_connect();
+    test_publish();
+    test_small_packets();
+    test_decode();
+    test_round_trip();
+    test_session();
+    printf("%d checks, %d failures\n", tests, failures);
+
+    bench(iterations);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Host check of the outbox admission policy: replays a rental's publish
+ * schedule (a frame every second, a status change every 30 s, a track
+ * batch every 2 minutes, diagnostics every 5 minutes and a performance
+ * report every 10 minutes) over a link that stops acknowledging for a
+ * while, the case where esp-mqtt keeps every QoS 1 message in RAM.
+ * Compares the outbox with no limit against the policy, and checks that
+ * the outbox never passes the limit and no report is refused.
+ *
+ *   gcc -O2 -Iinclude tools/outbox_policy_sim.c src/outbox_policy.c -o outbox_policy_sim
+ *   ./outbox_policy_sim [stall_minutes]
+ */
+
+#include "outbox_policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Same values as mqtt_vehicle_client.h
+#define MQTT_OUTBOX_LIMIT   16384
+
+static const outbox_class_config_t classes[OUTBOX_CLASS_COUNT] = {
+    [OUTBOX_CLASS_REPORT] = { 1, 100 },
+    [OUTBOX_CLASS_STATUS] = { 1, 75 },
+    [OUTBOX_CLASS_TRACK] = { 1, 50 },
+    [OUTBOX_CLASS_READING] = { 1, 25 },
+    [OUTBOX_CLASS_DIAG] = { 0, 25 },
+};
+
+// Typical JSON sizes in bytes, plus topic and MQTT header
+static const uint32_t class_bytes[OUTBOX_CLASS_COUNT] = {
+    [OUTBOX_CLASS_REPORT] = 480,
+    [OUTBOX_CLASS_STATUS] = 230,
+    [OUTBOX_CLASS_TRACK] = 340,
+    [OUTBOX_CLASS_READING] = 190,
+    [OUTBOX_CLASS_DIAG] = 2900,
+};
+
+typedef struct {
+    uint32_t bytes;             // QoS 1 bytes waiting for PUBACK
+    uint32_t peak;
+    uint32_t offered[OUTBOX_CLASS_COUNT];
+} outbox_t;
+
+static int failures;
+
+static void publish(outbox_t* o, outbox_policy_t* p, outbox_class_t cls) {
+    uint32_t len = class_bytes[cls];
+    o->offered[cls]++;
+
+    if (p && outbox_policy_admit(p, cls, o->bytes, len, true) != OUTBOX_SEND) {
+        return;
+    }
+    // QoS 0 goes straight to the socket
+    if (classes[cls].qos > 0) {
+        o->bytes += len;
+        if (o->bytes > o->peak) {
+            o->peak = o->bytes;
+        }
+    }
+}
+
+static void run(outbox_policy_t* p, uint32_t stall_s, const char* name) {
+    outbox_t o = {0};
+
+    for (uint32_t t = 1; t <= stall_s; t++) {
+        publish(&o, p, (t % 30 == 0) ? OUTBOX_CLASS_STATUS : OUTBOX_CLASS_READING);
+        if (t % 120 == 0) {
+            publish(&o, p, OUTBOX_CLASS_TRACK);
+        }
+        if (t % 300 == 0) {
+            publish(&o, p, OUTBOX_CLASS_DIAG);
+        }
+        if (t % 600 == 0) {
+            publish(&o, p, OUTBOX_CLASS_REPORT);
+        }
+    }
+
+    printf("%-10s outbox peak %6u bytes\n", name, o.peak);
+    for (int cls = 0; cls < OUTBOX_CLASS_COUNT && p; cls++) {
+        const outbox_class_stats_t* s = &p->stats[cls];
+        printf("  %-9s offered %5u  sent %5u  deferred %5u  dropped %5u\n",
+               outbox_class_name((outbox_class_t)cls), o.offered[cls], s->sent, s->deferred,
+               s->dropped);
+    }
+
+    if (p && o.peak > MQTT_OUTBOX_LIMIT) {
+        printf("FAIL outbox passed the limit\n");
+        failures++;
+    }
+    // Reports alone fit, so none may be refused
+    uint32_t report_bytes = o.offered[OUTBOX_CLASS_REPORT] * class_bytes[OUTBOX_CLASS_REPORT];
+    if (p && report_bytes <= MQTT_OUTBOX_LIMIT / 4 &&
+        p->stats[OUTBOX_CLASS_REPORT].sent != o.offered[OUTBOX_CLASS_REPORT]) {
+        printf("FAIL report refused\n");
+        failures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t stall_s = (argc > 1) ? (uint32_t)atoi(argv[1]) * 60 : 60 * 60;
+    outbox_policy_t policy;
+
+    printf("%u minute stall\n", stall_s / 60);
+    run(NULL, stall_s, "unbounded");
+    outbox_policy_init(&policy, MQTT_OUTBOX_LIMIT, classes);
+    run(&policy, stall_s, "policy");
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
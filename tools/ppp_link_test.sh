@@ -0,0 +1,80 @@
+#!/bin/sh
+# PPP link test on a Linux host: the modem emulator answers the data call
+# and bridges it to pppd (the network side), and a second pppd dials it
+# over the emulator's pty exactly as the device does (AT+CGDCONT,
+# ATD*99***1#, CONNECT, LCP/IPCP). The emulator drops the call every
+# DROP_S seconds; the dialing pppd notices through LCP echoes and redials
+# ("persist"), like the sim808_ppp redial supervisor, so the test passes
+# when the link gets its address back after each drop.
+#
+# To test the firmware itself, point the board's modem UART at the
+# emulator instead of the second pppd:
+#   sudo tools/sim808_emulator.py --ppp --ppp-drop 60 --link /tmp/sim808
+#   socat /tmp/sim808,raw,echo=0 /dev/ttyUSB0,raw,echo=0,b115200
+# and watch for "PPP redialed" in the device log.
+#
+# Needs root (pppd) and python3.
+#   sudo tools/ppp_link_test.sh [drops]
+
+set -u
+
+DROPS=${1:-3}
+DROP_S=30
+LINK=/tmp/sim808_ppp_test
+LOCAL=10.64.0.2
+PEER=10.64.0.1
+DIR=$(dirname "$0")
+
+python3 "$DIR/sim808_emulator.py" --ppp --ppp-drop "$DROP_S" --link "$LINK" \
+    --ppp-local "$PEER" --ppp-remote "$LOCAL" &
+EMULATOR=$!
+PPPD=
+trap 'kill $PPPD $EMULATOR 2>/dev/null' EXIT INT TERM
+
+# Wait for the emulator's pty
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -e "$LINK" ] && break
+    sleep 0.5
+done
+
+pppd "$LINK" 115200 nodetach noauth local nocrtscts nodefaultroute \
+    persist holdoff 2 maxfail 0 lcp-echo-interval 2 lcp-echo-failure 3 \
+    connect "chat -v '' AT OK 'AT+CGDCONT=1,\"IP\",\"internet\"' OK ATD*99***1# CONNECT" &
+PPPD=$!
+
+# The dialing side holds "inet LOCAL peer PEER", the emulator's pppd the reverse
+link_up() {
+    ip -4 -o addr show | grep -q "inet $LOCAL peer $PEER"
+}
+
+# wait_for up|down seconds
+wait_for() {
+    for i in $(seq 1 "$2"); do
+        if link_up; then
+            [ "$1" = up ] && return 0
+        else
+            [ "$1" = down ] && return 0
+        fi
+        sleep 1
+    done
+    return 1
+}
+
+failures=0
+for drop in $(seq 0 "$DROPS"); do
+    if wait_for up "$DROP_S"; then
+        echo "link up after $drop drops"
+    else
+        echo "FAIL link still down after drop $drop"
+        failures=$((failures + 1))
+    fi
+    [ "$drop" -eq "$DROPS" ] && break
+    # Echo failures take about 8 s to notice the drop
+    if ! wait_for down $((DROP_S + 15)); then
+        echo "FAIL drop $((drop + 1)) not noticed"
+        failures=$((failures + 1))
+    fi
+done
+
+echo "$failures failures"
+[ "$failures" -eq 0 ]
@@ -0,0 +1,126 @@
+/*
+ * Host check of the report-by-exception filters: feeds the tracking task's
+ * sampling schedule (location and status every 5 s, battery every 10 s)
+ * for a parked vehicle with GPS and ADC noise, then for a drive, and
+ * compares the messages published against the fixed-interval schedule.
+ *
+ *   gcc -O2 -Iinclude tools/report_filter_sim.c src/report_filter.c -lm -o report_filter_sim
+ *   ./report_filter_sim [idle_hours]
+ */
+
+#include "report_filter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Same values as vehicle_tasks.c
+#define LOCATION_DEADBAND_M     25.0
+#define HEADING_DEADBAND_DEG    15.0
+#define HEADING_MIN_SPEED       5.0
+#define BATTERY_DEADBAND_V      0.05
+#define LOCATION_HEARTBEAT      300000
+#define STATUS_HEARTBEAT        300000
+#define BATTERY_HEARTBEAT       600000
+
+#define SAMPLE_MS               5000
+#define M_PER_DEG               111320.0
+
+static report_location_filter_t location_filter;
+static report_status_filter_t status_filter;
+static report_battery_filter_t battery_filter;
+static int failures;
+
+static double noise(double amplitude) {
+    return ((double)rand() / RAND_MAX * 2.0 - 1.0) * amplitude;
+}
+
+typedef struct {
+    uint32_t samples;
+    uint32_t published;
+    uint32_t max_silence_ms;    // Longest gap between reports of one topic
+} run_t;
+
+static void run(const char* name, uint32_t* now_ms, uint32_t duration_ms, bool driving) {
+    static uint32_t last_report[3];
+    run_t r = {0};
+    double lat = 48.137, lon = 11.575, course = 90.0, speed = 0.0, voltage = 12.6;
+    bool locked = !driving;
+
+    for (uint32_t t = 0; t < duration_ms; t += SAMPLE_MS, *now_ms += SAMPLE_MS) {
+        bool sent[3];
+
+        if (driving) {
+            // 30..70 km/h with gentle turns
+            speed = 50.0 + 20.0 * sin(t / 60000.0);
+            course = fmod(course + noise(4.0) + 360.0, 360.0);
+            double step = speed / 3.6 * SAMPLE_MS / 1000.0;
+            lat += step * cos(course * M_PI / 180.0) / M_PER_DEG;
+            lon += step * sin(course * M_PI / 180.0) / (M_PER_DEG * cos(lat * M_PI / 180.0));
+            voltage = 13.8 + noise(0.02);
+        } else {
+            // Parked receiver wanders a few meters and reports random courses
+            speed = fabs(noise(1.5));
+            course = fabs(noise(360.0));
+            voltage = 12.6 + noise(0.01);
+        }
+
+        double jitter_lat = noise(4.0) / M_PER_DEG;
+        double jitter_lon = noise(4.0) / M_PER_DEG;
+        sent[0] = report_location_due(&location_filter, *now_ms, lat + jitter_lat, lon + jitter_lon,
+                                      speed, course);
+        sent[1] = report_status_due(&status_filter, *now_ms, driving, locked, false);
+        r.samples += 2;
+        r.published += sent[0] + sent[1];
+
+        sent[2] = false;
+        if ((t / SAMPLE_MS) % 2 == 0) {
+            sent[2] = report_battery_due(&battery_filter, *now_ms, voltage);
+            r.samples++;
+            r.published += sent[2];
+        }
+
+        for (int i = 0; i < 3; i++) {
+            if (sent[i]) {
+                uint32_t gap = *now_ms - last_report[i];
+                if (last_report[i] && gap > r.max_silence_ms) r.max_silence_ms = gap;
+                last_report[i] = *now_ms;
+            }
+        }
+    }
+
+    printf("%-8s %6u samples, %5u published, %5.1f%% fewer, longest silence %u s\n", name,
+           r.samples, r.published, 100.0 * (r.samples - r.published) / r.samples,
+           r.max_silence_ms / 1000);
+
+    // Heartbeats keep every topic alive within one sample of its interval
+    if (r.max_silence_ms > BATTERY_HEARTBEAT + 2 * SAMPLE_MS) {
+        printf("FAIL %s heartbeat\n", name);
+        failures++;
+    }
+    if (!driving && r.published * 10 > r.samples) {
+        printf("FAIL %s reduction below 90%%\n", name);
+        failures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    int idle_hours = (argc > 1) ? atoi(argv[1]) : 20;
+    uint32_t now_ms = 1000;
+
+    srand(1);
+    report_location_filter_init(&location_filter, LOCATION_DEADBAND_M, HEADING_DEADBAND_DEG,
+                                HEADING_MIN_SPEED, LOCATION_HEARTBEAT);
+    report_status_filter_init(&status_filter, STATUS_HEARTBEAT);
+    report_battery_filter_init(&battery_filter, BATTERY_DEADBAND_V, BATTERY_HEARTBEAT);
+
+    run("idle", &now_ms, idle_hours * 3600000u, false);
+    run("drive", &now_ms, 2 * 3600000u, true);
+    run("idle", &now_ms, 2 * 3600000u, false);
+
+    printf("location %u reports (%u heartbeats), status %u (%u), battery %u (%u)\n",
+           location_filter.base.reports, location_filter.base.heartbeats,
+           status_filter.base.reports, status_filter.base.heartbeats,
+           battery_filter.base.reports, battery_filter.base.heartbeats);
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
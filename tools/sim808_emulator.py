@@ -0,0 +1,756 @@
+#!/usr/bin/env python3
+"""SIM808 modem emulator on a Linux pseudo-terminal.
+
+Speaks the AT subset used by the sim808_* driver so connection setup and
+publish throughput can be measured without a module or SIM card:
+
+  AT, ATE0/1, AT+IPR, AT&W, AT+CMGF, AT+CSQ, AT+CREG?, AT+CGATT?, AT+CPOWD
+  AT+CGNSPWR, AT+CGNSINF, AT+CGNSSEQ, AT+CGNSTST (NMEA streaming)
+  AT+SAPBR (bearer open/query/close)
+  AT+CIPSHUT, AT+CIPMUX, AT+CIPMODE, AT+CIPRXGET, AT+CIPSTART, AT+CIPSEND,
+  AT+CIPCLOSE, +++ / ATO in transparent mode
+  AT+HTTPINIT, AT+HTTPPARA, AT+HTTPDATA, AT+HTTPACTION, AT+HTTPREAD, AT+HTTPTERM
+  AT+CGDCONT, ATD*99***1#, ATH, +++ / ATO with --ppp
+
+TCP connections opened with CIPSTART are bridged to a real socket, normally a
+local MQTT broker (mosquitto), so the MQTT traffic is end to end. HTTP
+requests are made for real as well, --http redirects them to a local server
+such as tools/http_ingest_server.py.
+
+With --ppp the data call (ATD*99***1#) answers CONNECT and bridges the UART
+to pppd on a second pty, the peer the device's PPP netif negotiates with.
+--ppp-drop hangs the call up from the network side every N seconds
+(NO CARRIER) to exercise redialing. pppd usually needs root.
+
+Examples:
+  tools/sim808_emulator.py --link /tmp/sim808
+  tools/sim808_emulator.py --broker 127.0.0.1:1883 \\
+      --latency CIPSEND=120:40 --latency CIPSTART=1500:500 \\
+      --fail CIPSEND=0.02 --track drive.nmea
+  tools/sim808_emulator.py --http 127.0.0.1:8080 --latency HTTPACTION=2500:1000
+  sudo tools/sim808_emulator.py --ppp --ppp-drop 60 --link /tmp/sim808
+
+Latency is milliseconds with optional jitter (uniform +/-), failure rates are
+probabilities per command. Command names are matched without the "AT+"
+prefix; "*" sets the default. Tracks are NMEA logs recorded from the module
+(replayed one RMC epoch per second) or CSV lines "lat,lon[,alt,speed,course]".
+
+Per-command counts, injected latency and bridged bytes are printed on exit.
+"""
+
+import argparse
+import collections
+import datetime
+import heapq
+import os
+import random
+import re
+import selectors
+import socket
+import subprocess
+import sys
+import time
+import tty
+import urllib.error
+import urllib.parse
+import urllib.request
+
+ESCAPE_GUARD_S = 1.0
+NMEA_PERIOD_S = 1.0
+
+
+def nmea_checksum(body):
+    value = 0
+    for c in body.encode():
+        value ^= c
+    return "%02X" % value
+
+
+def nmea(body):
+    return "$%s*%s" % (body, nmea_checksum(body))
+
+
+def to_nmea_coord(value, deg_digits, hemis):
+    hemi = hemis[0] if value >= 0 else hemis[1]
+    value = abs(value)
+    degrees = int(value)
+    minutes = (value - degrees) * 60
+    return "%0*d%07.4f" % (deg_digits, degrees, minutes), hemi
+
+
+def from_nmea_coord(field, hemi, deg_digits):
+    if not field:
+        return None
+    value = int(field[:deg_digits]) + float(field[deg_digits:]) / 60
+    return -value if hemi in ("S", "W") else value
+
+
+class Fix:
+    def __init__(self, lat, lon, alt=0.0, speed=0.0, course=0.0, sentences=None):
+        self.lat = lat
+        self.lon = lon
+        self.alt = alt
+        self.speed = speed          # km/h
+        self.course = course
+        self.sentences = sentences  # Recorded NMEA epoch, replayed verbatim
+
+
+def load_track(path):
+    """Load a CSV or NMEA track into a list of fixes."""
+    fixes = []
+    epoch = []
+    alt = 0.0
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            if line.startswith("$"):
+                epoch.append(line)
+                fields = line.split("*")[0].split(",")
+                kind = fields[0][3:]
+                if kind == "GGA" and len(fields) > 9 and fields[9]:
+                    alt = float(fields[9])
+                elif kind == "RMC" and len(fields) > 8:
+                    lat = from_nmea_coord(fields[3], fields[4], 2)
+                    lon = from_nmea_coord(fields[5], fields[6], 3)
+                    if lat is not None and lon is not None:
+                        speed = float(fields[7] or 0) * 1.852
+                        course = float(fields[8] or 0)
+                        fixes.append(Fix(lat, lon, alt, speed, course, epoch))
+                    epoch = []
+                continue
+            values = [float(v) for v in line.split(",")]
+            fixes.append(Fix(*values[:5]))
+    if not fixes:
+        raise SystemExit("track %s has no fixes" % path)
+    return fixes
+
+
+def parse_rule(text, convert):
+    name, _, value = text.partition("=")
+    name = name.upper()
+    if name.startswith("AT+"):
+        name = name[3:]
+    return name, convert(value)
+
+
+def parse_latency(value):
+    base, _, jitter = value.partition(":")
+    return float(base) / 1000, float(jitter or 0) / 1000
+
+
+class Stats:
+    def __init__(self):
+        self.commands = collections.Counter()
+        self.failures = collections.Counter()
+        self.delay = collections.defaultdict(float)
+        self.bytes_up = 0
+        self.bytes_down = 0
+        self.started = time.monotonic()
+
+    def report(self, out):
+        elapsed = time.monotonic() - self.started
+        out.write("\n%-12s %8s %8s %10s\n" % ("command", "count", "failed", "avg ms"))
+        for name, count in sorted(self.commands.items()):
+            out.write("%-12s %8d %8d %10.1f\n" % (
+                name, count, self.failures[name], 1000 * self.delay[name] / count))
+        out.write("\nbridged %d bytes up, %d bytes down in %.1f s\n" % (
+            self.bytes_up, self.bytes_down, elapsed))
+
+
+class Modem:
+    def __init__(self, args):
+        self.args = args
+        self.master, slave = os.openpty()
+        tty.setraw(slave)
+        self.slave_name = os.ttyname(slave)
+        os.set_blocking(self.master, False)
+
+        self.sel = selectors.DefaultSelector()
+        self.sel.register(self.master, selectors.EVENT_READ, "uart")
+
+        self.stats = Stats()
+        self.latency = dict(args.latency)
+        self.fail = dict(args.fail)
+        self.track = load_track(args.track) if args.track else [Fix(-7.2575, 112.7521, 5.0)]
+        self.rng = random.Random(args.seed)
+
+        self.echo = True
+        self.line = bytearray()
+        self.pending = []               # (due, seq, bytes) heap of delayed output
+        self.seq = 0
+        self.busy_until = 0.0           # Commands are answered one at a time
+        self.queued = collections.deque()
+
+        self.gnss_on = False
+        self.gnss_started = 0.0
+        self.nmea_stream = False
+        self.next_nmea = 0.0
+
+        self.bearer_open = False
+        self.cipmode = 0
+        self.manual_rx = False
+        self.sock = None
+        self.sock_rx = bytearray()
+        self.send_remaining = 0         # Bytes owed after a CIPSEND/HTTPDATA prompt
+        self.send_target = "CIPSEND"
+        self.send_buf = bytearray()
+        self.data_mode = False          # Transparent pipe (TCP or PPP) active
+        self.last_uart_rx = 0.0
+        self.plus_count = 0
+        self.plus_time = 0.0
+
+        self.http_session = False
+        self.http_params = {}
+        self.http_body = b""
+        self.http_response = b""
+
+        self.pppd = None                # Peer of the data call
+        self.ppp_master = None
+        self.ppp_since = 0.0
+
+    # ---------------------------------------------------------------- output
+
+    def write_now(self, data):
+        try:
+            os.write(self.master, data)
+        except BlockingIOError:
+            pass
+
+    def respond(self, name, *lines, raw=b""):
+        """Queue a response after the command's configured latency."""
+        base, jitter = self.latency.get(name, self.latency.get("*", (0.0, 0.0)))
+        delay = max(0.0, base + self.rng.uniform(-jitter, jitter))
+        self.stats.delay[name] += delay
+        due = max(time.monotonic(), self.busy_until) + delay
+        payload = b"".join(b"\r\n" + l.encode() + b"\r\n" for l in lines) + raw
+        self.schedule(due, payload)
+        self.busy_until = due
+        return due
+
+    def schedule(self, due, payload):
+        self.seq += 1
+        heapq.heappush(self.pending, (due, self.seq, payload))
+
+    def urc(self, line):
+        self.schedule(time.monotonic(), b"\r\n" + line.encode() + b"\r\n")
+
+    def flush_pending(self, now):
+        while self.pending and self.pending[0][0] <= now:
+            _, _, payload = heapq.heappop(self.pending)
+            if callable(payload):
+                payload()
+            else:
+                self.write_now(payload)
+
+    # ------------------------------------------------------------------ GNSS
+
+    def current_fix(self):
+        index = int((time.monotonic() - self.gnss_started) / NMEA_PERIOD_S)
+        return self.track[index % len(self.track)]
+
+    def cgnsinf(self):
+        if not self.gnss_on:
+            return "+CGNSINF: 0,,,,,,,,,,,,,,,,,,,,"
+        fix = self.current_fix()
+        stamp = datetime.datetime.now(datetime.timezone.utc).strftime("%Y%m%d%H%M%S.000")
+        return "+CGNSINF: 1,1,%s,%.6f,%.6f,%.3f,%.2f,%.1f,1,,0.9,1.2,0.8,,12,9,,,42,," % (
+            stamp, fix.lat, fix.lon, fix.alt, fix.speed, fix.course)
+
+    def nmea_epoch(self):
+        fix = self.current_fix()
+        if fix.sentences:
+            return fix.sentences
+        now = datetime.datetime.now(datetime.timezone.utc)
+        lat, ns = to_nmea_coord(fix.lat, 2, "NS")
+        lon, ew = to_nmea_coord(fix.lon, 3, "EW")
+        hms = now.strftime("%H%M%S.000")
+        return [
+            nmea("GPGGA,%s,%s,%s,%s,%s,1,09,0.9,%.1f,M,0.0,M,," % (hms, lat, ns, lon, ew, fix.alt)),
+            nmea("GPRMC,%s,A,%s,%s,%s,%s,%.2f,%.1f,%s,,,A" % (
+                hms, lat, ns, lon, ew, fix.speed / 1.852, fix.course, now.strftime("%d%m%y"))),
+        ]
+
+    # ------------------------------------------------------------------- TCP
+
+    def tcp_open(self, host, port):
+        if self.args.broker:
+            host, _, port = self.args.broker.partition(":")
+            port = int(port or 1883)
+        try:
+            sock = socket.create_connection((host, port), timeout=5)
+        except OSError as e:
+            sys.stderr.write("CIPSTART to %s:%s failed: %s\n" % (host, port, e))
+            return False
+        sock.setblocking(False)
+        self.sock = sock
+        self.sock_rx.clear()
+        self.sel.register(sock, selectors.EVENT_READ, "tcp")
+        return True
+
+    def tcp_close(self):
+        if self.sock is not None:
+            self.sel.unregister(self.sock)
+            self.sock.close()
+            self.sock = None
+        self.data_mode = False
+
+    def tcp_send(self, data):
+        if self.sock is None:
+            return False
+        try:
+            self.sock.sendall(data)
+        except OSError:
+            return False
+        self.stats.bytes_up += len(data)
+        return True
+
+    def tcp_readable(self):
+        try:
+            data = self.sock.recv(4096)
+        except OSError:
+            data = b""
+        if not data:
+            self.tcp_close()
+            self.urc("CLOSED")
+            return
+        self.stats.bytes_down += len(data)
+        if self.data_mode:
+            self.write_now(data)
+        elif self.cipmode == 1:
+            self.sock_rx += data        # Escaped, held until ATO
+        elif self.manual_rx:
+            was_empty = not self.sock_rx
+            self.sock_rx += data
+            if was_empty:
+                self.urc("+CIPRXGET: 1")
+        else:
+            self.write_now(data)
+
+    # ------------------------------------------------------------------- PPP
+
+    def ppp_open(self):
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        os.set_blocking(master, False)
+        command = ["pppd", os.ttyname(slave), "115200", "nodetach", "noauth", "local",
+                   "nocrtscts", "passive", "%s:%s" % (self.args.ppp_local, self.args.ppp_remote),
+                   "lcp-echo-interval", "5", "lcp-echo-failure", "3"] + self.args.ppp_option
+        try:
+            self.pppd = subprocess.Popen(command, pass_fds=(slave,))
+        except OSError as e:
+            sys.stderr.write("pppd failed to start: %s\n" % e)
+            os.close(master)
+            os.close(slave)
+            return False
+        os.close(slave)
+        self.ppp_master = master
+        self.ppp_since = time.monotonic()
+        self.sel.register(master, selectors.EVENT_READ, "ppp")
+        return True
+
+    def ppp_close(self):
+        if self.ppp_master is None:
+            return
+        self.sel.unregister(self.ppp_master)
+        os.close(self.ppp_master)
+        self.ppp_master = None
+        self.pppd.terminate()
+        try:
+            self.pppd.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.pppd.kill()
+        self.pppd = None
+
+    def ppp_readable(self):
+        try:
+            data = os.read(self.ppp_master, 4096)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b""
+        if not data:
+            self.hangup("pppd exited")
+            return
+        self.stats.bytes_down += len(data)
+        # While escaped to command mode frames are lost, PPP retransmits them
+        if self.data_mode:
+            self.write_now(data)
+
+    def hangup(self, reason):
+        """Network side ends the data call, the modem reports NO CARRIER."""
+        sys.stderr.write("data call dropped: %s\n" % reason)
+        self.stats.failures["ATD"] += 1
+        self.ppp_close()
+        self.data_mode = False
+        self.plus_count = 0
+        self.urc("NO CARRIER")
+
+    def data_send(self, data):
+        if self.ppp_master is not None:
+            try:
+                os.write(self.ppp_master, data)
+            except OSError:
+                return False
+            self.stats.bytes_up += len(data)
+            return True
+        return self.tcp_send(data)
+
+    # -------------------------------------------------------------- commands
+
+    def failed(self, name):
+        rate = self.fail.get(name, self.fail.get("*", 0.0))
+        if self.rng.random() < rate:
+            self.stats.failures[name] += 1
+            return True
+        return False
+
+    def command(self, text):
+        upper = text.upper()
+        match = re.match(r"AT\+([A-Z]+)", upper)
+        name = match.group(1) if match else upper
+        if upper.startswith("ATD"):
+            name = "ATD"
+        self.stats.commands[name] += 1
+
+        if self.echo:
+            self.write_now(text.encode() + b"\r")
+
+        if self.failed(name):
+            final = {"CIPSTART": "CONNECT FAIL", "CIPSEND": "ERROR"}.get(name, "ERROR")
+            self.respond(name, final)
+            return
+
+        arg = text.split("=", 1)[1] if "=" in text else ""
+
+        if upper in ("AT", "AT&W") or name in ("CMGF", "IPR", "CGNSSEQ", "CIPMUX", "CGDCONT"):
+            self.respond(name, "OK")
+        elif upper == "ATE0" or upper == "ATE1":
+            self.echo = upper == "ATE1"
+            self.respond(name, "OK")
+        elif name == "CSQ":
+            self.respond(name, "+CSQ: %d,0" % self.args.rssi, "OK")
+        elif name == "CREG":
+            self.respond(name, "+CREG: 0,1", "OK")
+        elif name == "CGATT":
+            self.respond(name, "+CGATT: 1", "OK")
+        elif name == "CPOWD":
+            self.respond(name, "NORMAL POWER DOWN")
+        elif name == "CGNSPWR":
+            on = arg.strip() == "1"
+            if on and not self.gnss_on:
+                self.gnss_started = time.monotonic()
+            self.gnss_on = on
+            self.respond(name, "OK")
+        elif name == "CGNSINF":
+            self.respond(name, self.cgnsinf(), "OK")
+        elif name == "CGNSTST":
+            self.nmea_stream = arg.strip() == "1"
+            self.next_nmea = time.monotonic() + NMEA_PERIOD_S
+            self.respond(name, "OK")
+        elif name == "SAPBR":
+            self.sapbr(arg)
+        elif name == "CIPSHUT":
+            self.tcp_close()
+            self.respond(name, "SHUT OK")
+        elif name == "CIPMODE":
+            self.cipmode = int(arg or 0)
+            self.respond(name, "OK")
+        elif name == "CIPRXGET":
+            self.ciprxget(arg)
+        elif name == "CIPSTART":
+            self.cipstart(arg)
+        elif name == "CIPSEND":
+            self.cipsend(arg)
+        elif name == "CIPCLOSE":
+            self.tcp_close()
+            self.respond(name, "CLOSE OK")
+        elif name.startswith("HTTP"):
+            self.http_command(name, arg)
+        elif name == "ATD":
+            self.dial(upper)
+        elif upper == "ATH":
+            self.ppp_close()
+            self.respond("ATH", "OK")
+        elif upper == "ATO" and self.ppp_master is not None:
+            due = self.respond("ATO", "CONNECT")
+            self.schedule(due, self.enter_data_mode)
+        elif upper == "ATO":
+            if self.sock is not None and self.cipmode == 1:
+                due = self.respond("ATO", "CONNECT")
+                self.schedule(due, self.enter_data_mode)
+            else:
+                self.respond("ATO", "NO CARRIER")
+        else:
+            self.respond(name, "ERROR")
+
+    def dial(self, upper):
+        if not self.args.ppp or not upper.startswith("ATD*99") or self.ppp_master is not None:
+            self.respond("ATD", "NO CARRIER")
+            return
+        if not self.ppp_open():
+            self.respond("ATD", "NO CARRIER")
+            return
+        due = self.respond("ATD", "CONNECT")
+        self.schedule(due, self.enter_data_mode)
+
+    def sapbr(self, arg):
+        parts = arg.split(",")
+        op = parts[0]
+        if op == "3":
+            self.respond("SAPBR", "OK")
+        elif op == "1":
+            self.bearer_open = True
+            self.respond("SAPBR", "OK")
+        elif op == "0":
+            self.respond("SAPBR", "OK" if self.bearer_open else "ERROR")
+            self.bearer_open = False
+        elif op == "2":
+            if self.bearer_open:
+                self.respond("SAPBR", '+SAPBR: 1,1,"10.64.0.2"', "OK")
+            else:
+                self.respond("SAPBR", '+SAPBR: 1,3,"0.0.0.0"', "OK")
+        else:
+            self.respond("SAPBR", "ERROR")
+
+    def ciprxget(self, arg):
+        parts = [p for p in arg.split(",") if p]
+        if parts[:1] == ["1"]:
+            self.manual_rx = True
+            self.respond("CIPRXGET", "OK")
+        elif parts[:1] == ["0"]:
+            self.manual_rx = False
+            self.respond("CIPRXGET", "OK")
+        elif parts[:1] == ["2"] and self.sock is not None:
+            size = int(parts[1]) if len(parts) > 1 else 1460
+            data = bytes(self.sock_rx[:size])
+            del self.sock_rx[:size]
+            header = "+CIPRXGET: 2,%d,%d" % (len(data), len(self.sock_rx))
+            self.respond("CIPRXGET", raw=b"\r\n" + header.encode() + b"\r\n" + data + b"\r\nOK\r\n")
+        else:
+            self.respond("CIPRXGET", "ERROR")
+
+    def cipstart(self, arg):
+        m = re.match(r'"TCP","([^"]+)",(\d+)', arg, re.I)
+        if not m:
+            self.respond("CIPSTART", "ERROR")
+            return
+        if self.sock is not None:
+            self.respond("CIPSTART", "ALREADY CONNECT")
+            return
+        ok = self.tcp_open(m.group(1), int(m.group(2)))
+        if self.cipmode == 1:
+            due = self.respond("CIPSTART", "OK", "CONNECT" if ok else "CONNECT FAIL")
+            if ok:
+                self.schedule(due, self.enter_data_mode)
+        else:
+            self.respond("CIPSTART", "OK", "CONNECT OK" if ok else "CONNECT FAIL")
+
+    def cipsend(self, arg):
+        if self.sock is None:
+            self.respond("CIPSEND", "ERROR")
+            return
+        self.send_remaining = int(arg) if arg else 1460
+        self.send_target = "CIPSEND"
+        self.send_buf.clear()
+        self.respond("CIPSEND", raw=b"> ")
+
+    # ------------------------------------------------------------------ HTTP
+
+    def http_command(self, name, arg):
+        if name == "HTTPINIT":
+            ok = not self.http_session
+            self.http_session = True
+            self.http_params = {"CID": "1"}
+            self.respond(name, "OK" if ok else "ERROR")
+        elif not self.http_session or not self.bearer_open:
+            self.respond(name, "ERROR")
+        elif name == "HTTPTERM":
+            self.http_session = False
+            self.respond(name, "OK")
+        elif name == "HTTPPARA":
+            m = re.match(r'"([A-Z]+)","?(.*?)"?$', arg, re.I)
+            if m:
+                self.http_params[m.group(1).upper()] = m.group(2)
+            self.respond(name, "OK" if m else "ERROR")
+        elif name == "HTTPDATA":
+            size = int(arg.split(",")[0] or 0)
+            self.send_remaining = size
+            self.send_target = "HTTPDATA"
+            self.send_buf.clear()
+            self.respond(name, "DOWNLOAD")
+            if size == 0:
+                self.http_body = b""
+                self.respond(name, "OK")
+        elif name == "HTTPACTION":
+            method = int(arg or 0)
+            due = self.respond(name, "OK")
+            self.schedule(due, lambda: self.http_request(method))
+        elif name == "HTTPREAD":
+            data = self.http_response
+            self.respond(name, raw=b"\r\n+HTTPREAD: %d\r\n" % len(data) + data + b"\r\nOK\r\n")
+        else:
+            self.respond(name, "ERROR")
+
+    def http_request(self, method):
+        url = self.http_params.get("URL", "")
+        if "://" not in url:
+            url = "http://" + url
+        if self.args.http:
+            parts = urllib.parse.urlsplit(url)
+            url = urllib.parse.urlunsplit(parts._replace(netloc=self.args.http))
+        body = self.http_body if method == 1 else None
+        request = urllib.request.Request(url, data=body, method=("GET", "POST", "HEAD")[method % 3])
+        if body is not None:
+            request.add_header("Content-Type", self.http_params.get("CONTENT", "text/plain"))
+        try:
+            with urllib.request.urlopen(request, timeout=30) as reply:
+                status, data = reply.status, reply.read()
+        except urllib.error.HTTPError as e:
+            status, data = e.code, e.read()
+        except OSError as e:
+            sys.stderr.write("HTTP %s failed: %s\n" % (url, e))
+            status, data = 601, b""     # Network error
+        self.stats.bytes_up += len(body or b"")
+        self.stats.bytes_down += len(data)
+        self.http_response = data
+        self.urc("+HTTPACTION: %d,%d,%d" % (method, status, len(data)))
+
+    def enter_data_mode(self):
+        self.data_mode = True
+        self.plus_count = 0
+        if self.sock_rx:
+            self.write_now(bytes(self.sock_rx))
+            self.sock_rx.clear()
+
+    # ----------------------------------------------------------------- input
+
+    def uart_bytes(self, data, now):
+        for b in data:
+            c = bytes([b])
+            if self.data_mode:
+                self.data_byte(c, now)
+            elif self.send_remaining > 0:
+                self.send_buf += c
+                self.send_remaining -= 1
+                if self.send_remaining == 0 and self.send_target == "HTTPDATA":
+                    self.http_body = bytes(self.send_buf)
+                    self.respond("HTTPDATA", "OK")
+                elif self.send_remaining == 0:
+                    ok = self.tcp_send(bytes(self.send_buf))
+                    self.respond("CIPSEND", "SEND OK" if ok else "SEND FAIL")
+            elif c in (b"\r", b"\n"):
+                # A +++ sent while already in command mode is ignored
+                text = self.line.decode(errors="replace").strip().lstrip("+")
+                if text:
+                    self.queued.append(text)
+                self.line = bytearray()
+            else:
+                self.line += c
+        self.last_uart_rx = now
+
+    def data_byte(self, c, now):
+        # +++ counts only after a silent guard period, otherwise it's payload
+        if c == b"+" and (self.plus_count > 0 or now - self.last_uart_rx >= ESCAPE_GUARD_S):
+            self.plus_count += 1
+            self.plus_time = now
+            return
+        if self.plus_count:
+            self.data_send(b"+" * self.plus_count)
+            self.plus_count = 0
+        self.data_send(c)
+
+    def check_escape(self, now):
+        if self.data_mode and self.plus_count == 3 and now - self.plus_time >= ESCAPE_GUARD_S / 2:
+            self.data_mode = False
+            self.plus_count = 0
+            self.urc("OK")
+
+    def run_queued(self, now):
+        while self.queued and self.busy_until <= now and self.send_remaining == 0:
+            self.command(self.queued.popleft())
+
+    def tick(self, now):
+        if (self.ppp_master is not None and self.args.ppp_drop and
+                now - self.ppp_since >= self.args.ppp_drop):
+            self.hangup("--ppp-drop")
+        if self.nmea_stream and self.gnss_on and not self.data_mode and now >= self.next_nmea:
+            self.next_nmea = now + NMEA_PERIOD_S
+            for sentence in self.nmea_epoch():
+                self.write_now(sentence.encode() + b"\r\n")
+
+    # ------------------------------------------------------------------ loop
+
+    def run(self):
+        while True:
+            now = time.monotonic()
+            deadlines = [now + 0.05]
+            if self.pending:
+                deadlines.append(self.pending[0][0])
+            timeout = max(0.0, min(deadlines) - now)
+
+            for key, _ in self.sel.select(timeout):
+                if key.data == "uart":
+                    try:
+                        data = os.read(self.master, 4096)
+                    except (BlockingIOError, OSError):
+                        data = b""
+                    if data:
+                        self.uart_bytes(data, time.monotonic())
+                elif key.data == "tcp" and self.sock is not None:
+                    self.tcp_readable()
+                elif key.data == "ppp" and self.ppp_master is not None:
+                    self.ppp_readable()
+
+            now = time.monotonic()
+            self.check_escape(now)
+            self.flush_pending(now)
+            self.run_queued(now)
+            self.tick(now)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--link", help="symlink to create for the pty slave, e.g. /tmp/sim808")
+    parser.add_argument("--broker", help="host:port every CIPSTART connects to instead")
+    parser.add_argument("--latency", action="append", default=[],
+                        type=lambda v: parse_rule(v, parse_latency),
+                        metavar="CMD=MS[:JITTER]", help="response latency for a command")
+    parser.add_argument("--fail", action="append", default=[],
+                        type=lambda v: parse_rule(v, float),
+                        metavar="CMD=RATE", help="failure probability for a command")
+    parser.add_argument("--http", help="host:port every HTTPACTION goes to instead")
+    parser.add_argument("--track", help="NMEA log or CSV track to replay")
+    parser.add_argument("--rssi", type=int, default=20, help="CSQ rssi value (0-31)")
+    parser.add_argument("--seed", type=int, help="random seed for repeatable runs")
+    parser.add_argument("--ppp", action="store_true", help="bridge ATD*99***1# to pppd")
+    parser.add_argument("--ppp-drop", type=float, metavar="S",
+                        help="drop the data call after S seconds (NO CARRIER)")
+    parser.add_argument("--ppp-local", default="10.64.0.1", help="pppd's own address")
+    parser.add_argument("--ppp-remote", default="10.64.0.2", help="address given to the device")
+    parser.add_argument("--ppp-option", action="append", default=[], metavar="OPT",
+                        help="extra pppd option, repeatable")
+    args = parser.parse_args()
+
+    modem = Modem(args)
+    if args.link:
+        if os.path.islink(args.link):
+            os.unlink(args.link)
+        os.symlink(modem.slave_name, args.link)
+    print("SIM808 emulator on %s" % (args.link or modem.slave_name), flush=True)
+
+    try:
+        modem.run()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        modem.ppp_close()
+        modem.stats.report(sys.stdout)
+        if args.link and os.path.islink(args.link):
+            os.unlink(args.link)
+
+
+if __name__ == "__main__":
+    main()
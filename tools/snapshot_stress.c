@@ -0,0 +1,126 @@
+/*
+ * Host stress test of the double-buffered seqlock used for vehicle_state
+ * and the performance data. Two writer threads (the command handler and
+ * the kill switch, serialized by a mutex as on the device) flip a state
+ * the way rent commands do, while reader threads take snapshots and check
+ * that every copy is consistent: is_active and is_locked never disagree,
+ * and all counters of a copy come from the same write.
+ *
+ *   gcc -O2 -pthread -Iinclude tools/snapshot_stress.c -o snapshot_stress
+ *   ./snapshot_stress [seconds]
+ */
+
+#include "seqlock.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define READERS     2
+#define COUNTERS    24      // About the size of vehicle_performance_t
+
+typedef struct {
+    bool is_active;
+    bool is_locked;
+    uint32_t generation;
+    float counters[COUNTERS];
+    char order_id[64];
+} shared_t;
+
+static shared_t data[2];
+static seqlock_t lock;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool stop;
+static atomic_uint_fast64_t writes, reads, retries, torn;
+
+static void* writer(void* arg) {
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+
+    while (!atomic_load(&stop)) {
+        pthread_mutex_lock(&writer_mutex);
+        uint32_t seq = seqlock_write_begin(&lock);
+        shared_t* next = &data[(seq + 1) & 1];
+        *next = data[seq & 1];
+
+        // One rent command or kill, every field derived from generation
+        next->generation++;
+        next->is_active = (next->generation & 1) != 0;
+        next->is_locked = !next->is_active;
+        for (int i = 0; i < COUNTERS; i++) {
+            next->counters[i] = (float)(next->generation % 100000) + i;
+        }
+        snprintf(next->order_id, sizeof(next->order_id), "ORD-%u-%u", id, next->generation);
+
+        seqlock_write_end(&lock);
+        pthread_mutex_unlock(&writer_mutex);
+        atomic_fetch_add(&writes, 1);
+    }
+    return NULL;
+}
+
+static bool consistent(const shared_t* s) {
+    if (s->is_active == s->is_locked || s->is_active != ((s->generation & 1) != 0)) {
+        return false;
+    }
+    for (int i = 0; i < COUNTERS; i++) {
+        if (s->counters[i] != (float)(s->generation % 100000) + i) {
+            return false;
+        }
+    }
+    const char* dash = strrchr(s->order_id, '-');
+    return s->generation == 0 || (dash && strtoul(dash + 1, NULL, 10) == s->generation);
+}
+
+static void* reader(void* arg) {
+    (void)arg;
+    uint32_t last = 0;
+
+    while (!atomic_load(&stop)) {
+        shared_t snapshot;
+        uint32_t seq;
+        int attempts = 0;
+        do {
+            seq = seqlock_read_begin(&lock);
+            snapshot = data[seq & 1];
+            attempts++;
+        } while (seqlock_read_retry(&lock, seq));
+
+        atomic_fetch_add(&reads, 1);
+        atomic_fetch_add(&retries, attempts - 1);
+        if (!consistent(&snapshot) || snapshot.generation < last) {
+            atomic_fetch_add(&torn, 1);
+        }
+        last = snapshot.generation;
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int seconds = (argc > 1) ? atoi(argv[1]) : 5;
+    pthread_t writers[2], readers[READERS];
+
+    seqlock_init(&lock);
+    for (uintptr_t i = 0; i < 2; i++) {
+        pthread_create(&writers[i], NULL, writer, (void*)i);
+    }
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&readers[i], NULL, reader, NULL);
+    }
+
+    struct timespec ts = { .tv_sec = seconds };
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, true);
+    for (int i = 0; i < 2; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+
+    uint64_t r = atomic_load(&reads);
+    printf("%llu writes, %llu snapshots, %.3f%% retried, %llu inconsistent\n",
+           (unsigned long long)atomic_load(&writes), (unsigned long long)r,
+           r ? 100.0 * atomic_load(&retries) / r : 0.0, (unsigned long long)atomic_load(&torn));
+    return atomic_load(&torn) ? 1 : 0;
+}
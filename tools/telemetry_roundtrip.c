@@ -0,0 +1,424 @@
+/*
+ * Host reference decoder check for the binary telemetry encoding.
+ *
+ * For random samples of every message type it writes the JSON payload the
+ * device would publish and the binary one, decodes the binary message and
+ * compares each field with the value read back from the JSON text: numbers
+ * must agree to the fixed point resolution, strings, flags and the
+ * timestamp exactly. Prints the payload sizes of both encodings.
+ *
+ * Frames (realtime.frame) are checked the same way for random field sets,
+ * and their wire cost compared with the legacy messages they replace.
+ *
+ * A simulated drive then checks realtime.track batching: every fix must
+ * come back out of the batches, and the wire cost per km (MQTT PUBLISH
+ * header, payload and PUBACK) is compared with one location per fix.
+ *
+ *   gcc -O2 -Iinclude tools/telemetry_roundtrip.c src/telemetry_codec.c \
+ *       src/json_writer.c src/mqtt_codec.c -lm -o telemetry_roundtrip
+ *   ./telemetry_roundtrip [samples]
+ */
+
+#include "json_writer.h"
+#include "mqtt_codec.h"
+#include "telemetry_codec.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* vehicle_id = "VH-000123";
+
+// Same cadence as vehicle_tasks.c / mqtt_vehicle_client.h
+#define FIX_INTERVAL_MS     5000
+#define TRACK_BATCH_POINTS  24
+#define DRIVE_KM            100.0
+static int failures;
+
+static double frand(double lo, double hi) {
+    return lo + (hi - lo) * ((double)rand() / RAND_MAX);
+}
+
+// ISO timestamp exactly as mqtt_vehicle_client.c formats it
+static void format_timestamp(uint64_t ms, char* buf, size_t size) {
+    time_t sec = (time_t)(ms / 1000);
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + strlen(buf), size - strlen(buf), ".%03dZ", (int)(ms % 1000));
+}
+
+static const char* json_value(const char* json, const char* key) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* p = strstr(json, pattern);
+    if (p == NULL) {
+        fprintf(stderr, "missing key %s in %s\n", key, json);
+        exit(1);
+    }
+    return p + strlen(pattern);
+}
+
+// Off by at most half the fixed point step, plus the float the value is
+// decoded into
+static void check_number(const char* json, const char* key, float decoded, double resolution) {
+    double expected = strtod(json_value(json, key), NULL);
+    if (fabs(expected - decoded) > resolution / 2 + fabs(expected) * FLT_EPSILON) {
+        printf("FAIL %s: json %.9g, binary %.9g\n", key, expected, decoded);
+        failures++;
+    }
+}
+
+static void check_string(const char* json, const char* key, const char* decoded) {
+    const char* p = json_value(json, key);
+    size_t len = strlen(decoded);
+    if (p[0] != '"' || strncmp(p + 1, decoded, len) != 0 || p[1 + len] != '"') {
+        printf("FAIL %s: binary \"%s\" in %s\n", key, decoded, json);
+        failures++;
+    }
+}
+
+static void check_bool(const char* json, const char* key, bool decoded) {
+    const char* expected = decoded ? "true" : "false";
+    if (strncmp(json_value(json, key), expected, strlen(expected)) != 0) {
+        printf("FAIL %s: binary %s in %s\n", key, expected, json);
+        failures++;
+    }
+}
+
+static void decode(const uint8_t* bin, int len, telemetry_message_t* msg, const char* json) {
+    char timestamp[32];
+    if (len < 0 || telemetry_decode(bin, len, msg) != 0) {
+        printf("FAIL decode (%d bytes)\n", len);
+        exit(1);
+    }
+    format_timestamp(msg->timestamp_ms, timestamp, sizeof(timestamp));
+    check_string(json, "timestamp", timestamp);
+}
+
+// Bytes on the wire for one QoS 1 publish, PUBACK included
+static size_t publish_cost(const char* topic, size_t payload_len) {
+    uint8_t header[128];
+    int len = mqtt_encode_publish_header(header, sizeof(header), topic, payload_len, 1, false, 1);
+    return (size_t)len + payload_len + 4;
+}
+
+static void location_json(char* buf, size_t size, const telemetry_track_point_t* fix) {
+    char timestamp[32];
+    json_writer_t w;
+    format_timestamp(fix->timestamp_ms, timestamp, sizeof(timestamp));
+    json_writer_init(&w, buf, size);
+    json_begin_object(&w, NULL);
+    json_add_string(&w, "vehicle_id", vehicle_id);
+    json_add_number(&w, "latitude", fix->latitude);
+    json_add_number(&w, "longitude", fix->longitude);
+    json_add_number(&w, "altitude", fix->altitude);
+    json_add_string(&w, "timestamp", timestamp);
+    json_end_object(&w);
+}
+
+/**
+ * Drive DRIVE_KM with a fix every FIX_INTERVAL_MS, once as single location
+ * messages and once as track batches
+ */
+static void simulate_track(void) {
+    char topic_location[64];
+    char topic_track[64];
+    char json_buf[512];
+    uint8_t bin[TELEMETRY_MAX_MESSAGE];
+    uint8_t track_buf[TELEMETRY_TRACK_MAX_MESSAGE];
+    telemetry_track_point_t batch[TRACK_BATCH_POINTS];
+    static telemetry_message_t msg;
+    size_t batch_count = 0;
+    size_t fixes = 0, track_points = 0;
+    size_t json_bytes = 0, bin_bytes = 0, track_bytes = 0, track_packets = 0;
+
+    snprintf(topic_location, sizeof(topic_location), "realtime.location.%s", vehicle_id);
+    snprintf(topic_track, sizeof(topic_track), "realtime.track.%s", vehicle_id);
+
+    double lat = -7.2575, lon = 112.7521, alt = 12.0, heading = 0.3, km = 0;
+    uint64_t ts = 1700000000000ULL;
+
+    while (km < DRIVE_KM || batch_count > 0) {
+        bool driving = km < DRIVE_KM;
+        if (driving) {
+            double speed_kmh = frand(5, 60);
+            double step_km = speed_kmh * FIX_INTERVAL_MS / 3600000.0;
+            heading += frand(-0.3, 0.3);
+            lat += step_km / 111.32 * cos(heading);
+            lon += step_km / (111.32 * cos(lat * M_PI / 180)) * sin(heading);
+            alt += frand(-1.5, 1.5);
+            km += step_km;
+            ts += FIX_INTERVAL_MS + rand() % 50;
+
+            telemetry_track_point_t fix = {
+                .timestamp_ms = ts,
+                .latitude = (float)lat,
+                .longitude = (float)lon,
+                .altitude = (float)alt
+            };
+            location_json(json_buf, sizeof(json_buf), &fix);
+            json_bytes += publish_cost(topic_location, strlen(json_buf));
+            telemetry_location_t loc = { fix.latitude, fix.longitude, fix.altitude };
+            bin_bytes += publish_cost(topic_location,
+                                      telemetry_encode_location(bin, sizeof(bin), ts, &loc));
+            batch[batch_count++] = fix;
+            fixes++;
+        }
+
+        if (batch_count == TRACK_BATCH_POINTS || (!driving && batch_count > 0)) {
+            int len = telemetry_encode_track(track_buf, sizeof(track_buf), batch, batch_count);
+            if (len < 0 || telemetry_decode(track_buf, len, &msg) != 0 ||
+                msg.type != TELEMETRY_MSG_TRACK || msg.track.count != batch_count) {
+                printf("FAIL track decode (%d bytes)\n", len);
+                exit(1);
+            }
+            for (size_t i = 0; i < batch_count; i++) {
+                char timestamp[32];
+                location_json(json_buf, sizeof(json_buf), &batch[i]);
+                format_timestamp(msg.track.points[i].timestamp_ms, timestamp, sizeof(timestamp));
+                check_string(json_buf, "timestamp", timestamp);
+                check_number(json_buf, "latitude", msg.track.points[i].latitude,
+                             1.0 / TELEMETRY_COORD_SCALE);
+                check_number(json_buf, "longitude", msg.track.points[i].longitude,
+                             1.0 / TELEMETRY_COORD_SCALE);
+                check_number(json_buf, "altitude", msg.track.points[i].altitude,
+                             1.0 / TELEMETRY_ALTITUDE_SCALE);
+            }
+            track_bytes += publish_cost(topic_track, len);
+            track_packets++;
+            track_points += batch_count;
+            batch_count = 0;
+        }
+    }
+
+    if (track_points != fixes) {
+        printf("FAIL track kept %zu of %zu fixes\n", track_points, fixes);
+        failures++;
+    }
+    printf("\ndrive %.0f km, %zu fixes, every %d ms\n", DRIVE_KM, fixes, FIX_INTERVAL_MS);
+    printf("%-12s %7.0f B/km  %5.1f packets/km\n", "json", json_bytes / DRIVE_KM, fixes / DRIVE_KM);
+    printf("%-12s %7.0f B/km  %5.1f packets/km\n", "bin1", bin_bytes / DRIVE_KM, fixes / DRIVE_KM);
+    printf("%-12s %7.0f B/km  %5.1f packets/km  (%.1fx fewer bytes, %.1fx fewer packets than json)\n",
+           "track1", track_bytes / DRIVE_KM, track_packets / DRIVE_KM,
+           (double)json_bytes / track_bytes, (double)fixes / track_packets);
+}
+
+int main(int argc, char** argv) {
+    int samples = (argc > 1) ? atoi(argv[1]) : 10000;
+    size_t json_bytes[7] = {0};
+    size_t bin_bytes[7] = {0};
+    size_t legacy_wire = 0, legacy_packets = 0, frame_wire = 0;
+    char json_buf[512];
+    uint8_t bin[TELEMETRY_MAX_MESSAGE];
+    char timestamp[32];
+    json_writer_t w;
+    telemetry_message_t msg;
+
+    srand(1);
+    for (int i = 0; i < samples; i++) {
+        uint64_t ts = 1700000000000ULL + (uint64_t)i * 5000 + rand() % 1000;
+        format_timestamp(ts, timestamp, sizeof(timestamp));
+
+        // realtime.location
+        telemetry_location_t loc = {
+            .latitude = (float)frand(-90, 90),
+            .longitude = (float)frand(-180, 180),
+            .altitude = (float)frand(-100, 3000)
+        };
+        json_writer_init(&w, json_buf, sizeof(json_buf));
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "vehicle_id", vehicle_id);
+        json_add_number(&w, "latitude", loc.latitude);
+        json_add_number(&w, "longitude", loc.longitude);
+        json_add_number(&w, "altitude", loc.altitude);
+        json_add_string(&w, "timestamp", timestamp);
+        json_end_object(&w);
+        int len = telemetry_encode_location(bin, sizeof(bin), ts, &loc);
+        decode(bin, len, &msg, json_buf);
+        check_number(json_buf, "latitude", msg.location.latitude, 1.0 / TELEMETRY_COORD_SCALE);
+        check_number(json_buf, "longitude", msg.location.longitude, 1.0 / TELEMETRY_COORD_SCALE);
+        check_number(json_buf, "altitude", msg.location.altitude, 1.0 / TELEMETRY_ALTITUDE_SCALE);
+        json_bytes[TELEMETRY_MSG_LOCATION] += w.len;
+        bin_bytes[TELEMETRY_MSG_LOCATION] += len;
+        size_t legacy_len[3] = { w.len };
+
+        // realtime.status
+        telemetry_status_t status = {
+            .is_active = rand() & 1,
+            .is_locked = rand() & 1,
+            .is_killed = rand() & 1
+        };
+        json_writer_init(&w, json_buf, sizeof(json_buf));
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "vehicle_id", vehicle_id);
+        json_add_bool(&w, "is_active", status.is_active);
+        json_add_bool(&w, "is_locked", status.is_locked);
+        json_add_bool(&w, "is_killed", status.is_killed);
+        json_add_string(&w, "timestamp", timestamp);
+        json_end_object(&w);
+        len = telemetry_encode_status(bin, sizeof(bin), ts, &status);
+        decode(bin, len, &msg, json_buf);
+        check_bool(json_buf, "is_active", msg.status.is_active);
+        check_bool(json_buf, "is_locked", msg.status.is_locked);
+        check_bool(json_buf, "is_killed", msg.status.is_killed);
+        json_bytes[TELEMETRY_MSG_STATUS] += w.len;
+        bin_bytes[TELEMETRY_MSG_STATUS] += len;
+        legacy_len[1] = w.len;
+
+        // realtime.battery
+        telemetry_battery_t battery = {
+            .voltage = (float)frand(10.5, 14.6),
+            .battery_level = (float)frand(0, 100)
+        };
+        json_writer_init(&w, json_buf, sizeof(json_buf));
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "vehicle_id", vehicle_id);
+        json_add_number(&w, "device_voltage", battery.voltage);
+        json_add_number(&w, "device_battery_level", battery.battery_level);
+        json_add_string(&w, "timestamp", timestamp);
+        json_end_object(&w);
+        len = telemetry_encode_battery(bin, sizeof(bin), ts, &battery);
+        decode(bin, len, &msg, json_buf);
+        check_number(json_buf, "device_voltage", msg.battery.voltage, 1.0 / TELEMETRY_VOLTAGE_SCALE);
+        check_number(json_buf, "device_battery_level", msg.battery.battery_level,
+                     1.0 / TELEMETRY_LEVEL_SCALE);
+        json_bytes[TELEMETRY_MSG_BATTERY] += w.len;
+        bin_bytes[TELEMETRY_MSG_BATTERY] += len;
+        legacy_len[2] = w.len;
+
+        // realtime.frame, mostly all three readings of a cycle
+        telemetry_frame_t frame = {
+            .fields = (i % 4 == 0) ? 1 + rand() % 7 : 7,
+            .location = loc,
+            .status = status,
+            .battery = battery
+        };
+        json_writer_init(&w, json_buf, sizeof(json_buf));
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "vehicle_id", vehicle_id);
+        if (frame.fields & TELEMETRY_FRAME_LOCATION) {
+            json_begin_object(&w, "location");
+            json_add_number(&w, "latitude", loc.latitude);
+            json_add_number(&w, "longitude", loc.longitude);
+            json_add_number(&w, "altitude", loc.altitude);
+            json_end_object(&w);
+        }
+        if (frame.fields & TELEMETRY_FRAME_STATUS) {
+            json_begin_object(&w, "status");
+            json_add_bool(&w, "is_active", status.is_active);
+            json_add_bool(&w, "is_locked", status.is_locked);
+            json_add_bool(&w, "is_killed", status.is_killed);
+            json_end_object(&w);
+        }
+        if (frame.fields & TELEMETRY_FRAME_BATTERY) {
+            json_begin_object(&w, "battery");
+            json_add_number(&w, "device_voltage", battery.voltage);
+            json_add_number(&w, "device_battery_level", battery.battery_level);
+            json_end_object(&w);
+        }
+        json_add_string(&w, "timestamp", timestamp);
+        json_end_object(&w);
+        len = telemetry_encode_frame(bin, sizeof(bin), ts, &frame);
+        decode(bin, len, &msg, json_buf);
+        if (msg.type != TELEMETRY_MSG_FRAME || msg.frame.fields != frame.fields) {
+            printf("FAIL frame fields %02x, sent %02x\n", msg.frame.fields, frame.fields);
+            failures++;
+        }
+        if (frame.fields & TELEMETRY_FRAME_LOCATION) {
+            check_number(json_buf, "latitude", msg.frame.location.latitude, 1.0 / TELEMETRY_COORD_SCALE);
+            check_number(json_buf, "longitude", msg.frame.location.longitude, 1.0 / TELEMETRY_COORD_SCALE);
+            check_number(json_buf, "altitude", msg.frame.location.altitude, 1.0 / TELEMETRY_ALTITUDE_SCALE);
+        }
+        if (frame.fields & TELEMETRY_FRAME_STATUS) {
+            check_bool(json_buf, "is_active", msg.frame.status.is_active);
+            check_bool(json_buf, "is_locked", msg.frame.status.is_locked);
+            check_bool(json_buf, "is_killed", msg.frame.status.is_killed);
+        }
+        if (frame.fields & TELEMETRY_FRAME_BATTERY) {
+            check_number(json_buf, "device_voltage", msg.frame.battery.voltage,
+                         1.0 / TELEMETRY_VOLTAGE_SCALE);
+            check_number(json_buf, "device_battery_level", msg.frame.battery.battery_level,
+                         1.0 / TELEMETRY_LEVEL_SCALE);
+        }
+        json_bytes[TELEMETRY_MSG_FRAME] += w.len;
+        bin_bytes[TELEMETRY_MSG_FRAME] += len;
+
+        // Wire cost of the legacy messages with the same readings
+        static const char* const legacy_topics[3] = {
+            "realtime.location.VH-000123", "realtime.status.VH-000123", "realtime.battery.VH-000123"
+        };
+        for (int f = 0; f < 3; f++) {
+            if (frame.fields & (1 << f)) {
+                legacy_wire += publish_cost(legacy_topics[f], legacy_len[f]);
+                legacy_packets++;
+            }
+        }
+        frame_wire += publish_cost("realtime.frame.VH-000123", w.len);
+
+        // report.performance
+        static const char* const scores[] = { "ringan", "sedang", "berat" };
+        telemetry_performance_t perf = {
+            .front_tire = (float)frand(0, 50000),
+            .rear_tire = (float)frand(0, 50000),
+            .brake_pad = (float)frand(0, 50000),
+            .engine_oil = (float)frand(0, 5000),
+            .chain_or_cvt = (float)frand(0, 50000),
+            .engine = (float)frand(0, 50000),
+            .distance_travelled = (float)frand(0, 300),
+            .average_speed = (float)frand(0, 80),
+            .max_speed = (float)frand(0, 120)
+        };
+        snprintf(perf.order_id, sizeof(perf.order_id), "ORD-%08d", rand());
+        snprintf(perf.weight_score, sizeof(perf.weight_score), "%s", scores[rand() % 3]);
+        json_writer_init(&w, json_buf, sizeof(json_buf));
+        json_begin_object(&w, NULL);
+        json_add_string(&w, "vehicle_id", vehicle_id);
+        json_add_string(&w, "order_id", perf.order_id);
+        json_add_string(&w, "weight_score", perf.weight_score);
+        json_add_number(&w, "front_tire", perf.front_tire);
+        json_add_number(&w, "rear_tire", perf.rear_tire);
+        json_add_number(&w, "brake_pad", perf.brake_pad);
+        json_add_number(&w, "engine_oil", perf.engine_oil);
+        json_add_number(&w, "chain_or_cvt", perf.chain_or_cvt);
+        json_add_number(&w, "engine", perf.engine);
+        json_add_number(&w, "distance_travelled", perf.distance_travelled);
+        json_add_number(&w, "average_speed", perf.average_speed);
+        json_add_number(&w, "max_speed", perf.max_speed);
+        json_add_string(&w, "timestamp", timestamp);
+        json_end_object(&w);
+        len = telemetry_encode_performance(bin, sizeof(bin), ts, &perf);
+        decode(bin, len, &msg, json_buf);
+        double perf_res = 1.0 / TELEMETRY_PERF_SCALE;
+        check_string(json_buf, "order_id", msg.performance.order_id);
+        check_string(json_buf, "weight_score", msg.performance.weight_score);
+        check_number(json_buf, "front_tire", msg.performance.front_tire, perf_res);
+        check_number(json_buf, "rear_tire", msg.performance.rear_tire, perf_res);
+        check_number(json_buf, "brake_pad", msg.performance.brake_pad, perf_res);
+        check_number(json_buf, "engine_oil", msg.performance.engine_oil, perf_res);
+        check_number(json_buf, "chain_or_cvt", msg.performance.chain_or_cvt, perf_res);
+        check_number(json_buf, "engine", msg.performance.engine, perf_res);
+        check_number(json_buf, "distance_travelled", msg.performance.distance_travelled, perf_res);
+        check_number(json_buf, "average_speed", msg.performance.average_speed, perf_res);
+        check_number(json_buf, "max_speed", msg.performance.max_speed, perf_res);
+        json_bytes[TELEMETRY_MSG_PERFORMANCE] += w.len;
+        bin_bytes[TELEMETRY_MSG_PERFORMANCE] += len;
+    }
+
+    static const char* const names[] = { "", "location", "status", "battery", "performance",
+                                         "track", "frame" };
+    for (int t = TELEMETRY_MSG_LOCATION; t <= TELEMETRY_MSG_FRAME; t++) {
+        if (t == TELEMETRY_MSG_TRACK) continue;
+        printf("%-12s json %6.1f B  binary %5.1f B  (%.0f%%)\n", names[t],
+               (double)json_bytes[t] / samples, (double)bin_bytes[t] / samples,
+               100.0 * bin_bytes[t] / json_bytes[t]);
+    }
+    printf("frame vs legacy json: %.2fx fewer publishes (and PUBACKs), %.2fx fewer bytes\n",
+           (double)legacy_packets / samples, (double)legacy_wire / frame_wire);
+
+    simulate_track();
+    printf("%d samples, %d mismatches\n", samples, failures);
+    return failures ? 1 : 0;
+}